@@ -37,45 +37,6 @@ namespace zipios
 {
 
 
-namespace
-{
-
-/** \brief Search for an entry.
- *
- * This function searches for an entry that match the given name.
- * If that entry exists, the \p it parameter will be pointing
- * to it.
- *
- * The \p cep parameter is also set to the object found.
- *
- * \param[in] collections  The collections to search for the specified name.
- * \param[in] name  The name of the entry to search.
- * \param[out] cep  The pointer to the entry found.
- * \param[out] file_collection  A reference to a smarter pointer where we
- *                              can save the found file collection.
- * \param[in] matchpath  How the name of the entry is compared with \p name.
- */
-void matchEntry(
-      CollectionCollection::vector_t collections
-    , std::string const & name
-    , FileEntry::pointer_t & cep
-    , FileCollection::pointer_t & file_collection
-    , CollectionCollection::MatchPath matchpath)
-{
-    for(auto it = collections.begin(); it != collections.end(); ++it)
-    {
-        cep = (*it)->getEntry(name, matchpath);
-        if(cep)
-        {
-            file_collection = *it;
-            return;
-        }
-    }
-    cep.reset();
-    file_collection.reset();
-}
-
-} // no name namespace
 
 
 /** \class CollectionCollection
@@ -90,6 +51,20 @@ void matchEntry(
  * mounted on /. If more than one collection contain a file with
  * the same path only the one in the first added collection is
  * accessible.
+ *
+ * The names of the entries are indexed on the first search (or the
+ * first walk through the entries) so a search resolves a name to its
+ * collection and entry in constant time, whatever the number of
+ * collections. The entries of the children are also saved in
+ * m_entries, in order, so walking all the entries of a
+ * CollectionCollection does not require a concatenation. Children
+ * which load their entries lazily, such as a DirectoryCollection,
+ * only get loaded at that time.
+ *
+ * The index is a snapshot of the entries of the children taken when
+ * it gets built. Adding a collection invalidates it so it is built
+ * again on the next search. The children are clones owned by the
+ * CollectionCollection so they do not otherwise change.
  */
 
 
@@ -114,8 +89,13 @@ CollectionCollection::CollectionCollection()
  * \param[in] rhs  The source to copy in the new CollectionCollection.
  */
 CollectionCollection::CollectionCollection(CollectionCollection const & rhs)
-    : FileCollection(rhs)
+    : FileCollection(rhs.m_filename)
 {
+    // the entries are not copied from rhs, they are added back along
+    // their collection
+    //
+    m_valid = rhs.m_valid;
+
     m_collections.reserve(rhs.m_collections.size());
     for(auto it = rhs.m_collections.begin(); it != rhs.m_collections.end(); ++it)
     {
@@ -136,11 +116,14 @@ CollectionCollection::CollectionCollection(CollectionCollection const & rhs)
  */
 CollectionCollection & CollectionCollection::operator = (CollectionCollection const & rhs)
 {
-    FileCollection::operator = (rhs);
-
     if(this != &rhs)
     {
+        m_filename = rhs.m_filename;
+        m_valid = rhs.m_valid;
+        invalidateIndex();
+
         m_collections.clear();
+        invalidateOverlay();
         // A call to the CollectionCollection::size() function has side
         // effects, try to avoid them at this time
         //m_collections.reserve(rhs.m_collections.size());
@@ -211,6 +194,7 @@ bool CollectionCollection::addCollection(FileCollection const & collection)
     }
 
     m_collections.push_back(collection.clone());
+    invalidateOverlay();
 
     return true;
 }
@@ -277,38 +261,12 @@ void CollectionCollection::close()
         (*it)->close();
     }
     m_collections.clear();
+    invalidateOverlay();
 
     FileCollection::close();
 }
 
 
-/** \brief Retrieve a vector to all the collection entries.
- *
- * This function gathers the entries of all the children collections
- * and add them to a vector that it then returns.
- *
- * The CollectionCollection itself has no entries.
- *
- * It is possible to define a CollectionCollection as a child of
- * another CollectionCollection. The process repeats infinitum
- * as required.
- *
- * \return A copy of all the entries found in the child Collections.
- */
-FileEntry::vector_t CollectionCollection::entries() const
-{
-    mustBeValid();
-
-    FileEntry::vector_t all_entries;
-    for(auto it = m_collections.begin(); it != m_collections.end(); ++it)
-    {
-        all_entries += (*it)->entries();
-    }
-
-    return all_entries;
-}
-
-
 /** \brief Get an entry from the collection.
  *
  * This function returns a shared pointer to a FileEntry object for
@@ -345,15 +303,29 @@ FileEntry::vector_t CollectionCollection::entries() const
  */
 FileEntry::pointer_t CollectionCollection::getEntry(std::string const & name, MatchPath matchpath) const
 {
-    mustBeValid();
-
-    // Returns the first matching entry.
-    FileCollection::pointer_t file_collection;
-    FileEntry::pointer_t cep;
+    return findEntry(name, matchpath);
+}
 
-    matchEntry(m_collections, name, cep, file_collection, matchpath);
 
-    return cep;
+/** \brief Search an entry in the collections without allocating.
+ *
+ * This function is the same as getEntry() with a string view as the
+ * name. The entry found is the one of the first collection that
+ * includes an entry with that name.
+ *
+ * \param[in] name  The name of the entry to search.
+ * \param[in] matchpath  Specify MatchPath::MATCH, if the path should match
+ *                       as well, specify MatchPath::IGNORE, if the path
+ *                       should be ignored.
+ *
+ * \return A shared pointer to the found entry. The returned pointer
+ *         is null if no entry is found.
+ *
+ * \sa getEntry()
+ */
+FileEntry::pointer_t CollectionCollection::findEntry(std::string_view name, MatchPath matchpath) const
+{
+    return resolve(name, matchpath).m_entry;
 }
 
 
@@ -388,39 +360,152 @@ FileEntry::pointer_t CollectionCollection::getEntry(std::string const & name, Ma
  */
 CollectionCollection::stream_pointer_t CollectionCollection::getInputStream(std::string const & entry_name, MatchPath matchpath)
 {
-    mustBeValid();
-
-    FileCollection::pointer_t file_collection;
-    FileEntry::pointer_t cep;
+    overlay_entry_t const e(resolve(entry_name, matchpath));
+    return e.m_entry == nullptr ? nullptr : e.m_collection->getEntryInputStream(e.m_entry);
+}
 
-    matchEntry(m_collections, entry_name, cep, file_collection, matchpath);
 
-    return cep ? file_collection->getInputStream(entry_name) : nullptr;
+/** \brief Retrieve an istream for one of the entries of this collection.
+ *
+ * This function opens \p entry using the collection it was found in.
+ * This is used when this CollectionCollection is itself a child of
+ * another CollectionCollection.
+ *
+ * \param[in] entry  The entry to open.
+ *
+ * \return A shared pointer to an open istream for the specified entry
+ *         or a null pointer if \p entry is not visible in this collection.
+ */
+CollectionCollection::stream_pointer_t CollectionCollection::getEntryInputStream(FileEntry::pointer_t entry)
+{
+    overlay_entry_t const e(resolve(entry->getName(), MatchPath::MATCH));
+    return e.m_entry == nullptr || e.m_entry != entry ? nullptr : e.m_collection->getEntryInputStream(entry);
 }
 
 
-/** \brief Return the size of the of this collection.
+/** \brief Make sure the overlay index and m_entries are built.
  *
- * This function computes the total size of this collection which
- * is to sum of the size of its child collections.
+ * The overlay index gets built the first time an entry is searched or
+ * the entries are accessed, and again after the list of collections
+ * changed. The index is built once, even when several threads call
+ * this function simultaneously.
  *
  * \warning
  * This function has the side effect of loading all the data from
  * DirectoryCollection objects.
+ */
+void CollectionCollection::loadEntries() const
+{
+    if(m_overlay_valid.load(std::memory_order_acquire))
+    {
+        return;
+    }
+
+    std::unique_lock<std::shared_mutex> lock(m_overlay_mutex);
+    if(!m_overlay_valid.load(std::memory_order_relaxed))
+    {
+        buildOverlay();
+    }
+}
+
+
+/** \brief Build the overlay index from all the collections.
+ *
+ * This function adds the entries of each collection to the overlay
+ * index and m_entries, in the order the collections were added. The
+ * index and m_entries were cleared by invalidateOverlay().
  *
- * \return The total size of the collection.
+ * \note
+ * The function is called with m_overlay_mutex locked exclusively.
  */
-size_t CollectionCollection::size() const
+void CollectionCollection::buildOverlay() const
 {
-    mustBeValid();
+    for(auto const & collection : m_collections)
+    {
+        addToOverlay(collection);
+    }
 
-    size_t sz(0);
-    for(auto it = m_collections.begin(); it != m_collections.end(); ++it)
+    m_overlay_valid.store(true, std::memory_order_release);
+}
+
+
+/** \brief Add the entries of a collection to the overlay index.
+ *
+ * This function appends the entries of \p collection to m_entries and
+ * adds their names to the full path and basename indexes. A name which
+ * is already defined by a previously added collection is ignored so the
+ * first collection wins, as expected.
+ *
+ * \param[in] collection  The collection of which entries get added.
+ */
+void CollectionCollection::addToOverlay(FileCollection::pointer_t collection) const
+{
+    for(auto const & entry : *collection)
     {
-        sz += (*it)->size();
+        const_cast<CollectionCollection *>(this)->m_entries.push_back(entry);
+
+        std::string name_str(entry->getName());
+        if(m_overlay.find(name_str) != m_overlay.end())
+        {
+            // shadowed by a previous collection (the basename is
+            // then necessarily defined too)
+            //
+            continue;
+        }
+
+        // a deque does not move its items when we push more so the
+        // views remain valid
+        //
+        m_overlay_names.push_back(std::move(name_str));
+        std::string_view const name(m_overlay_names.back());
+        overlay_entry_t const e{ collection, entry };
+        m_overlay.emplace(name, e);
+
+        std::string_view::size_type const pos(name.find_last_of(g_separator));
+        m_filename_overlay.emplace(pos == std::string_view::npos ? name : name.substr(pos + 1), e);
     }
+}
+
+
+/** \brief Mark the overlay index as out of date.
+ *
+ * The next search or access to the entries rebuilds the overlay index
+ * and m_entries from the current list of collections. In the meantime
+ * the entries of the previous collections get released.
+ */
+void CollectionCollection::invalidateOverlay()
+{
+    m_overlay_valid.store(false, std::memory_order_release);
+
+    m_entries.clear();
+    m_overlay.clear();
+    m_filename_overlay.clear();
+    m_overlay_names.clear();
+}
+
+
+/** \brief Find the collection and entry corresponding to a name.
+ *
+ * This function searches the overlay index for \p name. The index is
+ * built first if necessary. The search holds a shared lock on the
+ * index so it does not run while another thread builds it.
+ *
+ * \param[in] name  The name of the entry to search.
+ * \param[in] matchpath  Whether the full path or just the filename is matched.
+ *
+ * \return The collection and entry found, both null if \p name is not
+ *         defined.
+ */
+CollectionCollection::overlay_entry_t CollectionCollection::resolve(std::string_view name, MatchPath matchpath) const
+{
+    mustBeValid();
+
+    loadEntries();
 
-    return sz;
+    overlay_t const & overlay(matchpath == MatchPath::MATCH ? m_overlay : m_filename_overlay);
+    std::shared_lock<std::shared_mutex> lock(m_overlay_mutex);
+    auto const it(overlay.find(name));
+    return it == overlay.end() ? overlay_entry_t() : it->second;
 }
 
 
@@ -0,0 +1,792 @@
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (c) 2015-2022  Made to Order Software Corp.  All Rights Reserved
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Implementation of the compression backends.
+ *
+ * This file defines the functions used to select the compression
+ * engine, the base classes of the backends, and the zlib backend.
+ */
+
+#include "compressionbackend.hpp"
+#include "inflatepool.hpp"
+
+#include "zipios/zipiosexceptions.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+
+#include <zlib.h>
+
+
+namespace zipios
+{
+
+
+namespace
+{
+
+
+/** \brief The engine used by the streams created from now on.
+ *
+ * The default is zlib.
+ */
+std::atomic<CompressionEngine>  g_compression_engine(CompressionEngine::ZLIB);
+
+
+/** \brief Inflate raw deflate streams with zlib.
+ *
+ * This backend wraps a z_stream. It supports the checkpoints used by
+ * the InflateIndex.
+ *
+ * zlib sizes are limited to 32 bits so larger input buffers are fed
+ * to zlib in chunks and the output is limited to 4 GiB per call.
+ */
+class ZlibInflateBackend
+    : public InflateBackend
+{
+public:
+    virtual ~ZlibInflateBackend() override
+    {
+        if(m_initialized)
+        {
+            inflateEnd(&m_zs);
+        }
+    }
+
+    virtual CompressionEngine getEngine() const override
+    {
+        return CompressionEngine::ZLIB;
+    }
+
+    virtual bool reset() override
+    {
+        m_zs.next_in = nullptr;
+        m_zs.avail_in = 0;
+        m_pending_in = 0;
+
+        if(m_initialized)
+        {
+            m_last_error = inflateReset(&m_zs);
+        }
+        else
+        {
+            // windowBits is passed < 0 to tell that there is no zlib header
+            //
+            m_last_error = inflateInit2(&m_zs, -MAX_WBITS);
+            m_initialized = m_last_error == Z_OK;
+        }
+
+        return m_last_error == Z_OK;
+    }
+
+    virtual void setInput(void const * buffer, size_t size) override
+    {
+        m_zs.next_in = reinterpret_cast<Bytef *>(const_cast<void *>(buffer));
+        m_zs.avail_in = static_cast<uInt>(std::min(size, static_cast<size_t>(std::numeric_limits<uInt>::max())));
+        m_pending_in = size - m_zs.avail_in;
+    }
+
+    virtual size_t getAvailableInput() const override
+    {
+        return m_zs.avail_in + m_pending_in;
+    }
+
+    virtual status_t inflate(void * buffer, size_t & size, flush_t flush) override
+    {
+        if(m_zs.avail_in == 0
+        && m_pending_in > 0)
+        {
+            m_zs.avail_in = static_cast<uInt>(std::min(m_pending_in, static_cast<size_t>(std::numeric_limits<uInt>::max())));
+            m_pending_in -= m_zs.avail_in;
+        }
+
+        // zlib refuses a null output pointer, even when empty
+        //
+        Bytef empty(0);
+        uInt const max_out(static_cast<uInt>(std::min(size, static_cast<size_t>(std::numeric_limits<uInt>::max()))));
+        m_zs.next_out = buffer == nullptr ? &empty : reinterpret_cast<Bytef *>(buffer);
+        m_zs.avail_out = max_out;
+
+        int zflush(Z_NO_FLUSH);
+        switch(flush)
+        {
+        case flush_t::NO_FLUSH:
+            break;
+
+        case flush_t::BLOCK:
+            zflush = Z_BLOCK;
+            break;
+
+        case flush_t::FINISH:
+            // only the last chunk of a large input is the end
+            //
+            zflush = m_pending_in == 0 ? Z_FINISH : Z_NO_FLUSH;
+            break;
+
+        }
+
+        m_last_error = ::inflate(&m_zs, zflush);
+        size = max_out - m_zs.avail_out;
+
+        switch(m_last_error)
+        {
+        case Z_OK:
+            return status_t::OK;
+
+        case Z_STREAM_END:
+            return status_t::STREAM_END;
+
+        case Z_BUF_ERROR:
+            return status_t::BUFFER_ERROR;
+
+        default:
+            return status_t::DATA_ERROR;
+
+        }
+    }
+
+    virtual std::string getErrorMessage() const override
+    {
+        return zError(m_last_error);
+    }
+
+    virtual bool supportsCheckpoints() const override
+    {
+        return true;
+    }
+
+    virtual bool atBlockBoundary() const override
+    {
+        // bit 7 is set at the end of a block, bit 6 while in the
+        // last block, after which there is no block to restart from
+        //
+        return (m_zs.data_type & 192) == 128;
+    }
+
+    virtual int getPendingBits() const override
+    {
+        return m_zs.data_type & 7;
+    }
+
+    virtual size_t getWindow(unsigned char * window) const override
+    {
+        uInt size(0);
+        if(inflateGetDictionary(const_cast<z_stream *>(&m_zs), window, &size) != Z_OK)
+        {
+            return 0; // LCOV_EXCL_LINE
+        }
+        return size;
+    }
+
+    virtual bool restore(int bits, int value, unsigned char const * window, size_t size) override
+    {
+        if(bits != 0
+        && inflatePrime(&m_zs, bits, value) != Z_OK)
+        {
+            return false; // LCOV_EXCL_LINE
+        }
+        return size == 0
+            || inflateSetDictionary(&m_zs, window, static_cast<uInt>(size)) == Z_OK;
+    }
+
+private:
+    z_stream                m_zs = z_stream();
+    bool                    m_initialized = false;
+    size_t                  m_pending_in = 0;
+    int                     m_last_error = Z_OK;
+};
+
+
+/** \brief Deflate raw deflate streams with zlib.
+ *
+ * This backend wraps a z_stream initialized with deflateInit2().
+ */
+class ZlibDeflateBackend
+    : public DeflateBackend
+{
+public:
+    ZlibDeflateBackend(int level)
+    {
+        // windowBits is passed -MAX_WBITS to tell that no zlib
+        // header should be written
+        //
+        int const default_mem_level(8);
+        m_last_error = deflateInit2(&m_zs, level, Z_DEFLATED, -MAX_WBITS, default_mem_level, Z_DEFAULT_STRATEGY);
+        if(m_last_error != Z_OK)
+        {
+            // Not too sure how we could generate an error here, the
+            // deflateInit2() would fail if (1) there is not enough memory
+            // and (2) if a parameter is out of wack which neither can be
+            // generated from the outside (well... not easily)
+            throw IOException(std::string("DeflateBackend::create(): error while initializing zlib, ") + zError(m_last_error)); // LCOV_EXCL_LINE
+        }
+    }
+
+    virtual ~ZlibDeflateBackend() override
+    {
+        deflateEnd(&m_zs);
+    }
+
+    virtual CompressionEngine getEngine() const override
+    {
+        return CompressionEngine::ZLIB;
+    }
+
+    virtual void setInput(void const * buffer, size_t size) override
+    {
+        m_zs.next_in = reinterpret_cast<Bytef *>(const_cast<void *>(buffer));
+        m_zs.avail_in = static_cast<uInt>(std::min(size, static_cast<size_t>(std::numeric_limits<uInt>::max())));
+        m_pending_in = size - m_zs.avail_in;
+    }
+
+    virtual size_t getAvailableInput() const override
+    {
+        return m_zs.avail_in + m_pending_in;
+    }
+
+    virtual status_t deflate(void * buffer, size_t & size, bool finish) override
+    {
+        if(m_zs.avail_in == 0
+        && m_pending_in > 0)
+        {
+            m_zs.avail_in = static_cast<uInt>(std::min(m_pending_in, static_cast<size_t>(std::numeric_limits<uInt>::max())));
+            m_pending_in -= m_zs.avail_in;
+        }
+
+        uInt const max_out(static_cast<uInt>(std::min(size, static_cast<size_t>(std::numeric_limits<uInt>::max()))));
+        m_zs.next_out = reinterpret_cast<Bytef *>(buffer);
+        m_zs.avail_out = max_out;
+
+        m_last_error = ::deflate(&m_zs, finish && m_pending_in == 0 ? Z_FINISH : Z_NO_FLUSH);
+        size = max_out - m_zs.avail_out;
+
+        switch(m_last_error)
+        {
+        case Z_OK:
+            return status_t::OK;
+
+        case Z_STREAM_END:
+            return status_t::STREAM_END;
+
+        default:
+            return status_t::STREAM_ERROR; // LCOV_EXCL_LINE
+
+        }
+    }
+
+    virtual std::string getErrorMessage() const override
+    {
+        return zError(m_last_error);
+    }
+
+    virtual bool supportsBlocks() const override
+    {
+        return true;
+    }
+
+    virtual bool startBlock(void const * dictionary, size_t size) override
+    {
+        m_pending_in = 0;
+        m_last_error = deflateReset(&m_zs);
+        if(m_last_error == Z_OK
+        && size > 0)
+        {
+            m_last_error = deflateSetDictionary(&m_zs, reinterpret_cast<Bytef const *>(dictionary), static_cast<uInt>(size));
+        }
+        return m_last_error == Z_OK;
+    }
+
+    virtual status_t flushBlock(void * buffer, size_t & size) override
+    {
+        if(m_zs.avail_in == 0
+        && m_pending_in > 0)
+        {
+            m_zs.avail_in = static_cast<uInt>(std::min(m_pending_in, static_cast<size_t>(std::numeric_limits<uInt>::max())));
+            m_pending_in -= m_zs.avail_in;
+        }
+
+        uInt const max_out(static_cast<uInt>(std::min(size, static_cast<size_t>(std::numeric_limits<uInt>::max()))));
+        m_zs.next_out = reinterpret_cast<Bytef *>(buffer);
+        m_zs.avail_out = max_out;
+
+        m_last_error = ::deflate(&m_zs, m_pending_in == 0 ? Z_SYNC_FLUSH : Z_NO_FLUSH);
+        size = max_out - m_zs.avail_out;
+
+        if(m_last_error != Z_OK)
+        {
+            return status_t::STREAM_ERROR; // LCOV_EXCL_LINE
+        }
+
+        // the flush is complete once zlib did not fill the whole buffer
+        //
+        return m_pending_in == 0 && m_zs.avail_in == 0 && m_zs.avail_out > 0
+                    ? status_t::STREAM_END
+                    : status_t::OK;
+    }
+
+private:
+    z_stream                m_zs = z_stream();
+    size_t                  m_pending_in = 0;
+    int                     m_last_error = Z_OK;
+};
+
+
+} // no name namespace
+
+
+
+/** \brief Check whether an engine was compiled in.
+ *
+ * zlib is always available.
+ *
+ * \param[in] engine  The engine to check.
+ *
+ * \return true if \p engine can be used.
+ */
+bool isCompressionEngineAvailable(CompressionEngine engine)
+{
+    switch(engine)
+    {
+    case CompressionEngine::ZLIB:
+        return true;
+
+    }
+
+    return false;
+}
+
+
+/** \brief Select the engine used to compress and decompress data.
+ *
+ * The engine applies to the streams and buffers processed after the
+ * call. Streams which are already open keep their engine.
+ *
+ * All the engines read and write standard raw deflate streams so data
+ * compressed by one engine can be decompressed by any other. The
+ * compressed bytes are not identical from one engine to another.
+ *
+ * A backend which does not support checkpoints (see
+ * ZipFile::setCheckpointInterval()) or blocks still works; seeking
+ * then inflates from the start and the parallel compression is
+ * done with zlib.
+ *
+ * \exception InvalidException
+ * This exception is raised if \p engine was not compiled in.
+ *
+ * \param[in] engine  The engine to use from now on.
+ */
+void setCompressionEngine(CompressionEngine engine)
+{
+    if(!isCompressionEngineAvailable(engine))
+    {
+        throw InvalidException(std::string("setCompressionEngine(): the \"")
+                             + getCompressionEngineName(engine)
+                             + "\" compression engine is not available in this build.");
+    }
+
+    g_compression_engine = engine;
+}
+
+
+/** \brief Retrieve the engine currently in use.
+ *
+ * \return The engine selected with setCompressionEngine() or zlib.
+ */
+CompressionEngine getCompressionEngine()
+{
+    return g_compression_engine;
+}
+
+
+/** \brief Retrieve the name of an engine.
+ *
+ * \param[in] engine  The engine to name.
+ *
+ * \return The name of the library behind \p engine.
+ */
+char const * getCompressionEngineName(CompressionEngine engine)
+{
+    switch(engine)
+    {
+    case CompressionEngine::ZLIB:
+        return "zlib";
+
+    }
+
+    return "unknown";
+}
+
+
+
+/** \class InflateBackend
+ * \brief Decompress a raw deflate stream.
+ *
+ * An InflateBackend decompresses a raw deflate stream (no zlib or gzip
+ * header) with the library selected by the CompressionEngine. The
+ * interface follows the zlib streaming model: the input is attached
+ * with setInput() and inflate() is called until it returns something
+ * other than status_t::OK.
+ *
+ * The optional checkpoint functions let the InflateInputStreambuf
+ * save and restore the state of the stream at block boundaries, see
+ * InflateIndex.
+ */
+
+
+/** \brief Create an inflate backend.
+ *
+ * The backend must be reset() before use.
+ *
+ * \param[in] engine  The engine to use.
+ *
+ * \return The new backend.
+ */
+InflateBackend::pointer_t InflateBackend::create(CompressionEngine engine)
+{
+    // zlib is the only engine at this time
+    //
+    static_cast<void>(engine);
+    return std::make_unique<ZlibInflateBackend>();
+}
+
+
+/** \brief Clean up the backend.
+ *
+ * The destructor of the implementation releases the library state.
+ */
+InflateBackend::~InflateBackend()
+{
+}
+
+
+/** \fn InflateBackend::getEngine() const;
+ * \brief Retrieve the engine used by this backend.
+ *
+ * \return The engine of the backend.
+ */
+
+
+/** \fn InflateBackend::reset();
+ * \brief Prepare the backend for a new stream.
+ *
+ * This function initializes the library state the first time and
+ * resets it afterward. Any pending input is dropped.
+ *
+ * \return true if the backend is ready.
+ */
+
+
+/** \fn InflateBackend::setInput(void const * buffer, size_t size);
+ * \brief Attach the next chunk of compressed data.
+ *
+ * The buffer must remain valid until getAvailableInput() returns 0.
+ *
+ * \param[in] buffer  The compressed data.
+ * \param[in] size  The number of bytes in \p buffer.
+ */
+
+
+/** \fn InflateBackend::getAvailableInput() const;
+ * \brief Retrieve the number of input bytes not yet consumed.
+ *
+ * \return The number of bytes of the last setInput() still to be read.
+ */
+
+
+/** \fn InflateBackend::inflate(void * buffer, size_t & size, flush_t flush);
+ * \brief Decompress data.
+ *
+ * This function decompresses data in \p buffer. On return \p size is
+ * set to the number of bytes saved in \p buffer.
+ *
+ * Use flush_t::FINISH once the last input chunk was attached and
+ * flush_t::BLOCK to stop at each block boundary (see atBlockBoundary().)
+ *
+ * \param[out] buffer  The buffer receiving the data.
+ * \param[in,out] size  The size of \p buffer, then the number of bytes
+ *                      saved in it.
+ * \param[in] flush  How to flush the data.
+ *
+ * \return status_t::OK if more data can be decompressed,
+ *         status_t::STREAM_END at the end of the stream,
+ *         status_t::BUFFER_ERROR if no progress was possible,
+ *         status_t::DATA_ERROR if the data is invalid.
+ */
+
+
+/** \fn InflateBackend::getErrorMessage() const;
+ * \brief Describe the last error.
+ *
+ * \return A message describing the last error of the library.
+ */
+
+
+/** \brief Check whether the backend supports checkpoints.
+ *
+ * \return true if atBlockBoundary(), getPendingBits(), getWindow() and
+ *         restore() are implemented.
+ */
+bool InflateBackend::supportsCheckpoints() const
+{
+    return false;
+}
+
+
+/** \brief Check whether the last inflate() stopped between two blocks.
+ *
+ * \return true if a checkpoint can be taken now.
+ */
+bool InflateBackend::atBlockBoundary() const
+{
+    return false;
+}
+
+
+/** \brief Retrieve the number of bits of the last input byte not used.
+ *
+ * \return The number of bits, 0 to 7, of the byte before the current
+ *         input position which belong to the next block.
+ */
+int InflateBackend::getPendingBits() const
+{
+    return 0;
+}
+
+
+/** \brief Retrieve the last 32 KiB of decompressed data.
+ *
+ * \param[out] window  A buffer of at least 32 KiB.
+ *
+ * \return The number of bytes saved in \p window.
+ */
+size_t InflateBackend::getWindow(unsigned char * window) const
+{
+    static_cast<void>(window);
+    return 0;
+}
+
+
+/** \brief Restore the state saved at a checkpoint.
+ *
+ * The backend must be reset() first and the input positioned right
+ * after the byte holding the pending bits.
+ *
+ * \param[in] bits  The number of pending bits.
+ * \param[in] value  The pending bits.
+ * \param[in] window  The window saved with getWindow().
+ * \param[in] size  The size of \p window.
+ *
+ * \return true if the state was restored.
+ */
+bool InflateBackend::restore(int bits, int value, unsigned char const * window, size_t size)
+{
+    static_cast<void>(bits);
+    static_cast<void>(value);
+    static_cast<void>(window);
+    static_cast<void>(size);
+    return false;
+}
+
+
+
+/** \class DeflateBackend
+ * \brief Compress data in a raw deflate stream.
+ *
+ * A DeflateBackend compresses data in a raw deflate stream (no zlib
+ * or gzip header) with the library selected by the CompressionEngine.
+ */
+
+
+/** \brief Create a deflate backend.
+ *
+ * \exception IOException
+ * This exception is raised if the library cannot be initialized.
+ *
+ * \param[in] level  The zlib compression level, 1 to 9, or -1 for the
+ *                   default level.
+ * \param[in] engine  The engine to use.
+ *
+ * \return The new backend, ready to compress data.
+ */
+DeflateBackend::pointer_t DeflateBackend::create(int level, CompressionEngine engine)
+{
+    // zlib is the only engine at this time
+    //
+    static_cast<void>(engine);
+    return std::make_unique<ZlibDeflateBackend>(level);
+}
+
+
+/** \brief Clean up the backend.
+ *
+ * The destructor of the implementation releases the library state.
+ */
+DeflateBackend::~DeflateBackend()
+{
+}
+
+
+/** \fn DeflateBackend::deflate(void * buffer, size_t & size, bool finish);
+ * \brief Compress data.
+ *
+ * This function compresses the input attached with setInput() in
+ * \p buffer. On return \p size is set to the number of bytes saved
+ * in \p buffer. Once all the data was attached, call it with \p finish
+ * set to true until it returns status_t::STREAM_END.
+ *
+ * \param[out] buffer  The buffer receiving the compressed data.
+ * \param[in,out] size  The size of \p buffer, then the number of bytes
+ *                      saved in it.
+ * \param[in] finish  Whether all the input was attached.
+ *
+ * \return status_t::OK, status_t::STREAM_END once all the data was
+ *         output after a finish, or status_t::STREAM_ERROR.
+ */
+
+
+/** \fn DeflateBackend::getErrorMessage() const;
+ * \brief Describe the last error.
+ *
+ * \return A message describing the last error of the library.
+ */
+
+
+/** \brief Check whether the backend can compress independent blocks.
+ *
+ * \return true if startBlock() and flushBlock() are implemented.
+ */
+bool DeflateBackend::supportsBlocks() const
+{
+    return false;
+}
+
+
+/** \brief Start compressing a new block.
+ *
+ * This function resets the backend and primes it with \p dictionary,
+ * usually the last 32 KiB of the data preceding the block, so the
+ * block can refer to that data. The data of the block is then attached
+ * with setInput().
+ *
+ * A block ends with flushBlock() or, if it is the last one, with
+ * deflate() and \p finish set to true. The output of consecutive
+ * blocks, concatenated, is one valid raw deflate stream.
+ *
+ * \param[in] dictionary  The data preceding the block.
+ * \param[in] size  The size of \p dictionary, 0 for the first block.
+ *
+ * \return true if the backend is ready to compress the block.
+ */
+bool DeflateBackend::startBlock(void const * dictionary, size_t size)
+{
+    static_cast<void>(dictionary);
+    static_cast<void>(size);
+    return false;
+}
+
+
+/** \brief Compress the block and end it on a byte boundary.
+ *
+ * This function works like deflate() except that the stream is not
+ * terminated. Instead the output ends with an empty stored block
+ * (a sync flush) so the next block can be appended as is. Call it
+ * until it returns status_t::STREAM_END.
+ *
+ * \param[out] buffer  The buffer receiving the compressed data.
+ * \param[in,out] size  The size of \p buffer, then the number of bytes
+ *                      saved in it.
+ *
+ * \return status_t::OK, status_t::STREAM_END once the whole block was
+ *         output, or status_t::STREAM_ERROR.
+ */
+DeflateBackend::status_t DeflateBackend::flushBlock(void * buffer, size_t & size)
+{
+    static_cast<void>(buffer);
+    size = 0;
+    return status_t::STREAM_ERROR;
+}
+
+
+
+/** \brief Decompress a whole buffer at once.
+ *
+ * This function decompresses the raw deflate stream \p input in
+ * \p output. It succeeds only if the stream ends after exactly
+ * \p output_size bytes.
+ *
+ * \param[in] input  The compressed data.
+ * \param[in] input_size  The size of the compressed data.
+ * \param[out] output  The buffer receiving the decompressed data.
+ * \param[in] output_size  The size of the decompressed data.
+ * \param[in] engine  The engine to use.
+ *
+ * \return true if the data was decompressed.
+ */
+bool inflateBuffer(
+          void const * input
+        , size_t input_size
+        , void * output
+        , size_t output_size
+        , CompressionEngine engine)
+{
+    // the backends of the current engine are recycled by the pool
+    //
+    bool const pooled(engine == getCompressionEngine());
+    InflateBackend::pointer_t backend(pooled
+                                        ? acquireInflateBackend()
+                                        : InflateBackend::create(engine));
+    if(!backend->reset())
+    {
+        return false; // LCOV_EXCL_LINE
+    }
+    backend->setInput(input, input_size);
+
+    char * out(static_cast<char *>(output));
+    size_t inflated(0);
+    InflateBackend::status_t status(InflateBackend::status_t::OK);
+    while(status == InflateBackend::status_t::OK)
+    {
+        size_t size(output_size - inflated);
+        status = backend->inflate(out + inflated, size, InflateBackend::flush_t::FINISH);
+        inflated += size;
+    }
+
+    if(pooled)
+    {
+        releaseInflateBackend(std::move(backend));
+    }
+
+    return status == InflateBackend::status_t::STREAM_END
+        && inflated == output_size;
+}
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
@@ -0,0 +1,128 @@
+#pragma once
+#ifndef COMPRESSIONBACKEND_HPP
+#define COMPRESSIONBACKEND_HPP
+
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (c) 2015-2022  Made to Order Software Corp.  All Rights Reserved
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Declaration of the compression backends.
+ *
+ * The zipios::InflateBackend and zipios::DeflateBackend classes hide
+ * the library used to decompress and compress raw deflate streams so
+ * the stream buffers do not depend on zlib directly.
+ */
+
+#include "zipios/compressionengine.hpp"
+
+#include <memory>
+#include <string>
+
+
+namespace zipios
+{
+
+
+class InflateBackend
+{
+public:
+    typedef std::unique_ptr<InflateBackend>     pointer_t;
+
+    enum class flush_t
+    {
+        NO_FLUSH,
+        BLOCK,
+        FINISH
+    };
+
+    enum class status_t
+    {
+        OK,
+        STREAM_END,
+        BUFFER_ERROR,
+        DATA_ERROR
+    };
+
+    static pointer_t        create(CompressionEngine engine = getCompressionEngine());
+
+    virtual                 ~InflateBackend();
+
+    virtual CompressionEngine getEngine() const = 0;
+    virtual bool            reset() = 0;
+    virtual void            setInput(void const * buffer, size_t size) = 0;
+    virtual size_t          getAvailableInput() const = 0;
+    virtual status_t        inflate(void * buffer, size_t & size, flush_t flush) = 0;
+    virtual std::string     getErrorMessage() const = 0;
+
+    virtual bool            supportsCheckpoints() const;
+    virtual bool            atBlockBoundary() const;
+    virtual int             getPendingBits() const;
+    virtual size_t          getWindow(unsigned char * window) const;
+    virtual bool            restore(int bits, int value, unsigned char const * window, size_t size);
+};
+
+
+class DeflateBackend
+{
+public:
+    typedef std::unique_ptr<DeflateBackend>     pointer_t;
+
+    enum class status_t
+    {
+        OK,
+        STREAM_END,
+        STREAM_ERROR
+    };
+
+    static pointer_t        create(int level, CompressionEngine engine = getCompressionEngine());
+
+    virtual                 ~DeflateBackend();
+
+    virtual CompressionEngine getEngine() const = 0;
+    virtual void            setInput(void const * buffer, size_t size) = 0;
+    virtual size_t          getAvailableInput() const = 0;
+    virtual status_t        deflate(void * buffer, size_t & size, bool finish) = 0;
+    virtual std::string     getErrorMessage() const = 0;
+
+    virtual bool            supportsBlocks() const;
+    virtual bool            startBlock(void const * dictionary, size_t size);
+    virtual status_t        flushBlock(void * buffer, size_t & size);
+};
+
+
+bool                        inflateBuffer(
+                                      void const * input
+                                    , size_t input_size
+                                    , void * output
+                                    , size_t output_size
+                                    , CompressionEngine engine = getCompressionEngine());
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
+#endif
@@ -0,0 +1,553 @@
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (c) 2015-2022  Made to Order Software Corp.  All Rights Reserved
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Implementation of the CRC-32 functions.
+ *
+ * The zip format uses the CRC-32 of the IEEE 802.3 polynomial, the same
+ * as zlib's crc32() function. This file offers two kernels to compute it:
+ *
+ * \li A carry-less multiplication (PCLMULQDQ) folding kernel on x86-64
+ *     processors which support it; it is based on the Intel white paper
+ *     "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ
+ *     Instruction";
+ * \li A portable slice-by-16 table driven kernel used everywhere else
+ *     and for the bytes the folding kernel does not handle.
+ *
+ * The kernel is selected once, at run time, depending on the CPU
+ * features.
+ */
+
+#include "crc32.hpp"
+
+#include "zipios/zipiosexceptions.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+#include <zlib.h>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define ZIPIOS_CRC32_PCLMUL
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define ZIPIOS_TARGET_PCLMUL
+#else
+#define ZIPIOS_TARGET_PCLMUL __attribute__((target("pclmul,sse4.1")))
+#endif
+#endif
+
+
+namespace zipios
+{
+
+
+namespace
+{
+
+
+/** \brief The size of the chunks computed in parallel.
+ *
+ * Large buffers and files are cut in chunks of this size. Each chunk
+ * CRC-32 is computed by one of the threads and the results are then
+ * combined together.
+ */
+size_t const g_crc32_chunk_size = 4 * 1024 * 1024;
+
+
+/** \brief The size of the buffer used to read a file.
+ *
+ * The crc32File() function reads the file in blocks of this size.
+ */
+size_t const g_crc32_file_buffer_size = 256 * 1024;
+
+
+/** \brief The reflected IEEE 802.3 polynomial.
+ *
+ * This is the polynomial used by zip, gzip, PNG, etc.
+ */
+uint32_t const g_crc32_polynomial = 0xEDB88320;
+
+
+/** \brief The tables used by the slice-by-16 kernel.
+ *
+ * Table 0 is the usual byte at a time table. Table N gives the CRC of
+ * a byte followed by N zero bytes.
+ */
+struct crc32_tables_t
+{
+    uint32_t            m_table[16][256];
+};
+
+
+/** \brief Generate the slice-by-16 tables.
+ *
+ * The tables are computed at compile time.
+ *
+ * \return The tables used by the slice-by-16 kernel.
+ */
+constexpr crc32_tables_t generate_crc32_tables()
+{
+    crc32_tables_t tables = {};
+    for(uint32_t idx(0); idx < 256; ++idx)
+    {
+        uint32_t c(idx);
+        for(int bit(0); bit < 8; ++bit)
+        {
+            c = (c & 1) != 0 ? (c >> 1) ^ g_crc32_polynomial : c >> 1;
+        }
+        tables.m_table[0][idx] = c;
+    }
+    for(uint32_t idx(0); idx < 256; ++idx)
+    {
+        for(int slice(1); slice < 16; ++slice)
+        {
+            uint32_t const previous(tables.m_table[slice - 1][idx]);
+            tables.m_table[slice][idx] = (previous >> 8) ^ tables.m_table[0][previous & 0xFF];
+        }
+    }
+    return tables;
+}
+
+
+constexpr crc32_tables_t const g_crc32_tables = generate_crc32_tables();
+
+
+/** \brief Compute the CRC-32 16 bytes at a time.
+ *
+ * This kernel is portable. It processes 16 bytes per iteration using
+ * the 16 tables and then the remaining bytes one at a time.
+ *
+ * \param[in] reg  The CRC-32 register (i.e. the inverted CRC-32.)
+ * \param[in] buf  The bytes to add to the CRC-32.
+ * \param[in] size  The number of bytes in \p buf.
+ *
+ * \return The new CRC-32 register.
+ */
+uint32_t crc32_slice_by_16(uint32_t reg, unsigned char const * buf, size_t size)
+{
+    auto const & t(g_crc32_tables.m_table);
+    for(; size >= 16; buf += 16, size -= 16)
+    {
+        uint32_t const a(reg
+                ^ (static_cast<uint32_t>(buf[0])
+                | (static_cast<uint32_t>(buf[1]) << 8)
+                | (static_cast<uint32_t>(buf[2]) << 16)
+                | (static_cast<uint32_t>(buf[3]) << 24)));
+        reg = t[15][a & 0xFF] ^ t[14][(a >> 8) & 0xFF] ^ t[13][(a >> 16) & 0xFF] ^ t[12][a >> 24]
+            ^ t[11][buf[4]] ^ t[10][buf[5]] ^ t[9][buf[6]] ^ t[8][buf[7]]
+            ^ t[7][buf[8]] ^ t[6][buf[9]] ^ t[5][buf[10]] ^ t[4][buf[11]]
+            ^ t[3][buf[12]] ^ t[2][buf[13]] ^ t[1][buf[14]] ^ t[0][buf[15]];
+    }
+    for(; size > 0; ++buf, --size)
+    {
+        reg = (reg >> 8) ^ t[0][(reg ^ *buf) & 0xFF];
+    }
+    return reg;
+}
+
+
+#ifdef ZIPIOS_CRC32_PCLMUL
+/** \brief Load 16 unaligned bytes.
+ *
+ * \param[in] p  A pointer to the bytes to load.
+ *
+ * \return The 16 bytes in an SSE register.
+ */
+ZIPIOS_TARGET_PCLMUL
+inline __m128i load(unsigned char const * p)
+{
+    return _mm_loadu_si128(reinterpret_cast<__m128i const *>(p));
+}
+
+
+/** \brief Fold one 128 bit register into the next 16 bytes.
+ *
+ * \param[in] x  The register to fold.
+ * \param[in] k  The folding constants.
+ * \param[in] next  The next 16 bytes.
+ *
+ * \return The folded register.
+ */
+ZIPIOS_TARGET_PCLMUL
+inline __m128i fold16(__m128i x, __m128i k, __m128i next)
+{
+    __m128i const lo(_mm_clmulepi64_si128(x, k, 0x00));
+    __m128i const hi(_mm_clmulepi64_si128(x, k, 0x11));
+    return _mm_xor_si128(_mm_xor_si128(hi, next), lo);
+}
+
+
+/** \brief Compute the CRC-32 with carry-less multiplications.
+ *
+ * This kernel folds the input 64 bytes at a time in four 128 bit
+ * registers, folds those into one register and finally applies a
+ * Barrett reduction to get the 32 bit CRC. The constants are the
+ * bit-reflected values given in the Intel paper.
+ *
+ * The bytes which do not fill a 16 byte block are processed with
+ * the slice-by-16 kernel.
+ *
+ * \param[in] reg  The CRC-32 register (i.e. the inverted CRC-32.)
+ * \param[in] buf  The bytes to add to the CRC-32.
+ * \param[in] size  The number of bytes in \p buf.
+ *
+ * \return The new CRC-32 register.
+ */
+ZIPIOS_TARGET_PCLMUL
+uint32_t crc32_pclmul(uint32_t reg, unsigned char const * buf, size_t size)
+{
+    if(size < 64)
+    {
+        return crc32_slice_by_16(reg, buf, size);
+    }
+
+    __m128i const k1k2(_mm_set_epi64x(0x01C6E41596, 0x0154442BD4));
+    __m128i const k3k4(_mm_set_epi64x(0x00CCAA009E, 0x01751997D0));
+    __m128i const k5k0(_mm_set_epi64x(0x0000000000, 0x0163CD6124));
+    __m128i const poly(_mm_set_epi64x(0x01F7011641, 0x01DB710641));
+    __m128i const mask32(_mm_setr_epi32(~0, 0, ~0, 0));
+
+    __m128i x1(_mm_xor_si128(load(buf), _mm_cvtsi32_si128(static_cast<int>(reg))));
+    __m128i x2(load(buf + 0x10));
+    __m128i x3(load(buf + 0x20));
+    __m128i x4(load(buf + 0x30));
+    buf += 64;
+    size -= 64;
+
+    // fold 64 bytes at a time
+    //
+    for(; size >= 64; buf += 64, size -= 64)
+    {
+        __m128i const x5(_mm_clmulepi64_si128(x1, k1k2, 0x00));
+        __m128i const x6(_mm_clmulepi64_si128(x2, k1k2, 0x00));
+        __m128i const x7(_mm_clmulepi64_si128(x3, k1k2, 0x00));
+        __m128i const x8(_mm_clmulepi64_si128(x4, k1k2, 0x00));
+
+        x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k1k2, 0x11), x5), load(buf));
+        x2 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x2, k1k2, 0x11), x6), load(buf + 0x10));
+        x3 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x3, k1k2, 0x11), x7), load(buf + 0x20));
+        x4 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x4, k1k2, 0x11), x8), load(buf + 0x30));
+    }
+
+    // fold the four registers into one and then 16 bytes at a time
+    //
+    x1 = fold16(x1, k3k4, x2);
+    x1 = fold16(x1, k3k4, x3);
+    x1 = fold16(x1, k3k4, x4);
+    for(; size >= 16; buf += 16, size -= 16)
+    {
+        x1 = fold16(x1, k3k4, load(buf));
+    }
+
+    // fold 128 bits to 64 bits
+    //
+    x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+    x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, mask32);
+    x1 = _mm_clmulepi64_si128(x1, k5k0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    // Barrett reduction to 32 bits
+    //
+    x2 = _mm_and_si128(x1, mask32);
+    x2 = _mm_clmulepi64_si128(x2, poly, 0x10);
+    x2 = _mm_and_si128(x2, mask32);
+    x2 = _mm_clmulepi64_si128(x2, poly, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    reg = static_cast<uint32_t>(_mm_extract_epi32(x1, 1));
+
+    return crc32_slice_by_16(reg, buf, size);
+}
+
+
+/** \brief Check whether the CPU supports the PCLMUL kernel.
+ *
+ * The kernel makes use of the PCLMULQDQ and SSE4.1 instructions.
+ *
+ * \return true if both instruction sets are available.
+ */
+bool cpu_has_pclmul()
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 1)) != 0        // PCLMULQDQ
+        && (info[2] & (1 << 19)) != 0;      // SSE4.1
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("pclmul")
+        && __builtin_cpu_supports("sse4.1");
+#endif
+}
+#endif
+
+
+typedef uint32_t (*crc32_kernel_t)(uint32_t reg, unsigned char const * buf, size_t size);
+
+
+/** \brief The CRC-32 kernel selected for this CPU.
+ *
+ * The kernel gets selected the first time a CRC-32 is computed.
+ */
+struct crc32_engine_t
+{
+    crc32_kernel_t      m_kernel = &crc32_slice_by_16;
+    char const *        m_name = "slice-by-16";
+};
+
+
+/** \brief Get the CRC-32 engine.
+ *
+ * The engine is selected once, at run time, depending on the CPU
+ * features.
+ *
+ * \return A reference to the CRC-32 engine.
+ */
+crc32_engine_t const & get_engine()
+{
+    static crc32_engine_t const engine([]()
+        {
+            crc32_engine_t e;
+#ifdef ZIPIOS_CRC32_PCLMUL
+            if(cpu_has_pclmul())
+            {
+                e.m_kernel = &crc32_pclmul;
+                e.m_name = "pclmul";
+            }
+#endif
+            return e;
+        }());
+    return engine;
+}
+
+
+/** \brief Compute the CRC-32 of \p size bytes in chunks.
+ *
+ * This function cuts \p size bytes in chunks of g_crc32_chunk_size bytes,
+ * has a pool of \p thread_count threads compute the CRC-32 of each
+ * chunk with \p chunk_crc32 and then combines the results.
+ *
+ * \param[in] size  The total number of bytes.
+ * \param[in] thread_count  The number of threads to use, 0 for one
+ *                          per CPU.
+ * \param[in] chunk_crc32  The function computing the CRC-32 of the chunk
+ *                         at the specified position and size.
+ *
+ * \return The CRC-32 of all the bytes.
+ */
+template<typename F>
+uint32_t crc32_chunks(size_t size, size_t thread_count, F chunk_crc32)
+{
+    size_t const chunks((size + g_crc32_chunk_size - 1) / g_crc32_chunk_size);
+    if(thread_count == 0)
+    {
+        thread_count = std::max(1U, std::thread::hardware_concurrency());
+    }
+    thread_count = std::min(thread_count, chunks);
+    if(thread_count <= 1)
+    {
+        return chunk_crc32(0, size);
+    }
+
+    std::vector<uint32_t> crcs(chunks);
+    std::atomic<size_t> next(0);
+    auto worker = [&]()
+        {
+            for(;;)
+            {
+                size_t const idx(next++);
+                if(idx >= chunks)
+                {
+                    break;
+                }
+                size_t const pos(idx * g_crc32_chunk_size);
+                crcs[idx] = chunk_crc32(pos, std::min(g_crc32_chunk_size, size - pos));
+            }
+        };
+
+    std::vector<std::thread> threads;
+    threads.reserve(thread_count);
+    for(size_t idx(0); idx < thread_count; ++idx)
+    {
+        threads.emplace_back(worker);
+    }
+    for(auto & t : threads)
+    {
+        t.join();
+    }
+
+    uint32_t result(crcs[0]);
+    for(size_t idx(1); idx < chunks; ++idx)
+    {
+        size_t const pos(idx * g_crc32_chunk_size);
+        result = crc32_combine(result, crcs[idx], static_cast<z_off_t>(std::min(g_crc32_chunk_size, size - pos)));
+    }
+    return result;
+}
+
+
+} // no name namespace
+
+
+/** \brief Add bytes to a CRC-32.
+ *
+ * This function is a drop-in replacement of zlib's crc32() function.
+ * Start with a \p crc of 0 and call it with each buffer in turn to get
+ * the CRC-32 of the concatenation of all the buffers.
+ *
+ * The function uses the fastest kernel available on this CPU.
+ *
+ * \param[in] crc  The CRC-32 of the previous bytes, 0 to start.
+ * \param[in] buffer  The bytes to add to the CRC-32.
+ * \param[in] size  The number of bytes in \p buffer.
+ *
+ * \return The updated CRC-32.
+ */
+uint32_t crc32Update(uint32_t crc, void const * buffer, size_t size)
+{
+    if(size == 0)
+    {
+        return crc;
+    }
+    return ~get_engine().m_kernel(~crc, static_cast<unsigned char const *>(buffer), size);
+}
+
+
+/** \brief Compute the CRC-32 of a large buffer using multiple threads.
+ *
+ * The buffer is cut in chunks which are computed in parallel by a pool
+ * of threads. The CRC-32 of each chunk is then combined to obtain the
+ * CRC-32 of the whole buffer. Small buffers are computed by the calling
+ * thread.
+ *
+ * \param[in] buffer  The bytes of which the CRC-32 is computed.
+ * \param[in] size  The number of bytes in \p buffer.
+ * \param[in] thread_count  The maximum number of threads to use, 0 to
+ *                          use one thread per CPU.
+ *
+ * \return The CRC-32 of \p buffer.
+ */
+uint32_t crc32Parallel(void const * buffer, size_t size, size_t thread_count)
+{
+    unsigned char const * buf(static_cast<unsigned char const *>(buffer));
+    return crc32_chunks(size, thread_count, [buf](size_t pos, size_t length)
+        {
+            return crc32Update(0, buf + pos, length);
+        });
+}
+
+
+/** \brief Compute the CRC-32 of a file.
+ *
+ * This function reads the named file and returns its CRC-32. By
+ * default, the file is read by the calling thread. When more threads
+ * are requested, large files are cut in chunks which are read and
+ * computed in parallel by a pool of threads, each with its own file
+ * handle.
+ *
+ * \exception IOException
+ * This exception is raised if the file cannot be opened or read.
+ *
+ * \param[in] filename  The name of the file to read.
+ * \param[in] thread_count  The maximum number of threads to use, 0 to
+ *                          use one thread per CPU, 1 by default.
+ *
+ * \return The CRC-32 of the file.
+ */
+uint32_t crc32File(std::string const & filename, size_t thread_count)
+{
+    std::ifstream in(filename, std::ios::in | std::ios::binary | std::ios::ate);
+    if(!in.is_open())
+    {
+        throw IOException("Can't open file \"" + filename + "\".");
+    }
+    std::streamoff const size(in.tellg());
+    if(size < 0)
+    {
+        throw IOException("Can't determine the size of file \"" + filename + "\"."); // LCOV_EXCL_LINE
+    }
+    in.close();
+
+    std::atomic<bool> failed(false);
+    uint32_t const result(crc32_chunks(static_cast<size_t>(size), thread_count, [&filename, &failed](size_t pos, size_t length)
+        {
+            uint32_t crc(0);
+            std::ifstream f(filename, std::ios::in | std::ios::binary);
+            if(!f.seekg(static_cast<std::streamoff>(pos)))
+            {
+                failed = true;
+                return crc;
+            }
+            std::vector<char> buf(std::min(g_crc32_file_buffer_size, length));
+            while(length > 0)
+            {
+                f.read(buf.data(), std::min(buf.size(), length));
+                std::streamsize const got(f.gcount());
+                if(got <= 0)
+                {
+                    failed = true;
+                    break;
+                }
+                crc = crc32Update(crc, buf.data(), static_cast<size_t>(got));
+                length -= static_cast<size_t>(got);
+            }
+            return crc;
+        }));
+    if(failed)
+    {
+        throw IOException("Error reading file \"" + filename + "\".");
+    }
+
+    return result;
+}
+
+
+/** \brief Get the name of the CRC-32 kernel in use.
+ *
+ * This function returns "pclmul" when the carry-less multiplication
+ * kernel is used and "slice-by-16" otherwise. It is mainly useful for
+ * tests and benchmarks.
+ *
+ * \return The name of the selected kernel.
+ */
+char const * crc32Engine()
+{
+    return get_engine().m_name;
+}
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
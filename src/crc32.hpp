@@ -0,0 +1,53 @@
+#pragma once
+#ifndef CRC32_HPP
+#define CRC32_HPP
+
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (c) 2015-2022  Made to Order Software Corp.  All Rights Reserved
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Declaration of the CRC-32 functions.
+ *
+ * This file declares the internal functions used to compute the CRC-32
+ * checksum saved in zip archives. The public functions are declared in
+ * zipios/crc32.hpp.
+ */
+
+#include "zipios/crc32.hpp"
+
+
+namespace zipios
+{
+
+
+uint32_t            crc32Update(uint32_t crc, void const * buffer, size_t size);
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
+#endif
@@ -29,21 +29,223 @@
 
 #include "zipios/zipiosexceptions.hpp"
 
+#include "crc32.hpp"
 #include "zipios_common.hpp"
 
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include <zlib.h>
+
 
 namespace zipios
 {
 
+
+namespace
+{
+
+
+/** \brief Size of the blocks compressed by the threads.
+ *
+ * Each block costs one empty stored block (5 bytes) and loses the
+ * matches it could have found before its dictionary.
+ */
+size_t const g_deflate_block_size = 128 * 1024;
+
+
+/** \brief Size of the dictionary of a block.
+ *
+ * This is the size of the deflate window, a match can never refer
+ * to data further back.
+ */
+size_t const g_deflate_dictionary_size = 32 * 1024;
+
+
+/** \brief Number of blocks in flight per thread.
+ *
+ * The writer waits for the oldest block once that many blocks per
+ * thread were pushed and not yet written. This bounds the memory used.
+ */
+size_t const g_deflate_blocks_per_thread = 2;
+
+
+} // no name namespace
+
+
+
+/** \brief The threads compressing the blocks of an entry.
+ *
+ * The blocks get compressed in any order by the threads. The writer
+ * keeps them in the order they were pushed and outputs them as they
+ * become ready.
+ */
+struct DeflateOutputStreambuf::block_pool_t
+{
+    struct block_t
+    {
+        std::vector<char>   m_input = std::vector<char>();
+        std::vector<char>   m_dictionary = std::vector<char>();
+        std::vector<char>   m_output = std::vector<char>();
+        uint32_t            m_crc32 = 0;
+        bool                m_last = false;
+        bool                m_done = false;
+        std::exception_ptr  m_error = std::exception_ptr();
+    };
+    typedef std::shared_ptr<block_t>    block_pointer_t;
+
+    block_pool_t(int level, CompressionEngine engine, size_t thread_count)
+        : m_level(level)
+        , m_engine(engine)
+        , m_thread_count(thread_count)
+    {
+        m_block.reserve(g_deflate_block_size);
+    }
+
+    ~block_pool_t()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_condition.notify_all();
+        for(auto & t : m_threads)
+        {
+            t.join();
+        }
+    }
+
+    void push(block_pointer_t block)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_waiting.push_back(block);
+            m_blocks.push_back(block);
+        }
+        m_condition.notify_all();
+
+        // the threads are only started once the entry is known to be
+        // larger than one block
+        //
+        if(m_threads.empty())
+        {
+            for(size_t idx(0); idx < m_thread_count; ++idx)
+            {
+                m_threads.emplace_back(&block_pool_t::run, this);
+            }
+        }
+    }
+
+    void run()
+    {
+        DeflateBackend::pointer_t backend;
+        for(;;)
+        {
+            block_pointer_t block;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_condition.wait(lock, [this]() { return m_stop || !m_waiting.empty(); });
+                if(m_stop)
+                {
+                    return;
+                }
+                block = m_waiting.front();
+                m_waiting.pop_front();
+            }
+
+            try
+            {
+                if(backend == nullptr)
+                {
+                    backend = DeflateBackend::create(m_level, m_engine);
+                    if(!backend->supportsBlocks())
+                    {
+                        backend = DeflateBackend::create(m_level, CompressionEngine::ZLIB); // LCOV_EXCL_LINE
+                    }
+                }
+                compress(*backend, *block);
+            }
+            catch(...)
+            {
+                block->m_error = std::current_exception();
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                block->m_done = true;
+            }
+            m_condition.notify_all();
+        }
+    }
+
+    static void compress(DeflateBackend & backend, block_t & block)
+    {
+        block.m_crc32 = crc32Update(0, block.m_input.data(), block.m_input.size());
+
+        if(!backend.startBlock(block.m_dictionary.data(), block.m_dictionary.size()))
+        {
+            throw IOException("DeflateOutputStreambuf: cannot start a block: " + backend.getErrorMessage()); // LCOV_EXCL_LINE
+        }
+        backend.setInput(block.m_input.data(), block.m_input.size());
+
+        block.m_output.reserve(block.m_input.size() + block.m_input.size() / 16 + 1024);
+        DeflateBackend::status_t status(DeflateBackend::status_t::OK);
+        while(status == DeflateBackend::status_t::OK)
+        {
+            size_t const pos(block.m_output.size());
+            size_t bytes(std::max(block.m_output.capacity() - pos, static_cast<size_t>(1024)));
+            block.m_output.resize(pos + bytes);
+            status = block.m_last
+                        ? backend.deflate(&block.m_output[pos], bytes, true)
+                        : backend.flushBlock(&block.m_output[pos], bytes);
+            block.m_output.resize(pos + bytes);
+        }
+
+        if(status != DeflateBackend::status_t::STREAM_END)
+        {
+            throw IOException("DeflateOutputStreambuf: deflate() of a block failed: " + backend.getErrorMessage()); // LCOV_EXCL_LINE
+        }
+    }
+
+    int const                   m_level;
+    CompressionEngine const     m_engine;
+    size_t const                m_thread_count;
+    std::mutex                  m_mutex = std::mutex();
+    std::condition_variable     m_condition = std::condition_variable();
+    std::deque<block_pointer_t> m_waiting = std::deque<block_pointer_t>();     // blocks not yet compressed
+    std::deque<block_pointer_t> m_blocks = std::deque<block_pointer_t>();      // blocks not yet written, in order
+    std::vector<std::thread>    m_threads = std::vector<std::thread>();
+    bool                        m_stop = false;
+    std::vector<char>           m_block = std::vector<char>();      // the block being filled
+    std::vector<char>           m_dictionary = std::vector<char>(); // the end of the previous block
+    bool                        m_pushed = false;
+};
+
+
+
 /** \class DeflateOutputStreambuf
  * \brief A class to handle stream deflate on the fly.
  *
  * DeflateOutputStreambuf is an output stream filter, that deflates
  * the data that is written to it before it passes it on to the
  * output stream it is attached to. Deflation/Inflation is a
- * compression/decompression method used in gzip and zip. The zlib
- * library is used to perform the actual deflation, this class only
- * wraps the functionality in an output stream filter.
+ * compression/decompression method used in gzip and zip. The
+ * DeflateBackend of the current compression engine (zlib by default)
+ * performs the actual deflation, this class only wraps the
+ * functionality in an output stream filter.
+ *
+ * With setThreadCount(), large streams get compressed by several
+ * threads, the way pigz does it. The data is cut in blocks of 128 KiB,
+ * each block gets compressed by one of the threads using the last
+ * 32 KiB of the previous block as its dictionary and ends with a sync
+ * flush. The compressed blocks, written in order, form one standard
+ * deflate stream. The CRC-32 of the blocks are combined with
+ * crc32_combine(). The result is a little larger than the output of
+ * a single thread and not byte-identical to it. Streams which fit
+ * in one block are compressed by the calling thread as usual.
  */
 
 
@@ -73,15 +275,24 @@ DeflateOutputStreambuf::DeflateOutputStreambuf(std::streambuf * outbuf)
  * then makes sure that the remaining data from zlib is printed in
  * the output file.
  *
- * This is similar to calling closeStream() explicitly.
+ * This is similar to calling closeStream() explicitly, except that
+ * errors are ignored. Call closeStream() to know whether the last
+ * data could be compressed and written.
  */
 DeflateOutputStreambuf::~DeflateOutputStreambuf()
 {
-    closeStream();
+    // a destructor must not throw
+    try
+    {
+        closeStream();
+    }
+    catch(...)
+    {
+    }
 }
 
 
-/** \brief Initialize the zlib library.
+/** \brief Initialize the deflate backend.
  *
  * This method is called in the constructor, so it must not write
  * anything to the output streambuf m_outbuf (see notice in
@@ -100,15 +311,12 @@ DeflateOutputStreambuf::~DeflateOutputStreambuf()
  */
 bool DeflateOutputStreambuf::init(FileEntry::CompressionLevel compression_level)
 {
-    if(m_zs_initialized)
+    if(m_backend != nullptr)
     {
         // This is excluded from the coverage since if we reach this
         // line there is an internal error that needs to be fixed.
         throw std::logic_error("DeflateOutputStreambuf::init(): initialization function called when the class is already initialized. This is not supported."); // LCOV_EXCL_LINE
     }
-    m_zs_initialized = true;
-
-    int const default_mem_level(8);
 
     int zlevel(Z_NO_COMPRESSION);
     switch(compression_level)
@@ -152,36 +360,24 @@ bool DeflateOutputStreambuf::init(FileEntry::CompressionLevel compression_level)
 
     }
 
-    // m_zs.next_in and avail_in must be set according to
-    // zlib.h (inline doc).
-    m_zs.next_in  = reinterpret_cast<unsigned char *>(&m_invec[0]);
-    m_zs.avail_in = 0;
-
-    m_zs.next_out  = reinterpret_cast<unsigned char *>(&m_outvec[0]);
-    m_zs.avail_out = getBufferSize();
-
+    // the backend throws an IOException if it cannot be initialized
     //
-    // windowBits is passed -MAX_WBITS to tell that no zlib
-    // header should be written.
-    //
-    int const err = deflateInit2(&m_zs, zlevel, Z_DEFLATED, -MAX_WBITS, default_mem_level, Z_DEFAULT_STRATEGY);
-    if(err != Z_OK)
+    m_backend = DeflateBackend::create(zlevel);
+    m_outvec_size = 0;
+    m_overflown_bytes = 0;
+
+    size_t const thread_count(getThreadCount());
+    if(thread_count > 1)
     {
-        // Not too sure how we could generate an error here, the deflateInit2()
-        // would fail if (1) there is not enough memory and (2) if a parameter
-        // is out of wack which neither can be generated from the outside
-        // (well... not easily)
-        std::ostringstream msgs; // LCOV_EXCL_LINE
-        msgs << "DeflateOutputStreambuf::init(): error while initializing zlib, " << zError(err) << std::endl; // LCOV_EXCL_LINE
-        throw IOException(msgs.str()); // LCOV_EXCL_LINE
+        m_block_pool = std::make_unique<block_pool_t>(zlevel, m_backend->getEngine(), thread_count);
     }
 
     // streambuf init:
     setp(&m_invec[0], &m_invec[0] + getBufferSize());
 
-    m_crc32 = crc32(0, Z_NULL, 0);
+    m_crc32 = 0;
 
-    return err == Z_OK;
+    return true;
 }
 
 
@@ -196,25 +392,35 @@ bool DeflateOutputStreambuf::init(FileEntry::CompressionLevel compression_level)
  * Note that this function can be called to close the current zlib
  * library stream and start a new one. It is actually called from
  * the putNextEntry() function (via the closeEntry() function.)
+ *
+ * The stream gets closed even when the last data cannot be compressed
+ * or written, in which case the error is rethrown. A second call then
+ * has no effect.
+ *
+ * \exception IOException
+ * This exception is raised if the remaining data cannot be compressed
+ * or written to the output.
  */
 void DeflateOutputStreambuf::closeStream()
 {
-    if(m_zs_initialized)
+    if(m_backend != nullptr)
     {
-        m_zs_initialized = false;
-
-        // flush any remaining data
-        endDeflation();
-
-        int const err(deflateEnd(&m_zs));
-        if(err != Z_OK) // when we close a directory, we get the Z_DATA_ERROR!
+        // flush any remaining data, the backend and the worker threads
+        // get released whether it works or not
+        //
+        try
         {
-            // There are not too many cases which break the deflateEnd()
-            // function call...
-            std::ostringstream msgs; // LCOV_EXCL_LINE
-            msgs << "DeflateOutputStreambuf::closeStream(): deflateEnd failed: " << zError(err) << std::endl; // LCOV_EXCL_LINE
-            throw IOException(msgs.str()); // LCOV_EXCL_LINE
+            endDeflation();
         }
+        catch(...)
+        {
+            m_backend.reset();
+            m_block_pool.reset();
+            throw;
+        }
+
+        m_backend.reset();
+        m_block_pool.reset();
     }
 }
 
@@ -254,6 +460,35 @@ size_t DeflateOutputStreambuf::getSize() const
 }
 
 
+/** \brief Set the number of threads used to compress one stream.
+ *
+ * By default a stream is compressed by the calling thread. With more
+ * than one thread, the streams started by the following init() get
+ * compressed in blocks by that many threads (see the class
+ * description.) The output is a standard deflate stream either way.
+ *
+ * \param[in] thread_count  The number of threads, 0 for one per CPU.
+ */
+void DeflateOutputStreambuf::setThreadCount(size_t thread_count)
+{
+    m_thread_count = thread_count;
+}
+
+
+/** \brief Retrieve the number of threads used to compress one stream.
+ *
+ * \return The number of threads, 1 or more.
+ */
+size_t DeflateOutputStreambuf::getThreadCount() const
+{
+    if(m_thread_count == 0)
+    {
+        return std::max(1U, std::thread::hardware_concurrency());
+    }
+    return m_thread_count;
+}
+
+
 /** \brief Handle an overflow.
  *
  * This function is called by the streambuf implementation whenever
@@ -269,47 +504,19 @@ size_t DeflateOutputStreambuf::getSize() const
  */
 int DeflateOutputStreambuf::overflow(int c)
 {
-    int err(Z_OK);
-
-    m_zs.avail_in = pptr() - pbase();
-    m_zs.next_in = reinterpret_cast<unsigned char *>(&m_invec[0]);
-
-    if(m_zs.avail_in > 0)
-    {
-        m_crc32 = crc32(m_crc32, m_zs.next_in, m_zs.avail_in); // update crc32
-
-        m_zs.next_out = reinterpret_cast<unsigned char *>(&m_outvec[0]);
-        m_zs.avail_out = getBufferSize();
-
-        // Deflate until m_invec is empty.
-        while((m_zs.avail_in > 0 || m_zs.avail_out == 0) && err == Z_OK)
-        {
-            if(m_zs.avail_out == 0)
-            {
-                flushOutvec();
-            }
-
-            err = deflate(&m_zs, Z_NO_FLUSH);
-        }
-    }
-
-    // somehow we need this flush here or it fails
-    flushOutvec();
+    size_t const size(pptr() - pbase());
+    m_overflown_bytes += size;
 
     // Update 'put' pointers
     setp(&m_invec[0], &m_invec[0] + getBufferSize());
 
-    if(err != Z_OK && err != Z_STREAM_END)
+    if(m_block_pool != nullptr)
     {
-        // Throw an exception to make istream set badbit
-        //
-        // This is marked as not cover-able by tests because the calls
-        // that access this function only happen in an internal loop and
-        // even if we were to write a direct test, I do not see how
-        // we could end up with an error here
-        OutputStringStream msgs; // LCOV_EXCL_LINE
-        msgs << "Deflation failed:" << zError(err); // LCOV_EXCL_LINE
-        throw IOException(msgs.str()); // LCOV_EXCL_LINE
+        addBlockData(&m_invec[0], size);
+    }
+    else
+    {
+        deflateData(&m_invec[0], size);
     }
 
     if(c != EOF)
@@ -340,8 +547,8 @@ int DeflateOutputStreambuf::sync() // LCOV_EXCL_LINE
 
 /** \brief Flush the cached output data.
  *
- * This function flushes m_outvec and updates the output pointer
- * and size m_zs.next_out and m_zs.avail_out.
+ * This function writes the m_outvec_size bytes of m_outvec to the
+ * output streambuf and empties m_outvec.
  */
 void DeflateOutputStreambuf::flushOutvec()
 {
@@ -350,7 +557,7 @@ void DeflateOutputStreambuf::flushOutvec()
      * flow through without the need to have this crap of bytes to
      * skip...
      */
-    std::size_t const deflated_bytes(getBufferSize() - m_zs.avail_out);
+    std::size_t const deflated_bytes(m_outvec_size);
     if(deflated_bytes > 0)
     {
         std::size_t const bc(m_outbuf->sputn(&m_outvec[0], deflated_bytes));
@@ -363,8 +570,168 @@ void DeflateOutputStreambuf::flushOutvec()
         }
     }
 
-    m_zs.next_out = reinterpret_cast<unsigned char *>(&m_outvec[0]);
-    m_zs.avail_out = getBufferSize();
+    m_outvec_size = 0;
+}
+
+
+/** \brief Compress data with the backend of the calling thread.
+ *
+ * This function updates the CRC-32, compresses \p data and writes the
+ * result to the output streambuf.
+ *
+ * \exception IOException
+ * This exception is raised whenever the backend returns an error.
+ *
+ * \param[in] data  The data to compress.
+ * \param[in] size  The number of bytes in \p data.
+ */
+void DeflateOutputStreambuf::deflateData(char const * data, size_t size)
+{
+    DeflateBackend::status_t status(DeflateBackend::status_t::OK);
+
+    if(size > 0)
+    {
+        m_crc32 = crc32Update(m_crc32, data, size); // update crc32
+
+        m_backend->setInput(data, size);
+
+        // Deflate until data is empty.
+        while((m_backend->getAvailableInput() > 0 || m_outvec_size == getBufferSize())
+           && status == DeflateBackend::status_t::OK)
+        {
+            if(m_outvec_size == getBufferSize())
+            {
+                flushOutvec();
+            }
+
+            size_t bytes(getBufferSize() - m_outvec_size);
+            status = m_backend->deflate(&m_outvec[m_outvec_size], bytes, false);
+            m_outvec_size += bytes;
+        }
+    }
+
+    // somehow we need this flush here or it fails
+    flushOutvec();
+
+    if(status == DeflateBackend::status_t::STREAM_ERROR)
+    {
+        // Throw an exception to make istream set badbit
+        //
+        // This is marked as not cover-able by tests because the calls
+        // that access this function only happen in an internal loop and
+        // even if we were to write a direct test, I do not see how
+        // we could end up with an error here
+        OutputStringStream msgs; // LCOV_EXCL_LINE
+        msgs << "Deflation failed:" << m_backend->getErrorMessage(); // LCOV_EXCL_LINE
+        throw IOException(msgs.str()); // LCOV_EXCL_LINE
+    }
+}
+
+
+/** \brief Add data to the blocks compressed by the threads.
+ *
+ * The data is appended to the current block. Each time the block is
+ * full, it gets pushed to the threads.
+ *
+ * \param[in] data  The data to compress.
+ * \param[in] size  The number of bytes in \p data.
+ */
+void DeflateOutputStreambuf::addBlockData(char const * data, size_t size)
+{
+    std::vector<char> & block(m_block_pool->m_block);
+    while(size > 0)
+    {
+        size_t const bytes(std::min(size, g_deflate_block_size - block.size()));
+        block.insert(block.end(), data, data + bytes);
+        data += bytes;
+        size -= bytes;
+        if(block.size() == g_deflate_block_size)
+        {
+            pushBlock(false);
+        }
+    }
+}
+
+
+/** \brief Push the current block to the threads.
+ *
+ * The block gets the end of the data pushed so far as its dictionary.
+ * The blocks already compressed are then written out. If too many
+ * blocks are in flight, the function waits for the oldest ones.
+ *
+ * \param[in] last  Whether this is the last block of the stream.
+ */
+void DeflateOutputStreambuf::pushBlock(bool last)
+{
+    block_pool_t::block_pointer_t block(std::make_shared<block_pool_t::block_t>());
+    block->m_input.swap(m_block_pool->m_block);
+    block->m_dictionary = m_block_pool->m_dictionary;
+    block->m_last = last;
+
+    std::vector<char> & dictionary(m_block_pool->m_dictionary);
+    dictionary.insert(dictionary.end(), block->m_input.begin(), block->m_input.end());
+    if(dictionary.size() > g_deflate_dictionary_size)
+    {
+        dictionary.erase(dictionary.begin(), dictionary.end() - g_deflate_dictionary_size);
+    }
+
+    m_block_pool->m_block.reserve(g_deflate_block_size);
+    m_block_pool->m_pushed = true;
+    m_block_pool->push(block);
+
+    writeBlocks(last);
+}
+
+
+/** \brief Write the compressed blocks in order.
+ *
+ * This function writes the blocks which are ready and combines their
+ * CRC-32. It stops at the first block still being compressed unless
+ * too many blocks are in flight or \p wait_all is true.
+ *
+ * \exception IOException
+ * This exception is raised if a block could not be compressed or
+ * written.
+ *
+ * \param[in] wait_all  Whether to wait for all the blocks.
+ */
+void DeflateOutputStreambuf::writeBlocks(bool wait_all)
+{
+    size_t const max_blocks(m_block_pool->m_thread_count * g_deflate_blocks_per_thread);
+    for(;;)
+    {
+        block_pool_t::block_pointer_t block;
+        {
+            std::unique_lock<std::mutex> lock(m_block_pool->m_mutex);
+            if(m_block_pool->m_blocks.empty())
+            {
+                return;
+            }
+            block = m_block_pool->m_blocks.front();
+            if(!block->m_done)
+            {
+                if(!wait_all
+                && m_block_pool->m_blocks.size() < max_blocks)
+                {
+                    return;
+                }
+                m_block_pool->m_condition.wait(lock, [&block]() { return block->m_done; });
+            }
+            m_block_pool->m_blocks.pop_front();
+        }
+
+        if(block->m_error != nullptr)
+        {
+            std::rethrow_exception(block->m_error);
+        }
+
+        std::streamsize const size(block->m_output.size());
+        if(m_outbuf->sputn(block->m_output.data(), size) != size)
+        {
+            throw IOException("DeflateOutputStreambuf::writeBlocks(): write to buffer failed."); // LCOV_EXCL_LINE
+        }
+        m_crc32 = crc32_combine(m_crc32, block->m_crc32, static_cast<z_off_t>(block->m_input.size()));
+    }
 }
 
 
@@ -378,11 +745,24 @@ void DeflateOutputStreambuf::endDeflation()
 {
     overflow();
 
-    m_zs.next_out = reinterpret_cast<unsigned char *>(&m_outvec[0]);
-    m_zs.avail_out = getBufferSize();
+    if(m_block_pool != nullptr)
+    {
+        if(m_block_pool->m_pushed)
+        {
+            // the last block ends the deflate stream
+            //
+            pushBlock(true);
+            return;
+        }
+
+        // the whole stream fits in one block, compress it here so
+        // small streams do not pay for the threads
+        //
+        deflateData(m_block_pool->m_block.data(), m_block_pool->m_block.size());
+    }
 
     // Deflate until _invec is empty.
-    int err(Z_OK);
+    DeflateBackend::status_t status(DeflateBackend::status_t::OK);
 
     // make sure to NOT call deflate() if nothing was written to the
     // deflate output stream, otherwise we get a "spurious" (as far
@@ -391,25 +771,27 @@ void DeflateOutputStreambuf::endDeflation()
     //
     if(m_overflown_bytes > 0)
     {
-        while(err == Z_OK)
+        while(status == DeflateBackend::status_t::OK)
         {
-            if(m_zs.avail_out == 0)
+            if(m_outvec_size == getBufferSize())
             {
                 flushOutvec();
             }
 
-            err = deflate(&m_zs, Z_FINISH);
+            size_t bytes(getBufferSize() - m_outvec_size);
+            status = m_backend->deflate(&m_outvec[m_outvec_size], bytes, true);
+            m_outvec_size += bytes;
         }
     }
     else
     {
         // this is not expected to happen, but it can
-        err = Z_STREAM_END; // LCOV_EXCL_LINE
+        status = DeflateBackend::status_t::STREAM_END; // LCOV_EXCL_LINE
     }
 
     flushOutvec();
 
-    if(err != Z_STREAM_END)
+    if(status != DeflateBackend::status_t::STREAM_END)
     {
         // This is marked as not cover-able because the calls that
         // access this function only happen in an internal loop and
@@ -417,7 +799,7 @@ void DeflateOutputStreambuf::endDeflation()
         // we could end up with an error here
         std::ostringstream msgs; // LCOV_EXCL_LINE
         msgs << "DeflateOutputStreambuf::endDeflation(): deflate() failed: " // LCOV_EXCL_LINE
-             << zError(err) << std::endl; // LCOV_EXCL_LINE
+             << m_backend->getErrorMessage() << std::endl; // LCOV_EXCL_LINE
         throw IOException(msgs.str()); // LCOV_EXCL_LINE
     }
 }
@@ -32,13 +32,14 @@
  * The counter part is the class zipios::InflateInputStreambuf.
  */
 
+#include "compressionbackend.hpp"
 #include "filteroutputstreambuf.hpp"
 
 #include "zipios/fileentry.hpp"
 
 #include <cstdint>
-
-#include <zlib.h>
+#include <memory>
+#include <vector>
 
 
 namespace zipios
@@ -57,23 +58,34 @@ public:
     void                    closeStream();
     uint32_t                getCrc32() const;
     size_t                  getSize() const;
+    void                    setThreadCount(size_t thread_count);
+    size_t                  getThreadCount() const;
 
 protected:
     virtual int             overflow(int c = EOF);
     virtual int             sync();
 
-    uint32_t                m_overflown_bytes = 0;
+    size_t                  m_overflown_bytes = 0;
     std::vector<char>       m_invec = std::vector<char>();
     uint32_t                m_crc32 = 0;
 
 private:
+    struct block_pool_t;
+
+    void                    deflateData(char const * data, size_t size);
+    void                    addBlockData(char const * data, size_t size);
+    void                    pushBlock(bool last);
+    void                    writeBlocks(bool wait_all);
     void                    endDeflation();
     void                    flushOutvec();
 
-    z_stream                m_zs = z_stream();
-    bool                    m_zs_initialized = false;
+    DeflateBackend::pointer_t   m_backend = DeflateBackend::pointer_t();
 
     std::vector<char>       m_outvec = std::vector<char>();
+    size_t                  m_outvec_size = 0;  // number of bytes in m_outvec
+    size_t                  m_thread_count = 1;
+    std::unique_ptr<block_pool_t>
+                            m_block_pool;   // no initializer, block_pool_t is incomplete here
 };
 
 
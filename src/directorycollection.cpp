@@ -100,6 +100,45 @@ DirectoryCollection::DirectoryCollection(
 }
 
 
+/** \brief Copy a DirectoryCollection in a new one.
+ *
+ * This constructor copies the \p rhs collection, including its entries
+ * if they were already loaded.
+ *
+ * \param[in] rhs  The source collection to copy.
+ */
+DirectoryCollection::DirectoryCollection(DirectoryCollection const & rhs)
+    : FileCollection(rhs)
+    , m_entries_loaded(rhs.m_entries_loaded.load())
+    , m_recursive(rhs.m_recursive)
+    , m_filepath(rhs.m_filepath)
+{
+}
+
+
+/** \brief Copy a DirectoryCollection in this one.
+ *
+ * This assignment operator copies the \p rhs collection, including
+ * its entries if they were already loaded.
+ *
+ * \param[in] rhs  The source collection to copy.
+ *
+ * \return A reference to this DirectoryCollection.
+ */
+DirectoryCollection & DirectoryCollection::operator = (DirectoryCollection const & rhs)
+{
+    if(this != &rhs)
+    {
+        FileCollection::operator = (rhs);
+        m_entries_loaded = rhs.m_entries_loaded.load();
+        m_recursive = rhs.m_recursive;
+        m_filepath = rhs.m_filepath;
+    }
+
+    return *this;
+}
+
+
 /** \brief Clean up a DirectoryCollection object.
  *
  * The destructor ensures that the object is properly cleaned up.
@@ -132,10 +171,7 @@ void DirectoryCollection::close()
  * holding the entries.
  *
  * \note
- * The copy of the vector is required because of the implementation
- * of CollectionCollection which does not hold a vector of all the
- * entries defined in its children. It is also cleaner (albeit slower)
- * in case one wants to use the library in a thread environment.
+ * To walk the entries without a copy, use begin() and end() instead.
  *
  * \return A copy of the internal FileEntry vector.
  */
@@ -203,12 +239,33 @@ FileEntry::pointer_t DirectoryCollection::getEntry(std::string const & name, Mat
 DirectoryCollection::stream_pointer_t DirectoryCollection::getInputStream(std::string const & entry_name, MatchPath matchpath)
 {
     FileEntry::pointer_t ent(getEntry(entry_name, matchpath));
-    if(ent == nullptr || ent->isDirectory())
+    if(ent == nullptr)
     {
         return DirectoryCollection::stream_pointer_t();
     }
 
-    DirectoryCollection::stream_pointer_t p(std::make_shared<std::ifstream>(ent->getName(), std::ios::in | std::ios::binary));
+    return getEntryInputStream(ent);
+}
+
+
+/** \brief Retrieve an istream for one of the entries of this collection.
+ *
+ * This function opens the file represented by \p entry, an entry of
+ * this DirectoryCollection, without searching it by name. A directory
+ * cannot be opened so in that case the function returns a null pointer.
+ *
+ * \param[in] entry  The entry to open.
+ *
+ * \return A shared pointer to an open istream for the specified entry.
+ */
+DirectoryCollection::stream_pointer_t DirectoryCollection::getEntryInputStream(FileEntry::pointer_t entry)
+{
+    if(entry->isDirectory())
+    {
+        return DirectoryCollection::stream_pointer_t();
+    }
+
+    DirectoryCollection::stream_pointer_t p(std::make_shared<std::ifstream>(entry->getName(), std::ios::in | std::ios::binary));
     return p;
 }
 
@@ -232,15 +289,24 @@ FileCollection::pointer_t DirectoryCollection::clone() const
  * all the files found in the specified directory and sub-directories
  * if the DirectoryCollection was created with the recursive flag
  * set to true (the default.)
+ *
+ * The entries get loaded once, even when several threads call the
+ * function simultaneously.
  */
 void DirectoryCollection::loadEntries() const
 {
     // WARNING: this has to stay here because the collection could get close()'d...
     mustBeValid();
 
-    if(!m_entries_loaded)
+    if(!m_entries_loaded.load(std::memory_order_acquire))
     {
-        m_entries_loaded = true;
+        // another thread may be loading the entries, wait for it
+        //
+        std::lock_guard<std::mutex> lock(m_load_mutex);
+        if(m_entries_loaded.load(std::memory_order_relaxed))
+        {
+            return;
+        }
 
         // if the read fails then the directory may have been deleted
         // in which case we want to invalidate this DirectoryCollection
@@ -262,6 +328,9 @@ void DirectoryCollection::loadEntries() const
             const_cast<DirectoryCollection *>(this)->close();
             throw;
         }
+
+        const_cast<DirectoryCollection *>(this)->invalidateIndex();
+        m_entries_loaded.store(true, std::memory_order_release);
     }
 }
 
@@ -30,11 +30,9 @@
 
 #include "zipios/zipiosexceptions.hpp"
 
+#include "crc32.hpp"
 #include "zipios_common.hpp"
 
-#include <fstream>
-#include <zlib.h>
-
 
 namespace zipios
 {
@@ -128,43 +126,24 @@ bool DirectoryEntry::isEqual(FileEntry const & file_entry) const
  * This is only a helper function. The CRC32 for the zip file is computed
  * on the fly as data is being streamed.
  *
+ * The file is read by the calling thread (see crc32File()).
+ *
  * \warning
  * This function recomputes the CRC32 on each call. It doesn't get cached.
  *
+ * \exception IOException
+ * This exception is raised if the file cannot be opened or read.
+ *
  * \return The CRC32 of this file.
  */
 uint32_t DirectoryEntry::computeCRC32() const
 {
-    uint32_t result(crc32(0L, Z_NULL, 0));
-
-    if(!m_filename.isDirectory())
+    if(m_filename.isDirectory())
     {
-        // TODO: I tried to use std::basic_ifstream<Bytef> to avoid the
-        //       reinterpret_cast<>(), but somehow that doesn't work at all
-        //
-        std::ifstream in;
-        in.open(m_filename);
-        if(!in.is_open())
-        {
-            throw IOException(
-                  "Can't open file \""
-                + m_filename.filename()
-                + "\".");
-        }
-
-        for(;;)
-        {
-            Bytef buf[64 * 1024];
-            in.read(reinterpret_cast<char *>(buf), sizeof(buf));
-            if(in.gcount() == 0)
-            {
-                break;
-            }
-            result = crc32(result, buf, in.gcount());
-        }
+        return 0;
     }
 
-    return result;
+    return crc32File(m_filename);
 }
 
 
@@ -0,0 +1,210 @@
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (c) 2015-2022  Made to Order Software Corp.  All Rights Reserved
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Implementation of zipios::EntryCache.
+ *
+ * This file defines the functions of the zipios::EntryCache class used
+ * by the ZipFile to keep the data of hot entries in memory.
+ */
+
+#include "entrycache.hpp"
+
+
+namespace zipios
+{
+
+
+/** \class EntryCache
+ * \brief A least recently used cache of entry data.
+ *
+ * The cache keeps the data of entries, keyed by the offset of their
+ * local header in the archive, until the total size of the cached data
+ * reaches the budget. At that point, the least recently used entries
+ * get evicted to make room for the new one.
+ *
+ * The buffers are reference counted: an entry which gets evicted while
+ * a stream or a view still uses its data remains valid until that
+ * stream or view is released.
+ *
+ * The cache is shared by a ZipFile and its clones so all the functions
+ * are thread safe.
+ */
+
+
+/** \brief Initialize an empty cache.
+ *
+ * \param[in] budget  The maximum number of bytes of data kept in the cache.
+ */
+EntryCache::EntryCache(size_t budget)
+    : m_budget(budget)
+{
+}
+
+
+/** \brief Change the budget of the cache.
+ *
+ * If the cache holds more than \p budget bytes, the least recently
+ * used entries are evicted immediately.
+ *
+ * \param[in] budget  The maximum number of bytes of data kept in the cache.
+ */
+void EntryCache::setBudget(size_t budget)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_budget = budget;
+    evict(m_budget);
+}
+
+
+/** \brief Retrieve the budget of the cache.
+ *
+ * \return The maximum number of bytes of data kept in the cache.
+ */
+size_t EntryCache::getBudget() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    return m_budget;
+}
+
+
+/** \brief Search for the data of an entry.
+ *
+ * On a hit, the entry becomes the most recently used one.
+ *
+ * \param[in] entry_offset  The offset of the local header of the entry.
+ *
+ * \return The data of the entry or nullptr on a miss.
+ */
+EntryCache::buffer_t EntryCache::find(offset_t entry_offset)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto const it(m_entries.find(entry_offset));
+    if(it == m_entries.end())
+    {
+        ++m_misses;
+        return buffer_t();
+    }
+
+    ++m_hits;
+    m_lru.splice(m_lru.begin(), m_lru, it->second);
+    return it->second->second;
+}
+
+
+/** \brief Add the data of an entry to the cache.
+ *
+ * The entry becomes the most recently used one. Older entries get
+ * evicted until the new data fits in the budget. Data larger than the
+ * budget is not cached at all.
+ *
+ * If another thread already added the same entry, the existing data
+ * is kept.
+ *
+ * \param[in] entry_offset  The offset of the local header of the entry.
+ * \param[in] buffer  The data of the entry.
+ */
+void EntryCache::insert(offset_t entry_offset, buffer_t buffer)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if(buffer == nullptr
+    || buffer->size() > m_budget
+    || m_entries.find(entry_offset) != m_entries.end())
+    {
+        return;
+    }
+
+    evict(m_budget - buffer->size());
+
+    m_lru.emplace_front(entry_offset, buffer);
+    m_entries[entry_offset] = m_lru.begin();
+    m_size += buffer->size();
+}
+
+
+/** \brief Remove all the entries from the cache.
+ *
+ * The counters are not reset.
+ */
+void EntryCache::clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_lru.clear();
+    m_entries.clear();
+    m_size = 0;
+}
+
+
+/** \brief Retrieve the counters of the cache.
+ *
+ * \return The number of hits, misses and evictions since the cache was
+ *         created along the current size and budget.
+ */
+ZipFile::cache_statistics_t EntryCache::getStatistics() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    ZipFile::cache_statistics_t statistics;
+    statistics.m_hits = m_hits;
+    statistics.m_misses = m_misses;
+    statistics.m_evictions = m_evictions;
+    statistics.m_entries = m_entries.size();
+    statistics.m_size = m_size;
+    statistics.m_budget = m_budget;
+    return statistics;
+}
+
+
+/** \brief Evict the least recently used entries.
+ *
+ * This function removes entries from the end of the LRU list until the
+ * size of the cached data is \p budget bytes or less. The caller must
+ * hold the mutex.
+ *
+ * \param[in] budget  The maximum number of bytes to keep.
+ */
+void EntryCache::evict(size_t budget)
+{
+    while(m_size > budget)
+    {
+        cache_item_t const & item(m_lru.back());
+        m_size -= item.second->size();
+        m_entries.erase(item.first);
+        m_lru.pop_back();
+        ++m_evictions;
+    }
+}
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
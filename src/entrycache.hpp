@@ -0,0 +1,93 @@
+#pragma once
+#ifndef ENTRYCACHE_HPP
+#define ENTRYCACHE_HPP
+
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (c) 2015-2022  Made to Order Software Corp.  All Rights Reserved
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Define zipios::EntryCache to keep decompressed entries in memory.
+ *
+ * The zipios::EntryCache class keeps the data of the most recently used
+ * entries of a ZipFile up to a budget in bytes.
+ */
+
+#include "zipios/zipfile.hpp"
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+
+namespace zipios
+{
+
+
+class EntryCache
+{
+public:
+    typedef std::shared_ptr<EntryCache>                 pointer_t;
+    typedef std::shared_ptr<std::vector<char> const>    buffer_t;
+
+                            EntryCache(size_t budget);
+                            EntryCache(EntryCache const & rhs) = delete;
+
+    EntryCache &            operator = (EntryCache const & rhs) = delete;
+
+    void                    setBudget(size_t budget);
+    size_t                  getBudget() const;
+    buffer_t                find(offset_t entry_offset);
+    void                    insert(offset_t entry_offset, buffer_t buffer);
+    void                    clear();
+    ZipFile::cache_statistics_t
+                            getStatistics() const;
+
+private:
+    typedef std::pair<offset_t, buffer_t>                   cache_item_t;
+    typedef std::list<cache_item_t>                         cache_list_t;
+    typedef std::unordered_map<offset_t, cache_list_t::iterator>
+                                                            cache_map_t;
+
+    void                    evict(size_t budget);
+
+    mutable std::mutex      m_mutex = std::mutex();
+    size_t                  m_budget = 0;
+    size_t                  m_size = 0;
+    cache_list_t            m_lru = cache_list_t();     // most recently used first
+    cache_map_t             m_entries = cache_map_t();
+    size_t                  m_hits = 0;
+    size_t                  m_misses = 0;
+    size_t                  m_evictions = 0;
+};
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
+#endif
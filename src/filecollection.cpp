@@ -27,11 +27,26 @@
  * functions.
  */
 
+#if !defined(ZIPIOS_WINDOWS) && (defined(_WINDOWS) || defined(WIN32) || defined(_WIN32) || defined(__WIN32))
+#define ZIPIOS_WINDOWS
+#endif
+
 #include "zipios/filecollection.hpp"
 
 #include "zipios/zipiosexceptions.hpp"
 
-#include <algorithm>
+#include "zipios_common.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+#ifdef ZIPIOS_WINDOWS
+#include <sys/utime.h>
+#else
+#include <utime.h>
+#endif
+
 
 
 namespace zipios
@@ -50,104 +65,38 @@ namespace
 char const * g_default_filename = "-";
 
 
-/** \brief Class object used with the std::find_if() function.
+/** \brief The size of the buffer used to extract a file.
  *
- * This function object is used with the STL find_if algorithm to
- * find a FileEntry in a container, which name (as obtained with
- * FileEntry::getName()) is identical to the name specified in the
- * MatchName constructor.
+ * Each extraction thread copies the data of the entries to the output
+ * files using a buffer of this size so the writes are large.
  */
-class MatchName
-{
-public:
-    /** \brief Initialize a MatchName object.
-     *
-     * This function saves the name to search in the FileCollection.
-     *
-     * This class expect the name to be a full path and file name
-     * with extension. The full name has to match.
-     *
-     * \param[in] name  The name of the file being searched.
-     */
-    explicit MatchName(std::string const & name)
-        : m_name(name)
-    {
-    }
-
-    /** \brief Compare an entry to this MatchName.
-     *
-     * This function compares the full name of the entry with the
-     * saved full name. If equal, then it returns true. It is used
-     * with the std::find_if() function.
-     *
-     * \todo
-     * We could transform that with lambda at some point.
-     *
-     * \param[in] entry  The entry to compare with the MatchName.
-     *
-     * \return true if the name of the entry matches the MatchName.
-     */
-    bool operator() (FileEntry::pointer_t entry) const
-    {
-        return entry->getName() == m_name;
-    }
-
-private:
-    std::string const       m_name;
-};
+size_t const g_extract_buffer_size = 256 * 1024;
 
 
-/** \brief Class object used with the std::find_if() function.
+/** \brief Change the modification time of a file.
  *
- * This function object is used with the STL find_if algorithm to
- * find a FileEntry in a container, which name (as obtained with
- * FileEntry::getFileName()) is identical to the name specified in the
- * MatchFileName constructor.
+ * This function sets the access and modification times of \p path
+ * to \p mtime.
  *
- * \warning
- * The file name cannot include a '/' in this case or the search will
- * always fail.
+ * \param[in] path  The path to the file or directory to modify.
+ * \param[in] mtime  The new modification time.
+ *
+ * \return true if the time was changed.
  */
-class MatchFileName
+bool set_modification_time(std::string const & path, std::time_t mtime)
 {
-public:
-    /** \brief Initialize a MatchFileName object.
-     *
-     * This function saves the base name to search in the
-     * FileCollection.
-     *
-     * This class expect the name to be a base file name, eventually with
-     * an extension. If the name includes a slash then the search will
-     * always fail.
-     *
-     * \param[in] name  The name of the file being searched.
-     */
-    explicit MatchFileName(std::string const & name)
-        : m_name(name)
-    {
-    }
-
-    /** \brief Compare an entry to this MatchFileName.
-     *
-     * This function compares the base name of the entry with the
-     * saved base name. If equal, then it returns true. It is used
-     * with the std::find_if() function.
-     *
-     * \todo
-     * We could transform that with lambda at some point.
-     *
-     * \param[in] entry  The entry to compare with the MatchFileName.
-     *
-     * \return true if the name of the entry matches the MatchFileName.
-     */
-    bool operator() (FileEntry::pointer_t entry) const
-    {
-        return entry->getFileName() == m_name;
-    }
-
-private:
-    std::string const       m_name;
-};
+#ifdef ZIPIOS_WINDOWS
+    struct _utimbuf times;
+    times.actime = mtime;
+    times.modtime = mtime;
+    return _utime(path.c_str(), &times) == 0;
+#else
+    struct utimbuf times;
+    times.actime = mtime;
+    times.modtime = mtime;
+    return utime(path.c_str(), &times) == 0;
+#endif
+}
 
 
 } // no name namespace
@@ -161,6 +110,28 @@ private:
  * collection of files. The specializations of FileCollection
  * represents different origins of file collections, such as
  * directories, simple filename lists and compressed archives.
+ *
+ * \par Thread Safety
+ * The read-only functions of all the collections can be called from
+ * any number of threads simultaneously on the same object. These are
+ * entries(), begin(), end(), getEntry(), findEntry(), getInputStream(),
+ * getName(), size(), isValid() and mustBeValid(). The data loaded on
+ * demand, such as the name index or the entries of a DirectoryCollection,
+ * is initialized once under a lock. The streams returned by
+ * getInputStream() are independent from each other, although one stream
+ * must not be used by several threads at the same time.
+ *
+ * \par
+ * The functions that modify a collection (addEntry(), close(),
+ * setMethod(), setLevel(), assignment, CollectionCollection::addCollection(),
+ * etc.) must not run at the same time as any other function on the same
+ * collection. Entries are shared with the callers, so modifying an entry
+ * is a modification of the collection.
+ *
+ * \par
+ * An exception is the StreamEntry. It reads from an std::istream that
+ * the caller owns and all the streams returned for that entry read from
+ * it. Such streams can only be used one at a time.
  */
 
 
@@ -323,6 +294,8 @@ FileCollection & FileCollection::operator = (FileCollection const & rhs)
         }
 
         m_valid = rhs.m_valid;
+
+        invalidateIndex();
     }
 
     return *this;
@@ -365,6 +338,7 @@ FileCollection::~FileCollection()
 void FileCollection::addEntry(FileEntry const & entry)
 {
     m_entries.push_back(entry.clone());
+    invalidateIndex();
 }
 
 
@@ -377,6 +351,7 @@ void FileCollection::close()
     m_entries.clear();
     m_filename = g_default_filename;
     m_valid = false;
+    invalidateIndex();
 }
 
 
@@ -392,12 +367,265 @@ void FileCollection::close()
  */
 FileEntry::vector_t FileCollection::entries() const
 {
+    loadEntries();
+
     mustBeValid();
 
     return m_entries;
 }
 
 
+/** \brief Extract all the entries of this collection.
+ *
+ * This function is the same as extract() without a filter.
+ *
+ * \param[in] directory  The directory where the entries get extracted.
+ * \param[in] thread_count  The number of threads used to extract the
+ *                          files, 0 to use one per processor.
+ *
+ * \return The entries which could not be extracted with an error message.
+ *
+ * \sa extract()
+ */
+FileCollection::extract_errors_t FileCollection::extractAll(std::string const & directory, size_t thread_count)
+{
+    return extract(directory, filter_t(), thread_count);
+}
+
+
+/** \brief Extract the entries of this collection to disk.
+ *
+ * This function saves the entries accepted by \p filter under
+ * \p directory. If \p filter is empty, all the entries get extracted.
+ *
+ * The directories are all created first, then the files are read and
+ * written by a pool of \p thread_count threads. Once a file is written,
+ * its modification time is set to the one of its entry. The directories
+ * get their modification time set last since creating the files changes
+ * it.
+ *
+ * An entry which fails does not stop the extraction. Instead, its name
+ * is added to the returned map along an error message. This includes
+ * entries with an absolute name or a name going outside of \p directory
+ * using "..", which are never extracted.
+ *
+ * \note
+ * The collection must be valid or the function raises an exception.
+ *
+ * \param[in] directory  The directory where the entries get extracted.
+ * \param[in] filter  A function returning true for the entries to extract.
+ * \param[in] thread_count  The number of threads used to extract the
+ *                          files, 0 to use one per processor.
+ *
+ * \return The entries which could not be extracted with an error message.
+ *
+ * \sa extractAll()
+ */
+FileCollection::extract_errors_t FileCollection::extract(std::string const & directory, filter_t const & filter, size_t thread_count)
+{
+    loadEntries();
+
+    mustBeValid();
+
+    extract_errors_t errors;
+    std::mutex errors_mutex;
+
+    // select the entries and gather the directories so we create each
+    // of them only once (the map sorts parents before their children)
+    //
+    std::filesystem::path const root(directory.empty() ? std::string(".") : directory);
+    std::vector<std::pair<FileEntry::pointer_t, std::filesystem::path>> files;
+    std::map<std::filesystem::path, FileEntry::pointer_t> directories;
+    for(auto const & entry : m_entries)
+    {
+        if(filter && !filter(*entry))
+        {
+            continue;
+        }
+
+        std::string const name(entry->getName());
+        std::filesystem::path const relative(std::filesystem::path(name).lexically_normal());
+        if(relative.empty()
+        || relative.has_root_path()
+        || *relative.begin() == "..")
+        {
+            errors[name] = "entry name is not a relative path inside the destination directory.";
+            continue;
+        }
+
+        std::filesystem::path const path(root / relative);
+        if(entry->isDirectory())
+        {
+            directories[path] = entry;
+        }
+        else
+        {
+            files.emplace_back(entry, path);
+            directories.emplace(path.parent_path(), FileEntry::pointer_t());
+        }
+    }
+
+    for(auto const & d : directories)
+    {
+        std::error_code ec;
+        std::filesystem::create_directories(d.first, ec);
+        if(ec
+        && d.second != nullptr)
+        {
+            errors[d.second->getName()] = "could not create directory: " + ec.message() + ".";
+        }
+    }
+
+    std::atomic<size_t> next(0);
+    auto worker = [this, &files, &next, &errors, &errors_mutex]()
+        {
+            std::vector<char> buffer(g_extract_buffer_size);
+            for(;;)
+            {
+                size_t const idx(next++);
+                if(idx >= files.size())
+                {
+                    break;
+                }
+                FileEntry::pointer_t const & entry(files[idx].first);
+                std::string const path(files[idx].second.string());
+
+                std::string error;
+                try
+                {
+                    stream_pointer_t is(getEntryInputStream(entry));
+                    std::ofstream out(path, std::ios::out | std::ios::binary | std::ios::trunc);
+                    if(is == nullptr)
+                    {
+                        error = "could not open the entry for reading.";
+                    }
+                    else if(!out)
+                    {
+                        error = "could not open the output file for writing.";
+                    }
+                    else
+                    {
+                        while(*is)
+                        {
+                            is->read(buffer.data(), buffer.size());
+                            out.write(buffer.data(), is->gcount());
+                        }
+                        out.close();
+                        if(is->bad())
+                        {
+                            error = "an error occurred reading the entry.";
+                        }
+                        else if(!out)
+                        {
+                            error = "an error occurred writing the output file.";
+                        }
+                        else if(!set_modification_time(path, entry->getUnixTime()))
+                        {
+                            error = "could not set the modification time of the output file.";
+                        }
+                    }
+                }
+                catch(std::exception const & e)
+                {
+                    error = e.what();
+                }
+
+                if(!error.empty())
+                {
+                    std::lock_guard<std::mutex> lock(errors_mutex);
+                    errors[entry->getName()] = error;
+                }
+            }
+        };
+
+    if(thread_count == 0)
+    {
+        thread_count = std::max(1U, std::thread::hardware_concurrency());
+    }
+    thread_count = std::min(thread_count, files.size());
+    if(thread_count <= 1)
+    {
+        worker();
+    }
+    else
+    {
+        std::vector<std::thread> threads;
+        threads.reserve(thread_count);
+        for(size_t idx(0); idx < thread_count; ++idx)
+        {
+            threads.emplace_back(worker);
+        }
+        for(auto & t : threads)
+        {
+            t.join();
+        }
+    }
+
+    for(auto const & d : directories)
+    {
+        if(d.second != nullptr
+        && errors.find(d.second->getName()) == errors.end())
+        {
+            set_modification_time(d.first.string(), d.second->getUnixTime());
+        }
+    }
+
+    return errors;
+}
+
+
+/** \brief Get an iterator to the first entry of this collection.
+ *
+ * The FileCollection can be used in a range based for loop to walk
+ * its entries without making a copy of the vector of entries as the
+ * entries() function does:
+ *
+ * \code
+ *      for(auto const & entry : zf)
+ *      {
+ *          std::cout << entry->getName() << std::endl;
+ *      }
+ * \endcode
+ *
+ * The iterators become invalid when the collection is modified
+ * (i.e. addEntry(), close(), assignment, etc.)
+ *
+ * \note
+ * The collection must be valid or the function raises an exception.
+ *
+ * \return An iterator to the first entry.
+ *
+ * \sa end()
+ * \sa entries()
+ */
+FileCollection::const_iterator FileCollection::begin() const
+{
+    loadEntries();
+
+    mustBeValid();
+
+    return m_entries.cbegin();
+}
+
+
+/** \brief Get an iterator to the end of this collection.
+ *
+ * This function returns the end iterator matching begin().
+ *
+ * \return An iterator just after the last entry.
+ *
+ * \sa begin()
+ */
+FileCollection::const_iterator FileCollection::end() const
+{
+    loadEntries();
+
+    mustBeValid();
+
+    return m_entries.cend();
+}
+
+
 /** \brief Get an entry from this collection.
  *
  * This function returns a shared pointer to a FileEntry object for
@@ -419,23 +647,154 @@ FileEntry::vector_t FileCollection::entries() const
  * \sa mustBeValid()
  */
 FileEntry::pointer_t FileCollection::getEntry(std::string const & name, MatchPath matchpath) const
+{
+    return findEntry(name, matchpath);
+}
+
+
+/** \brief Search an entry without allocating a string.
+ *
+ * This function is the same as getEntry() except that the name is
+ * passed as a string view so callers that have the name in a buffer
+ * do not have to allocate a string to search for it.
+ *
+ * The search uses a hash index which is built the first time an
+ * entry is searched and after the list of entries was modified (see
+ * invalidateIndex()). Concurrent searches share a read lock on the
+ * index; rebuilding it takes the lock exclusively. When
+ * \p matchpath is MatchPath::IGNORE and several entries have the
+ * same basename, the first one in the collection is returned, like
+ * the linear search used to do.
+ *
+ * \note
+ * The collection must be valid or the function raises an exception.
+ *
+ * \param[in] name  The name of the entry to search.
+ * \param[in] matchpath  Specify MatchPath::MATCH, if the path should match
+ *                       as well, specify MatchPath::IGNORE, if the path
+ *                       should be ignored.
+ *
+ * \return A shared pointer to the found entry. The returned pointer
+ *         is null if no entry is found.
+ *
+ * \sa getEntry()
+ * \sa mustBeValid()
+ */
+FileEntry::pointer_t FileCollection::findEntry(std::string_view name, MatchPath matchpath) const
 {
     // make sure the entries were loaded if necessary
-    entries();
+    loadEntries();
 
     mustBeValid();
 
-    FileEntry::vector_t::const_iterator iter;
-    if(matchpath == MatchPath::MATCH)
+    name_index_t const & index(matchpath == MatchPath::MATCH ? m_name_index : m_filename_index);
+
+    // the lookup holds a shared lock so no other thread can rebuild
+    // the index under our feet
+    //
     {
-        iter = std::find_if(m_entries.begin(), m_entries.end(), MatchName(name));
+        std::shared_lock<std::shared_mutex> lock(m_index_mutex);
+        if(m_index_valid.load(std::memory_order_acquire))
+        {
+            auto const it(index.find(name));
+            return it == index.end() ? FileEntry::pointer_t() : it->second;
+        }
     }
-    else
+
+    std::unique_lock<std::shared_mutex> lock(m_index_mutex);
+    if(!m_index_valid.load(std::memory_order_relaxed))
     {
-        iter = std::find_if(m_entries.begin(), m_entries.end(), MatchFileName(name));
+        buildIndex();
+    }
+    auto const it(index.find(name));
+    return it == index.end() ? FileEntry::pointer_t() : it->second;
+}
+
+
+/** \brief Retrieve an istream for an entry of this collection.
+ *
+ * This function returns an istream for the specified \p entry which
+ * must be one of the entries of this collection. It is used by the
+ * CollectionCollection which already found the entry and would
+ * otherwise have to search for it a second time.
+ *
+ * The default implementation searches the entry by name. Collections
+ * that can directly open an entry override this function.
+ *
+ * \param[in] entry  An entry of this collection.
+ *
+ * \return A shared pointer to an open istream for the specified entry.
+ */
+FileCollection::stream_pointer_t FileCollection::getEntryInputStream(FileEntry::pointer_t entry)
+{
+    return getInputStream(entry->getName());
+}
+
+
+/** \brief Make sure the entries are loaded.
+ *
+ * Collections which read their entries on demand, such as the
+ * DirectoryCollection, override this function to load them in m_entries.
+ * The functions accessing m_entries call it first so they do not have
+ * to make a copy of the entries just to trigger the load.
+ *
+ * By default the function does nothing.
+ */
+void FileCollection::loadEntries() const
+{
+}
+
+
+/** \brief Mark the name index as out of date.
+ *
+ * Classes that modify the m_entries vector must call this function so
+ * the next findEntry() rebuilds the index. The index is not checked
+ * against the entries on each lookup.
+ *
+ * \sa findEntry()
+ */
+void FileCollection::invalidateIndex()
+{
+    m_index_valid.store(false, std::memory_order_release);
+}
+
+
+/** \brief Build the name index.
+ *
+ * This function creates the full path and basename hash indexes used
+ * by findEntry(). The keys are views in m_index_names which holds a
+ * copy of each entry name so the index does not depend on the entries
+ * keeping their names in place.
+ *
+ * The basename of an entry is the last segment of its name, as
+ * returned by FileEntry::getFileName(). Only the first entry with
+ * a given basename is kept.
+ *
+ * \note
+ * The function is called with m_index_mutex locked exclusively.
+ */
+void FileCollection::buildIndex() const
+{
+    m_name_index.clear();
+    m_filename_index.clear();
+    m_index_names.clear();
+
+    // the reserve() is required so the views remain valid
+    //
+    m_index_names.reserve(m_entries.size());
+    m_name_index.reserve(m_entries.size());
+    m_filename_index.reserve(m_entries.size());
+    for(auto const & entry : m_entries)
+    {
+        m_index_names.push_back(entry->getName());
+        std::string_view const name(m_index_names.back());
+        m_name_index.emplace(name, entry);
+
+        std::string_view::size_type const pos(name.find_last_of(g_separator));
+        m_filename_index.emplace(pos == std::string_view::npos ? name : name.substr(pos + 1), entry);
     }
 
-    return iter == m_entries.end() ? FileEntry::pointer_t() : *iter;
+    m_index_valid.store(true, std::memory_order_release);
 }
 
 
@@ -471,7 +830,7 @@ std::string FileCollection::getName() const
 size_t FileCollection::size() const
 {
     // make sure the entries were loaded if necessary
-    entries();
+    loadEntries();
 
     mustBeValid();
     return m_entries.size();
@@ -534,7 +893,7 @@ void FileCollection::setMethod(
     , StorageMethod large_storage_method)
 {
     // make sure the entries were loaded if necessary
-    entries();
+    loadEntries();
 
     mustBeValid();
 
@@ -574,7 +933,7 @@ void FileCollection::setLevel(
     , FileEntry::CompressionLevel large_compression_level)
 {
     // make sure the entries were loaded if necessary
-    entries();
+    loadEntries();
 
     mustBeValid();
 
@@ -605,13 +964,12 @@ void FileCollection::setLevel(
 std::ostream & operator << (std::ostream & os, FileCollection const & collection)
 {
     os << "collection '" << collection.getName() << "' {";
-    FileEntry::vector_t entries(collection.entries());
     char const *sep("");
-    for(auto it = entries.begin(); it != entries.end(); ++it)
+    for(auto const & entry : collection)
     {
         os << sep;
         sep = ", ";
-        os << (*it)->getName();
+        os << entry->getName();
     }
     os << "}";
     return os;
@@ -0,0 +1,302 @@
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (c) 2015-2022  Made to Order Software Corp.  All Rights Reserved
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Implementation of zipios::ForwardInputStreambuf.
+ *
+ * This file includes the implementation of a read-only stream buffer
+ * which moves forward in input that cannot be repositioned.
+ */
+
+#include "forwardinputstreambuf.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+
+namespace zipios
+{
+
+
+namespace
+{
+
+/** \brief The size of the buffer used to read from the input.
+ *
+ * Each ForwardInputStreambuf allocates a buffer of this size which is
+ * filled with one read of the input stream buffer.
+ */
+size_t const g_buffer_size = 64 * 1024;
+
+
+/** \brief The number of bytes kept in the buffer once consumed.
+ *
+ * When the buffer gets refilled, the last bytes already consumed are
+ * kept at its start so a reader can seek back a little. An inflate
+ * stream which reads past the end of the compressed data (it reads
+ * chunks of getBufferSize() bytes) uses that to give back the bytes
+ * it did not use. This must be larger than getBufferSize().
+ */
+size_t const g_history_size = 16 * 1024;
+
+} // no name namespace
+
+
+/** \class ForwardInputStreambuf
+ * \brief A stream buffer over input which can only be read forward.
+ *
+ * The ForwardInputStreambuf class reads another stream buffer, such
+ * as the buffer of a pipe or a socket, without ever repositioning it.
+ * It counts the bytes it reads so it knows the current position even
+ * though the input does not. Seeking forward reads and discards the
+ * data up to the new position. Seeking backward only works within the
+ * data still present in the buffer, which includes at least the last
+ * 16 KiB consumed.
+ *
+ * The ZipStreamReader uses it so the ZipInputStreambuf, which queries
+ * the position of its input, can read archives arriving from a pipe.
+ */
+
+
+/** \brief Initialize a ForwardInputStreambuf.
+ *
+ * The position starts at zero, whatever the position of \p inbuf.
+ *
+ * \param[in,out] inbuf  The stream buffer to read from.
+ */
+ForwardInputStreambuf::ForwardInputStreambuf(std::streambuf * inbuf)
+    : FilterInputStreambuf(inbuf)
+{
+    m_buffer.resize(g_buffer_size);
+    setg(m_buffer.data(), m_buffer.data(), m_buffer.data());
+}
+
+
+/** \brief Clean up the buffer.
+ *
+ * The data read from the input and not yet consumed is lost.
+ */
+ForwardInputStreambuf::~ForwardInputStreambuf()
+{
+}
+
+
+/** \brief Make sure some data is available in the get area.
+ *
+ * This function reads from the input until at least \p size bytes are
+ * available in the get area. The data is not consumed. It is used to
+ * look at a signature before deciding how to read what follows.
+ *
+ * \param[in] size  The number of bytes which must be available.
+ *
+ * \return A pointer to the next \p size bytes or nullptr if the input
+ *         ends before.
+ */
+char const * ForwardInputStreambuf::peek(size_t size)
+{
+    size_t available(egptr() - gptr());
+    if(available >= size)
+    {
+        return gptr();
+    }
+
+    // move the history and what is left at the start of the buffer
+    // and fill the rest
+    //
+    size_t const keep(std::min(static_cast<size_t>(gptr() - eback()), g_history_size));
+    memmove(m_buffer.data(), gptr() - keep, keep + available);
+    if(m_buffer.size() < keep + size)
+    {
+        m_buffer.resize(keep + size);
+    }
+    while(available < size)
+    {
+        std::streamsize const r(m_inbuf->sgetn(m_buffer.data() + keep + available, m_buffer.size() - keep - available));
+        if(r <= 0)
+        {
+            break;
+        }
+        available += r;
+        m_position += r;
+    }
+    setg(m_buffer.data(), m_buffer.data() + keep, m_buffer.data() + keep + available);
+
+    return available >= size ? gptr() : nullptr;
+}
+
+
+/** \brief Read more data from the input.
+ *
+ * This function is called when the get area is empty. It keeps the
+ * last bytes consumed at the start of the buffer and fills the rest
+ * with one read of the input.
+ *
+ * \return The next character or EOF when the end of the input is reached.
+ */
+ForwardInputStreambuf::int_type ForwardInputStreambuf::underflow()
+{
+    if(gptr() < egptr())
+    {
+        return traits_type::to_int_type(*gptr()); // LCOV_EXCL_LINE
+    }
+
+    size_t const keep(std::min(static_cast<size_t>(egptr() - eback()), g_history_size));
+    memmove(m_buffer.data(), egptr() - keep, keep);
+    std::streamsize const r(m_inbuf->sgetn(m_buffer.data() + keep, m_buffer.size() - keep));
+    size_t const size(r > 0 ? r : 0);
+    m_position += size;
+    setg(m_buffer.data(), m_buffer.data() + keep, m_buffer.data() + keep + size);
+    if(size == 0)
+    {
+        return traits_type::eof();
+    }
+
+    return traits_type::to_int_type(*gptr());
+}
+
+
+/** \brief Read a block of data.
+ *
+ * This function copies what is left in the get area and then, if the
+ * remainder is at least as large as our buffer, it reads it directly
+ * from the input in \p s instead of going through our buffer. The end
+ * of the data read that way is copied back in the buffer as history.
+ *
+ * \param[out] s  The buffer receiving the data.
+ * \param[in] n  The number of bytes to read.
+ *
+ * \return The number of bytes read.
+ */
+std::streamsize ForwardInputStreambuf::xsgetn(char_type * s, std::streamsize n)
+{
+    std::streamsize const available(std::min(n, static_cast<std::streamsize>(egptr() - gptr())));
+    memcpy(s, gptr(), available);
+    gbump(static_cast<int>(available));
+    if(n - available < static_cast<std::streamsize>(m_buffer.size() - g_history_size))
+    {
+        return available + std::streambuf::xsgetn(s + available, n - available);
+    }
+
+    std::streamsize const r(m_inbuf->sgetn(s + available, n - available));
+    std::streamsize const size(r > 0 ? r : 0);
+    m_position += size;
+    size_t const keep(std::min(static_cast<size_t>(available + size), g_history_size));
+    memcpy(m_buffer.data(), s + available + size - keep, keep);
+    setg(m_buffer.data(), m_buffer.data() + keep, m_buffer.data() + keep);
+
+    return available + size;
+}
+
+
+/** \brief Seek to a position relative to the start or current position.
+ *
+ * This function moves the read position. Asking for the current
+ * position has no side effect. A position within the buffer is
+ * reached directly. A position further in the input is reached by
+ * reading and discarding the data up to it.
+ *
+ * The end of the input is unknown, so std::ios_base::end is not
+ * supported.
+ *
+ * \param[in] off  The offset to apply.
+ * \param[in] dir  The reference point used to apply the offset.
+ * \param[in] which  Which pointer to move, only std::ios_base::in is
+ *                   used.
+ *
+ * \return The new position or -1 if the position cannot be reached.
+ */
+ForwardInputStreambuf::pos_type ForwardInputStreambuf::seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which)
+{
+    if((which & std::ios_base::in) == 0)
+    {
+        return pos_type(off_type(-1));
+    }
+
+    off_type const current(m_position - (egptr() - gptr()));
+    off_type base(0);
+    switch(dir)
+    {
+    case std::ios_base::beg:
+        break;
+
+    case std::ios_base::cur:
+        base = current;
+        break;
+
+    default:
+        return pos_type(off_type(-1));
+
+    }
+
+    off_type const pos(base + off);
+    off_type const start_of_buffer(m_position - (egptr() - eback()));
+    if(pos < start_of_buffer)
+    {
+        return pos_type(off_type(-1));
+    }
+    if(pos <= m_position)
+    {
+        setg(eback(), eback() + (pos - start_of_buffer), egptr());
+        return pos_type(pos);
+    }
+
+    // skip the data up to the new position
+    //
+    while(m_position < pos)
+    {
+        setg(eback(), egptr(), egptr());
+        if(underflow() == traits_type::eof())
+        {
+            return pos_type(off_type(-1));
+        }
+    }
+    setg(eback(), egptr() - (m_position - pos), egptr());
+
+    return pos_type(pos);
+}
+
+
+/** \brief Seek to an absolute position.
+ *
+ * This function moves the read position to the specified absolute
+ * position, see seekoff() for the limitations.
+ *
+ * \param[in] pos  The new position.
+ * \param[in] which  Which pointer to move, only std::ios_base::in is
+ *                   supported.
+ *
+ * \return The new position or -1 if the position cannot be reached.
+ */
+ForwardInputStreambuf::pos_type ForwardInputStreambuf::seekpos(pos_type pos, std::ios_base::openmode which)
+{
+    return seekoff(off_type(pos), std::ios_base::beg, which);
+}
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
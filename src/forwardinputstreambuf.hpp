@@ -0,0 +1,77 @@
+#pragma once
+#ifndef FORWARDINPUTSTREAMBUF_HPP
+#define FORWARDINPUTSTREAMBUF_HPP
+
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (c) 2015-2022  Made to Order Software Corp.  All Rights Reserved
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Define zipios::ForwardInputStreambuf to read non-seekable input.
+ *
+ * The zipios::ForwardInputStreambuf counts the bytes read from another
+ * stream buffer so it can report its position and move forward in
+ * input which cannot be repositioned, such as a pipe.
+ */
+
+#include "filterinputstreambuf.hpp"
+
+#include "zipios/zipios-config.hpp"
+
+#include <vector>
+
+
+namespace zipios
+{
+
+
+class ForwardInputStreambuf : public FilterInputStreambuf
+{
+public:
+                                ForwardInputStreambuf(std::streambuf * inbuf);
+                                ForwardInputStreambuf(ForwardInputStreambuf const & rhs) = delete;
+    virtual                     ~ForwardInputStreambuf() override;
+
+    ForwardInputStreambuf &     operator = (ForwardInputStreambuf const & rhs) = delete;
+
+    char const *                peek(size_t size);
+
+protected:
+    virtual int_type            underflow() override;
+    virtual std::streamsize     xsgetn(char_type * s, std::streamsize n) override;
+    virtual pos_type            seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which = std::ios_base::in) override;
+    virtual pos_type            seekpos(pos_type pos, std::ios_base::openmode which = std::ios_base::in) override;
+
+private:
+    std::vector<char>           m_buffer = std::vector<char>();
+    offset_t                    m_position = 0;     // position of egptr() in the input
+};
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
+#endif
@@ -0,0 +1,223 @@
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (c) 2015-2022  Made to Order Software Corp.  All Rights Reserved
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Implementation of zipios::InflateIndex.
+ *
+ * This file defines the functions of the zipios::InflateIndex and
+ * zipios::InflateIndexCache classes used to seek in DEFLATED entries.
+ */
+
+#include "inflateindex.hpp"
+
+#include <iterator>
+
+
+namespace zipios
+{
+
+
+/** \class InflateIndex
+ * \brief A set of checkpoints in a deflate stream.
+ *
+ * A deflate stream can only be read from the start: each block refers
+ * to data in the previous 32 KiB of output and blocks do not start on
+ * byte boundaries. To restart inflating in the middle of a stream, we
+ * need the position of a block boundary in the compressed data (with
+ * the number of bits of the previous byte that belong to that block)
+ * and the 32 KiB window of inflated data that precedes it. This is
+ * the technique used by the zran.c example of zlib.
+ *
+ * The InflateInputStreambuf adds one such checkpoint each time it
+ * crosses a block boundary at least getInterval() bytes past the
+ * previous checkpoint. The index is therefore built lazily, only as
+ * far as the entry was read. Seeking restarts from the closest
+ * checkpoint before the target and inflates the few remaining bytes.
+ *
+ * Each checkpoint uses a little over 32 KiB of memory so the interval
+ * should remain in the megabytes for large entries.
+ *
+ * The index is shared by all the streams opened on the same entry so
+ * all the functions are thread safe.
+ */
+
+
+/** \brief Initialize an empty index.
+ *
+ * The \p interval defines the minimum distance, in inflated bytes,
+ * between two checkpoints.
+ *
+ * \param[in] interval  The distance between checkpoints.
+ */
+InflateIndex::InflateIndex(offset_t interval)
+    : m_interval(interval)
+{
+}
+
+
+/** \brief Retrieve the distance between checkpoints.
+ *
+ * \return The interval specified on construction.
+ */
+offset_t InflateIndex::getInterval() const
+{
+    return m_interval;
+}
+
+
+/** \brief Retrieve the number of checkpoints in this index.
+ *
+ * \return The number of checkpoints added so far.
+ */
+size_t InflateIndex::size() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_checkpoints.size();
+}
+
+
+/** \brief Determine where the next checkpoint is due.
+ *
+ * This function returns the position in the inflated data at which a
+ * stream currently at \p position should add its next checkpoint.
+ * The start of the data is an implicit checkpoint.
+ *
+ * When the returned value is less than or equal to \p position, a
+ * checkpoint is due at the next block boundary. A checkpoint found
+ * a short distance after \p position (i.e. added by another stream
+ * which stopped at a different block boundary) postpones the next
+ * one so the index does not get two checkpoints a few bytes apart.
+ *
+ * \param[in] position  The current position in the inflated data.
+ *
+ * \return The position at which the next checkpoint is due.
+ */
+offset_t InflateIndex::nextCheckpoint(offset_t position) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    checkpoint_map_t::const_iterator it(m_checkpoints.upper_bound(position));
+    if(it != m_checkpoints.end()
+    && it->first - position < m_interval)
+    {
+        return it->first + m_interval;
+    }
+
+    offset_t const previous(it == m_checkpoints.begin() ? 0 : std::prev(it)->first);
+    return previous + m_interval;
+}
+
+
+/** \brief Add a checkpoint to the index.
+ *
+ * This function saves \p checkpoint in the index. If another stream
+ * already saved a checkpoint at the same position, the index is left
+ * unchanged.
+ *
+ * \param[in] checkpoint  The checkpoint to add.
+ */
+void InflateIndex::addCheckpoint(checkpoint_t::pointer_t checkpoint)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_checkpoints.emplace(checkpoint->m_out, checkpoint);
+}
+
+
+/** \brief Find the checkpoint to use to seek to the specified position.
+ *
+ * This function returns the last checkpoint at or before \p position.
+ *
+ * \param[in] position  The position in the inflated data to seek to.
+ *
+ * \return The checkpoint or nullptr when inflating has to restart
+ *         from the start of the data.
+ */
+InflateIndex::checkpoint_t::pointer_t InflateIndex::findCheckpoint(offset_t position) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    checkpoint_map_t::const_iterator it(m_checkpoints.upper_bound(position));
+    if(it == m_checkpoints.begin())
+    {
+        return checkpoint_t::pointer_t();
+    }
+
+    return std::prev(it)->second;
+}
+
+
+
+/** \class InflateIndexCache
+ * \brief The inflate indexes of the entries of a ZipFile.
+ *
+ * The ZipFile keeps one InflateIndex per DEFLATED entry so the streams
+ * opened later on the same entry benefit from the checkpoints added
+ * by the previous ones. The indexes are identified by the offset of
+ * the entry in the archive.
+ */
+
+
+/** \brief Retrieve the index of an entry.
+ *
+ * This function returns the index of the entry found at
+ * \p entry_offset, creating it on the first call. If the existing
+ * index uses a different interval, it gets replaced.
+ *
+ * \param[in] entry_offset  The offset of the entry in the archive.
+ * \param[in] interval  The distance between checkpoints.
+ *
+ * \return The index of the entry.
+ */
+InflateIndex::pointer_t InflateIndexCache::getIndex(offset_t entry_offset, offset_t interval)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    InflateIndex::pointer_t & index(m_indexes[entry_offset]);
+    if(index == nullptr
+    || index->getInterval() != interval)
+    {
+        index = std::make_shared<InflateIndex>(interval);
+    }
+
+    return index;
+}
+
+
+/** \brief Release all the indexes.
+ *
+ * The streams currently using an index keep their own reference to it.
+ */
+void InflateIndexCache::clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_indexes.clear();
+}
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
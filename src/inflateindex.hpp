@@ -0,0 +1,107 @@
+#pragma once
+#ifndef INFLATEINDEX_HPP
+#define INFLATEINDEX_HPP
+
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (c) 2015-2022  Made to Order Software Corp.  All Rights Reserved
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Define zipios::InflateIndex to seek in compressed data.
+ *
+ * The zipios::InflateIndex class saves the state of the inflate
+ * stream at regular intervals so a stream can restart inflating
+ * from the middle of a DEFLATED entry.
+ */
+
+#include "zipios/zipios-config.hpp"
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+
+namespace zipios
+{
+
+
+class InflateIndex
+{
+public:
+    typedef std::shared_ptr<InflateIndex>   pointer_t;
+
+    struct checkpoint_t
+    {
+        typedef std::shared_ptr<checkpoint_t const>    pointer_t;
+
+        offset_t                    m_out = 0;      // position in the inflated data
+        offset_t                    m_in = 0;       // position in the compressed data
+        int                         m_bits = 0;     // bits of the byte at m_in - 1 still to be used
+        std::vector<unsigned char>  m_window = std::vector<unsigned char>();
+    };
+
+                            InflateIndex(offset_t interval);
+                            InflateIndex(InflateIndex const & rhs) = delete;
+
+    InflateIndex &          operator = (InflateIndex const & rhs) = delete;
+
+    offset_t                getInterval() const;
+    size_t                  size() const;
+    offset_t                nextCheckpoint(offset_t position) const;
+    void                    addCheckpoint(checkpoint_t::pointer_t checkpoint);
+    checkpoint_t::pointer_t findCheckpoint(offset_t position) const;
+
+private:
+    typedef std::map<offset_t, checkpoint_t::pointer_t>     checkpoint_map_t;
+
+    mutable std::mutex      m_mutex = std::mutex();
+    offset_t                m_interval = 0;
+    checkpoint_map_t        m_checkpoints = checkpoint_map_t();
+};
+
+
+class InflateIndexCache
+{
+public:
+    typedef std::shared_ptr<InflateIndexCache>  pointer_t;
+
+    InflateIndex::pointer_t getIndex(offset_t entry_offset, offset_t interval);
+    void                    clear();
+
+private:
+    typedef std::unordered_map<offset_t, InflateIndex::pointer_t>   index_map_t;
+
+    std::mutex              m_mutex = std::mutex();
+    index_map_t             m_indexes = index_map_t();
+};
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
+#endif
@@ -31,8 +31,13 @@
 
 #include "zipios/zipiosexceptions.hpp"
 
+#include "inflatepool.hpp"
 #include "zipios_common.hpp"
 
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
 
 namespace zipios
 {
@@ -44,9 +49,9 @@ namespace zipios
  * inflates the input from the attached input stream.
  *
  * Deflation/Inflation is a compression/decompression method used
- * in gzip and zip. The zlib library is used to perform the actual
- * inflation, this class only wraps the functionality in an input
- * stream filter.
+ * in gzip and zip. The engine selected with setCompressionEngine()
+ * (zlib by default) is used to perform the actual inflation, this
+ * class only wraps the functionality in an input stream filter.
  *
  * \todo
  * Add support for bzip2, lzma compressions.
@@ -60,8 +65,8 @@ namespace zipios
  * setup the stream start position using the \p start_pos
  * parameter.
  *
- * Data will be inflated (decompressed using zlib) before being
- * returned.
+ * Data will be inflated (decompressed using the compression engine
+ * selected with setCompressionEngine()) before being returned.
  *
  * \param[in,out] inbuf  The streambuf to use for input.
  * \param[in] start_pos  A position to reset the inbuf to before reading. Specify
@@ -69,8 +74,7 @@ namespace zipios
  */
 InflateInputStreambuf::InflateInputStreambuf(std::streambuf * inbuf, offset_t start_pos)
     : FilterInputStreambuf(inbuf)
-    , m_outvec(getBufferSize())
-    , m_invec(getBufferSize())
+    , m_outvec(acquireStreamBuffer())
 {
     // NOTICE: It is important that this constructor and the methods it
     // calls doesn't do anything with the input streambuf inbuf, other
@@ -87,24 +91,14 @@ InflateInputStreambuf::InflateInputStreambuf(std::streambuf * inbuf, offset_t st
 
 /** \brief Clean up the InflateInputStreambuf object.
  *
- * The destructor makes sure all allocated resources get cleaned up.
+ * The destructor returns the backend and the buffers to the pool of
+ * the current thread so the next stream can reuse them.
  */
 InflateInputStreambuf::~InflateInputStreambuf()
 {
-    // Dealloc z_stream stuff
-    int const err(inflateEnd(&m_zs));
-    if(err != Z_OK)
-    {
-        // in a destructor we cannot throw...
-        OutputStringStream msgs; // LCOV_EXCL_LINE
-        msgs << "InflateInputStreambuf::~InflateInputStreambuf(): inflateEnd() failed" // LCOV_EXCL_LINE
-             << ": " << zError(err); // LCOV_EXCL_LINE
-        /** \TODO
-         * Write an error callback interface and call that instead of
-         * using std::cerr...
-         */
-        std::cerr << msgs.str() << std::endl; // LCOV_EXCL_LINE
-    }
+    releaseInflateBackend(std::move(m_backend));
+    releaseStreamBuffer(m_invec);
+    releaseStreamBuffer(m_outvec);
 }
 
 
@@ -114,8 +108,8 @@ InflateInputStreambuf::~InflateInputStreambuf()
  * in the input area by updating the pointers to the input area
  * and reading more data in from the input sequence if required.
  *
- * This function actually passes the data through the zlib library
- * to decompress it.
+ * The data is obtained with readData(), which passes it through the
+ * compression backend to decompress it.
  *
  * \return The value of that character on success or
  *         std::streambuf::traits_type::eof() on failure.
@@ -129,39 +123,171 @@ std::streambuf::int_type InflateInputStreambuf::underflow()
         return traits_type::to_int_type(*gptr()); // LCOV_EXCL_LINE
     }
 
-    // Prepare _outvec and get array pointers
-    m_zs.avail_out = getBufferSize();
-    m_zs.next_out = reinterpret_cast<unsigned char *>(&m_outvec[0]);
+    std::streamsize const bytes(readData(&m_outvec[0], getBufferSize()));
+    setg(&m_outvec[0], &m_outvec[0], &m_outvec[0] + bytes);
+
+    if(bytes > 0)
+    {
+        return traits_type::to_int_type(*gptr());
+    }
+
+    return traits_type::eof();
+}
+
+
+/** \brief Read a block of data.
+ *
+ * This function is called by istream::read() and similar functions to
+ * read \p n bytes at once. The data still available in the get area is
+ * copied first. After that, when the remainder is at least as large as
+ * our buffer, the data gets inflated directly in the caller's buffer
+ * instead of going through m_outvec and getting copied a second time.
+ * Small remainders still go through underflow() so the rest of the
+ * inflated buffer is available to the following reads.
+ *
+ * \param[out] s  The buffer receiving the data.
+ * \param[in] n  The number of bytes to read.
+ *
+ * \return The number of bytes read, less than \p n at the end of the data.
+ */
+std::streamsize InflateInputStreambuf::xsgetn(char * s, std::streamsize n)
+{
+    std::streamsize got(0);
+    while(got < n)
+    {
+        std::streamsize const available(egptr() - gptr());
+        if(available > 0)
+        {
+            std::streamsize const size(std::min(available, n - got));
+            memcpy(s + got, gptr(), size);
+            gbump(static_cast<int>(size));
+            got += size;
+        }
+        else if(n - got >= static_cast<std::streamsize>(getBufferSize()))
+        {
+            // the get area does not represent the data preceding the
+            // current position anymore
+            //
+            setg(&m_outvec[0], &m_outvec[0], &m_outvec[0]);
+            std::streamsize const bytes(readData(s + got, n - got));
+            if(bytes == 0)
+            {
+                break;
+            }
+            got += bytes;
+        }
+        else if(traits_type::eq_int_type(underflow(), traits_type::eof()))
+        {
+            break;
+        }
+    }
+
+    return got;
+}
+
+
+/** \brief Inflate data in the specified buffer.
+ *
+ * This function reads compressed data from the input streambuf and
+ * inflates it in \p buffer until the buffer is full or the end of
+ * the compressed data is reached.
+ *
+ * Sub-classes can override this function to read data in another
+ * way (i.e. the ZipInputStreambuf reads STORED entries as is.) Both,
+ * underflow() and xsgetn(), get their data through this function.
+ *
+ * When an index is attached (see setIndex()), inflate stops at each
+ * block boundary so a checkpoint can be added to the index once the
+ * interval since the previous checkpoint is reached.
+ *
+ * \exception IOException
+ * This exception is raised if the backend fails to inflate the data.
+ *
+ * \param[out] buffer  The buffer receiving the inflated data.
+ * \param[in] size  The size of \p buffer.
+ *
+ * \return The number of bytes saved in \p buffer, 0 at the end of the data.
+ */
+std::streamsize InflateInputStreambuf::readData(char * buffer, std::streamsize size)
+{
+    // zipios saves empty entries without any deflate data, not even
+    // an empty final block
+    //
+    if(m_input_size == 0)
+    {
+        return 0;
+    }
 
-    // Inflate until _outvec is full
+    // Inflate until buffer is full
     // eof (or I/O prob) on _inbuf will break out of loop too.
-    int err(Z_OK);
-    while(m_zs.avail_out > 0 && err == Z_OK)
+    // once the end of the stream was found, do not read any more
+    // input, it belongs to whatever follows the compressed data
+    //
+    if(m_end_of_stream)
     {
-        if(m_zs.avail_in == 0)
+        return 0;
+    }
+
+    InflateBackend & backend(getBackend());
+    std::streamsize got(0);
+    InflateBackend::status_t status(InflateBackend::status_t::OK);
+    while(got < size && status == InflateBackend::status_t::OK)
+    {
+        if(backend.getAvailableInput() == 0)
         {
-            // fill m_invec
-            std::streamsize const bc(m_inbuf->sgetn(&m_invec[0], getBufferSize()));
+            // fill m_invec, without reading past the compressed data
+            // when its size is known
+            std::streamsize in_size(getBufferSize());
+            if(m_remain_in >= 0 && m_remain_in < in_size)
+            {
+                in_size = m_remain_in;
+            }
+            std::streamsize const bc(in_size > 0 ? m_inbuf->sgetn(&m_invec[0], in_size) : 0);
             /** \FIXME
              * Add I/O error handling while inflating data from a file.
              */
-            m_zs.next_in = reinterpret_cast<unsigned char *>(&m_invec[0]);
-            m_zs.avail_in = bc;
+            backend.setInput(&m_invec[0], bc);
+            m_read_in += bc;
+            if(m_remain_in > 0)
+            {
+                m_remain_in -= bc;
+            }
             // If we could not read any new data (bc == 0) and inflate is not
-            // done it will return Z_BUF_ERROR and thus breaks out of the
+            // done it will return BUFFER_ERROR and thus breaks out of the
             // loop. This means we do not have to respond to the situation
             // where we cannot read more bytes here.
         }
 
-        err = inflate(&m_zs, Z_NO_FLUSH);
+        // once the last byte of the compressed data was read, tell the
+        // backend that this is the end so it does not wait for a "dummy"
+        // byte; with an index, stop at each block boundary
+        //
+        InflateBackend::flush_t const flush(m_remain_in == 0
+                                                ? InflateBackend::flush_t::FINISH
+                                                : (m_index == nullptr
+                                                        ? InflateBackend::flush_t::NO_FLUSH
+                                                        : InflateBackend::flush_t::BLOCK));
+        size_t bytes(size - got);
+        status = backend.inflate(buffer + got, bytes, flush);
+        got += bytes;
+
+        if(flush == InflateBackend::flush_t::BLOCK
+        && status == InflateBackend::status_t::OK
+        && backend.atBlockBoundary()
+        && m_total_out + got >= m_next_checkpoint)
+        {
+            addCheckpoint(m_total_out + got);
+        }
     }
+    m_total_out += got;
 
-    // Normally the number of inflated bytes will be the
-    // full length of the output buffer, but if we can't read
-    // more input from the _inbuf streambuf, we end up with
-    // less.
-    offset_t const inflated_bytes = getBufferSize() - m_zs.avail_out;
-    setg(&m_outvec[0], &m_outvec[0], &m_outvec[0] + inflated_bytes);
+    // at the end of the data, the backend reports a full output
+    // buffer as a BUFFER_ERROR
+    if(status == InflateBackend::status_t::BUFFER_ERROR
+    && got == size)
+    {
+        status = InflateBackend::status_t::OK;
+    }
 
     /** \FIXME
      * Look at the error returned from inflate here, if there is
@@ -170,42 +296,54 @@ std::streambuf::int_type InflateInputStreambuf::underflow()
      * This at least throws, we probably want to create a log
      * mechanism that the end user can connect to with a callback.
      */
-    if(err != Z_OK && err != Z_STREAM_END)
+    if(status != InflateBackend::status_t::OK
+    && status != InflateBackend::status_t::STREAM_END)
     {
         OutputStringStream msgs;
         msgs << "InflateInputStreambuf::underflow(): inflate failed"
-             << ": " << zError(err);
+             << ": " << backend.getErrorMessage();
         // Throw an exception to immediately exit to the read() or similar
         // function and make istream set badbit
         throw IOException(msgs.str());
     }
+    m_end_of_stream = status == InflateBackend::status_t::STREAM_END;
 
-    if(inflated_bytes > 0)
-    {
-        return traits_type::to_int_type(*gptr());
-    }
-
-    return traits_type::eof();
+    // Normally the number of inflated bytes will be the
+    // full length of the output buffer, but if we can't read
+    // more input from the _inbuf streambuf, we end up with
+    // less.
+    return got;
 }
 
 
 
 /** \brief Initializes the stream buffer.
  *
- * This function resets the zlib stream and purges input and output buffers.
+ * This function resets the inflate backend and purges input and output buffers.
  * It also repositions the input streambuf at stream_position.
  *
+ * The backend is only acquired when data gets inflated (see getBackend())
+ * so a sub-class which does not inflate (i.e. a STORED entry in a
+ * ZipInputStreambuf) never initializes the compression library.
+ *
  * \warning
  * This method is called in the constructor, so it must not read anything
  * from the input streambuf m_inbuf (see notice in constructor.)
  *
+ * When \p input_size is specified, the inflate input is bounded to
+ * exactly that many bytes: the stream never reads past the compressed
+ * data and the last chunk of input is flagged as the end of the
+ * stream. Otherwise the data is read in full buffers until the backend finds
+ * the end of the stream, which may read bytes that follow it.
+ *
  * \param[in] stream_position  A position to reset the inbuf to before
  *                             reading. Specify -1 to read from the
  *                             current position.
+ * \param[in] input_size  The size of the compressed data or -1 if unknown.
  *
  * \sa InflateInputStreambuf()
  */
-bool InflateInputStreambuf::reset(offset_t stream_position)
+bool InflateInputStreambuf::reset(offset_t stream_position, offset_t input_size)
 {
     if(stream_position >= 0)
     {
@@ -213,29 +351,21 @@ bool InflateInputStreambuf::reset(offset_t stream_position)
         m_inbuf->pubseekpos(stream_position);
     }
 
-    // m_zs.next_in and avail_in must be set according to
-    // zlib.h (inline doc).
-    m_zs.next_in = reinterpret_cast<Bytef *>(&m_invec[0]);
-    m_zs.avail_in = 0;
-
-    int err(Z_OK);
-    if(m_zs_initialized)
-    {
-        // just reset it
-        err = inflateReset(&m_zs);
-    }
-    else
-    {
-        // initialize it
-        err = inflateInit2(&m_zs, -MAX_WBITS);
-        /* windowBits is passed < 0 to tell that there is no zlib header.
-           Note that in this case inflate *requires* an extra "dummy" byte
-           after the compressed stream in order to complete decompression
-           and return Z_STREAM_END.  We always have an extra "dummy" byte,
-           because there is always some trailing data after the compressed
-           data (either the next entry or the central directory.  */
-        m_zs_initialized = true;
-    }
+    // remember where the data starts so seekData() can restart
+    //
+    m_data_start = m_inbuf->pubseekoff(0, std::ios::cur, std::ios::in);
+    m_input_size = input_size;
+    m_read_in = 0;
+    m_total_out = 0;
+    m_end_of_stream = false;
+
+    // reset() drops any pending input; when the size of the compressed
+    // data is known, the last chunk is passed with FINISH so inflate
+    // does not need any byte past the compressed stream to detect the
+    // end of the stream
+    //
+    m_remain_in = input_size;
+    bool const result(m_backend == nullptr || m_backend->reset());
 
     // streambuf init:
     // The important thing here, is that
@@ -244,7 +374,266 @@ bool InflateInputStreambuf::reset(offset_t stream_position)
     //   the first time data is read).
     setg(&m_outvec[0], &m_outvec[0] + getBufferSize(), &m_outvec[0] + getBufferSize());
 
-    return err == Z_OK;
+    return result;
+}
+
+
+/** \brief Get the inflate backend, acquiring it if necessary.
+ *
+ * The first call takes a backend and an input buffer from the pool of
+ * the current thread (see acquireInflateBackend()) and resets the
+ * backend. The following calls return the same backend.
+ *
+ * \exception IOException
+ * This exception is raised if the backend cannot be initialized.
+ *
+ * \return A reference to the backend of this stream buffer.
+ */
+InflateBackend & InflateInputStreambuf::getBackend()
+{
+    if(m_backend == nullptr)
+    {
+        InflateBackend::pointer_t backend(acquireInflateBackend());
+        if(!backend->reset())
+        {
+            throw IOException("InflateInputStreambuf::getBackend(): the inflate backend could not be initialized: " + backend->getErrorMessage()); // LCOV_EXCL_LINE
+        }
+        m_backend = std::move(backend);
+        m_invec = acquireStreamBuffer();
+    }
+
+    return *m_backend;
+}
+
+
+/** \brief Attach an index of checkpoints to this stream buffer.
+ *
+ * The index makes seekData() fast: instead of inflating all the data
+ * from the start, it restarts from the closest checkpoint. While the
+ * data gets read, new checkpoints are added to the index so the next
+ * seek benefits from them.
+ *
+ * The index should be attached right after reset() and it has to be
+ * specific to the compressed data read by this stream buffer.
+ *
+ * \param[in] index  The index to use and update, may be nullptr.
+ */
+void InflateInputStreambuf::setIndex(InflateIndex::pointer_t index)
+{
+    // without checkpoints, seeking restarts from the start of the data
+    //
+    m_index = index != nullptr && getBackend().supportsCheckpoints() ? index : InflateIndex::pointer_t();
+    if(m_index != nullptr)
+    {
+        m_next_checkpoint = m_index->nextCheckpoint(m_total_out);
+    }
+}
+
+
+/** \brief Position the stream so the next read starts at \p position.
+ *
+ * This function repositions the inflate stream so the next call to
+ * readData() returns the inflated data starting at \p position. When
+ * the position is behind the current position, inflating restarts
+ * from the closest checkpoint found in the index or from the start of
+ * the compressed data. The bytes between that restart point and
+ * \p position are inflated and discarded.
+ *
+ * The caller is responsible for the get area.
+ *
+ * \exception IOException
+ * This exception is raised if the backend fails to inflate the data.
+ *
+ * \param[in] position  The position in the inflated data.
+ *
+ * \return true if the stream is now at \p position, false if the
+ *         input cannot be repositioned or the data is too short.
+ */
+bool InflateInputStreambuf::seekData(offset_t position)
+{
+    InflateIndex::checkpoint_t::pointer_t checkpoint;
+    if(m_index != nullptr)
+    {
+        checkpoint = m_index->findCheckpoint(position);
+    }
+    offset_t const restart_position(checkpoint != nullptr ? checkpoint->m_out : 0);
+    if(position < m_total_out
+    || restart_position > m_total_out)
+    {
+        if(!restart(checkpoint.get()))
+        {
+            return false;
+        }
+    }
+
+    while(m_total_out < position)
+    {
+        std::streamsize const size(static_cast<std::streamsize>(std::min(
+                                      position - m_total_out
+                                    , static_cast<offset_t>(getBufferSize()))));
+        if(InflateInputStreambuf::readData(&m_outvec[0], size) == 0)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+/** \brief Retrieve the current position in the inflated data.
+ *
+ * \return The number of inflated bytes returned by readData() since the
+ *         start of the data, data still in the get area included.
+ */
+offset_t InflateInputStreambuf::getDataPosition() const
+{
+    return m_total_out;
+}
+
+
+/** \brief Retrieve the number of compressed bytes used so far.
+ *
+ * This is the number of bytes read from the input minus the bytes the
+ * backend did not consume yet. Once readData() returned 0, it is the
+ * size of the compressed data, which is how the end of an entry with
+ * an unknown compressed size gets found.
+ *
+ * \return The number of bytes of compressed data consumed.
+ */
+offset_t InflateInputStreambuf::getCompressedSize() const
+{
+    return m_read_in - static_cast<offset_t>(m_backend == nullptr ? 0 : m_backend->getAvailableInput());
+}
+
+
+/** \brief Give back to the input the bytes the backend did not consume.
+ *
+ * The input is read in chunks of getBufferSize() bytes, so when the
+ * size of the compressed data is not known, the last chunk generally
+ * includes bytes found after the compressed data. This function moves
+ * the input back so its position is right after the compressed data.
+ *
+ * It is expected to be called once readData() returned 0.
+ *
+ * \return true if the input is now positioned right after the last byte
+ *         consumed, false if it cannot be repositioned.
+ */
+bool InflateInputStreambuf::rewindInput()
+{
+    offset_t const unused(m_read_in - getCompressedSize());
+    if(unused == 0)
+    {
+        return true;
+    }
+
+    if(m_inbuf->pubseekoff(-unused, std::ios::cur, std::ios::in) == std::streampos(-1))
+    {
+        return false;
+    }
+    m_read_in -= unused;
+    m_backend->setInput(&m_invec[0], 0);
+
+    return true;
+}
+
+
+/** \brief Restart inflating from a checkpoint.
+ *
+ * This function resets the backend and repositions the input at
+ * \p checkpoint, or at the start of the compressed data when
+ * \p checkpoint is nullptr. When the block at the checkpoint starts in
+ * the middle of a byte, that byte is read and its remaining bits are
+ * fed back to the backend along the window saved in the checkpoint
+ * (with zlib, inflatePrime() and inflateSetDictionary().)
+ *
+ * \param[in] checkpoint  The checkpoint to restart from or nullptr.
+ *
+ * \return true if the stream was restarted.
+ */
+bool InflateInputStreambuf::restart(InflateIndex::checkpoint_t const * checkpoint)
+{
+    if(m_data_start < 0)
+    {
+        return false;
+    }
+
+    offset_t const in(checkpoint != nullptr ? checkpoint->m_in : 0);
+    int const bits(checkpoint != nullptr ? checkpoint->m_bits : 0);
+    offset_t const start(m_data_start + in - (bits != 0 ? 1 : 0));
+    if(m_inbuf->pubseekpos(start, std::ios::in) != std::streampos(start)
+    || !getBackend().reset())
+    {
+        return false;
+    }
+
+    m_remain_in = m_input_size < 0 ? -1 : m_input_size - in;
+    m_read_in = in;
+    m_total_out = 0;
+    m_end_of_stream = false;
+
+    if(checkpoint != nullptr)
+    {
+        int value(0);
+        if(bits != 0)
+        {
+            int const c(m_inbuf->sbumpc());
+            if(c == traits_type::eof())
+            {
+                return false;
+            }
+            value = c >> (8 - bits);
+        }
+        if(!getBackend().restore(
+                      bits
+                    , value
+                    , checkpoint->m_window.data()
+                    , checkpoint->m_window.size()))
+        {
+            return false;
+        }
+        m_total_out = checkpoint->m_out;
+    }
+
+    if(m_index != nullptr)
+    {
+        m_next_checkpoint = m_index->nextCheckpoint(m_total_out);
+    }
+
+    return true;
+}
+
+
+/** \brief Save the state of the inflate stream in the index.
+ *
+ * This function is called by readData() when inflate stopped at a
+ * block boundary at least one interval after the previous checkpoint.
+ * It saves the position of the boundary in the compressed data, the
+ * number of bits of the last byte that belong to the next block and
+ * the current window of inflated data.
+ *
+ * If another stream already added a checkpoint close to this position
+ * no new checkpoint gets added.
+ *
+ * \param[in] position  The position of the boundary in the inflated data.
+ */
+void InflateInputStreambuf::addCheckpoint(offset_t position)
+{
+    m_next_checkpoint = m_index->nextCheckpoint(position);
+    if(position < m_next_checkpoint)
+    {
+        return;
+    }
+
+    std::shared_ptr<InflateIndex::checkpoint_t> checkpoint(std::make_shared<InflateIndex::checkpoint_t>());
+    checkpoint->m_out = position;
+    checkpoint->m_in = m_read_in - m_backend->getAvailableInput();
+    checkpoint->m_bits = m_backend->getPendingBits();
+    checkpoint->m_window.resize(32768);
+    checkpoint->m_window.resize(m_backend->getWindow(checkpoint->m_window.data()));
+    m_index->addCheckpoint(checkpoint);
+
+    m_next_checkpoint = position + m_index->getInterval();
 }
 
 
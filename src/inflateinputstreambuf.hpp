@@ -31,14 +31,14 @@
  * class and which may be compressed using the zlib library.
  */
 
+#include "compressionbackend.hpp"
 #include "filterinputstreambuf.hpp"
+#include "inflateindex.hpp"
 
 #include "zipios/zipios-config.hpp"
 
 #include <vector>
 
-#include <zlib.h>
-
 
 namespace zipios
 {
@@ -53,20 +53,38 @@ public:
 
     InflateInputStreambuf &  operator = (InflateInputStreambuf const & rhs) = delete;
 
-    bool                    reset(offset_t stream_position = -1);
+    bool                    reset(offset_t stream_position = -1, offset_t input_size = -1);
+    void                    setIndex(InflateIndex::pointer_t index);
 
 protected:
     virtual std::streambuf::int_type             underflow() override;
+    virtual std::streamsize                      xsgetn(char * s, std::streamsize n) override;
+    virtual std::streamsize                      readData(char * buffer, std::streamsize size);
+    bool                                         seekData(offset_t position);
+    offset_t                                     getDataPosition() const;
+    offset_t                                     getCompressedSize() const;
+    bool                                         rewindInput();
 
     /** \FIXME Consider design?
      */
     std::vector<char>       m_outvec = std::vector<char>();
 
 private:
+    InflateBackend &        getBackend();
+    bool                    restart(InflateIndex::checkpoint_t const * checkpoint);
+    void                    addCheckpoint(offset_t position);
+
     std::vector<char>       m_invec = std::vector<char>();
 
-    z_stream                m_zs = z_stream();
-    bool                    m_zs_initialized = false;
+    InflateBackend::pointer_t   m_backend = InflateBackend::pointer_t();
+    offset_t                m_remain_in = -1;   // compressed bytes not yet read from m_inbuf, -1 if unknown
+    offset_t                m_data_start = -1;  // position of the compressed data in m_inbuf, -1 if unknown
+    offset_t                m_input_size = -1;  // size of the compressed data, -1 if unknown
+    offset_t                m_read_in = 0;      // compressed bytes read from m_inbuf
+    offset_t                m_total_out = 0;    // inflated bytes returned by readData()
+    InflateIndex::pointer_t m_index = InflateIndex::pointer_t();
+    offset_t                m_next_checkpoint = 0;
+    bool                    m_end_of_stream = false;
 };
 
 
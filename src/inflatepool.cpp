@@ -0,0 +1,216 @@
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (c) 2015-2022  Made to Order Software Corp.  All Rights Reserved
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Implementation of the pool of inflate backends and buffers.
+ *
+ * Each thread keeps a few inflate backends and stream buffers released
+ * by the streams it destroyed. The next stream created by that thread
+ * reuses them. A backend taken from the pool only needs a reset (with
+ * zlib, an inflateReset() instead of an inflateInit2()) and the buffers
+ * do not need to be allocated again.
+ */
+
+#include "inflatepool.hpp"
+
+#include "zipios/compressionengine.hpp"
+
+#include <atomic>
+
+
+namespace zipios
+{
+
+
+namespace
+{
+
+
+/** \brief Maximum number of backends kept by a thread.
+ *
+ * With zlib, each backend uses about 40 KiB. A thread rarely reads
+ * more than a few entries at the same time so a few backends are
+ * enough to avoid nearly all allocations.
+ */
+size_t const g_max_backends = 4;
+
+
+/** \brief Maximum number of buffers kept by a thread.
+ *
+ * Each stream uses one buffer for its output and, when it inflates,
+ * another for its input.
+ */
+size_t const g_max_buffers = 8;
+
+
+/** \brief Number of backends created by acquireInflateBackend().
+ *
+ * Backends taken from a pool are not counted.
+ */
+std::atomic<size_t> g_backend_count(0);
+
+
+/** \brief Whether the pool of this thread was destroyed.
+ *
+ * A stream destroyed while its thread exits (or, in the main thread,
+ * after the thread local objects were destroyed) must not return
+ * its resources to the pool anymore. This flag is trivially
+ * destructible so it can be checked at any time.
+ */
+thread_local bool g_pool_destroyed = false;
+
+
+/** \brief The resources kept by a thread.
+ *
+ * The backends and buffers released by the streams of a thread.
+ */
+struct pool_t
+{
+    ~pool_t()
+    {
+        g_pool_destroyed = true;
+    }
+
+    std::vector<InflateBackend::pointer_t>  m_backends = std::vector<InflateBackend::pointer_t>();
+    std::vector<std::vector<char>>          m_buffers = std::vector<std::vector<char>>();
+};
+
+
+thread_local pool_t g_pool;
+
+
+} // no name namespace
+
+
+
+/** \brief Get an inflate backend.
+ *
+ * This function returns a backend of the current compression engine
+ * from the pool of the calling thread. If the pool has no such backend,
+ * a new one gets created.
+ *
+ * The backend has to be reset before use.
+ *
+ * \return An inflate backend.
+ */
+InflateBackend::pointer_t acquireInflateBackend()
+{
+    if(!g_pool_destroyed)
+    {
+        CompressionEngine const engine(getCompressionEngine());
+        while(!g_pool.m_backends.empty())
+        {
+            InflateBackend::pointer_t backend(std::move(g_pool.m_backends.back()));
+            g_pool.m_backends.pop_back();
+            if(backend->getEngine() == engine)
+            {
+                return backend;
+            }
+            // the engine changed, drop this backend
+        }
+    }
+
+    ++g_backend_count;
+    return InflateBackend::create();
+}
+
+
+/** \brief Return an inflate backend to the pool.
+ *
+ * The backend is kept for the next acquireInflateBackend() of the
+ * calling thread unless the pool is already full.
+ *
+ * \param[in] backend  The backend to release, may be nullptr.
+ */
+void releaseInflateBackend(InflateBackend::pointer_t backend)
+{
+    if(backend != nullptr
+    && !g_pool_destroyed
+    && g_pool.m_backends.size() < g_max_backends)
+    {
+        g_pool.m_backends.push_back(std::move(backend));
+    }
+}
+
+
+/** \brief Get a stream buffer.
+ *
+ * This function returns a buffer of getBufferSize() bytes. The contents
+ * of the buffer are undefined.
+ *
+ * \return A buffer of getBufferSize() bytes.
+ */
+std::vector<char> acquireStreamBuffer()
+{
+    if(!g_pool_destroyed
+    && !g_pool.m_buffers.empty())
+    {
+        std::vector<char> buffer(std::move(g_pool.m_buffers.back()));
+        g_pool.m_buffers.pop_back();
+        return buffer;
+    }
+
+    return std::vector<char>(getBufferSize());
+}
+
+
+/** \brief Return a stream buffer to the pool.
+ *
+ * The buffer is moved to the pool of the calling thread unless the
+ * pool is full. On return \p buffer is empty either way.
+ *
+ * \param[in,out] buffer  The buffer to release.
+ */
+void releaseStreamBuffer(std::vector<char> & buffer)
+{
+    if(buffer.size() == getBufferSize()
+    && !g_pool_destroyed
+    && g_pool.m_buffers.size() < g_max_buffers)
+    {
+        g_pool.m_buffers.push_back(std::move(buffer));
+    }
+    buffer = std::vector<char>();
+}
+
+
+/** \brief Get the number of inflate backends created so far.
+ *
+ * This function returns the number of times acquireInflateBackend()
+ * had to create a new backend, in all threads. It shows how effective
+ * the pools are.
+ *
+ * \return The number of backends created.
+ */
+size_t getInflateBackendCount()
+{
+    return g_backend_count;
+}
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
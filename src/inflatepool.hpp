@@ -0,0 +1,59 @@
+#pragma once
+#ifndef INFLATEPOOL_HPP
+#define INFLATEPOOL_HPP
+
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (c) 2015-2022  Made to Order Software Corp.  All Rights Reserved
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Declaration of the pool of inflate backends and stream buffers.
+ *
+ * Opening an entry stream needs an inflate backend and buffers of
+ * getBufferSize() bytes. These functions recycle them between the
+ * streams created by a thread instead of allocating them each time.
+ */
+
+#include "compressionbackend.hpp"
+
+#include <vector>
+
+
+namespace zipios
+{
+
+
+InflateBackend::pointer_t   acquireInflateBackend();
+void                        releaseInflateBackend(InflateBackend::pointer_t backend);
+std::vector<char>           acquireStreamBuffer();
+void                        releaseStreamBuffer(std::vector<char> & buffer);
+size_t                      getInflateBackendCount();
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
+#endif
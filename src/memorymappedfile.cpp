@@ -0,0 +1,299 @@
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (c) 2015-2022  Made to Order Software Corp.  All Rights Reserved
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Implementation of the zipios::MemoryMappedFile class.
+ *
+ * This file includes the operating system specific code used to map
+ * a file in memory.
+ */
+
+#if !defined(ZIPIOS_WINDOWS) && (defined(_WINDOWS) || defined(WIN32) || defined(_WIN32) || defined(__WIN32))
+#define ZIPIOS_WINDOWS
+#endif
+
+#include "memorymappedfile.hpp"
+
+#include "zipios/zipiosexceptions.hpp"
+
+#include <algorithm>
+
+#ifdef ZIPIOS_WINDOWS
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+namespace zipios
+{
+
+
+/** \class MemoryMappedFile
+ * \brief Map a file in memory.
+ *
+ * A MemoryMappedFile object maps an entire file in memory, read-only.
+ * The ZipFile uses this class when opened with AccessMode::MEMORY_MAP
+ * so that the Central Directory and the entries can be read without
+ * any additional I/O system call.
+ *
+ * The mapping stays valid until the object gets destroyed. Since the
+ * object is generally managed by a shared pointer, streams reading from
+ * the mapping keep a copy of that pointer so the mapping stays valid
+ * as long as they are in use.
+ *
+ * \warning
+ * If the file gets truncated while mapped, accessing the missing pages
+ * generates a SIGBUS. Do not use a memory mapped ZipFile on archives that
+ * may be modified while you read them.
+ */
+
+
+/** \brief Map the named file in memory.
+ *
+ * This constructor opens the named file and maps its entire content
+ * in memory. The file descriptor is closed immediately after the
+ * mapping was created since the mapping does not require it.
+ *
+ * An empty file is valid. In that case data() returns nullptr and
+ * size() returns zero.
+ *
+ * \exception IOException
+ * This exception is raised if the file cannot be opened or mapped.
+ *
+ * \param[in] filename  The name of the file to map in memory.
+ */
+MemoryMappedFile::MemoryMappedFile(std::string const & filename)
+{
+#ifdef ZIPIOS_WINDOWS
+    HANDLE file(CreateFileA(
+                  filename.c_str()
+                , GENERIC_READ
+                , FILE_SHARE_READ
+                , nullptr
+                , OPEN_EXISTING
+                , FILE_ATTRIBUTE_NORMAL
+                , nullptr));
+    if(file == INVALID_HANDLE_VALUE)
+    {
+        throw IOException("Error opening Zip archive file for memory mapping.");
+    }
+
+    LARGE_INTEGER file_size;
+    if(!GetFileSizeEx(file, &file_size))
+    {
+        CloseHandle(file);
+        throw IOException("Error retrieving the size of the Zip archive file to map in memory.");
+    }
+    m_size = static_cast<size_t>(file_size.QuadPart);
+
+    if(m_size > 0)
+    {
+        HANDLE mapping(CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr));
+        CloseHandle(file);
+        if(mapping == nullptr)
+        {
+            throw IOException("Error creating a memory mapping of the Zip archive file.");
+        }
+        m_data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(mapping);
+        if(m_data == nullptr)
+        {
+            throw IOException("Error mapping the Zip archive file in memory.");
+        }
+    }
+    else
+    {
+        CloseHandle(file);
+    }
+#else
+    int const fd(open(filename.c_str(), O_RDONLY | O_CLOEXEC));
+    if(fd < 0)
+    {
+        throw IOException("Error opening Zip archive file for memory mapping.");
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) != 0)
+    {
+        close(fd);
+        throw IOException("Error retrieving the size of the Zip archive file to map in memory."); // LCOV_EXCL_LINE
+    }
+    m_size = static_cast<size_t>(st.st_size);
+
+    if(m_size > 0)
+    {
+        void * data(mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0));
+        if(data == MAP_FAILED)
+        {
+            close(fd);
+            throw IOException("Error mapping the Zip archive file in memory.");
+        }
+        m_data = data;
+    }
+
+    // the mapping remains valid after the descriptor is closed
+    close(fd);
+#endif
+}
+
+
+/** \brief Unmap the file.
+ *
+ * The destructor releases the memory mapping.
+ */
+MemoryMappedFile::~MemoryMappedFile()
+{
+    if(m_data != nullptr)
+    {
+#ifdef ZIPIOS_WINDOWS
+        UnmapViewOfFile(m_data);
+#else
+        munmap(m_data, m_size);
+#endif
+    }
+}
+
+
+/** \brief Retrieve a pointer to the mapped data.
+ *
+ * This function returns a pointer to the first byte of the file.
+ *
+ * \return A pointer to the data or nullptr if the file is empty.
+ */
+char const * MemoryMappedFile::data() const
+{
+    return reinterpret_cast<char const *>(m_data);
+}
+
+
+/** \brief Retrieve the size of the mapped file.
+ *
+ * This function returns the size of the file at the time it was mapped.
+ *
+ * \return The number of bytes accessible through data().
+ */
+size_t MemoryMappedFile::size() const
+{
+    return m_size;
+}
+
+
+/** \brief Give a hint about how a range of the mapping gets accessed.
+ *
+ * This function passes \p advice to the operating system for the
+ * \p size bytes starting at \p pos with madvise(). NORMAL, SEQUENTIAL
+ * and RANDOM change the readahead used on page faults and WILLNEED
+ * starts reading the range in the background.
+ *
+ * With DONTNEED, the pages entirely included in the range get paged
+ * out (MADV_PAGEOUT) so they leave the page cache unless another
+ * process maps them. On systems without MADV_PAGEOUT, the pages are
+ * only removed from this mapping and remain in the page cache.
+ *
+ * Errors are ignored since the hints never change the data read. On
+ * MS-Windows the function does nothing.
+ *
+ * \param[in] pos  The start of the range.
+ * \param[in] size  The size of the range, if 0, the function does nothing.
+ * \param[in] advice  The hint to give to the operating system.
+ */
+void MemoryMappedFile::advise(offset_t pos, offset_t size, IOAdvice advice) const
+{
+#ifdef ZIPIOS_WINDOWS
+    static_cast<void>(pos);
+    static_cast<void>(size);
+    static_cast<void>(advice);
+#else
+    if(m_data == nullptr
+    || pos < 0
+    || size <= 0
+    || pos >= static_cast<offset_t>(m_size))
+    {
+        return;
+    }
+
+    offset_t const page_size(sysconf(_SC_PAGESIZE));
+    offset_t start(pos);
+    offset_t end(std::min(pos + size, static_cast<offset_t>(m_size)));
+    if(advice == IOAdvice::DONTNEED)
+    {
+        // only release the pages which are entirely in the range
+        //
+        start = (start + page_size - 1) / page_size * page_size;
+        end = end / page_size * page_size;
+    }
+    else
+    {
+        start = start / page_size * page_size;
+    }
+    if(start >= end)
+    {
+        return;
+    }
+
+    int hint(MADV_NORMAL);
+    switch(advice)
+    {
+    case IOAdvice::NORMAL:
+        break;
+
+    case IOAdvice::SEQUENTIAL:
+        hint = MADV_SEQUENTIAL;
+        break;
+
+    case IOAdvice::RANDOM:
+        hint = MADV_RANDOM;
+        break;
+
+    case IOAdvice::WILLNEED:
+        hint = MADV_WILLNEED;
+        break;
+
+    case IOAdvice::DONTNEED:
+#ifdef MADV_PAGEOUT
+        if(madvise(reinterpret_cast<char *>(m_data) + start, end - start, MADV_PAGEOUT) == 0)
+        {
+            return;
+        }
+        // older kernel, at least release our mapping
+#endif
+        hint = MADV_DONTNEED;
+        break;
+
+    }
+    madvise(reinterpret_cast<char *>(m_data) + start, end - start, hint);
+#endif
+}
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
@@ -1,11 +1,10 @@
 #pragma once
-#ifndef BACKBUFFER_HPP
-#define BACKBUFFER_HPP
+#ifndef MEMORYMAPPEDFILE_HPP
+#define MEMORYMAPPEDFILE_HPP
 
 /*
   Zipios -- a small C++ library that provides easy access to .zip files.
 
-  Copyright (C) 2000-2007  Thomas Sondergaard
   Copyright (c) 2015-2022  Made to Order Software Corp.  All Rights Reserved
 
   This library is free software; you can redistribute it and/or
@@ -24,32 +23,40 @@
 */
 
 /** \file
- * \brief The header file for zipios::BackBuffer
+ * \brief Declaration of the zipios::MemoryMappedFile class.
  *
- * The zipios::BackBuffer class is used to read a file backward.
+ * The zipios::MemoryMappedFile class maps a whole file in memory in
+ * read-only mode.
  */
 
-#include "zipios/virtualseeker.hpp"
-
 #include "zipios_common.hpp"
 
+#include <memory>
+#include <string>
+
 
 namespace zipios
 {
 
 
-class BackBuffer : public ::zipios::buffer_t
+class MemoryMappedFile
 {
 public:
-                            BackBuffer(std::istream & is, VirtualSeeker const & vs = VirtualSeeker(), ssize_t const chunk_size = 1024);
+    typedef std::shared_ptr<MemoryMappedFile>   pointer_t;
+
+                            MemoryMappedFile(std::string const & filename);
+                            MemoryMappedFile(MemoryMappedFile const & rhs) = delete;
+                            ~MemoryMappedFile();
+
+    MemoryMappedFile &      operator = (MemoryMappedFile const & rhs) = delete;
 
-    ssize_t                 readChunk(ssize_t & read_pointer);
+    char const *            data() const;
+    size_t                  size() const;
+    void                    advise(offset_t pos, offset_t size, IOAdvice advice) const;
 
 private:
-    VirtualSeeker           m_vs = VirtualSeeker();
-    ssize_t                 m_chunk_size = 0;
-    std::istream &          m_is;
-    std::streampos          m_file_pos = 0;
+    void *                  m_data = nullptr;
+    size_t                  m_size = 0;
 };
 
 
@@ -0,0 +1,257 @@
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (c) 2015-2022  Made to Order Software Corp.  All Rights Reserved
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Implementation of zipios::MemoryStreambuf.
+ *
+ * This file also implements the zipios::MemoryInputStream.
+ */
+
+#include "memorystreambuf.hpp"
+
+#include "zipios/zipiosexceptions.hpp"
+
+#include <algorithm>
+
+
+namespace zipios
+{
+
+
+/** \class MemoryStreambuf
+ * \brief A read-only stream buffer over a memory mapped file.
+ *
+ * The MemoryStreambuf class presents the content of a MemoryMappedFile
+ * as a standard input stream buffer. The entire mapping is used as the
+ * get area so reading from it never copies the data to an intermediate
+ * buffer and never calls the operating system.
+ *
+ * The buffer keeps a reference to the memory mapped file so the mapping
+ * remains valid as long as the buffer exists, even if the ZipFile that
+ * created the mapping was closed or destroyed.
+ *
+ * When created with the drop after read flag, the buffer releases the
+ * pages it went through once destroyed. Since reading does not call
+ * any of our functions, the range is determined from the positions
+ * the buffer was moved to and from.
+ */
+
+
+/** \brief Initialize a MemoryStreambuf over a memory mapped file.
+ *
+ * The get area is set to the entire content of the memory mapped file.
+ * The read position starts at the beginning of the file.
+ *
+ * \exception InvalidException
+ * This exception is raised if \p file is a null pointer.
+ *
+ * \param[in] file  The memory mapped file to read from.
+ * \param[in] drop_after_read  Whether the pages read get released by
+ *                             the destructor.
+ */
+MemoryStreambuf::MemoryStreambuf(MemoryMappedFile::pointer_t file, bool drop_after_read)
+{
+    if(file == nullptr)
+    {
+        throw InvalidException("MemoryStreambuf was called with a nullptr as the memory mapped file.");
+    }
+
+    // the buffer shares the ownership of the mapping
+    //
+    m_data = std::shared_ptr<char const>(file, file->data());
+
+    // the streambuf interface requires non-const pointers, we never write
+    // to the get area so this is safe
+    //
+    char * data(const_cast<char *>(m_data.get()));
+    setg(data, data, data + file->size());
+
+    if(drop_after_read)
+    {
+        m_drop_file = file;
+        m_read_start = file->size();
+    }
+}
+
+
+/** \brief Initialize a MemoryStreambuf over a buffer.
+ *
+ * The get area is set to the \p size bytes at \p data. The buffer
+ * keeps a reference to \p data so the bytes remain valid as long as
+ * the buffer exists. This is used to read the entries kept in the
+ * cache of a ZipFile.
+ *
+ * \exception InvalidException
+ * This exception is raised if \p data is a null pointer.
+ *
+ * \param[in] data  The data to read from.
+ * \param[in] size  The number of bytes at \p data.
+ */
+MemoryStreambuf::MemoryStreambuf(std::shared_ptr<char const> data, size_t size)
+    : m_data(data)
+{
+    if(m_data == nullptr)
+    {
+        throw InvalidException("MemoryStreambuf was called with a nullptr as the data buffer.");
+    }
+
+    char * start(const_cast<char *>(m_data.get()));
+    setg(start, start, start + size);
+}
+
+
+/** \brief Clean up the buffer.
+ *
+ * The destructor releases the reference to the memory mapped file
+ * or the data buffer. If the buffer was created with the drop after
+ * read flag, the pages read are first released.
+ */
+MemoryStreambuf::~MemoryStreambuf()
+{
+    if(m_drop_file != nullptr)
+    {
+        off_type const end(std::max(m_read_end, static_cast<off_type>(gptr() - eback())));
+        if(end > m_read_start)
+        {
+            m_drop_file->advise(m_read_start, end - m_read_start, IOAdvice::DONTNEED);
+        }
+    }
+}
+
+
+/** \brief Seek to a position relative to the start, current position, or end.
+ *
+ * This function moves the read pointer within the memory mapped file.
+ * Since this buffer is read-only, there is no output position. The
+ * \p which parameter must include std::ios_base::in, which is the case
+ * of the default used by pubseekpos() and pubseekoff().
+ *
+ * \param[in] off  The offset to apply.
+ * \param[in] dir  The reference point used to apply the offset.
+ * \param[in] which  Which pointer to move, only std::ios_base::in is
+ *                   used.
+ *
+ * \return The new position or -1 if the position is out of range.
+ */
+MemoryStreambuf::pos_type MemoryStreambuf::seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which)
+{
+    if((which & std::ios_base::in) == 0)
+    {
+        return pos_type(off_type(-1));
+    }
+
+    off_type base(0);
+    switch(dir)
+    {
+    case std::ios_base::beg:
+        break;
+
+    case std::ios_base::cur:
+        base = gptr() - eback();
+        break;
+
+    case std::ios_base::end:
+        base = egptr() - eback();
+        break;
+
+    default:
+        return pos_type(off_type(-1)); // LCOV_EXCL_LINE
+
+    }
+
+    off_type const pos(base + off);
+    if(pos < 0 || pos > egptr() - eback())
+    {
+        return pos_type(off_type(-1));
+    }
+
+    if(m_drop_file != nullptr)
+    {
+        m_read_end = std::max(m_read_end, static_cast<off_type>(gptr() - eback()));
+        m_read_start = std::min(m_read_start, pos);
+    }
+
+    setg(eback(), eback() + pos, egptr());
+    return pos_type(pos);
+}
+
+
+/** \brief Seek to an absolute position.
+ *
+ * This function moves the read pointer to the specified absolute
+ * position in the memory mapped file.
+ *
+ * \param[in] pos  The new position.
+ * \param[in] which  Which pointer to move, only std::ios_base::in is
+ *                   supported.
+ *
+ * \return The new position or -1 if the position is out of range.
+ */
+MemoryStreambuf::pos_type MemoryStreambuf::seekpos(pos_type pos, std::ios_base::openmode which)
+{
+    return seekoff(off_type(pos), std::ios_base::beg, which);
+}
+
+
+
+
+/** \class MemoryInputStream
+ * \brief An istream reading a buffer in memory.
+ *
+ * This stream owns a MemoryStreambuf and reads from it. It is returned
+ * by ZipFile::getInputStream() for the entries found in its cache.
+ */
+
+
+/** \brief Initialize a stream reading \p size bytes at \p data.
+ *
+ * \exception InvalidException
+ * This exception is raised if \p data is a null pointer.
+ *
+ * \param[in] data  The data to read from.
+ * \param[in] size  The number of bytes at \p data.
+ */
+MemoryInputStream::MemoryInputStream(std::shared_ptr<char const> data, size_t size)
+    : std::istream(nullptr)
+    , m_streambuf(data, size)
+{
+    rdbuf(&m_streambuf);
+}
+
+
+/** \brief Clean up the stream.
+ *
+ * The destructor releases the reference to the data.
+ */
+MemoryInputStream::~MemoryInputStream()
+{
+}
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
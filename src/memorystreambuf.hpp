@@ -0,0 +1,87 @@
+#pragma once
+#ifndef MEMORYSTREAMBUF_HPP
+#define MEMORYSTREAMBUF_HPP
+
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (c) 2015-2022  Made to Order Software Corp.  All Rights Reserved
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Header file that defines zipios::MemoryStreambuf.
+ *
+ * The zipios::MemoryInputStream is an istream reading from a
+ * zipios::MemoryStreambuf it owns.
+ */
+
+#include "memorymappedfile.hpp"
+
+#include <iostream>
+
+
+namespace zipios
+{
+
+
+class MemoryStreambuf : public std::streambuf
+{
+public:
+                                MemoryStreambuf(MemoryMappedFile::pointer_t file, bool drop_after_read = false);
+                                MemoryStreambuf(std::shared_ptr<char const> data, size_t size);
+                                MemoryStreambuf(MemoryStreambuf const & rhs) = delete;
+    virtual                     ~MemoryStreambuf() override;
+
+    MemoryStreambuf &           operator = (MemoryStreambuf const & rhs) = delete;
+
+protected:
+    virtual pos_type            seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which = std::ios_base::in) override;
+    virtual pos_type            seekpos(pos_type pos, std::ios_base::openmode which = std::ios_base::in) override;
+
+private:
+    std::shared_ptr<char const> m_data = std::shared_ptr<char const>();
+    MemoryMappedFile::pointer_t m_drop_file = MemoryMappedFile::pointer_t();
+    off_type                    m_read_start = 0;   // range read so far
+    off_type                    m_read_end = 0;
+};
+
+
+class MemoryInputStream : public std::istream
+{
+public:
+                                MemoryInputStream(std::shared_ptr<char const> data, size_t size);
+                                MemoryInputStream(MemoryInputStream const & rhs) = delete;
+    virtual                     ~MemoryInputStream() override;
+
+    MemoryInputStream &         operator = (MemoryInputStream const & rhs) = delete;
+
+private:
+    MemoryStreambuf             m_streambuf;
+};
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
+#endif
@@ -0,0 +1,505 @@
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (c) 2015-2022  Made to Order Software Corp.  All Rights Reserved
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Implementation of the zipios::SharedFile class.
+ *
+ * This file includes the operating system specific code used to read
+ * a file at a given position without moving a shared file pointer.
+ */
+
+#if !defined(ZIPIOS_WINDOWS) && (defined(_WINDOWS) || defined(WIN32) || defined(_WIN32) || defined(__WIN32))
+#define ZIPIOS_WINDOWS
+#endif
+
+#include "sharedfile.hpp"
+
+#include "zipios/zipiosexceptions.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#ifdef ZIPIOS_WINDOWS
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+namespace zipios
+{
+
+
+namespace
+{
+
+/** \brief The alignment of the direct reads.
+ *
+ * With O_DIRECT, the buffer, the position and the size of a read must
+ * be multiples of the logical block size of the device. 4 KiB covers
+ * all the usual devices.
+ */
+size_t const g_direct_alignment = 4 * 1024;
+
+
+/** \brief The size of the buffer used by the direct reads.
+ *
+ * Direct reads go through an aligned buffer of this size. Each read
+ * sends one request of up to that size to the device.
+ */
+size_t const g_direct_buffer_size = 1024 * 1024;
+
+
+/** \brief Free a buffer allocated with posix_memalign().
+ */
+struct aligned_free_t
+{
+    void operator () (char * buffer) const
+    {
+        free(buffer);
+    }
+};
+
+} // no name namespace
+
+
+
+/** \class SharedFile
+ * \brief A read-only file shared between many readers.
+ *
+ * A SharedFile object opens a file once and lets any number of readers
+ * access it with positional reads (i.e. pread(2) on Unix.) Since the
+ * position is passed to each read, the readers do not share a file
+ * pointer and they do not disturb each other.
+ *
+ * The ZipFile uses this class when opened with AccessMode::STREAM so all
+ * the entry streams it returns use the same file descriptor instead of
+ * opening the archive again each time.
+ *
+ * The file remains open until the object gets destroyed. Since the
+ * object is generally managed by a shared pointer, streams reading from
+ * the file keep a copy of that pointer so the file stays open as long
+ * as they are in use.
+ *
+ * The object can also give hints to the operating system about the
+ * way the file gets read (see advise()) and read it without going
+ * through the page cache (see setDirectIO().)
+ */
+
+
+/** \brief Open the named file for reading.
+ *
+ * This constructor opens the named file in read-only mode and retrieves
+ * its size.
+ *
+ * \exception IOException
+ * This exception is raised if the file cannot be opened.
+ *
+ * \param[in] filename  The name of the file to open.
+ */
+SharedFile::SharedFile(std::string const & filename)
+    : m_filename(filename)
+{
+#ifdef ZIPIOS_WINDOWS
+    HANDLE file(CreateFileA(
+                  filename.c_str()
+                , GENERIC_READ
+                , FILE_SHARE_READ
+                , nullptr
+                , OPEN_EXISTING
+                , FILE_ATTRIBUTE_NORMAL
+                , nullptr));
+    if(file == INVALID_HANDLE_VALUE)
+    {
+        throw IOException("Error opening Zip archive file for reading in binary mode.");
+    }
+
+    LARGE_INTEGER file_size;
+    if(!GetFileSizeEx(file, &file_size))
+    {
+        CloseHandle(file);
+        throw IOException("Error retrieving the size of the Zip archive file.");
+    }
+    m_size = static_cast<offset_t>(file_size.QuadPart);
+    m_handle = reinterpret_cast<intptr_t>(file);
+#else
+    int const fd(open(filename.c_str(), O_RDONLY | O_CLOEXEC));
+    if(fd < 0)
+    {
+        throw IOException("Error opening Zip archive file for reading in binary mode.");
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) != 0)
+    {
+        close(fd);
+        throw IOException("Error retrieving the size of the Zip archive file."); // LCOV_EXCL_LINE
+    }
+    if(S_ISDIR(st.st_mode))
+    {
+        // open() accepts a directory in read-only mode, however read()
+        // then fails
+        //
+        close(fd);
+        throw IOException("Error opening Zip archive file for reading in binary mode.");
+    }
+    m_size = static_cast<offset_t>(st.st_size);
+    m_handle = fd;
+#endif
+}
+
+
+/** \brief Close the file.
+ *
+ * The destructor closes the file descriptor.
+ */
+SharedFile::~SharedFile()
+{
+#ifdef ZIPIOS_WINDOWS
+    CloseHandle(reinterpret_cast<HANDLE>(m_handle));
+#else
+    close(static_cast<int>(m_handle));
+    if(m_direct_handle >= 0)
+    {
+        close(m_direct_handle);
+    }
+#endif
+}
+
+
+/** \brief Read data from the specified position.
+ *
+ * This function reads up to \p size bytes in \p buf from position
+ * \p pos of the file. The file pointer is not used so several threads
+ * can read the same SharedFile simultaneously.
+ *
+ * The function returns less than \p size bytes only when the end of
+ * the file is reached.
+ *
+ * When setDirectIO() was turned on, the data is read with readDirect().
+ *
+ * \exception IOException
+ * This exception is raised if the operating system returns an error.
+ *
+ * \param[out] buf  The buffer where the data gets saved.
+ * \param[in] size  The maximum number of bytes to read.
+ * \param[in] pos  The position in the file where the read starts.
+ *
+ * \return The number of bytes read, 0 at the end of the file.
+ */
+size_t SharedFile::read(char * buf, size_t size, offset_t pos) const
+{
+    if(m_direct_io)
+    {
+        return readDirect(buf, size, pos);
+    }
+
+    size_t total(0);
+    while(total < size)
+    {
+#ifdef ZIPIOS_WINDOWS
+        OVERLAPPED overlapped = {};
+        ULARGE_INTEGER offset;
+        offset.QuadPart = static_cast<ULONGLONG>(pos + total);
+        overlapped.Offset = offset.LowPart;
+        overlapped.OffsetHigh = offset.HighPart;
+        DWORD const max_read(static_cast<DWORD>(std::min(size - total, static_cast<size_t>(0x40000000))));
+        DWORD r(0);
+        if(!ReadFile(reinterpret_cast<HANDLE>(m_handle), buf + total, max_read, &r, &overlapped))
+        {
+            if(GetLastError() == ERROR_HANDLE_EOF)
+            {
+                break;
+            }
+            throw IOException("Error reading the Zip archive file.");
+        }
+#else
+        ssize_t const r(pread(static_cast<int>(m_handle), buf + total, size - total, pos + total));
+        if(r < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue; // LCOV_EXCL_LINE
+            }
+            throw IOException("Error reading the Zip archive file."); // LCOV_EXCL_LINE
+        }
+#endif
+        if(r == 0)
+        {
+            break;
+        }
+        total += r;
+    }
+
+    return total;
+}
+
+
+/** \brief Retrieve the size of the file.
+ *
+ * This function returns the size of the file at the time it was opened.
+ *
+ * \return The size of the file in bytes.
+ */
+offset_t SharedFile::size() const
+{
+    return m_size;
+}
+
+
+/** \brief Give a hint about how a range of the file gets accessed.
+ *
+ * This function passes \p advice to the operating system for the
+ * \p size bytes starting at \p pos. The hint only affects the page
+ * cache: NORMAL, SEQUENTIAL and RANDOM change the readahead of the
+ * file, WILLNEED starts reading the range in the background and
+ * DONTNEED releases the cached pages of the range. Only the pages
+ * entirely included in the range get released so the data of
+ * neighbouring ranges remains cached.
+ *
+ * Errors are ignored since the hints never change the data read. On
+ * systems without posix_fadvise() (i.e. MS-Windows and macOS) the
+ * function does nothing.
+ *
+ * \param[in] pos  The start of the range.
+ * \param[in] size  The size of the range, if 0, the function does nothing.
+ * \param[in] advice  The hint to give to the operating system.
+ */
+void SharedFile::advise(offset_t pos, offset_t size, IOAdvice advice) const
+{
+#ifdef POSIX_FADV_NORMAL
+    if(size <= 0)
+    {
+        return;
+    }
+
+    int hint(POSIX_FADV_NORMAL);
+    switch(advice)
+    {
+    case IOAdvice::NORMAL:
+        break;
+
+    case IOAdvice::SEQUENTIAL:
+        hint = POSIX_FADV_SEQUENTIAL;
+        break;
+
+    case IOAdvice::RANDOM:
+        hint = POSIX_FADV_RANDOM;
+        break;
+
+    case IOAdvice::WILLNEED:
+        hint = POSIX_FADV_WILLNEED;
+        break;
+
+    case IOAdvice::DONTNEED:
+        hint = POSIX_FADV_DONTNEED;
+        break;
+
+    }
+    posix_fadvise(static_cast<int>(m_handle), pos, size, hint);
+#else
+    static_cast<void>(pos);
+    static_cast<void>(size);
+    static_cast<void>(advice);
+#endif
+}
+
+
+/** \brief Read the file without going through the page cache.
+ *
+ * When \p direct_io is true, the following reads go through a second
+ * descriptor opened with O_DIRECT (F_NOCACHE on macOS.) The data then
+ * goes straight from the device to an aligned buffer of this object
+ * and the page cache is not filled with data that will never be read
+ * again. This is useful to scan archives much larger than the memory
+ * without evicting the data of the other processes.
+ *
+ * Each direct read is a request to the device, so only use this mode
+ * when reading large blocks (readEntry() reads each entry with a
+ * single call.)
+ *
+ * The second descriptor is opened on the first call and remains open
+ * until the object gets destroyed so the reads of other threads are
+ * never disturbed.
+ *
+ * \param[in] direct_io  Whether the reads bypass the page cache.
+ *
+ * \return true if the reads now bypass the page cache, false if
+ *         \p direct_io is false or the system does not support it.
+ */
+bool SharedFile::setDirectIO(bool direct_io)
+{
+    if(!direct_io)
+    {
+        m_direct_io = false;
+        return false;
+    }
+
+#ifdef ZIPIOS_WINDOWS
+    return false;
+#else
+    std::lock_guard<std::mutex> lock(m_direct_mutex);
+
+    if(m_direct_handle < 0)
+    {
+#if defined(O_DIRECT)
+        int const fd(open(m_filename.c_str(), O_RDONLY | O_CLOEXEC | O_DIRECT));
+#elif defined(F_NOCACHE)
+        int fd(open(m_filename.c_str(), O_RDONLY | O_CLOEXEC));
+        if(fd >= 0
+        && fcntl(fd, F_NOCACHE, 1) != 0)
+        {
+            close(fd);
+            fd = -1;
+        }
+#else
+        int const fd(-1);
+#endif
+        if(fd < 0)
+        {
+            return false;
+        }
+
+        // make sure the name still references the same file
+        //
+        struct stat st;
+        struct stat direct_st;
+        if(fstat(static_cast<int>(m_handle), &st) != 0
+        || fstat(fd, &direct_st) != 0
+        || st.st_dev != direct_st.st_dev
+        || st.st_ino != direct_st.st_ino)
+        {
+            close(fd);
+            return false;
+        }
+        m_direct_handle = fd;
+    }
+
+    m_direct_io = true;
+    return true;
+#endif
+}
+
+
+/** \brief Check whether the reads bypass the page cache.
+ *
+ * \return true if setDirectIO() was successfully turned on.
+ */
+bool SharedFile::getDirectIO() const
+{
+    return m_direct_io;
+}
+
+
+/** \brief Read data without going through the page cache.
+ *
+ * This function is the implementation of read() once setDirectIO()
+ * was turned on. The reads are made in an aligned buffer, at aligned
+ * positions, and the requested data gets copied to \p buf.
+ *
+ * If the file system refuses the direct read, the function falls back
+ * to a normal read.
+ *
+ * \exception IOException
+ * This exception is raised if the operating system returns an error.
+ *
+ * \param[out] buf  The buffer where the data gets saved.
+ * \param[in] size  The maximum number of bytes to read.
+ * \param[in] pos  The position in the file where the read starts.
+ *
+ * \return The number of bytes read, 0 at the end of the file.
+ */
+size_t SharedFile::readDirect(char * buf, size_t size, offset_t pos) const
+{
+#ifdef ZIPIOS_WINDOWS
+    static_cast<void>(buf); // LCOV_EXCL_LINE
+    static_cast<void>(size); // LCOV_EXCL_LINE
+    static_cast<void>(pos); // LCOV_EXCL_LINE
+    return 0; // LCOV_EXCL_LINE
+#else
+    thread_local std::unique_ptr<char, aligned_free_t> aligned_buffer;
+    if(aligned_buffer == nullptr)
+    {
+        void * ptr(nullptr);
+        if(posix_memalign(&ptr, g_direct_alignment, g_direct_buffer_size) != 0)
+        {
+            throw std::bad_alloc(); // LCOV_EXCL_LINE
+        }
+        aligned_buffer.reset(reinterpret_cast<char *>(ptr));
+    }
+
+    size_t total(0);
+    while(total < size)
+    {
+        offset_t const position(pos + total);
+        offset_t const aligned_position(position & ~static_cast<offset_t>(g_direct_alignment - 1));
+        size_t const skip(position - aligned_position);
+        size_t const wanted(std::min(
+                  (skip + size - total + g_direct_alignment - 1) & ~(g_direct_alignment - 1)
+                , g_direct_buffer_size));
+        ssize_t const r(pread(m_direct_handle, aligned_buffer.get(), wanted, aligned_position));
+        if(r < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue; // LCOV_EXCL_LINE
+            }
+            if(errno == EINVAL)
+            {
+                // the file system does not support direct reads
+                //
+                m_direct_io = false; // LCOV_EXCL_LINE
+                return total + read(buf + total, size - total, position); // LCOV_EXCL_LINE
+            }
+            throw IOException("Error reading the Zip archive file."); // LCOV_EXCL_LINE
+        }
+        if(static_cast<size_t>(r) <= skip)
+        {
+            break;
+        }
+        size_t const available(std::min(static_cast<size_t>(r) - skip, size - total));
+        memcpy(buf + total, aligned_buffer.get() + skip, available);
+        total += available;
+        if(static_cast<size_t>(r) < wanted)
+        {
+            break;
+        }
+    }
+
+    return total;
+#endif
+}
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
@@ -0,0 +1,86 @@
+#pragma once
+#ifndef SHAREDFILE_HPP
+#define SHAREDFILE_HPP
+
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (c) 2015-2022  Made to Order Software Corp.  All Rights Reserved
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Declaration of the zipios::SharedFile class.
+ *
+ * The zipios::SharedFile class holds a read-only file descriptor which
+ * can be shared between many readers, each one reading at its own
+ * position.
+ */
+
+#include "zipios_common.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+
+namespace zipios
+{
+
+
+class SharedFile
+{
+public:
+    typedef std::shared_ptr<SharedFile>     pointer_t;
+
+                            SharedFile(std::string const & filename);
+                            SharedFile(SharedFile const & rhs) = delete;
+                            ~SharedFile();
+
+    SharedFile &            operator = (SharedFile const & rhs) = delete;
+
+    size_t                  read(char * buf, size_t size, offset_t pos) const;
+    offset_t                size() const;
+    void                    advise(offset_t pos, offset_t size, IOAdvice advice) const;
+    bool                    setDirectIO(bool direct_io);
+    bool                    getDirectIO() const;
+
+private:
+    size_t                  readDirect(char * buf, size_t size, offset_t pos) const;
+
+    std::string             m_filename = std::string();
+    intptr_t                m_handle = -1;  // fd or Windows HANDLE
+    offset_t                m_size = 0;
+    std::mutex              m_direct_mutex = std::mutex();
+    std::atomic<int>        m_direct_handle = -1;   // fd opened with O_DIRECT
+    mutable std::atomic<bool>
+                            m_direct_io = false;
+};
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
+#endif
@@ -0,0 +1,292 @@
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (c) 2015-2022  Made to Order Software Corp.  All Rights Reserved
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Implementation of zipios::SharedFileStreambuf.
+ *
+ * This file includes the implementation of a read-only stream buffer
+ * reading a SharedFile with its own position.
+ */
+
+#include "sharedfilestreambuf.hpp"
+
+#include "zipios/zipiosexceptions.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+
+namespace zipios
+{
+
+
+namespace
+{
+
+/** \brief The size of the buffer used to read from the file.
+ *
+ * Each SharedFileStreambuf allocates a buffer of this size which is
+ * filled with one positional read.
+ */
+size_t const g_buffer_size = 16 * 1024;
+
+} // no name namespace
+
+
+/** \class SharedFileStreambuf
+ * \brief A read-only stream buffer over a shared file.
+ *
+ * The SharedFileStreambuf class presents the content of a SharedFile
+ * as a standard input stream buffer. The buffer keeps its own position
+ * and reads the file with positional reads so any number of buffers
+ * can read the same SharedFile without disturbing each other.
+ *
+ * The buffer keeps a reference to the shared file so the file remains
+ * open as long as the buffer exists, even if the ZipFile that opened
+ * it was closed or destroyed.
+ *
+ * When created with the drop after read flag, the buffer releases the
+ * pages of the file it read from the page cache once destroyed.
+ */
+
+
+/** \brief Initialize a SharedFileStreambuf over a shared file.
+ *
+ * The get area starts empty and the read position is set to the
+ * beginning of the file.
+ *
+ * \exception InvalidException
+ * This exception is raised if \p file is a null pointer.
+ *
+ * \param[in] file  The shared file to read from.
+ * \param[in] drop_after_read  Whether the data read gets released from
+ *                             the page cache by the destructor.
+ */
+SharedFileStreambuf::SharedFileStreambuf(SharedFile::pointer_t file, bool drop_after_read)
+    : m_file(file)
+    , m_drop_after_read(drop_after_read)
+{
+    if(m_file == nullptr)
+    {
+        throw InvalidException("SharedFileStreambuf was called with a nullptr as the shared file.");
+    }
+
+    m_buffer.resize(g_buffer_size);
+    setg(m_buffer.data(), m_buffer.data(), m_buffer.data());
+}
+
+
+/** \brief Clean up the buffer.
+ *
+ * The destructor releases the reference to the shared file. If the
+ * buffer was created with the drop after read flag, the range of the
+ * file that was read is first released from the page cache.
+ */
+SharedFileStreambuf::~SharedFileStreambuf()
+{
+    if(m_read_end > m_read_start)
+    {
+        m_file->advise(m_read_start, m_read_end - m_read_start, IOAdvice::DONTNEED);
+    }
+}
+
+
+/** \brief Read more data from the file.
+ *
+ * This function is called when the get area is empty. It reads the
+ * next block of data from the file with one positional read.
+ *
+ * \return The next character or EOF when the end of the file is reached.
+ */
+SharedFileStreambuf::int_type SharedFileStreambuf::underflow()
+{
+    if(gptr() < egptr())
+    {
+        return traits_type::to_int_type(*gptr()); // LCOV_EXCL_LINE
+    }
+
+    m_position += egptr() - eback();
+    size_t const size(m_file->read(m_buffer.data(), m_buffer.size(), m_position));
+    readRange(m_position, size);
+    setg(m_buffer.data(), m_buffer.data(), m_buffer.data() + size);
+    if(size == 0)
+    {
+        return traits_type::eof();
+    }
+
+    return traits_type::to_int_type(*gptr());
+}
+
+
+/** \brief Read a block of data.
+ *
+ * This function copies what is left in the get area and then, if the
+ * remainder is at least as large as our buffer, it reads it with one
+ * positional read directly in \p s instead of going through our buffer.
+ *
+ * \param[out] s  The buffer receiving the data.
+ * \param[in] n  The number of bytes to read.
+ *
+ * \return The number of bytes read.
+ */
+std::streamsize SharedFileStreambuf::xsgetn(char_type * s, std::streamsize n)
+{
+    std::streamsize const available(std::min(n, static_cast<std::streamsize>(egptr() - gptr())));
+    memcpy(s, gptr(), available);
+    gbump(static_cast<int>(available));
+    if(n - available < static_cast<std::streamsize>(m_buffer.size()))
+    {
+        return available + std::streambuf::xsgetn(s + available, n - available);
+    }
+
+    // the get area is empty, so the current position is its end
+    //
+    offset_t const pos(m_position + (egptr() - eback()));
+    size_t const size(m_file->read(s + available, n - available, pos));
+    readRange(pos, size);
+    m_position = pos + size;
+    setg(m_buffer.data(), m_buffer.data(), m_buffer.data());
+
+    return available + size;
+}
+
+
+/** \brief Remember the range of the file that was read.
+ *
+ * When the buffer drops the data it read, this function extends the
+ * range to release on destruction with the \p size bytes read at
+ * \p pos. The range is expected to be contiguous, which is the case
+ * when reading one entry.
+ *
+ * \param[in] pos  The position of the data read.
+ * \param[in] size  The number of bytes read.
+ */
+void SharedFileStreambuf::readRange(offset_t pos, size_t size)
+{
+    if(!m_drop_after_read
+    || size == 0)
+    {
+        return;
+    }
+
+    offset_t const end(pos + size);
+    if(m_read_end == m_read_start)
+    {
+        m_read_start = pos;
+        m_read_end = end;
+    }
+    else
+    {
+        m_read_start = std::min(m_read_start, pos);
+        m_read_end = std::max(m_read_end, end);
+    }
+}
+
+
+/** \brief Seek to a position relative to the start, current position, or end.
+ *
+ * This function moves the read position within the file. If the new
+ * position is in the current get area, no data gets read again.
+ *
+ * Since this buffer is read-only, there is no output position. The
+ * \p which parameter must include std::ios_base::in, which is the case
+ * of the default used by pubseekpos() and pubseekoff().
+ *
+ * \param[in] off  The offset to apply.
+ * \param[in] dir  The reference point used to apply the offset.
+ * \param[in] which  Which pointer to move, only std::ios_base::in is
+ *                   used.
+ *
+ * \return The new position or -1 if the position is out of range.
+ */
+SharedFileStreambuf::pos_type SharedFileStreambuf::seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which)
+{
+    if((which & std::ios_base::in) == 0)
+    {
+        return pos_type(off_type(-1));
+    }
+
+    off_type base(0);
+    switch(dir)
+    {
+    case std::ios_base::beg:
+        break;
+
+    case std::ios_base::cur:
+        base = m_position + (gptr() - eback());
+        break;
+
+    case std::ios_base::end:
+        base = m_file->size();
+        break;
+
+    default:
+        return pos_type(off_type(-1)); // LCOV_EXCL_LINE
+
+    }
+
+    off_type const pos(base + off);
+    if(pos < 0 || pos > m_file->size())
+    {
+        return pos_type(off_type(-1));
+    }
+
+    if(pos >= m_position
+    && pos <= m_position + (egptr() - eback()))
+    {
+        setg(eback(), eback() + (pos - m_position), egptr());
+    }
+    else
+    {
+        m_position = pos;
+        setg(m_buffer.data(), m_buffer.data(), m_buffer.data());
+    }
+
+    return pos_type(pos);
+}
+
+
+/** \brief Seek to an absolute position.
+ *
+ * This function moves the read position to the specified absolute
+ * position in the file.
+ *
+ * \param[in] pos  The new position.
+ * \param[in] which  Which pointer to move, only std::ios_base::in is
+ *                   supported.
+ *
+ * \return The new position or -1 if the position is out of range.
+ */
+SharedFileStreambuf::pos_type SharedFileStreambuf::seekpos(pos_type pos, std::ios_base::openmode which)
+{
+    return seekoff(off_type(pos), std::ios_base::beg, which);
+}
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
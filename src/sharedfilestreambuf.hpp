@@ -0,0 +1,76 @@
+#pragma once
+#ifndef SHAREDFILESTREAMBUF_HPP
+#define SHAREDFILESTREAMBUF_HPP
+
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (c) 2015-2022  Made to Order Software Corp.  All Rights Reserved
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Header file that defines zipios::SharedFileStreambuf.
+ */
+
+#include "sharedfile.hpp"
+
+#include <iostream>
+#include <vector>
+
+
+namespace zipios
+{
+
+
+class SharedFileStreambuf : public std::streambuf
+{
+public:
+                                SharedFileStreambuf(SharedFile::pointer_t file, bool drop_after_read = false);
+                                SharedFileStreambuf(SharedFileStreambuf const & rhs) = delete;
+    virtual                     ~SharedFileStreambuf() override;
+
+    SharedFileStreambuf &       operator = (SharedFileStreambuf const & rhs) = delete;
+
+protected:
+    virtual int_type            underflow() override;
+    virtual std::streamsize     xsgetn(char_type * s, std::streamsize n) override;
+    virtual pos_type            seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which = std::ios_base::in) override;
+    virtual pos_type            seekpos(pos_type pos, std::ios_base::openmode which = std::ios_base::in) override;
+
+private:
+    void                        readRange(offset_t pos, size_t size);
+
+    SharedFile::pointer_t       m_file = SharedFile::pointer_t();
+    std::vector<char>           m_buffer = std::vector<char>();
+    offset_t                    m_position = 0;
+    bool                        m_drop_after_read = false;
+    offset_t                    m_read_start = 0;   // range read so far
+    offset_t                    m_read_end = 0;
+};
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
+#endif
@@ -0,0 +1,224 @@
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (c) 2015-2022  Made to Order Software Corp.  All Rights Reserved
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Implementation of zipios::SpillStreambuf.
+ *
+ * This file defines the functions of the zipios::SpillStreambuf class
+ * used by ZipFile::saveCollectionToArchive() to hold the compressed
+ * data of the entries until they get written to the archive.
+ */
+
+#include "spillstreambuf.hpp"
+
+#include "zipios/zipiosexceptions.hpp"
+
+#include <algorithm>
+
+
+namespace zipios
+{
+
+
+/** \class SpillStreambuf
+ * \brief An output stream buffer kept in memory or in a temporary file.
+ *
+ * The data written to a SpillStreambuf is kept in memory until it
+ * reaches the memory limit. At that point, it gets moved to a
+ * temporary file (see std::tmpfile()) and the following data is
+ * appended to that file. The file is deleted when the buffer is
+ * destroyed.
+ *
+ * Once all the data was written, copyTo() sends it to another stream
+ * buffer.
+ */
+
+
+/** \brief Initialize an empty buffer.
+ *
+ * \param[in] memory_limit  The number of bytes kept in memory before
+ *                          the data moves to a temporary file.
+ */
+SpillStreambuf::SpillStreambuf(size_t memory_limit)
+    : m_memory_limit(memory_limit)
+{
+}
+
+
+/** \brief Release the memory and delete the temporary file.
+ */
+SpillStreambuf::~SpillStreambuf()
+{
+    if(m_file != nullptr)
+    {
+        fclose(m_file);
+    }
+}
+
+
+/** \brief Retrieve the number of bytes written to this buffer.
+ *
+ * \return The size of the data.
+ */
+size_t SpillStreambuf::size() const
+{
+    return m_size;
+}
+
+
+/** \brief Check whether the data was moved to a temporary file.
+ *
+ * \return true if the data is in a temporary file.
+ */
+bool SpillStreambuf::spilled() const
+{
+    return m_file != nullptr;
+}
+
+
+/** \brief Write all the data of this buffer to \p outbuf.
+ *
+ * \exception IOException
+ * This exception is raised if the temporary file cannot be read back
+ * or \p outbuf does not accept all the data.
+ *
+ * \param[in,out] outbuf  The stream buffer receiving the data.
+ */
+void SpillStreambuf::copyTo(std::streambuf * outbuf)
+{
+    if(m_file == nullptr)
+    {
+        if(outbuf->sputn(m_memory.data(), m_memory.size()) != static_cast<std::streamsize>(m_memory.size()))
+        {
+            throw IOException("SpillStreambuf::copyTo(): write to buffer failed.");
+        }
+        return;
+    }
+
+    if(fflush(m_file) != 0
+    || fseek(m_file, 0, SEEK_SET) != 0)
+    {
+        throw IOException("SpillStreambuf::copyTo(): could not read back the temporary file."); // LCOV_EXCL_LINE
+    }
+    std::vector<char> buffer(64 * 1024);
+    size_t remain(m_size);
+    while(remain > 0)
+    {
+        size_t const r(fread(buffer.data(), 1, std::min(remain, buffer.size()), m_file));
+        if(r == 0)
+        {
+            throw IOException("SpillStreambuf::copyTo(): could not read back the temporary file."); // LCOV_EXCL_LINE
+        }
+        if(outbuf->sputn(buffer.data(), r) != static_cast<std::streamsize>(r))
+        {
+            throw IOException("SpillStreambuf::copyTo(): write to buffer failed.");
+        }
+        remain -= r;
+    }
+}
+
+
+/** \brief Write one character.
+ *
+ * The buffer has no put area so each character comes through here.
+ *
+ * \param[in] c  The character to write.
+ *
+ * \return The character or EOF if it cannot be written.
+ */
+SpillStreambuf::int_type SpillStreambuf::overflow(int_type c)
+{
+    if(traits_type::eq_int_type(c, traits_type::eof()))
+    {
+        return traits_type::not_eof(c);
+    }
+
+    char_type const ch(traits_type::to_char_type(c));
+    return xsputn(&ch, 1) == 1 ? c : traits_type::eof();
+}
+
+
+/** \brief Write a block of data.
+ *
+ * The data is appended to the memory buffer unless that would make it
+ * go over the memory limit, in which case the data moves to a
+ * temporary file first.
+ *
+ * \exception IOException
+ * This exception is raised if the temporary file cannot be created.
+ *
+ * \param[in] s  The data to write.
+ * \param[in] n  The number of bytes in \p s.
+ *
+ * \return The number of bytes written.
+ */
+std::streamsize SpillStreambuf::xsputn(char_type const * s, std::streamsize n)
+{
+    if(m_file == nullptr
+    && m_memory.size() + n > m_memory_limit)
+    {
+        spill();
+    }
+
+    if(m_file == nullptr)
+    {
+        m_memory.insert(m_memory.end(), s, s + n);
+    }
+    else if(fwrite(s, 1, n, m_file) != static_cast<size_t>(n))
+    {
+        return 0; // LCOV_EXCL_LINE
+    }
+    m_size += n;
+
+    return n;
+}
+
+
+/** \brief Move the data from memory to a temporary file.
+ *
+ * \exception IOException
+ * This exception is raised if the temporary file cannot be created or
+ * written to.
+ */
+void SpillStreambuf::spill()
+{
+    m_file = std::tmpfile();
+    if(m_file == nullptr)
+    {
+        throw IOException("SpillStreambuf::spill(): could not create a temporary file."); // LCOV_EXCL_LINE
+    }
+    if(fwrite(m_memory.data(), 1, m_memory.size(), m_file) != m_memory.size())
+    {
+        throw IOException("SpillStreambuf::spill(): could not write to the temporary file."); // LCOV_EXCL_LINE
+    }
+    m_memory = std::vector<char>();
+}
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
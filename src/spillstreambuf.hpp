@@ -0,0 +1,80 @@
+#pragma once
+#ifndef SPILLSTREAMBUF_HPP
+#define SPILLSTREAMBUF_HPP
+
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (c) 2015-2022  Made to Order Software Corp.  All Rights Reserved
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Define zipios::SpillStreambuf, an output buffer spilling to disk.
+ *
+ * The zipios::SpillStreambuf class keeps the data written to it in
+ * memory up to a limit and moves it to a temporary file beyond that.
+ */
+
+#include "zipios/zipios-config.hpp"
+
+#include <cstdio>
+#include <streambuf>
+#include <vector>
+
+
+namespace zipios
+{
+
+
+class SpillStreambuf : public std::streambuf
+{
+public:
+                            SpillStreambuf(size_t memory_limit);
+                            SpillStreambuf(SpillStreambuf const & rhs) = delete;
+    virtual                 ~SpillStreambuf() override;
+
+    SpillStreambuf &        operator = (SpillStreambuf const & rhs) = delete;
+
+    size_t                  size() const;
+    bool                    spilled() const;
+    void                    copyTo(std::streambuf * outbuf);
+
+protected:
+    virtual int_type        overflow(int_type c = traits_type::eof()) override;
+    virtual std::streamsize xsputn(char_type const * s, std::streamsize n) override;
+
+private:
+    void                    spill();
+
+    size_t                  m_memory_limit = 0;
+    std::vector<char>       m_memory = std::vector<char>();
+    FILE *                  m_file = nullptr;
+    size_t                  m_size = 0;
+};
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
+#endif
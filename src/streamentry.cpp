@@ -30,10 +30,10 @@
 
 #include "zipios/zipiosexceptions.hpp"
 
+#include "crc32.hpp"
 #include "zipios_common.hpp"
 
 #include <fstream>
-#include <zlib.h>
 
 
 namespace zipios
@@ -148,20 +148,20 @@ bool StreamEntry::isEqual(FileEntry const & file_entry) const
  */
 uint32_t StreamEntry::computeCRC32() const
 {
-    uint32_t result(crc32(0L, Z_NULL, 0));
+    uint32_t result(0);
 
     if(f_istream)
     {
         f_istream.seekg(0, std::ios::beg);
         for(;;)
         {
-            Bytef buf[64 * 1024];
-            f_istream.read(reinterpret_cast<char *>(buf), sizeof(buf));
+            char buf[64 * 1024];
+            f_istream.read(buf, sizeof(buf));
             if(f_istream.gcount() == 0)
             {
                 break;
             }
-            result = crc32(result, buf, f_istream.gcount());
+            result = crc32Update(result, buf, f_istream.gcount());
         }
     }
 
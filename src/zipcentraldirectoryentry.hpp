@@ -35,6 +35,8 @@
 
 #include "ziplocalentry.hpp"
 
+#include "zipios_common.hpp"
+
 
 namespace zipios
 {
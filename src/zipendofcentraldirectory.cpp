@@ -203,9 +203,10 @@ void ZipEndOfCentralDirectory::setOffset(offset_t start_offset)
 /** \brief Attempt to read an ZipEndOfCentralDirectory structure.
  *
  * This function tries to read an ZipEndOfCentralDirectory structure from the
- * specified buffer. This function expects a BackBuffer, which is used
- * because that is generally the fastest way to read the data (instead of
- * scanning the entire file).
+ * specified buffer. The ZipFile reads the tail of the file in a buffer
+ * and calls this function at each position where the signature may
+ * start, beginning with the last one (instead of scanning the entire
+ * file).
  *
  * \note
  * If a read from the buffer fails, then an exception is raised. Since
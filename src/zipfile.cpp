@@ -31,13 +31,26 @@
 #include "zipios/streamentry.hpp"
 #include "zipios/zipiosexceptions.hpp"
 
-#include "backbuffer.hpp"
+#include "compressionbackend.hpp"
+#include "crc32.hpp"
+#include "deflateoutputstreambuf.hpp"
+#include "entrycache.hpp"
+#include "inflateindex.hpp"
+#include "memorymappedfile.hpp"
+#include "memorystreambuf.hpp"
+#include "sharedfilestreambuf.hpp"
 #include "zipendofcentraldirectory.hpp"
 #include "zipcentraldirectoryentry.hpp"
 #include "zipinputstream.hpp"
+#include "ziplocalentry.hpp"
 #include "zipoutputstream.hpp"
 
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
 #include <fstream>
+#include <mutex>
+#include <thread>
 
 
 /** \brief The zipios namespace includes the Zipios library definitions.
@@ -266,11 +279,368 @@ namespace zipios
  */
 
 
+namespace
+{
+
+
+/** \brief Number of local headers verified in VerificationMode::SAMPLED.
+ *
+ * When opening a ZipFile with VerificationMode::SAMPLED, at most about
+ * this many local headers get verified, evenly distributed in the
+ * Central Directory. The last entry is always included.
+ */
+size_t const g_verification_samples = 64;
+
+
+/** \brief The size of the fixed part of a local header.
+ *
+ * The local header is followed by the filename and the extra field,
+ * each of which has a variable size.
+ */
+offset_t const g_local_header_size = 30;
+
+
+/** \brief Size of the End of Central Directory without its comment.
+ *
+ * The End of Central Directory structure is 22 bytes followed by
+ * the Zip archive comment.
+ */
+size_t const g_end_of_central_directory_header_size = 22;
+
+
+/** \brief Maximum size of the End of Central Directory.
+ *
+ * The End of Central Directory is the 22 bytes header followed by a
+ * comment of up to 65535 bytes. The structure has to be found within
+ * that many bytes from the end of the Zip archive.
+ */
+offset_t const g_max_end_of_central_directory_size = g_end_of_central_directory_header_size + 65535;
+
+
+/** \brief Compressed bytes of an entry kept in memory while saving.
+ *
+ * When saveCollectionToArchive() compresses entries in parallel, the
+ * compressed data of each entry waits in a SpillStreambuf until its
+ * turn to be written. Beyond this size, it goes to a temporary file.
+ */
+size_t const g_save_memory_limit = 1024 * 1024;
+
+
+/** \brief Number of entries compressed ahead of the writer per thread.
+ *
+ * The threads stop compressing new entries when that many entries per
+ * thread are compressed but not yet written, which bounds the memory
+ * and temporary files used while one large entry gets compressed.
+ */
+size_t const g_save_entries_per_thread = 4;
+
+
+/** \brief The result of the compression of one entry.
+ *
+ * The data is compressed exactly as the ZipOutputStreambuf would do it
+ * so the ZipOutputStreambuf::putCompressedEntry() function can write
+ * it as is.
+ */
+struct compressed_entry_t
+{
+    std::unique_ptr<SpillStreambuf> m_data = std::unique_ptr<SpillStreambuf>();
+    size_t                          m_size = 0;
+    uint32_t                        m_crc32 = 0;
+    std::exception_ptr              m_error = std::exception_ptr();
+    bool                            m_done = false;
+};
+
+
+/** \brief Compress the data of one entry of a collection.
+ *
+ * This function reads the data of \p entry and saves it in \p result,
+ * deflated with the compression level of the entry, or as is for
+ * STORED entries and the COMPRESSION_LEVEL_NONE level. The data goes
+ * through the same DeflateOutputStreambuf and in the same chunks as
+ * in a ZipOutputStream so the result is the same.
+ *
+ * \param[in] collection  The collection the entry comes from.
+ * \param[in] entry  The entry to compress.
+ * \param[out] result  The compressed data, its size and CRC32.
+ */
+void compressEntry(FileCollection & collection, FileEntry::pointer_t const & entry, compressed_entry_t & result)
+{
+    result.m_data = std::make_unique<SpillStreambuf>(g_save_memory_limit);
+    if(entry->isDirectory()
+    || entry->getSize() == 0)
+    {
+        return;
+    }
+
+    FileCollection::stream_pointer_t is(collection.getInputStream(entry->getName()));
+    if(is == nullptr
+    || !is->good())
+    {
+        return;
+    }
+
+    FileEntry::CompressionLevel const level(entry->getMethod() == StorageMethod::STORED
+                                                ? FileEntry::COMPRESSION_LEVEL_NONE
+                                                : entry->getLevel());
+    if(level == FileEntry::COMPRESSION_LEVEL_NONE)
+    {
+        std::vector<char> buffer(getBufferSize());
+        while(*is)
+        {
+            is->read(buffer.data(), buffer.size());
+            std::streamsize const size(is->gcount());
+            result.m_crc32 = crc32Update(result.m_crc32, buffer.data(), size);
+            result.m_size += size;
+            if(result.m_data->sputn(buffer.data(), size) != size)
+            {
+                throw IOException("compressEntry(): write to buffer failed."); // LCOV_EXCL_LINE
+            }
+        }
+        return;
+    }
+
+    DeflateOutputStreambuf deflate(result.m_data.get());
+    deflate.init(level);
+    {
+        std::ostream os(&deflate);
+        os << is->rdbuf();
+    }
+    deflate.closeStream();
+    result.m_size = deflate.getSize();
+    result.m_crc32 = deflate.getCrc32();
+}
+
+
+/** \brief Save the entries of a collection using several threads.
+ *
+ * A pool of \p thread_count threads compresses the entries in the
+ * order of the collection. The calling thread writes each entry as
+ * soon as it and all the entries before it are compressed, so the
+ * archive is the same as the one written by a single thread.
+ *
+ * \param[in,out] output_stream  The stream receiving the archive.
+ * \param[in] collection  The collection to save.
+ * \param[in] thread_count  The number of compression threads.
+ */
+void saveEntriesInParallel(ZipOutputStream & output_stream, FileCollection & collection, size_t thread_count)
+{
+    FileEntry::vector_t const entries(collection.begin(), collection.end());
+    std::vector<compressed_entry_t> results(entries.size());
+    size_t const window(thread_count * g_save_entries_per_thread);
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    size_t next(0);
+    size_t written(0);
+    bool stop(false);
+
+    auto worker = [&]()
+        {
+            for(;;)
+            {
+                size_t idx(0);
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    cv.wait(lock, [&]()
+                        {
+                            return stop
+                                || next >= entries.size()
+                                || next < written + window;
+                        });
+                    if(stop
+                    || next >= entries.size())
+                    {
+                        return;
+                    }
+                    idx = next++;
+                }
+
+                try
+                {
+                    compressEntry(collection, entries[idx], results[idx]);
+                }
+                catch(...)
+                {
+                    results[idx].m_error = std::current_exception();
+                }
+
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    results[idx].m_done = true;
+                }
+                cv.notify_all();
+            }
+        };
+
+    std::vector<std::thread> threads;
+    auto join = [&]()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stop = true;
+            }
+            cv.notify_all();
+            for(auto & t : threads)
+            {
+                t.join();
+            }
+        };
+
+    try
+    {
+        thread_count = std::min(thread_count, entries.size());
+        threads.reserve(thread_count);
+        for(size_t idx(0); idx < thread_count; ++idx)
+        {
+            threads.emplace_back(worker);
+        }
+
+        for(size_t idx(0); idx < entries.size(); ++idx)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [&]()
+                    {
+                        return results[idx].m_done;
+                    });
+            }
+            if(results[idx].m_error != nullptr)
+            {
+                std::rethrow_exception(results[idx].m_error);
+            }
+
+            output_stream.putCompressedEntry(
+                      entries[idx]
+                    , results[idx].m_size
+                    , results[idx].m_crc32
+                    , *results[idx].m_data);
+            results[idx].m_data.reset();
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                ++written;
+            }
+            cv.notify_all();
+        }
+    }
+    catch(...)
+    {
+        join();
+        throw;
+    }
+    join();
+}
+
+/** \brief Search a byte backward in a buffer.
+ *
+ * This function returns a pointer to the last occurrence of \p c in
+ * the first \p size bytes of \p buf. It uses memrchr() when the C
+ * library offers it since that function is vectorized.
+ *
+ * \param[in] buf  The buffer to search.
+ * \param[in] c  The byte to search.
+ * \param[in] size  The number of bytes to search.
+ *
+ * \return A pointer to the byte found or nullptr.
+ */
+unsigned char const * find_last_byte(unsigned char const * buf, unsigned char c, size_t size)
+{
+#ifdef __GLIBC__
+    return static_cast<unsigned char const *>(memrchr(buf, c, size));
+#else
+    for(unsigned char const * p(buf + size); p > buf; )
+    {
+        --p;
+        if(*p == c)
+        {
+            return p;
+        }
+    }
+    return nullptr;
+#endif
+}
+
+
+} // no name namespace
+
+
 /** \class ZipFile
  * \brief The ZipFile class represents a collection of files.
  *
  * ZipFile is a FileCollection, where the files are stored
  * in a .zip file.
+ *
+ * By default the ZipFile reads the archive using standard streams and
+ * each call to getInputStream() opens the archive file again. When the
+ * archive is opened with AccessMode::MEMORY_MAP, the whole file is
+ * mapped in memory once and both the Central Directory and the entries
+ * are read directly from that mapping.
+ */
+
+
+/** \enum ZipFile::AccessMode
+ * \brief The method used to access the Zip archive file.
+ *
+ * When opening a Zip archive by filename, the ZipFile can either
+ * use a standard file stream (STREAM) or map the file in memory
+ * (MEMORY_MAP).
+ *
+ * The STREAM mode opens the file once and all the entry streams share
+ * that file, each one reading it at its own position with pread(2).
+ * This is the best option when the address space is limited.
+ *
+ * The MEMORY_MAP mode maps the entire archive once. This avoids the
+ * system calls and the buffered copy of the data each time an entry
+ * is read, which is much faster when many entries get accessed. The
+ * mapping remains alive as long as the ZipFile or one of the streams
+ * returned by getInputStream() exists.
+ */
+
+
+/** \enum ZipFile::VerificationMode
+ * \brief How much of the archive gets verified when opening it.
+ *
+ * Each entry in a Zip archive is described twice: once in the Central
+ * Directory and once in a local header found just before the entry data.
+ * The ZipFile can verify that both descriptions match.
+ *
+ * The FULL mode reads all the local headers while opening the archive.
+ * This is the safest and the default, but it requires one seek and read
+ * per entry before the ZipFile can be used at all.
+ *
+ * The LAZY mode verifies the local header of an entry each time
+ * getInputStream() opens that entry. Since the stream has to read that
+ * header anyway, this costs no additional I/O.
+ *
+ * The SAMPLED mode verifies a small, evenly distributed, subset of the
+ * local headers while opening the archive and then behaves like LAZY.
+ * This catches most truncated or badly offset archives early without
+ * having to read all the headers.
+ *
+ * The NONE mode never verifies the local headers. Opening the archive
+ * then only costs reading the Central Directory.
+ */
+
+
+/** \struct ZipFile::entry_view_t
+ * \brief A read-only view of the data of a STORED entry.
+ *
+ * The getEntryView() function returns this structure. The m_data
+ * pointer gives access to the m_size bytes of the entry. The shared
+ * pointer keeps the memory it points to alive (the memory mapping of
+ * the archive or a buffer) so the view can be kept as long as needed.
+ */
+
+
+/** \struct ZipFile::cache_statistics_t
+ * \brief The counters of the cache of entries.
+ *
+ * The getCacheStatistics() function returns this structure. The
+ * m_hits, m_misses and m_evictions counters are cumulative since the
+ * cache was created. A high number of evictions compared to the number
+ * of hits means the budget is too small for the set of hot entries.
+ * The m_entries and m_size fields give the current number of entries
+ * and bytes in the cache and m_budget its maximum size.
  */
 
 
@@ -340,6 +710,9 @@ ZipFile::ZipFile()
  * If the file cannot be opened or the Zip directory cannot
  * be read, then the constructor throws an exception.
  *
+ * \exception IOException
+ * This exception is raised if the file cannot be opened or mapped in memory.
+ *
  * \exception FileCollectionException
  * This exception is raised if the initialization fails. The function verifies
  * that the input stream represents what is considered a valid zip file.
@@ -351,17 +724,35 @@ ZipFile::ZipFile()
  *                   indicates the end of the zip data in the file.
  *                   The offset is a positive number, even though the
  *                   offset goes toward the beginning of the file.
+ * \param[in] access_mode  Whether to read the file with a stream or map
+ *                         it in memory.
+ * \param[in] verification_mode  How the local headers get verified.
  */
-ZipFile::ZipFile(std::string const & filename, offset_t s_off, offset_t e_off)
+ZipFile::ZipFile(
+          std::string const & filename
+        , offset_t s_off
+        , offset_t e_off
+        , AccessMode access_mode
+        , VerificationMode verification_mode)
     : FileCollection(filename)
     , m_vs(s_off, e_off)
+    , m_verification_mode(verification_mode)
 {
-    std::ifstream zipfile(m_filename, std::ios::in | std::ios::binary);
-    if(!zipfile)
+    if(access_mode == AccessMode::MEMORY_MAP)
     {
-        throw IOException("Error opening Zip archive file for reading in binary mode.");
+        m_mapped_file = std::make_shared<MemoryMappedFile>(m_filename);
+        MemoryStreambuf buf(m_mapped_file);
+        std::istream zipfile(&buf);
+        init(zipfile);
+        return;
     }
 
+    // the entry streams share this file and read it with their own
+    // position so they do not have to open the file again
+    //
+    m_shared_file = std::make_shared<SharedFile>(m_filename);
+    SharedFileStreambuf buf(m_shared_file);
+    std::istream zipfile(&buf);
     init(zipfile);
 }
 
@@ -387,9 +778,15 @@ ZipFile::ZipFile(std::string const & filename, offset_t s_off, offset_t e_off)
  *                   indicates the end of the zip data in the file.
  *                   The offset is a positive number, even though the
  *                   offset goes toward the beginning of the file.
+ * \param[in] verification_mode  How the local headers get verified.
  */
-ZipFile::ZipFile(std::istream & is, offset_t s_off, offset_t e_off)
+ZipFile::ZipFile(
+          std::istream & is
+        , offset_t s_off
+        , offset_t e_off
+        , VerificationMode verification_mode)
     : m_vs(s_off, e_off)
+    , m_verification_mode(verification_mode)
 {
     init(is);
 }
@@ -409,28 +806,53 @@ ZipFile::ZipFile(std::istream & is, offset_t s_off, offset_t e_off)
 void ZipFile::init(std::istream & is)
 {
     // Find and read the End of Central Directory.
+    //
+    // The End of Central Directory is at most 22 bytes plus a comment of
+    // up to 65535 bytes from the end of the file, so a single read of
+    // that tail is enough to find it
+    //
     ZipEndOfCentralDirectory eocd;
     {
-        BackBuffer bb(is, m_vs);
-        ssize_t read_p(-1);
-        for(;;)
+        m_vs.vseekg(is, 0, std::ios::end);
+        offset_t const file_size(m_vs.vtellg(is));
+        if(file_size < 0)
+        {
+            // this happens when the start offset is after the end offset
+            // of the virtual seeker
+            //
+            throw IOException("Invalid virtual file endings.");
+        }
+        offset_t const tail_size(std::min(file_size, g_max_end_of_central_directory_size));
+        m_vs.vseekg(is, file_size - tail_size, std::ios::beg);
+        buffer_t tail;
+        zipRead(is, tail, tail_size);
+
+        // search the signature backward, the last one is the one we want
+        // since the comment may include such a signature; we only look
+        // for its first byte, read() verifies the whole signature
+        //
+        bool found(false);
+        if(tail.size() >= g_end_of_central_directory_header_size)
         {
-            if(read_p < 0)
+            size_t size(tail.size() - g_end_of_central_directory_header_size + 1);
+            while(size > 0)
             {
-                if(!bb.readChunk(read_p))
+                unsigned char const * p(find_last_byte(tail.data(), 'P', size));
+                if(p == nullptr)
                 {
-                    throw FileCollectionException("Unable to find zip structure: End-of-central-directory");
+                    break;
+                }
+                size = static_cast<size_t>(p - tail.data());
+                if(eocd.read(tail, size))
+                {
+                    found = true;
+                    break;
                 }
             }
-            // Note: this is pretty fast since it reads from 'bb' which
-            //       caches the buffer the readChunk() function just read.
-            //
-            if(eocd.read(bb, read_p))
-            {
-                // found it!
-                break;
-            }
-            --read_p;
+        }
+        if(!found)
+        {
+            throw FileCollectionException("Unable to find zip structure: End-of-central-directory");
         }
     }
 
@@ -462,7 +884,27 @@ void ZipFile::init(std::istream & is)
     // Consistency check #2:
     // Are local headers consistent with CD headers?
     //
-    for(auto it = m_entries.begin(); it != m_entries.end(); ++it)
+    // In LAZY mode, the check happens in getInputStream() and in NONE
+    // mode it never happens; the SAMPLED mode checks a few entries
+    // here and the others in getInputStream()
+    //
+    size_t step(0);
+    switch(m_verification_mode)
+    {
+    case VerificationMode::NONE:
+    case VerificationMode::LAZY:
+        break;
+
+    case VerificationMode::SAMPLED:
+        step = std::max(static_cast<size_t>(1), max_entry / g_verification_samples);
+        break;
+
+    case VerificationMode::FULL:
+        step = 1;
+        break;
+
+    }
+    for(size_t entry_num(0); step > 0 && entry_num < max_entry; entry_num += step)
     {
         /** \TODO
          * Make sure the entry offset is properly defined by
@@ -470,13 +912,16 @@ void ZipFile::init(std::istream & is)
          *
          * Also the isEqual() is a quite advanced (slow) test here!
          */
-        m_vs.vseekg(is, (*it)->getEntryOffset(), std::ios::beg);
-        ZipLocalEntry zlh;
-        zlh.read(is);
-        if(!is || !zlh.isEqual(**it))
-        {
-            throw FileCollectionException("Zip file consistency problem. Zip file data fields are inconsistent with zip file layout.");
-        }
+        verifyLocalHeader(is, *m_entries[entry_num]);
+    }
+    if(m_verification_mode == VerificationMode::SAMPLED
+    && max_entry > 0
+    && (max_entry - 1) % step != 0)
+    {
+        // always include the last entry which is the one most likely
+        // affected by a truncated file
+        //
+        verifyLocalHeader(is, *m_entries[max_entry - 1]);
     }
 
     // we are all good!
@@ -484,129 +929,1041 @@ void ZipFile::init(std::istream & is)
 }
 
 
-/** \brief Create a clone of this ZipFile.
+/** \brief Verify the local header of an entry.
  *
- * This function creates a heap allocated clone of the ZipFile object.
+ * This function reads the local header of \p entry from \p is and
+ * verifies that it matches the Central Directory entry.
  *
- * \return A shared pointer to a copy of this ZipFile object.
- */
-FileCollection::pointer_t ZipFile::clone() const
-{
-    return FileCollection::pointer_t(std::make_shared<ZipFile>(*this));
-}
-
-
-/** \brief Clean up the ZipFile object.
+ * \exception FileCollectionException
+ * This exception is raised if the local header cannot be read or does
+ * not match the \p entry.
  *
- * The destructor ensures that any ZipFile data gets flushed
- * out before returning.
+ * \param[in] is  The input stream used to read the ZipFile.
+ * \param[in] entry  The Central Directory entry to verify.
  */
-ZipFile::~ZipFile()
+void ZipFile::verifyLocalHeader(std::istream & is, FileEntry const & entry)
 {
-    close();
+    m_vs.vseekg(is, entry.getEntryOffset(), std::ios::beg);
+    ZipLocalEntry zlh;
+    zlh.read(is);
+    if(!is || !zlh.isEqual(entry))
+    {
+        throw FileCollectionException("Zip file consistency problem. Zip file data fields are inconsistent with zip file layout.");
+    }
 }
 
 
-/** \brief Retrieve a pointer to a file in the Zip archive.
- *
- * This function returns a shared pointer to an istream defined from the
- * named entry, which gives you access to the corresponding file defined
- * in the Zip archive.
- *
- * The function returns nullptr if there is no entry with the
- * specified name in this ZipFile.
- *
- * Note that the function returns a smart pointer to an istream. The
- * ZipFile class does not hold that pointer meaning that
- * if you call getInputStream() multiple times with the same
- * \p entry_name parameter, you get different istream instance each
- * time.
+/** \brief Find the position of the data of an entry.
  *
- * By default the \p entry_name parameter is expected to match the full
- * path and filename (MatchPath::MATCH). If you are looking for a file
- * and want to ignore the path, set the matchpath parameter
- * to MatchPath::IGNORE.
+ * The data of an entry starts right after its local header, which has
+ * a variable size. This function reads the local header to determine
+ * the position of the data. In the LAZY and SAMPLED verification modes,
+ * the local header also gets compared to the \p entry.
  *
- * \note
- * If the file is compressed inside the Zip archive, this input stream
- * returns the uncompressed data transparently to you (outside of the
- * time it takes to decompress the data, of course.)
+ * The archive must have been opened from a file (i.e. either
+ * m_mapped_file or m_shared_file is set.)
  *
- * \param[in] entry_name  The name of the file to search in the collection.
- * \param[in] matchpath  Whether the full path or just the filename is matched.
+ * \exception FileCollectionException
+ * This exception is raised if the local header is not valid.
  *
- * \return A shared pointer to an open istream for the specified entry.
+ * \param[in] entry  The entry of which the data position is requested.
  *
- * \sa CollectionCollection
- * \sa DirectoryCollection
- * \sa FileCollection
+ * \return The position of the data in the archive file.
  */
-ZipFile::stream_pointer_t ZipFile::getInputStream(std::string const & entry_name, MatchPath matchpath)
+offset_t ZipFile::findEntryData(FileEntry const & entry) const
 {
-    mustBeValid();
+    offset_t const header_pos(entry.getEntryOffset() + m_vs.startOffset());
 
-    // TODO: see whether we could make the handling of the StreamEntry
-    //       non-special
+    if(m_verification_mode == VerificationMode::LAZY
+    || m_verification_mode == VerificationMode::SAMPLED)
+    {
+        std::unique_ptr<std::streambuf> buf;
+        if(m_mapped_file != nullptr)
+        {
+            buf = std::make_unique<MemoryStreambuf>(m_mapped_file);
+        }
+        else
+        {
+            buf = std::make_unique<SharedFileStreambuf>(m_shared_file);
+        }
+        std::istream is(buf.get());
+        is.seekg(header_pos);
+        ZipLocalEntry header;
+        header.read(is);
+        if(!is
+        || !header.isEqual(entry))
+        {
+            throw FileCollectionException("Zip file consistency problem. Zip file data fields are inconsistent with zip file layout.");
+        }
+        return header_pos + header.getHeaderSize();
+    }
+
+    // only the signature and the variable field sizes are required
     //
-    FileEntry::pointer_t entry(getEntry(entry_name, matchpath));
-    StreamEntry::pointer_t stream(std::dynamic_pointer_cast<StreamEntry>(entry));
-    if(stream != nullptr)
+    unsigned char header[g_local_header_size];
+    if(m_mapped_file != nullptr)
     {
-        stream_pointer_t zis(std::make_shared<ZipInputStream>(stream->getStream()));
-        return zis;
+        if(header_pos < 0
+        || header_pos + static_cast<offset_t>(sizeof(header)) > static_cast<offset_t>(m_mapped_file->size()))
+        {
+            throw FileCollectionException("Zip file consistency problem. Zip file data fields are inconsistent with zip file layout.");
+        }
+        memcpy(header, m_mapped_file->data() + header_pos, sizeof(header));
     }
-    else if(entry != nullptr)
+    else if(m_shared_file->read(reinterpret_cast<char *>(header), sizeof(header), header_pos) != sizeof(header))
     {
-        stream_pointer_t zis(std::make_shared<ZipInputStream>(m_filename, entry->getEntryOffset() + m_vs.startOffset()));
-        return zis;
+        throw FileCollectionException("Zip file consistency problem. Zip file data fields are inconsistent with zip file layout.");
+    }
+    if(header[0] != 'P'
+    || header[1] != 'K'
+    || header[2] != 0x03
+    || header[3] != 0x04)
+    {
+        throw FileCollectionException("Zip file consistency problem. Zip file data fields are inconsistent with zip file layout.");
     }
+    size_t const filename_length(header[26] | (header[27] << 8));
+    size_t const extra_field_length(header[28] | (header[29] << 8));
 
-    // no entry with that name (and match) available
-    return nullptr;
+    return header_pos + g_local_header_size + filename_length + extra_field_length;
 }
 
 
-/** \brief Create a Zip archive from the specified FileCollection.
+/** \brief Read the data of an entry in a buffer.
  *
- * This function is expected to be used with a DirectoryCollection
- * that you created to save the collection in an archive.
+ * This function is the implementation of readEntry(). It copies or
+ * inflates the data of \p entry in \p buffer, which must be at least
+ * getSize() bytes.
  *
- * \param[in,out] os  The output stream where the Zip archive is saved.
- * \param[in] collection  The collection to save in this output stream.
- * \param[in] zip_comment  The global comment of the Zip archive.
+ * The compressed data is read with a single read (or used directly
+ * from the mapping) and inflated with a single call to the
+ * compression engine (see setCompressionEngine()).
+ *
+ * \param[in] entry  The entry to read.
+ * \param[out] buffer  The buffer receiving the data.
  */
-void ZipFile::saveCollectionToArchive(
-      std::ostream & os
-    , FileCollection & collection
-    , std::string const & zip_comment)
+void ZipFile::readEntryData(FileEntry const & entry, char * buffer)
 {
-    try
+    size_t const size(entry.getSize());
+
+    if((m_mapped_file == nullptr && m_shared_file == nullptr)
+    || dynamic_cast<StreamEntry const *>(&entry) != nullptr)
     {
-        ZipOutputStream output_stream(os);
+        // no direct access to the archive, go through a stream
+        //
+        stream_pointer_t is(getInputStream(entry.getName()));     // LCOV_EXCL_LINE
+        if(is == nullptr                                            // LCOV_EXCL_LINE
+        || !is->read(buffer, size))                                 // LCOV_EXCL_LINE
+        {
+            throw IOException("ZipFile::readEntry(): could not read \"" + entry.getName() + "\"."); // LCOV_EXCL_LINE
+        }
+        return; // LCOV_EXCL_LINE
+    }
 
-        output_stream.setComment(zip_comment);
+    readAhead(entry);
 
-        FileEntry::vector_t entries(collection.entries());
-        for(auto it(entries.begin()); it != entries.end(); ++it)
+    offset_t const data_pos(findEntryData(entry));
+    size_t const compressed_size(entry.getCompressedSize());
+    if(m_mapped_file != nullptr
+    && data_pos + static_cast<offset_t>(compressed_size) > static_cast<offset_t>(m_mapped_file->size()))
+    {
+        throw FileCollectionException("Zip file consistency problem. Entry data goes beyond the end of the archive.");
+    }
+
+    switch(entry.getMethod())
+    {
+    case StorageMethod::STORED:
+        // the range checked above must cover the whole copy
+        //
+        if(size != compressed_size)
         {
-            output_stream.putNextEntry(*it);
+            throw FileCollectionException("Zip file consistency problem. The size of a STORED entry does not match its compressed size.");
+        }
+        if(m_mapped_file != nullptr)
+        {
+            memcpy(buffer, m_mapped_file->data() + data_pos, size);
+        }
+        else if(m_shared_file->read(buffer, size, data_pos) != size)
+        {
+            throw FileCollectionException("Zip file consistency problem. Entry data goes beyond the end of the archive.");
+        }
+        break;
 
-            // next we need to include the data of that file in the
-            // output buffer if it is not a directory and the file is
-            // not an empty file
+    case StorageMethod::DEFLATED:
+    {
+        if(size == 0
+        && compressed_size == 0)
+        {
+            // an empty entry saved by zipios has no deflate data at all
             //
-            if(!(*it)->isDirectory()
-            && (*it)->getSize() > 0)
+            break;
+        }
+
+        std::vector<char> compressed;
+        char const * in(nullptr);
+        if(m_mapped_file != nullptr)
+        {
+            in = m_mapped_file->data() + data_pos;
+        }
+        else
+        {
+            compressed.resize(compressed_size);
+            if(m_shared_file->read(compressed.data(), compressed_size, data_pos) != compressed_size)
+            {
+                throw FileCollectionException("Zip file consistency problem. Entry data goes beyond the end of the archive.");
+            }
+            in = compressed.data();
+        }
+
+        if(!inflateBuffer(in, compressed_size, buffer, size))
+        {
+            throw IOException("ZipFile::readEntry(): inflate failed for \"" + entry.getName() + "\".");
+        }
+    }
+        break;
+
+    default:
+        throw FileCollectionException("Unsupported compression format");
+
+    }
+
+    dropEntryData(entry, data_pos + compressed_size);
+
+    if(m_verify_crc
+    && crc32Update(0, buffer, size) != entry.getCrc())
+    {
+        throw IOException("ZipFile::readEntry(): CRC32 mismatch for \""
+                        + entry.getName()
+                        + "\".");
+    }
+}
+
+
+/** \brief Get the data of an entry from the cache.
+ *
+ * This function returns the data of \p entry from the cache. On a miss,
+ * the entry is read in a new buffer which gets added to the cache.
+ *
+ * The function returns nullptr when the cache is off or the entry is
+ * not cached: directories, empty entries, entries larger than the
+ * budget and STORED entries of a memory mapped archive (which can
+ * already be accessed without any copy.) Entries of a ZipFile created
+ * from a stream are not cached either.
+ *
+ * \param[in] entry  The entry to search.
+ *
+ * \return The data of the entry or nullptr.
+ */
+std::shared_ptr<std::vector<char> const> ZipFile::getCachedData(FileEntry::pointer_t entry)
+{
+    if(m_entry_cache == nullptr
+    || entry->isDirectory()
+    || entry->getSize() == 0
+    || entry->getSize() > m_entry_cache->getBudget()
+    || (m_mapped_file == nullptr && m_shared_file == nullptr)
+    || (m_mapped_file != nullptr && entry->getMethod() == StorageMethod::STORED)
+    || std::dynamic_pointer_cast<StreamEntry>(entry) != nullptr)
+    {
+        return std::shared_ptr<std::vector<char> const>();
+    }
+
+    EntryCache::buffer_t data(m_entry_cache->find(entry->getEntryOffset()));
+    if(data == nullptr)
+    {
+        std::shared_ptr<std::vector<char>> buffer(std::make_shared<std::vector<char>>(entry->getSize()));
+        readEntryData(*entry, buffer->data());
+        data = buffer;
+        m_entry_cache->insert(entry->getEntryOffset(), data);
+    }
+
+    return data;
+}
+
+
+/** \brief Read the next entries ahead.
+ *
+ * When the I/O policy asks for readahead, this function asks the
+ * operating system to start reading the byte range going from the
+ * local header of \p entry to the local header of the entry found
+ * m_readahead_entries entries further in the archive. Entries are
+ * generally read in the order they appear in the archive, so their
+ * data is in memory by the time they get opened.
+ *
+ * Nothing is read ahead with direct I/O since the reads would not use
+ * the page cache anyway.
+ *
+ * \param[in] entry  The entry about to be read.
+ */
+void ZipFile::readAhead(FileEntry const & entry) const
+{
+    if(m_io_policy.m_readahead_entries == 0
+    || m_io_policy.m_direct_io
+    || (m_mapped_file == nullptr && m_shared_file == nullptr))
+    {
+        return;
+    }
+
+    offset_t const start(entry.getEntryOffset() + m_vs.startOffset());
+    offset_t end(m_mapped_file != nullptr
+                    ? static_cast<offset_t>(m_mapped_file->size())
+                    : m_shared_file->size());
+    auto const next(std::upper_bound(m_entry_offsets.begin(), m_entry_offsets.end(), entry.getEntryOffset()));
+    if(static_cast<size_t>(m_entry_offsets.end() - next) > m_io_policy.m_readahead_entries)
+    {
+        end = next[m_io_policy.m_readahead_entries] + m_vs.startOffset();
+    }
+
+    if(m_mapped_file != nullptr)
+    {
+        m_mapped_file->advise(start, end - start, IOAdvice::WILLNEED);
+    }
+    else
+    {
+        m_shared_file->advise(start, end - start, IOAdvice::WILLNEED);
+    }
+}
+
+
+/** \brief Release the pages of an entry which was read.
+ *
+ * When the I/O policy asks to drop the data after reading it, this
+ * function releases the pages going from the local header of \p entry
+ * to \p end from the page cache.
+ *
+ * \param[in] entry  The entry that was read.
+ * \param[in] end  The position of the end of the entry data.
+ */
+void ZipFile::dropEntryData(FileEntry const & entry, offset_t end) const
+{
+    if(!m_io_policy.m_drop_after_read)
+    {
+        return;
+    }
+
+    offset_t const start(entry.getEntryOffset() + m_vs.startOffset());
+    if(m_mapped_file != nullptr)
+    {
+        m_mapped_file->advise(start, end - start, IOAdvice::DONTNEED);
+    }
+    else if(m_shared_file != nullptr)
+    {
+        m_shared_file->advise(start, end - start, IOAdvice::DONTNEED);
+    }
+}
+
+
+/** \brief Create a clone of this ZipFile.
+ *
+ * This function creates a heap allocated clone of the ZipFile object.
+ *
+ * \return A shared pointer to a copy of this ZipFile object.
+ */
+FileCollection::pointer_t ZipFile::clone() const
+{
+    return FileCollection::pointer_t(std::make_shared<ZipFile>(*this));
+}
+
+
+/** \brief Clean up the ZipFile object.
+ *
+ * The destructor ensures that any ZipFile data gets flushed
+ * out before returning.
+ */
+ZipFile::~ZipFile()
+{
+    close();
+}
+
+
+/** \brief Close the ZipFile.
+ *
+ * This function closes the collection and releases the memory mapping
+ * if the archive was opened with AccessMode::MEMORY_MAP. Streams that
+ * were returned by getInputStream() keep their own reference to the
+ * mapping so they can still be read after this call.
+ */
+void ZipFile::close()
+{
+    m_mapped_file.reset();
+    m_shared_file.reset();
+    m_index_cache.reset();
+    m_entry_cache.reset();
+    FileCollection::close();
+}
+
+
+/** \brief Verify the CRC32 of the entries while reading them.
+ *
+ * By default the streams returned by getInputStream() do not verify
+ * the data they return. When this flag is set, the CRC32 of the data
+ * is computed as the stream buffers get filled and compared against
+ * the CRC32 saved in the archive once the end of the entry is reached.
+ * On a mismatch, the stream gets its badbit set (or throws an
+ * IOException if exceptions are turned on) instead of reaching a
+ * clean end of file.
+ *
+ * Since the CRC32 is computed on data which is already in the CPU
+ * cache, this is much cheaper than reading the entry a second time
+ * to verify it.
+ *
+ * A seek which skips data postpones the verification: the CRC32 is
+ * verified once all the data from the start of the entry was read and
+ * the end of the entry is reached.
+ *
+ * The flag only applies to streams opened after the call.
+ *
+ * \param[in] verify_crc  Whether the entries get verified.
+ */
+void ZipFile::setVerifyCrc(bool verify_crc)
+{
+    m_verify_crc = verify_crc;
+}
+
+
+/** \brief Check whether the entries get verified while read.
+ *
+ * This function returns the flag set with setVerifyCrc().
+ *
+ * \return true if the CRC32 of the entries gets verified.
+ */
+bool ZipFile::getVerifyCrc() const
+{
+    return m_verify_crc;
+}
+
+
+/** \brief Make the DEFLATED entries seekable.
+ *
+ * The streams returned by getInputStream() can always be repositioned
+ * with seekg(). For STORED entries this is immediate. For DEFLATED
+ * entries, all the data up to the new position has to be inflated
+ * again, which is very slow in large entries.
+ *
+ * When the interval is not zero, the ZipFile keeps an index for each
+ * DEFLATED entry. While an entry gets read, the stream saves the state
+ * of the inflate stream (the last 32 KiB of data and the position in
+ * the compressed data) in that index every \p interval bytes. A seek
+ * then restarts from the closest checkpoint before the new position
+ * and inflates at most \p interval bytes. The index is built lazily,
+ * as far as the entry was read, and it is shared by all the streams
+ * opened on that entry, including those opened on clones of this
+ * ZipFile.
+ *
+ * Each checkpoint uses about 32 KiB of memory. An interval of a few
+ * megabytes is a good compromise for multi-gigabyte entries.
+ *
+ * The interval only applies to streams opened after the call.
+ *
+ * \param[in] interval  The distance between checkpoints in bytes or 0
+ *                      to not index the entries.
+ */
+void ZipFile::setCheckpointInterval(size_t interval)
+{
+    m_checkpoint_interval = interval;
+    if(m_checkpoint_interval > 0
+    && m_index_cache == nullptr)
+    {
+        m_index_cache = std::make_shared<InflateIndexCache>();
+    }
+}
+
+
+/** \brief Retrieve the distance between checkpoints.
+ *
+ * This function returns the interval set with setCheckpointInterval().
+ *
+ * \return The distance between checkpoints or 0 if the DEFLATED entries
+ *         are not indexed.
+ */
+size_t ZipFile::getCheckpointInterval() const
+{
+    return m_checkpoint_interval;
+}
+
+
+/** \brief Keep the data of the most recently used entries in memory.
+ *
+ * When the budget is not zero, the ZipFile keeps the data of the
+ * entries it reads, up to \p budget bytes. Reading an entry which is
+ * in the cache costs no inflate and no I/O: getInputStream() returns a
+ * stream over the cached data, getEntryView() returns a view of it and
+ * readEntry() copies it. Once the budget is reached, the least recently
+ * used entries get evicted.
+ *
+ * On a miss, the whole entry is read with one call (as readEntry()
+ * does) and added to the cache, even when it is opened with
+ * getInputStream(). Only entries that need some work are cached: the
+ * DEFLATED entries and, when the archive is not memory mapped, the
+ * STORED entries. Entries larger than the budget are read as if there
+ * was no cache.
+ *
+ * The cache is shared with the clones of this ZipFile and is safe to
+ * use from multiple threads. Changing the budget of a clone changes
+ * the budget of the shared cache.
+ *
+ * \param[in] budget  The maximum number of bytes kept in the cache or 0
+ *                    to not cache entries.
+ *
+ * \sa getCacheStatistics()
+ */
+void ZipFile::setCacheBudget(size_t budget)
+{
+    if(m_entry_cache != nullptr)
+    {
+        m_entry_cache->setBudget(budget);
+    }
+    else if(budget > 0)
+    {
+        m_entry_cache = std::make_shared<EntryCache>(budget);
+    }
+}
+
+
+/** \brief Retrieve the budget of the cache of entries.
+ *
+ * \return The maximum number of bytes kept in the cache or 0 if the
+ *         entries are not cached.
+ */
+size_t ZipFile::getCacheBudget() const
+{
+    if(m_entry_cache == nullptr)
+    {
+        return 0;
+    }
+    return m_entry_cache->getBudget();
+}
+
+
+/** \brief Retrieve the counters of the cache of entries.
+ *
+ * Use these counters to size the budget (see setCacheBudget()).
+ *
+ * \return The cache statistics, all zeroes if the cache was never
+ *         turned on.
+ */
+ZipFile::cache_statistics_t ZipFile::getCacheStatistics() const
+{
+    if(m_entry_cache == nullptr)
+    {
+        return cache_statistics_t();
+    }
+    return m_entry_cache->getStatistics();
+}
+
+
+/** \brief Remove all the entries from the cache.
+ *
+ * The streams and views returned for cached entries remain valid. The
+ * counters are not reset.
+ */
+void ZipFile::clearCache()
+{
+    if(m_entry_cache != nullptr)
+    {
+        m_entry_cache->clear();
+    }
+}
+
+
+/** \brief Define how the archive file gets read.
+ *
+ * The policy tells the operating system how the archive is going to
+ * be accessed so it can manage its page cache accordingly. It never
+ * changes the data returned by the ZipFile.
+ *
+ * \li m_access_pattern -- SEQUENTIAL increases the readahead of the
+ * whole file, which is best when scanning all the entries in order.
+ * RANDOM turns the readahead off, which avoids reading data that is
+ * not going to be used when accessing a few entries at random.
+ *
+ * \li m_readahead_entries -- when not zero, opening an entry (with
+ * getInputStream(), getEntryView() or readEntry()) asks the operating
+ * system to start reading that entry and the next
+ * m_readahead_entries entries in the background.
+ *
+ * \li m_drop_after_read -- once an entry was read (by readEntry()) or
+ * its stream destroyed, its pages get released from the page cache.
+ * This lets a scan of an archive larger than the memory run without
+ * evicting the cached data of the rest of the system.
+ *
+ * \li m_direct_io -- the reads bypass the page cache altogether (see
+ * SharedFile::setDirectIO()). This is only available with
+ * AccessMode::STREAM on systems that support it. Reading the entries
+ * with readEntry() is strongly recommended in this mode since each
+ * read goes to the device.
+ *
+ * The access pattern and direct I/O apply to the archive file, which
+ * is shared with the clones of this ZipFile. The other fields only
+ * apply to this ZipFile and the clones created after the call.
+ *
+ * On systems without the necessary support (posix_fadvise(),
+ * madvise(), O_DIRECT) the hints are ignored. Use getIOPolicy() to
+ * know whether direct I/O was turned on.
+ *
+ * \param[in] policy  The new I/O policy.
+ */
+void ZipFile::setIOPolicy(io_policy_t const & policy)
+{
+    m_io_policy = policy;
+
+    if(m_io_policy.m_readahead_entries > 0
+    && m_entry_offsets.empty())
+    {
+        m_entry_offsets.reserve(m_entries.size());
+        for(auto const & entry : m_entries)
+        {
+            m_entry_offsets.push_back(entry->getEntryOffset());
+        }
+        std::sort(m_entry_offsets.begin(), m_entry_offsets.end());
+    }
+
+    IOAdvice advice(IOAdvice::NORMAL);
+    switch(m_io_policy.m_access_pattern)
+    {
+    case AccessPattern::NORMAL:
+        break;
+
+    case AccessPattern::SEQUENTIAL:
+        advice = IOAdvice::SEQUENTIAL;
+        break;
+
+    case AccessPattern::RANDOM:
+        advice = IOAdvice::RANDOM;
+        break;
+
+    }
+
+    if(m_shared_file != nullptr)
+    {
+        m_shared_file->advise(0, m_shared_file->size(), advice);
+        m_io_policy.m_direct_io = m_shared_file->setDirectIO(policy.m_direct_io);
+    }
+    else
+    {
+        if(m_mapped_file != nullptr)
+        {
+            m_mapped_file->advise(0, m_mapped_file->size(), advice);
+        }
+        m_io_policy.m_direct_io = false;
+    }
+}
+
+
+/** \brief Retrieve the I/O policy.
+ *
+ * This function returns the policy set with setIOPolicy(). The
+ * m_direct_io flag is only true if direct I/O could be turned on.
+ *
+ * \return The current I/O policy.
+ */
+ZipFile::io_policy_t ZipFile::getIOPolicy() const
+{
+    return m_io_policy;
+}
+
+
+/** \brief Retrieve a pointer to a file in the Zip archive.
+ *
+ * This function returns a shared pointer to an istream defined from the
+ * named entry, which gives you access to the corresponding file defined
+ * in the Zip archive.
+ *
+ * The function returns nullptr if there is no entry with the
+ * specified name in this ZipFile.
+ *
+ * Note that the function returns a smart pointer to an istream. The
+ * ZipFile class does not hold that pointer meaning that
+ * if you call getInputStream() multiple times with the same
+ * \p entry_name parameter, you get different istream instance each
+ * time.
+ *
+ * By default the \p entry_name parameter is expected to match the full
+ * path and filename (MatchPath::MATCH). If you are looking for a file
+ * and want to ignore the path, set the matchpath parameter
+ * to MatchPath::IGNORE.
+ *
+ * \note
+ * If the file is compressed inside the Zip archive, this input stream
+ * returns the uncompressed data transparently to you (outside of the
+ * time it takes to decompress the data, of course.)
+ *
+ * \param[in] entry_name  The name of the file to search in the collection.
+ * \param[in] matchpath  Whether the full path or just the filename is matched.
+ *
+ * \return A shared pointer to an open istream for the specified entry.
+ *
+ * \sa CollectionCollection
+ * \sa DirectoryCollection
+ * \sa FileCollection
+ */
+ZipFile::stream_pointer_t ZipFile::getInputStream(std::string const & entry_name, MatchPath matchpath)
+{
+    mustBeValid();
+
+    FileEntry::pointer_t entry(getEntry(entry_name, matchpath));
+    if(entry == nullptr)
+    {
+        // no entry with that name (and match) available
+        return nullptr;
+    }
+
+    return getEntryInputStream(entry);
+}
+
+
+/** \brief Access the data of a STORED entry without copying it.
+ *
+ * This function returns a view of the data of the named entry: a
+ * pointer and a size. The entry must be STORED (i.e. not compressed)
+ * since the view gives direct access to the bytes saved in the archive.
+ *
+ * When the archive was opened with AccessMode::MEMORY_MAP, the view
+ * points directly in the mapping: there is no copy at all. The view
+ * holds a reference to the mapping so it remains valid even after the
+ * ZipFile gets closed or destroyed.
+ *
+ * When the archive was opened with AccessMode::STREAM, the data is read
+ * with a single positional read in a buffer owned by the view.
+ *
+ * When the cache is turned on (see setCacheBudget()), the entries it
+ * handles, DEFLATED entries included, are returned as a view of the
+ * cached data.
+ *
+ * Otherwise the function returns an empty view (m_data is nullptr) if
+ * the entry does not exist, is a directory, or is compressed. Use
+ * getInputStream() to read such entries.
+ *
+ * The local header gets verified as with getInputStream() and, when
+ * setVerifyCrc() was turned on, the CRC32 of the data is verified
+ * before the view is returned.
+ *
+ * \exception FileCollectionException
+ * This exception is raised if the local header does not match the
+ * entry or the data goes beyond the end of the archive.
+ *
+ * \exception IOException
+ * This exception is raised if the data cannot be read or the CRC32
+ * verification fails.
+ *
+ * \param[in] entry_name  The name of the file to search in the collection.
+ * \param[in] matchpath  Whether the full path or just the filename is matched.
+ *
+ * \return A view of the entry data.
+ */
+ZipFile::entry_view_t ZipFile::getEntryView(std::string const & entry_name, MatchPath matchpath)
+{
+    mustBeValid();
+
+    entry_view_t view;
+
+    FileEntry::pointer_t entry(getEntry(entry_name, matchpath));
+    if(entry == nullptr)
+    {
+        return view;
+    }
+
+    std::shared_ptr<std::vector<char> const> const cached(getCachedData(entry));
+    if(cached != nullptr)
+    {
+        view.m_data = std::shared_ptr<char const>(cached, cached->data());
+        view.m_size = cached->size();
+        return view;
+    }
+
+    if(entry->isDirectory()
+    || entry->getMethod() != StorageMethod::STORED
+    || std::dynamic_pointer_cast<StreamEntry>(entry) != nullptr)
+    {
+        return view;
+    }
+
+    if(m_mapped_file == nullptr
+    && m_shared_file == nullptr)
+    {
+        return view; // LCOV_EXCL_LINE
+    }
+
+    readAhead(*entry);
+
+    offset_t const data_pos(findEntryData(*entry));
+    size_t const size(entry->getSize());
+    if(m_mapped_file != nullptr)
+    {
+        // the view references the pages, they are not dropped
+        //
+        if(data_pos + static_cast<offset_t>(size) > static_cast<offset_t>(m_mapped_file->size()))
+        {
+            throw FileCollectionException("Zip file consistency problem. Entry data goes beyond the end of the archive.");
+        }
+        view.m_data = std::shared_ptr<char const>(m_mapped_file, m_mapped_file->data() + data_pos);
+    }
+    else
+    {
+        std::shared_ptr<char> data(new char[size], std::default_delete<char[]>());
+        if(m_shared_file->read(data.get(), size, data_pos) != size)
+        {
+            throw FileCollectionException("Zip file consistency problem. Entry data goes beyond the end of the archive.");
+        }
+        view.m_data = data;
+        dropEntryData(*entry, data_pos + size);
+    }
+    view.m_size = size;
+
+    if(m_verify_crc
+    && crc32Update(0, view.m_data.get(), view.m_size) != entry->getCrc())
+    {
+        throw IOException("ZipFile::getEntryView(): CRC32 mismatch for \""
+                        + entry->getName()
+                        + "\".");
+    }
+
+    return view;
+}
+
+
+/** \brief Read the whole data of an entry in a caller buffer.
+ *
+ * This function decompresses the named entry directly in \p buffer.
+ * Contrary to getInputStream(), the data does not go through a stream
+ * and its buffers: the compressed data is accessed with one read (or
+ * directly in the mapping with AccessMode::MEMORY_MAP) and it gets
+ * inflated with a single call to the compression engine. This is much
+ * faster for small entries.
+ *
+ * The \p buffer must be at least getSize() bytes.
+ *
+ * When setVerifyCrc() was turned on, the CRC32 of the data gets verified.
+ *
+ * \exception InvalidException
+ * This exception is raised if the entry does not exist, is a directory,
+ * or \p buffer is too small.
+ *
+ * \exception FileCollectionException
+ * This exception is raised if the entry data is invalid.
+ *
+ * \exception IOException
+ * This exception is raised if the data cannot be read or the CRC32
+ * verification fails.
+ *
+ * \param[in] entry_name  The name of the file to search in the collection.
+ * \param[out] buffer  The buffer where the data gets saved.
+ * \param[in] size  The size of \p buffer.
+ * \param[in] matchpath  Whether the full path or just the filename is matched.
+ *
+ * \return The number of bytes saved in \p buffer, i.e. the entry size.
+ */
+size_t ZipFile::readEntry(
+      std::string const & entry_name
+    , char * buffer
+    , size_t size
+    , MatchPath matchpath)
+{
+    mustBeValid();
+
+    FileEntry::pointer_t entry(getEntry(entry_name, matchpath));
+    if(entry == nullptr
+    || entry->isDirectory())
+    {
+        throw InvalidException("ZipFile::readEntry(): no file named \"" + entry_name + "\".");
+    }
+    if(size < entry->getSize())
+    {
+        throw InvalidException("ZipFile::readEntry(): buffer too small for \"" + entry_name + "\".");
+    }
+
+    std::shared_ptr<std::vector<char> const> const cached(getCachedData(entry));
+    if(cached != nullptr)
+    {
+        memcpy(buffer, cached->data(), cached->size());
+    }
+    else
+    {
+        readEntryData(*entry, buffer);
+    }
+
+    return entry->getSize();
+}
+
+
+/** \brief Read the whole data of an entry in a new buffer.
+ *
+ * This function allocates a buffer of the size of the named entry and
+ * decompresses the entry in it. See the other readEntry() for details.
+ *
+ * \exception InvalidException
+ * This exception is raised if the entry does not exist or is a directory.
+ *
+ * \param[in] entry_name  The name of the file to search in the collection.
+ * \param[in] matchpath  Whether the full path or just the filename is matched.
+ *
+ * \return The data of the entry.
+ */
+std::vector<char> ZipFile::readEntry(std::string const & entry_name, MatchPath matchpath)
+{
+    mustBeValid();
+
+    FileEntry::pointer_t entry(getEntry(entry_name, matchpath));
+    if(entry == nullptr
+    || entry->isDirectory())
+    {
+        throw InvalidException("ZipFile::readEntry(): no file named \"" + entry_name + "\".");
+    }
+
+    std::shared_ptr<std::vector<char> const> const cached(getCachedData(entry));
+    if(cached != nullptr)
+    {
+        return *cached;
+    }
+
+    std::vector<char> result(entry->getSize());
+    readEntryData(*entry, result.data());
+
+    return result;
+}
+
+
+/** \brief Retrieve an istream for one of the entries of this ZipFile.
+ *
+ * This function opens a stream to read the data of \p entry, an
+ * entry of this ZipFile, without searching it by name.
+ *
+ * \param[in] entry  The entry to open.
+ *
+ * \return A shared pointer to an open istream for the specified entry.
+ */
+ZipFile::stream_pointer_t ZipFile::getEntryInputStream(FileEntry::pointer_t entry)
+{
+    // TODO: see whether we could make the handling of the StreamEntry
+    //       non-special
+    //
+    StreamEntry::pointer_t stream(std::dynamic_pointer_cast<StreamEntry>(entry));
+    if(stream != nullptr)
+    {
+        stream_pointer_t zis(std::make_shared<ZipInputStream>(stream->getStream()));
+        return zis;
+    }
+
+    std::shared_ptr<std::vector<char> const> const cached(getCachedData(entry));
+    if(cached != nullptr)
+    {
+        stream_pointer_t is(std::make_shared<MemoryInputStream>(
+                      std::shared_ptr<char const>(cached, cached->data())
+                    , cached->size()));
+        return is;
+    }
+
+    // the FULL mode already verified all the local headers; an entry
+    // with a trailing data descriptor still needs the CRC32 and sizes
+    // of the Central Directory
+    //
+    ZipLocalEntry const * const local_entry(dynamic_cast<ZipLocalEntry const *>(entry.get()));
+    FileEntry const * expected_entry(m_verification_mode == VerificationMode::LAZY
+                                  || m_verification_mode == VerificationMode::SAMPLED
+                                  || (local_entry != nullptr && local_entry->hasTrailingDataDescriptor())
+                                        ? entry.get()
+                                        : nullptr);
+    InflateIndex::pointer_t index;
+    if(m_checkpoint_interval > 0
+    && m_index_cache != nullptr
+    && entry->getMethod() == StorageMethod::DEFLATED)
+    {
+        index = m_index_cache->getIndex(entry->getEntryOffset(), static_cast<offset_t>(m_checkpoint_interval));
+    }
+    readAhead(*entry);
+    if(m_mapped_file != nullptr)
+    {
+        stream_pointer_t zis(std::make_shared<ZipInputStream>(
+                      std::make_unique<MemoryStreambuf>(m_mapped_file, m_io_policy.m_drop_after_read)
+                    , entry->getEntryOffset() + m_vs.startOffset()
+                    , expected_entry
+                    , m_verify_crc
+                    , index));
+        return zis;
+    }
+
+    if(m_shared_file != nullptr)
+    {
+        stream_pointer_t zis(std::make_shared<ZipInputStream>(
+                      std::make_unique<SharedFileStreambuf>(m_shared_file, m_io_policy.m_drop_after_read)
+                    , entry->getEntryOffset() + m_vs.startOffset()
+                    , expected_entry
+                    , m_verify_crc
+                    , index));
+        return zis;
+    }
+
+    stream_pointer_t zis(std::make_shared<ZipInputStream>(
+                  m_filename
+                , entry->getEntryOffset() + m_vs.startOffset()
+                , expected_entry
+                , m_verify_crc
+                , index));
+    return zis;
+}
+
+
+/** \brief Create a Zip archive from the specified FileCollection.
+ *
+ * This function is expected to be used with a DirectoryCollection
+ * that you created to save the collection in an archive.
+ *
+ * By default, the entries get read and compressed one after the other
+ * by the calling thread. With a \p thread_count other than 1, a pool
+ * of threads compresses the entries in memory (or in temporary files
+ * for large entries) while the calling thread writes them in order.
+ * The resulting archive is the same byte for byte. In that mode, the
+ * collection must support calls to getInputStream() from several
+ * threads at once (the DirectoryCollection and ZipFile do.)
+ *
+ * \param[in,out] os  The output stream where the Zip archive is saved.
+ * \param[in] collection  The collection to save in this output stream.
+ * \param[in] zip_comment  The global comment of the Zip archive.
+ * \param[in] thread_count  The number of threads compressing the entries,
+ *                          0 to use one per processor.
+ */
+void ZipFile::saveCollectionToArchive(
+      std::ostream & os
+    , FileCollection & collection
+    , std::string const & zip_comment
+    , size_t thread_count)
+{
+    if(thread_count == 0)
+    {
+        thread_count = std::max(1U, std::thread::hardware_concurrency());
+    }
+
+    try
+    {
+        ZipOutputStream output_stream(os);
+
+        output_stream.setComment(zip_comment);
+
+        if(thread_count > 1)
+        {
+            saveEntriesInParallel(output_stream, collection, thread_count);
+        }
+        else
+        {
+            for(auto it(collection.begin()); it != collection.end(); ++it)
             {
-                // get an InputStream
+                output_stream.putNextEntry(*it);
+
+                // next we need to include the data of that file in the
+                // output buffer if it is not a directory and the file is
+                // not an empty file
                 //
-                FileCollection::stream_pointer_t is(collection.getInputStream((*it)->getName()));
-                if(is != nullptr
-                && is->good())
+                if(!(*it)->isDirectory()
+                && (*it)->getSize() > 0)
                 {
-                    // copy the file content to the output
+                    // get an InputStream
                     //
-                    output_stream << is->rdbuf();
+                    FileCollection::stream_pointer_t is(collection.getInputStream((*it)->getName()));
+                    if(is != nullptr
+                    && is->good())
+                    {
+                        // copy the file content to the output
+                        //
+                        output_stream << is->rdbuf();
+                    }
                 }
             }
         }
@@ -58,22 +58,76 @@ namespace zipios
  *
  * \param[in] filename  The name of a valid zip file.
  * \param[in] pos position to reposition the istream to before reading.
+ * \param[in] expected_entry  The entry the local header must match or
+ *                            nullptr to skip that verification.
+ * \param[in] verify_crc  Whether the data is verified against its CRC32.
+ * \param[in] index  The checkpoint index used to seek in a DEFLATED entry.
  */
-ZipInputStream::ZipInputStream(std::string const & filename, std::streampos pos)
+ZipInputStream::ZipInputStream(
+          std::string const & filename
+        , std::streampos pos
+        , FileEntry const * expected_entry
+        , bool verify_crc
+        , InflateIndex::pointer_t index)
     : std::istream(nullptr)
     , m_ifs(std::make_unique<std::ifstream>(filename, std::ios::in | std::ios::binary))
     , m_ifs_ref(*m_ifs)
-    , m_izf(std::make_unique<ZipInputStreambuf>(m_ifs_ref.rdbuf(), pos))
+    , m_izf(std::make_unique<ZipInputStreambuf>(m_ifs_ref.rdbuf(), pos, expected_entry, verify_crc, index))
 {
     // properly initialize the stream with the newly allocated buffer
     init(m_izf.get());
 }
 
 
-ZipInputStream::ZipInputStream(std::istream & is)
+/** \brief Initialize a ZipInputStream reading from another stream.
+ *
+ * This constructor creates a ZIP file stream reading the entry found
+ * at \p start_pos in \p is. The stream \p is must remain valid as long
+ * as this ZipInputStream is used.
+ *
+ * \param[in] is  The stream with the Zip archive data.
+ * \param[in] start_pos  The position of the entry header in \p is or -1
+ *                       to read the header at the current position.
+ * \param[in] verify_crc  Whether the data is verified against its CRC32.
+ */
+ZipInputStream::ZipInputStream(
+          std::istream & is
+        , offset_t start_pos
+        , bool verify_crc)
     : std::istream(nullptr)
     , m_ifs_ref(is)
-    , m_izf(std::make_unique<ZipInputStreambuf>(m_ifs_ref.rdbuf(), 0))
+    , m_izf(std::make_unique<ZipInputStreambuf>(m_ifs_ref.rdbuf(), start_pos, nullptr, verify_crc))
+{
+    // properly initialize the stream with the newly allocated buffer
+    init(m_izf.get());
+}
+
+
+/** \brief Initialize a ZipInputStream from a stream buffer and position.
+ *
+ * This constructor creates a ZIP file stream reading its data from the
+ * specified stream buffer. The ZipInputStream takes ownership of the
+ * buffer. This is used to read entries directly from a memory mapped
+ * archive without having to open the file again.
+ *
+ * \param[in] source  The stream buffer with the Zip archive data.
+ * \param[in] pos  The position of the entry header in \p source.
+ * \param[in] expected_entry  The entry the local header must match or
+ *                            nullptr to skip that verification.
+ * \param[in] verify_crc  Whether the data is verified against its CRC32.
+ * \param[in] index  The checkpoint index used to seek in a DEFLATED entry.
+ */
+ZipInputStream::ZipInputStream(
+          std::unique_ptr<std::streambuf> source
+        , std::streampos pos
+        , FileEntry const * expected_entry
+        , bool verify_crc
+        , InflateIndex::pointer_t index)
+    : std::istream(nullptr)
+    , m_source(std::move(source))
+    , m_ifs(std::make_unique<std::istream>(m_source.get()))
+    , m_ifs_ref(*m_ifs)
+    , m_izf(std::make_unique<ZipInputStreambuf>(m_ifs_ref.rdbuf(), pos, expected_entry, verify_crc, index))
 {
     // properly initialize the stream with the newly allocated buffer
     init(m_izf.get());
@@ -90,6 +144,16 @@ ZipInputStream::~ZipInputStream()
 }
 
 
+/** \brief Retrieve the local header of the entry being read.
+ *
+ * \return A copy of the local header read by the constructor.
+ */
+FileEntry::pointer_t ZipInputStream::getEntry() const
+{
+    return m_izf->getEntry();
+}
+
+
 } // zipios namespace
 
 // Local Variables:
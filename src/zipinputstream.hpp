@@ -43,14 +43,31 @@ namespace zipios
 class ZipInputStream : public std::istream
 {
 public:
-                                        ZipInputStream(std::string const & filename, std::streampos pos = 0);
-                                        ZipInputStream(std::istream & is);
+                                        ZipInputStream(
+                                                  std::string const & filename
+                                                , std::streampos pos = 0
+                                                , FileEntry const * expected_entry = nullptr
+                                                , bool verify_crc = false
+                                                , InflateIndex::pointer_t index = InflateIndex::pointer_t());
+                                        ZipInputStream(
+                                                  std::istream & is
+                                                , offset_t start_pos = 0
+                                                , bool verify_crc = false);
+                                        ZipInputStream(
+                                                  std::unique_ptr<std::streambuf> source
+                                                , std::streampos pos
+                                                , FileEntry const * expected_entry = nullptr
+                                                , bool verify_crc = false
+                                                , InflateIndex::pointer_t index = InflateIndex::pointer_t());
                                         ZipInputStream(ZipInputStream const & rhs) = delete;
     virtual                             ~ZipInputStream() override;
 
     ZipInputStream &                    operator = (ZipInputStream const & rhs) = delete;
 
+    FileEntry::pointer_t                getEntry() const;
+
 private:
+    std::unique_ptr<std::streambuf>     m_source = std::unique_ptr<std::streambuf>();
     std::unique_ptr<std::istream>       m_ifs = std::unique_ptr<std::istream>();
     std::istream &                      m_ifs_ref;
     std::unique_ptr<ZipInputStreambuf>  m_izf = std::unique_ptr<ZipInputStreambuf>();
@@ -29,6 +29,9 @@
 
 #include "zipios/zipiosexceptions.hpp"
 
+#include "crc32.hpp"
+#include "zipios_common.hpp"
+
 #include <algorithm>
 
 
@@ -36,6 +39,20 @@ namespace zipios
 {
 
 
+namespace
+{
+
+/** \brief The optional signature of a data descriptor.
+ *
+ * The data descriptor which follows the data of an entry with a
+ * trailing data descriptor may start with this signature ("PK\x07\x08").
+ */
+uint32_t const g_data_descriptor_signature = 0x08074b50;
+
+} // no name namespace
+
+
+
 /** \class ZipInputStreambuf
  * \brief An input stream buffer for Zip data.
  *
@@ -50,12 +67,60 @@ namespace zipios
  * This ZipInputStreambuf constructor initializes the buffer from the
  * user specified buffer.
  *
+ * When \p expected_entry is not nullptr, the local header is compared
+ * against that entry (generally, the corresponding Central Directory
+ * entry) and the constructor throws if they do not match. This is how
+ * the ZipFile verifies the local headers lazily.
+ *
+ * \exception FileCollectionException
+ * This exception is raised if the local header does not match the
+ * \p expected_entry.
+ *
+ * When \p verify_crc is true, the CRC32 of the data gets computed as
+ * each buffer is filled and compared against the CRC32 of the local
+ * header (which the ZipFile verifies against the Central Directory)
+ * once the end of the entry is reached. On a mismatch, underflow()
+ * throws an IOException so the stream fails instead of returning a
+ * clean end of file.
+ *
+ * The stream buffer supports seeking. STORED entries are repositioned
+ * directly. DEFLATED entries get inflated from the start, or from the
+ * closest checkpoint of \p index when one is specified, up to the
+ * requested position. When verifying the CRC32, seeking postpones the
+ * verification until all the data from the start of the entry was
+ * read, see seekoff() for details.
+ *
+ * An entry with a trailing data descriptor (bit 3 of the general
+ * purpose flags) has its CRC32 and sizes saved after its data instead
+ * of its local header. When \p expected_entry is specified, its values
+ * are used. Otherwise, a DEFLATED entry is inflated until the end of
+ * the compressed stream is found, which gives the position of the data
+ * descriptor. A STORED entry can only be read that way if its local
+ * header includes its size anyway. Once the end of the data is
+ * reached, the data descriptor gets read and verified against the data
+ * and the input is left right after it. Until then, the size of the
+ * entry is unknown so the stream cannot be repositioned forward.
+ *
+ * \exception FileCollectionException
+ * This exception is also raised if a STORED entry has a trailing data
+ * descriptor and its size is not known.
+ *
  * \param[in,out] inbuf  The streambuf to use for input.
  * \param[in] start_pos  A position to reset the inbuf to before reading.
  *                       Specify -1 to read from the current position.
+ * \param[in] expected_entry  The entry the local header has to match or
+ *                            nullptr to not verify the local header.
+ * \param[in] verify_crc  Whether the data is verified against its CRC32.
+ * \param[in] index  The checkpoint index of a DEFLATED entry or nullptr.
  */
-ZipInputStreambuf::ZipInputStreambuf(std::streambuf * inbuf, offset_t start_pos)
+ZipInputStreambuf::ZipInputStreambuf(
+          std::streambuf * inbuf
+        , offset_t start_pos
+        , FileEntry const * expected_entry
+        , bool verify_crc
+        , InflateIndex::pointer_t index)
     : InflateInputStreambuf(inbuf, start_pos)
+    , m_verify_crc(verify_crc)
 {
     // read the zip local header
     std::istream is(m_inbuf); // istream does not destroy the streambuf.
@@ -63,20 +128,48 @@ ZipInputStreambuf::ZipInputStreambuf(std::streambuf * inbuf, offset_t start_pos)
 
     // if the read fails in any way it will throw
     m_current_entry.read(is);
-    if(m_current_entry.isValid() && m_current_entry.hasTrailingDataDescriptor())
+    if(expected_entry != nullptr
+    && !m_current_entry.isEqual(*expected_entry))
     {
-        throw FileCollectionException("Trailing data descriptor in zip file not supported");
+        throw FileCollectionException("Zip file consistency problem. Zip file data fields are inconsistent with zip file layout.");
+    }
+    offset_t compressed_size(m_current_entry.getCompressedSize());
+    m_data_descriptor = m_current_entry.isValid() && m_current_entry.hasTrailingDataDescriptor();
+    if(m_data_descriptor)
+    {
+        if(expected_entry != nullptr)
+        {
+            // the Central Directory has the CRC32 and sizes
+            //
+            m_current_entry.setCrc(expected_entry->getCrc());
+            m_current_entry.setSize(expected_entry->getSize());
+            m_current_entry.setCompressedSize(expected_entry->getCompressedSize());
+            compressed_size = m_current_entry.getCompressedSize();
+        }
+        else if(m_current_entry.getMethod() == StorageMethod::DEFLATED)
+        {
+            // find the end of the data with the end of the compressed stream
+            //
+            compressed_size = -1;
+        }
+        else if(m_current_entry.getCompressedSize() == 0)
+        {
+            throw FileCollectionException("Trailing data descriptor of a STORED entry of unknown size not supported");
+        }
     }
 
     switch(m_current_entry.getMethod())
     {
     case StorageMethod::DEFLATED:
-        reset() ; // reset inflatestream data structures
-//std::cerr << "deflated" << std::endl;
+        // reset inflatestream data structures and bound the input
+        // to the compressed data of this entry
+        reset(-1, compressed_size);
+        setIndex(index);
         break;
 
     case StorageMethod::STORED:
         m_remain = m_current_entry.getSize();
+        m_stored_start = m_inbuf->pubseekoff(0, std::ios::cur, std::ios::in);
         // Force underflow on first read:
         setg(&m_outvec[0], &m_outvec[0] + getBufferSize(), &m_outvec[0] + getBufferSize());
 //std::cerr << "stored" << std::endl;
@@ -110,46 +203,313 @@ ZipInputStreambuf::~ZipInputStreambuf()
 }
 
 
-/** \brief Called when more data is required.
+/** \brief Retrieve the local header of the entry.
  *
- * The function ensures that at least one byte is available
- * in the input area by updating the pointers to the input area
- * and reading more data in from the input sequence if required.
+ * \return A copy of the local header read by the constructor.
+ */
+FileEntry::pointer_t ZipInputStreambuf::getEntry() const
+{
+    return m_current_entry.clone();
+}
+
+
+/** \brief Move the read position within the entry.
+ *
+ * This function computes the new position in the uncompressed data of
+ * the entry and repositions the stream there. A position which is
+ * still in the get area is reached without reading anything.
+ *
+ * Only the input sequence can be repositioned. Asking for the current
+ * position (i.e. tellg()) has no side effect.
+ *
+ * When the CRC32 gets verified, it covers the data read in order from
+ * the start of the entry. Data skipped by a seek is not part of it, so
+ * reaching the end of the entry after skipping data does not verify
+ * anything. The verification happens once the caller seeks back and
+ * reads the skipped data, then reaches the end of the entry again.
  *
- * \return The value of that character on success or
- *         std::streambuf::traits_type::eof() on failure.
+ * \param[in] off  The offset to apply.
+ * \param[in] dir  The reference point used to apply the offset.
+ * \param[in] which  Which pointer to move, only std::ios_base::in is
+ *                   supported.
+ *
+ * \return The new position or -1 if the position is out of range or the
+ *         input cannot be repositioned.
  */
-std::streambuf::int_type ZipInputStreambuf::underflow()
+ZipInputStreambuf::pos_type ZipInputStreambuf::seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which)
 {
+    if((which & std::ios_base::in) == 0)
+    {
+        return pos_type(off_type(-1));
+    }
+
+    // position of the end of the get area in the entry data
+    //
+    offset_t const size(m_current_entry.getSize());
+    offset_t const end_of_buffer(m_current_entry.getMethod() == StorageMethod::STORED
+                                    ? size - m_remain
+                                    : getDataPosition());
+    offset_t const current(end_of_buffer - (egptr() - gptr()));
+
+    off_type base(0);
+    switch(dir)
+    {
+    case std::ios_base::beg:
+        break;
+
+    case std::ios_base::cur:
+        base = current;
+        break;
+
+    case std::ios_base::end:
+        base = size;
+        break;
+
+    default:
+        return pos_type(off_type(-1)); // LCOV_EXCL_LINE
+
+    }
+
+    offset_t const pos(base + off);
+    if(pos == current)
+    {
+        return pos_type(pos);
+    }
+    if(pos < 0 || pos > size)
+    {
+        return pos_type(off_type(-1));
+    }
+
+    offset_t const start_of_buffer(end_of_buffer - (egptr() - eback()));
+    if(pos >= start_of_buffer
+    && pos <= end_of_buffer)
+    {
+        setg(eback(), eback() + (pos - start_of_buffer), egptr());
+        return pos_type(pos);
+    }
+
     switch(m_current_entry.getMethod())
     {
     case StorageMethod::DEFLATED:
-        // inflate class takes care of it in this case
-        return InflateInputStreambuf::underflow();
+        if(!seekData(pos))
+        {
+            return pos_type(off_type(-1));
+        }
+        break;
 
     case StorageMethod::STORED:
-    {
-        // Ok, we are STORED, so we handle it ourselves.
-        offset_t const num_b(std::min(m_remain, static_cast<offset_t>(getBufferSize())));
-        std::streamsize const g(m_inbuf->sgetn(&m_outvec[0], num_b));
-        setg(&m_outvec[0], &m_outvec[0], &m_outvec[0] + g);
-        m_remain -= g;
-        if(g > 0)
+        if(m_stored_start < 0
+        || m_inbuf->pubseekpos(m_stored_start + pos, std::ios::in) != std::streampos(m_stored_start + pos))
         {
-            // we got some data, return it
-            return traits_type::to_int_type(*gptr());
+            return pos_type(off_type(-1));
         }
+        m_remain = size - pos;
+        break;
+
+    default: // LCOV_EXCL_LINE
+        throw std::logic_error("ZipInputStreambuf::seekoff(): unknown storage method"); // LCOV_EXCL_LINE
 
-        // documentation says to return EOF if no data available
-        return traits_type::eof();
     }
 
+    // next read fills the get area from the new position
+    //
+    setg(&m_outvec[0], &m_outvec[0], &m_outvec[0]);
+
+    return pos_type(pos);
+}
+
+
+/** \brief Seek to an absolute position within the entry.
+ *
+ * This function moves the read pointer to the specified absolute
+ * position in the uncompressed data of the entry.
+ *
+ * \param[in] pos  The new position.
+ * \param[in] which  Which pointer to move.
+ *
+ * \return The new position or -1 if the position is invalid.
+ */
+ZipInputStreambuf::pos_type ZipInputStreambuf::seekpos(pos_type pos, std::ios_base::openmode which)
+{
+    return seekoff(off_type(pos), std::ios_base::beg, which);
+}
+
+
+/** \brief Read the next block of data of this entry.
+ *
+ * This function reads data from the input streambuf. DEFLATED data
+ * is inflated by the InflateInputStreambuf. STORED data is read as is,
+ * directly in \p buffer.
+ *
+ * This function is used by underflow() to fill the get area and by
+ * xsgetn() to read large blocks directly in the caller's buffer.
+ *
+ * \param[out] buffer  The buffer receiving the data.
+ * \param[in] size  The size of \p buffer.
+ *
+ * \return The number of bytes saved in \p buffer, 0 at the end of the entry.
+ */
+std::streamsize ZipInputStreambuf::readData(char * buffer, std::streamsize size)
+{
+    std::streamsize bytes(0);
+    offset_t position(0);
+    switch(m_current_entry.getMethod())
+    {
+    case StorageMethod::DEFLATED:
+        // inflate class takes care of it in this case
+        position = getDataPosition();
+        bytes = InflateInputStreambuf::readData(buffer, size);
+        break;
+
+    case StorageMethod::STORED:
+        // Ok, we are STORED, so we handle it ourselves.
+        position = m_current_entry.getSize() - m_remain;
+        bytes = m_inbuf->sgetn(buffer, std::min(m_remain, static_cast<offset_t>(size)));
+        m_remain -= bytes;
+        break;
+
     default: // LCOV_EXCL_LINE
         // This should NEVER be reached or the constructor let something
         // go through that should not have gone through
-        throw std::logic_error("ZipInputStreambuf::underflow(): unknown storage method"); // LCOV_EXCL_LINE
+        throw std::logic_error("ZipInputStreambuf::readData(): unknown storage method"); // LCOV_EXCL_LINE
+
+    }
+
+    if(bytes == 0
+    && m_data_descriptor)
+    {
+        readDataDescriptor();
+    }
+
+    if(m_verify_crc)
+    {
+        verifyCrc(buffer, bytes, position);
+    }
+
+    return bytes;
+}
+
 
+/** \brief Read and verify the data descriptor found after the data.
+ *
+ * This function is called by readData() once the end of the data of
+ * an entry with a trailing data descriptor is reached. It positions
+ * the input right after the compressed data, reads the data descriptor
+ * and compares its sizes against the data actually found (and its
+ * CRC32 against the Central Directory when known.) The entry then
+ * gets its CRC32 and sizes from the data descriptor so verifyCrc()
+ * can check the data.
+ *
+ * \exception IOException
+ * This exception is raised if the data descriptor cannot be read or
+ * it does not match the data.
+ */
+void ZipInputStreambuf::readDataDescriptor()
+{
+    m_data_descriptor = false;
+
+    offset_t compressed_size(m_current_entry.getCompressedSize());
+    offset_t size(m_current_entry.getSize());
+    if(m_current_entry.getMethod() == StorageMethod::DEFLATED)
+    {
+        if(!rewindInput())
+        {
+            throw IOException("ZipInputStreambuf::readData(): could not find the data descriptor of \""
+                            + m_current_entry.getName()
+                            + "\".");
+        }
+        compressed_size = getCompressedSize();
+        size = getDataPosition();
+    }
+
+    // the signature is optional
+    //
+    std::istream is(m_inbuf);
+    uint32_t crc(0);
+    uint32_t descriptor_compressed_size(0);
+    uint32_t descriptor_size(0);
+    zipRead(is, crc);                           // 32
+    if(crc == g_data_descriptor_signature)
+    {
+        zipRead(is, crc);                       // 32
+    }
+    zipRead(is, descriptor_compressed_size);    // 32
+    zipRead(is, descriptor_size);               // 32
+    /** \todo
+     * Add support for zip64, the sizes of the data descriptor are
+     * 64 bit when the local header has a zip64 extra field.
+     */
+
+    if(descriptor_compressed_size != static_cast<uint32_t>(compressed_size)
+    || descriptor_size != static_cast<uint32_t>(size)
+    || (m_current_entry.getCrc() != 0 && crc != m_current_entry.getCrc()))
+    {
+        throw IOException("ZipInputStreambuf::readData(): data descriptor mismatch for \""
+                        + m_current_entry.getName()
+                        + "\".");
+    }
+
+    m_current_entry.setCrc(crc);
+    m_current_entry.setSize(size);
+    m_current_entry.setCompressedSize(compressed_size);
+}
+
+
+/** \brief Fold the new data in the CRC32 and verify it at the end.
+ *
+ * This function is called by readData() each time new data was read.
+ * It adds that data to the CRC32 of the entry. Once the end of the
+ * entry is reached (\p size is 0), it compares the CRC32 and size of
+ * all the data returned against the local header.
+ *
+ * The CRC32 covers the data read in order from the start of the entry.
+ * After a seek, the data which does not follow what was already
+ * verified is ignored. If the end of the entry is reached before all
+ * the data was verified, the verification is postponed until the
+ * caller seeks back and reads the missing data up to the end.
+ *
+ * \exception IOException
+ * This exception is raised if the CRC32 or the size of the data does
+ * not match the local header.
+ *
+ * \param[in] buffer  The data just read.
+ * \param[in] size  The number of bytes in \p buffer, 0 at the end.
+ * \param[in] position  The position of \p buffer in the entry data.
+ */
+void ZipInputStreambuf::verifyCrc(char const * buffer, std::streamsize size, offset_t position)
+{
+    if(size > 0)
+    {
+        // only the data following what was verified so far counts
+        //
+        offset_t const verified(m_returned_size);
+        if(position <= verified
+        && position + size > verified)
+        {
+            offset_t const skip(verified - position);
+            m_crc32 = crc32Update(m_crc32, buffer + skip, size - skip);
+            m_returned_size += size - skip;
+        }
+        return;
+    }
+
+    if(position > static_cast<offset_t>(m_returned_size))
+    {
+        // some of the data was skipped, it was not verified yet
+        //
+        return;
     }
+
+    if(m_crc32 != m_current_entry.getCrc()
+    || m_returned_size != m_current_entry.getSize())
+    {
+        throw IOException("ZipInputStreambuf::readData(): CRC32 mismatch for \""
+                        + m_current_entry.getName()
+                        + "\".");
+    }
+
+    // only verify once, readData() may be called again after EOF
+    m_verify_crc = false;
 }
 
 
@@ -42,18 +42,35 @@ namespace zipios
 class ZipInputStreambuf : public InflateInputStreambuf
 {
 public:
-                            ZipInputStreambuf(std::streambuf * inbuf, offset_t start_pos = -1);
+                            ZipInputStreambuf(
+                                      std::streambuf * inbuf
+                                    , offset_t start_pos = -1
+                                    , FileEntry const * expected_entry = nullptr
+                                    , bool verify_crc = false
+                                    , InflateIndex::pointer_t index = InflateIndex::pointer_t());
                             ZipInputStreambuf(ZipInputStreambuf const & src) = delete;
     ZipInputStreambuf &     operator = (ZipInputStreambuf const & rhs) = delete;
     virtual                 ~ZipInputStreambuf() override;
 
+    FileEntry::pointer_t    getEntry() const;
+
 protected:
-    virtual std::streambuf::int_type    underflow() override;
+    virtual pos_type        seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which = std::ios_base::in) override;
+    virtual pos_type        seekpos(pos_type pos, std::ios_base::openmode which = std::ios_base::in) override;
+    virtual std::streamsize readData(char * buffer, std::streamsize size) override;
 
 private:
+    void                    verifyCrc(char const * buffer, std::streamsize size, offset_t position);
+    void                    readDataDescriptor();
+
     ZipLocalEntry           m_current_entry = ZipLocalEntry();
     offset_t                m_remain = 0;     // For STORED entry only. the number of bytes that
                                               // has not been put in the m_outvec yet.
+    offset_t                m_stored_start = -1;  // For STORED entry only. the position of the data in m_inbuf.
+    bool                    m_verify_crc = false;
+    uint32_t                m_crc32 = 0;      // CRC32 of the first m_returned_size bytes of the entry
+    size_t                  m_returned_size = 0;
+    bool                    m_data_descriptor = false;  // a data descriptor follows the data and was not read yet
 };
 
 
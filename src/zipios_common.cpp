@@ -213,8 +213,7 @@ void zipRead(buffer_t const & is, size_t & pos, buffer_t & buffer, ssize_t const
         throw IOException("EOF reached while reading zip archive data from file.");
     }
 
-    buffer.clear();
-    buffer.insert(buffer.begin(), is.begin() + pos, is.begin() + pos + count);
+    buffer.assign(is.begin() + pos, is.begin() + pos + count);
 
     pos += count;
 }
@@ -227,8 +226,7 @@ void zipRead(buffer_t const & is, size_t & pos, std::string & str, ssize_t const
         throw IOException("EOF reached while reading zip archive data from file.");
     }
 
-    str.clear();
-    str.insert(str.begin(), is.begin() + pos, is.begin() + pos + count);
+    str.assign(reinterpret_cast<char const *>(is.data()) + pos, count);
 
     pos += count;
 }
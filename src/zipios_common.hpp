@@ -98,6 +98,22 @@ typedef std::ostringstream OutputStringStream;
 typedef std::vector<unsigned char>      buffer_t;
 
 
+/** \brief Hints given to the operating system about file accesses.
+ *
+ * The SharedFile and the MemoryMappedFile pass these hints to the
+ * operating system (posix_fadvise() and madvise() respectively.) They
+ * never change the data read, only how the page cache gets used.
+ */
+enum class IOAdvice : uint32_t
+{
+    NORMAL,         // default readahead
+    SEQUENTIAL,     // aggressive readahead
+    RANDOM,         // no readahead
+    WILLNEED,       // start reading the range now
+    DONTNEED        // the range is not going to be read again
+};
+
+
 void     zipRead(std::istream & is, uint32_t & value);
 void     zipRead(std::istream & is, uint16_t & value);
 void     zipRead(std::istream & is, uint8_t &  value);
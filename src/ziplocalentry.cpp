@@ -194,6 +194,12 @@ bool ZipLocalEntry::isDirectory() const
  * This function is also used to compare ZipCDirEntry since none
  * of the additional field participate in the comparison.
  *
+ * \note
+ * When the entry has a trailing data descriptor, the local header
+ * generally has its CRC32 and sizes set to zero. In that case, a zero
+ * on either side is viewed as equal to the value on the other side.
+ * Only these fields are relaxed, all the others must still match.
+ *
  * \param[in] file_entry  The file entry to compare this against.
  *
  * \return true if both FileEntry objects are considered equal.
@@ -205,11 +211,32 @@ bool ZipLocalEntry::isEqual(FileEntry const & file_entry) const
     {
         return false;
     }
-    return FileEntry::isEqual(file_entry)
+    if(!hasTrailingDataDescriptor())
+    {
+        return FileEntry::isEqual(file_entry)
+            && m_extract_version          == ze->m_extract_version
+            && m_general_purpose_bitfield == ze->m_general_purpose_bitfield
+            && m_is_directory             == ze->m_is_directory;
+            //&& m_compressed_size          == ze->m_compressed_size -- ignore in comparison
+    }
+
+    // the CRC32 and sizes are saved in the data descriptor
+    //
+    return m_filename                 == ze->m_filename
+        && m_comment                  == ze->m_comment
+        && (m_uncompressed_size       == ze->m_uncompressed_size
+            || m_uncompressed_size == 0
+            || ze->m_uncompressed_size == 0)
+        && m_unix_time                == ze->m_unix_time
+        && m_compress_method          == ze->m_compress_method
+        && (m_crc_32                  == ze->m_crc_32
+            || m_crc_32 == 0
+            || ze->m_crc_32 == 0)
+        && m_has_crc_32               == ze->m_has_crc_32
+        && m_valid                    == ze->m_valid
         && m_extract_version          == ze->m_extract_version
         && m_general_purpose_bitfield == ze->m_general_purpose_bitfield
         && m_is_directory             == ze->m_is_directory;
-        //&& m_compressed_size          == ze->m_compressed_size -- ignore in comparison
 }
 
 
@@ -298,7 +325,8 @@ void ZipLocalEntry::setCrc(uint32_t crc)
  * and uncompressed sizes set to zero.
  *
  * \note
- * Zipios does not support such a scheme.
+ * Zipios reads such entries (see ZipInputStreambuf) but never writes
+ * them.
  *
  * \return true if this file makes use of a trailing data buffer.
  */
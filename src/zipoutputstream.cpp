@@ -51,11 +51,12 @@ namespace zipios
  *
  * \param[in] os  The output stream to use to write the Zip archive.
  */
- //  ZipOutputStream ̳ std::ostream
-    ZipOutputStream::ZipOutputStream(std::ostream& os)
-        : std::ostream(new ZipOutputStreambuf(os.rdbuf())) {
-        // ﲻҪinit()ΪѾڻ๹дˡ
-    }
+ZipOutputStream::ZipOutputStream(std::ostream & os)
+    : std::ostream(nullptr)
+    , m_ozf(std::make_unique<ZipOutputStreambuf>(os.rdbuf()))
+{
+    init(m_ozf.get());
+}
 
 
 
@@ -141,6 +142,35 @@ void ZipOutputStream::putNextEntry(FileEntry::pointer_t entry)
 }
 
 
+/** \brief Add an entry with its already compressed data.
+ *
+ * This function saves the header of the entry followed by its data.
+ * It is used by ZipFile::saveCollectionToArchive() when the entries
+ * get compressed by several threads.
+ *
+ * \param[in] entry  The FileEntry to add to the output stream.
+ * \param[in] size  The size of the uncompressed data.
+ * \param[in] crc32  The CRC32 of the uncompressed data.
+ * \param[in] data  The data of the entry, compressed if DEFLATED.
+ *
+ * \sa ZipOutputStreambuf::putCompressedEntry()
+ */
+void ZipOutputStream::putCompressedEntry(
+          FileEntry::pointer_t entry
+        , size_t size
+        , uint32_t crc32
+        , SpillStreambuf & data)
+{
+    ZipCentralDirectoryEntry * central_directory_entry(dynamic_cast<ZipCentralDirectoryEntry *>(entry.get()));
+    if(central_directory_entry == nullptr)
+    {
+        entry = std::make_shared<ZipCentralDirectoryEntry>(*entry);
+    }
+
+    m_ozf->putCompressedEntry(entry, size, crc32, data);
+}
+
+
 /** \brief Set the global comment.
  *
  * This function is used to setup the Global Comment of the Zip archive
@@ -157,6 +187,27 @@ void ZipOutputStream::setComment(std::string const & comment)
 }
 
 
+/** \brief Compress large entries with several threads.
+ *
+ * The DEFLATED entries added after this call get compressed by
+ * \p thread_count threads. The data is cut in blocks compressed in
+ * parallel and joined in one standard deflate stream, so any unzip
+ * tool can read the entries. Entries smaller than one block (128 KiB)
+ * are not affected.
+ *
+ * This is useful to save a single very large file. To save many files,
+ * ZipFile::saveCollectionToArchive() compresses whole entries in
+ * parallel instead.
+ *
+ * \param[in] thread_count  The number of threads, 0 for one per CPU
+ *                          and 1 (the default) to not use threads.
+ */
+void ZipOutputStream::setThreadCount(size_t thread_count)
+{
+    m_ozf->setThreadCount(thread_count);
+}
+
+
 } // zipios namespace
 
 // Local Variables:
@@ -48,7 +48,13 @@ public:
     void            close();
     void            finish();
     void            putNextEntry(FileEntry::pointer_t entry);
+    void            putCompressedEntry(
+                              FileEntry::pointer_t entry
+                            , size_t size
+                            , uint32_t crc32
+                            , SpillStreambuf & data);
     void            setComment(std::string const & comment);
+    void            setThreadCount(size_t thread_count);
 
 private:
     std::unique_ptr<ZipOutputStreambuf> m_ozf = std::unique_ptr<ZipOutputStreambuf>();
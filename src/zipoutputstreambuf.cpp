@@ -30,6 +30,7 @@
 
 #include "zipios/zipiosexceptions.hpp"
 
+#include "crc32.hpp"
 #include "ziplocalentry.hpp"
 #include "zipendofcentraldirectory.hpp"
 
@@ -239,6 +240,44 @@ void ZipOutputStreambuf::putNextEntry(FileEntry::pointer_t entry)
 }
 
 
+/** \brief Save an entry of which the data was already compressed.
+ *
+ * This function writes the local header of \p entry followed by
+ * \p data, the data of the entry as it would have been written after
+ * a putNextEntry(): deflated by a DeflateOutputStreambuf initialized
+ * with the compression level of the entry or, for STORED entries, as
+ * is. The resulting bytes are the same as with putNextEntry() but the
+ * local header gets written only once, with its final sizes and CRC32.
+ *
+ * If a previous entry was still open, the function calls closeEntry()
+ * first.
+ *
+ * \param[in] entry  The entry to be saved.
+ * \param[in] size  The size of the uncompressed data.
+ * \param[in] crc32  The CRC32 of the uncompressed data.
+ * \param[in] data  The data of the entry, compressed if DEFLATED.
+ */
+void ZipOutputStreambuf::putCompressedEntry(
+          FileEntry::pointer_t entry
+        , size_t size
+        , uint32_t crc32
+        , SpillStreambuf & data)
+{
+    closeEntry();
+
+    entry->setSize(size);
+    entry->setCrc(crc32);
+    entry->setCompressedSize(data.size());
+
+    m_entries.push_back(entry);
+
+    std::ostream os(m_outbuf);
+    entry->setEntryOffset(os.tellp());
+    static_cast<ZipLocalEntry *>(entry.get())->ZipLocalEntry::write(os);
+    data.copyTo(m_outbuf);
+}
+
+
 /** \brief Set the archive comment.
  *
  * This function saves a global comment for the Zip archive.
@@ -269,7 +308,8 @@ void ZipOutputStreambuf::setComment(std::string const & comment)
  *
  * \exception IOException
  * This function generates an exception if saving the data to the output
- * fails.
+ * fails or if the entry would reach 4 GiB, which cannot be saved without
+ * zip64 support.
  *
  * \param[in] c  The character that made it all happen. Maybe EOF.
  *
@@ -278,14 +318,22 @@ void ZipOutputStreambuf::setComment(std::string const & comment)
 int ZipOutputStreambuf::overflow(int c)
 {
     std::size_t const size(pptr() - pbase());
-    m_overflown_bytes += size;
+
+    // without zip64 the size of an entry is saved on 32 bits
+    //
+    if(m_overflown_bytes + size > 0xFFFFFFFFUL)
+    {
+        throw IOException("ZipOutputStreambuf::overflow(): the entry is too large to fit in a 32 bit zip archive.");
+    }
+
     switch(m_compression_level)
     {
     case FileEntry::COMPRESSION_LEVEL_NONE:
     {
         // Ok, we are STORED, so we handle it ourselves to avoid "side
         // effects" from zlib, which adds markers every now and then.
-        m_crc32 = crc32(m_crc32, reinterpret_cast<Bytef const *>(&m_invec[0]), size); // update crc32
+        m_overflown_bytes += size;
+        m_crc32 = crc32Update(m_crc32, &m_invec[0], size); // update crc32
         size_t const bc(m_outbuf->sputn(&m_invec[0], size));
         if(size != bc)
         {
@@ -337,7 +385,7 @@ int ZipOutputStreambuf::sync() // LCOV_EXCL_LINE
 void ZipOutputStreambuf::setEntryClosedState()
 {
     m_open_entry = false;
-    m_crc32 = crc32(0, nullptr, 0);
+    m_crc32 = 0;
 
     /** \FIXME
      * Update put pointers to trigger overflow on write. Overflow
@@ -365,7 +413,7 @@ void ZipOutputStreambuf::updateEntryHeaderInfo()
     }
 
     std::ostream os(m_outbuf);
-    int const curr_pos(os.tellp());
+    offset_t const curr_pos(os.tellp());
 
     // update fields in m_entries.back()
     FileEntry::pointer_t entry(m_entries.back());
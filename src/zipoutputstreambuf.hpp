@@ -30,6 +30,7 @@
  */
 
 #include "deflateoutputstreambuf.hpp"
+#include "spillstreambuf.hpp"
 
 #include "zipios/fileentry.hpp"
 
@@ -51,6 +52,11 @@ public:
     void                        close();
     void                        finish();
     void                        putNextEntry(FileEntry::pointer_t entry);
+    void                        putCompressedEntry(
+                                          FileEntry::pointer_t entry
+                                        , size_t size
+                                        , uint32_t crc32
+                                        , SpillStreambuf & data);
     void                        setComment(std::string const & comment);
 
 protected:
@@ -0,0 +1,288 @@
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (c) 2015-2022  Made to Order Software Corp.  All Rights Reserved
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Implementation of zipios::ZipStreamReader.
+ *
+ * This file includes the implementation of the forward-only reader of
+ * Zip archives.
+ */
+
+#include "zipios/zipstreamreader.hpp"
+
+#include "zipios/zipiosexceptions.hpp"
+
+#include "forwardinputstreambuf.hpp"
+#include "zipinputstream.hpp"
+#include "ziplocalentry.hpp"
+
+
+namespace zipios
+{
+
+
+/** \class ZipStreamReader
+ * \brief Read a Zip archive from a non-seekable stream.
+ *
+ * The ZipFile class needs to seek to the end of the archive to read
+ * the Central Directory before it can return any entry. This is not
+ * possible when the archive arrives through a pipe or a socket.
+ *
+ * The ZipStreamReader instead reads the local headers in the order
+ * they appear in the archive and never seeks. Each call to nextEntry()
+ * returns the next entry and getInputStream() returns a stream with
+ * its data. The entries can thus be extracted while the rest of the
+ * archive is still being received:
+ *
+ * \code
+ *      zipios::ZipStreamReader reader(std::cin);
+ *      for(;;)
+ *      {
+ *          zipios::FileEntry::pointer_t entry(reader.nextEntry());
+ *          if(entry == nullptr)
+ *          {
+ *              break;
+ *          }
+ *          if(!entry->isDirectory())
+ *          {
+ *              zipios::ZipStreamReader::stream_pointer_t is(reader.getInputStream());
+ *              ...read the data from *is...
+ *          }
+ *      }
+ * \endcode
+ *
+ * The reader stops at the Central Directory. The entries it returns are
+ * the local headers, which do not include the information only saved
+ * in the Central Directory (comments, file attributes.)
+ *
+ * Archives written to a stream generally use trailing data descriptors
+ * (bit 3 of the general purpose flags): the CRC32 and sizes of an entry
+ * are saved after its data. The reader supports such DEFLATED entries
+ * by inflating them until the end of the compressed stream, which is
+ * also what has to be done to skip them. Their sizes and CRC32 are only
+ * known, and returned by getEntry(), once the end of their data was
+ * read.
+ *
+ * \warning
+ * The stream returned by getInputStream() reads directly from the input
+ * stream. It can only be used until the next call to nextEntry(). It
+ * can only seek forward, except within the data of a STORED entry still
+ * present in the buffer.
+ */
+
+
+/** \brief Initialize a reader of the archive found in \p is.
+ *
+ * The archive is expected to start at the current position of \p is.
+ * Nothing is read until nextEntry() gets called. The stream \p is must
+ * remain valid as long as the reader is used.
+ *
+ * \param[in,out] is  The stream with the Zip archive data.
+ */
+ZipStreamReader::ZipStreamReader(std::istream & is)
+    : m_buffer(std::make_shared<ForwardInputStreambuf>(is.rdbuf()))
+    , m_input(std::make_unique<std::istream>(m_buffer.get()))
+{
+}
+
+
+/** \brief Clean up the reader.
+ *
+ * The input stream is left wherever the reader stopped reading it.
+ */
+ZipStreamReader::~ZipStreamReader()
+{
+}
+
+
+/** \brief Verify the CRC32 of the entries while reading them.
+ *
+ * When set, the streams returned by getInputStream() compare the CRC32
+ * of their data against the local header once the end of the entry is
+ * reached, see ZipFile::setVerifyCrc() for details.
+ *
+ * The flag applies to the entries returned by the following calls to
+ * nextEntry().
+ *
+ * \param[in] verify_crc  Whether the entries get verified.
+ */
+void ZipStreamReader::setVerifyCrc(bool verify_crc)
+{
+    m_verify_crc = verify_crc;
+}
+
+
+/** \brief Check whether the entries get verified while read.
+ *
+ * \return true if the CRC32 of the entries gets verified.
+ */
+bool ZipStreamReader::getVerifyCrc() const
+{
+    return m_verify_crc;
+}
+
+
+/** \brief Move to the next entry of the archive.
+ *
+ * This function skips the data of the current entry which was not
+ * read yet and reads the local header of the next entry. The data of
+ * an entry with a trailing data descriptor has to be inflated to find
+ * its end.
+ *
+ * \exception FileCollectionException
+ * This exception is raised if the input ends before the Central
+ * Directory is reached, if something other than a local header or the
+ * Central Directory is found, or if the entry uses a format which is
+ * not supported.
+ *
+ * \exception IOException
+ * This exception is raised if the data of the current entry has to be
+ * read to find its end and it is invalid, or if its data descriptor
+ * does not match the data.
+ *
+ * \return The next entry or nullptr once the Central Directory is
+ *         reached.
+ */
+FileEntry::pointer_t ZipStreamReader::nextEntry()
+{
+    if(m_end)
+    {
+        return FileEntry::pointer_t();
+    }
+
+    if(m_entry != nullptr)
+    {
+        if(m_data_end < 0)
+        {
+            // read up to the data descriptor, the stream buffer then
+            // leaves the input right after it
+            //
+            std::streambuf * data(m_stream->rdbuf());
+            char buffer[4096];
+            while(data->sgetn(buffer, sizeof(buffer)) > 0)
+            {
+            }
+            m_data_end = m_buffer->pubseekoff(0, std::ios::cur, std::ios::in);
+        }
+        m_stream.reset();
+        m_entry.reset();
+        if(m_buffer->pubseekpos(m_data_end, std::ios::in) != std::streampos(m_data_end))
+        {
+            throw FileCollectionException("Zip stream ended in the middle of the data of an entry.");
+        }
+    }
+
+    char const * signature(m_buffer->peek(4));
+    if(signature == nullptr)
+    {
+        throw FileCollectionException("Zip stream ended before its Central Directory.");
+    }
+    if(signature[0] != 'P'
+    || signature[1] != 'K')
+    {
+        throw FileCollectionException("Zip stream does not include a local header where one was expected.");
+    }
+
+    if((signature[2] == 0x01 && signature[3] == 0x02)       // Central Directory entry
+    || (signature[2] == 0x05 && signature[3] == 0x06)       // End of Central Directory
+    || (signature[2] == 0x06 && signature[3] == 0x06))      // Zip64 End of Central Directory
+    {
+        m_end = true;
+        return FileEntry::pointer_t();
+    }
+
+    if(signature[2] != 0x03
+    || signature[3] != 0x04)
+    {
+        throw FileCollectionException("Zip stream does not include a local header where one was expected.");
+    }
+
+    try
+    {
+        m_stream = std::make_shared<ZipInputStream>(*m_input, -1, m_verify_crc);
+    }
+    catch(std::ios_base::failure const &)
+    {
+        throw FileCollectionException("Zip stream ended in the middle of a local header.");
+    }
+    m_entry = m_stream->getEntry();
+    ZipLocalEntry const * const local_entry(dynamic_cast<ZipLocalEntry const *>(m_entry.get()));
+    if(local_entry != nullptr
+    && local_entry->hasTrailingDataDescriptor())
+    {
+        // the end is found by reading the data
+        //
+        m_data_end = -1;
+    }
+    else
+    {
+        m_data_end = m_buffer->pubseekoff(0, std::ios::cur, std::ios::in) + static_cast<offset_t>(m_entry->getCompressedSize());
+    }
+
+    return m_entry;
+}
+
+
+/** \brief Retrieve the current entry.
+ *
+ * For an entry with a trailing data descriptor, once the end of its
+ * data was read, this function returns a copy of the entry with the
+ * CRC32 and sizes found in the data descriptor.
+ *
+ * \return The entry returned by the last call to nextEntry().
+ */
+FileEntry::pointer_t ZipStreamReader::getEntry() const
+{
+    if(m_data_end < 0
+    && m_stream != nullptr)
+    {
+        return m_stream->getEntry();
+    }
+
+    return m_entry;
+}
+
+
+/** \brief Retrieve a stream to read the data of the current entry.
+ *
+ * The stream returns the uncompressed data of the entry returned by
+ * the last call to nextEntry(). Each call returns the same stream.
+ *
+ * The stream is only valid until the next call to nextEntry().
+ *
+ * \return The stream of the current entry or nullptr if there is no
+ *         current entry.
+ */
+ZipStreamReader::stream_pointer_t ZipStreamReader::getInputStream() const
+{
+    return m_stream;
+}
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
@@ -0,0 +1,619 @@
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (c) 2015-2022  Made to Order Software Corp.  All Rights Reserved
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ *
+ * Zipios benchmarks.
+ *
+ * These tests measure the speed of various parts of the library. They
+ * are hidden so they do not run by default. To run them use:
+ *
+ * \code
+ *      zipios_tests "[benchmark]"
+ * \endcode
+ */
+
+#include "catch_main.hpp"
+
+#include <src/crc32.hpp>
+#include <src/sharedfile.hpp>
+#include <zipios/directorycollection.hpp>
+#include <zipios/zipfile.hpp>
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <zlib.h>
+
+
+namespace
+{
+
+
+/** \brief Measure the time it takes to run a function.
+ *
+ * This function runs \p f and returns the number of milliseconds
+ * it took to run.
+ *
+ * \param[in] f  The function to time.
+ *
+ * \return The duration of the call in milliseconds.
+ */
+template<typename F>
+double duration_ms(F f)
+{
+    std::chrono::steady_clock::time_point const start(std::chrono::steady_clock::now());
+    f();
+    std::chrono::steady_clock::time_point const end(std::chrono::steady_clock::now());
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+
+/** \brief Count the pages of a file present in the page cache.
+ *
+ * \param[in] filename  The name of the file to check.
+ *
+ * \return The number of bytes of the file in the page cache.
+ */
+size_t resident_bytes(std::string const & filename)
+{
+    int const fd(open(filename.c_str(), O_RDONLY));
+    if(fd < 0)
+    {
+        return 0;
+    }
+    off_t const size(lseek(fd, 0, SEEK_END));
+    void * data(mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0));
+    close(fd);
+    if(data == MAP_FAILED)
+    {
+        return 0;
+    }
+    size_t const page_size(sysconf(_SC_PAGESIZE));
+    std::vector<unsigned char> pages((size + page_size - 1) / page_size);
+    size_t count(0);
+    if(mincore(data, size, pages.data()) == 0)
+    {
+        for(auto const p : pages)
+        {
+            count += p & 1;
+        }
+    }
+    munmap(data, size);
+    return count * page_size;
+}
+
+
+} // no name namespace
+
+
+CATCH_TEST_CASE("benchmark_crc32", "[benchmark][.]")
+{
+    CATCH_START_SECTION("compute the CRC-32 with zlib and with the zipios engine")
+    {
+        size_t const size(256 * 1024 * 1024);
+        std::vector<unsigned char> buffer(size);
+        for(size_t i(0); i < size; ++i)
+        {
+            buffer[i] = static_cast<unsigned char>(rand());
+        }
+
+        uLong zlib_crc(0);
+        double const zlib_ms(duration_ms([&]()
+            {
+                zlib_crc = crc32(crc32(0L, Z_NULL, 0), buffer.data(), size);
+            }));
+
+        uint32_t engine_crc(0);
+        double const engine_ms(duration_ms([&]()
+            {
+                engine_crc = zipios::crc32Update(0, buffer.data(), size);
+            }));
+
+        uint32_t parallel_crc(0);
+        double const parallel_ms(duration_ms([&]()
+            {
+                parallel_crc = zipios::crc32Parallel(buffer.data(), size);
+            }));
+
+        CATCH_REQUIRE(engine_crc == zlib_crc);
+        CATCH_REQUIRE(parallel_crc == zlib_crc);
+
+        double const mib(static_cast<double>(size) / (1024.0 * 1024.0));
+        std::cout << "CRC-32 of " << mib << " MiB: zlib "
+                  << mib * 1000.0 / zlib_ms << " MiB/s, "
+                  << zipios::crc32Engine() << " "
+                  << mib * 1000.0 / engine_ms << " MiB/s, parallel "
+                  << mib * 1000.0 / parallel_ms << " MiB/s" << std::endl;
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("benchmark_crc_verification", "[benchmark][.]")
+{
+    CATCH_START_SECTION("read an entry with and without CRC verification")
+    {
+        std::string const top_dir(SNAP_CATCH2_NAMESPACE::g_tmp_dir() + "/benchmark-crc");
+        zipios_test::auto_unlink_t auto_unlink(top_dir, true);
+        CATCH_REQUIRE(system(("mkdir -p " + top_dir + "/test_dir").c_str()) == 0);
+        zipios_test::safe_chdir cwd(top_dir);
+
+        // a large text file which compresses well enough to inflate at
+        // more than 1 GB/s
+        //
+        size_t size(0);
+        {
+            std::ofstream out("test_dir/large.txt", std::ios::out | std::ios::binary);
+            for(size_t line(0); size < 128 * 1024 * 1024; ++line)
+            {
+                std::string const text("line " + std::to_string(line) + " of the CRC verification benchmark data\n");
+                out << text;
+                size += text.length();
+            }
+        }
+        {
+            zipios::DirectoryCollection dc("test_dir");
+            dc.setMethod(0, zipios::StorageMethod::DEFLATED, zipios::StorageMethod::DEFLATED);
+            dc.setLevel(0, zipios::FileEntry::COMPRESSION_LEVEL_FASTEST, zipios::FileEntry::COMPRESSION_LEVEL_FASTEST);
+            std::ofstream out("test.zip", std::ios::out | std::ios::binary | std::ios::trunc);
+            zipios::ZipFile::saveCollectionToArchive(out, dc);
+        }
+
+        zipios::ZipFile zf("test.zip", 0, 0, zipios::ZipFile::AccessMode::MEMORY_MAP);
+        CATCH_REQUIRE(zf.getEntry("test_dir/large.txt")->getMethod() == zipios::StorageMethod::DEFLATED);
+        auto read_entry = [&zf]()
+            {
+                zipios::ZipFile::stream_pointer_t is(zf.getInputStream("test_dir/large.txt"));
+                std::vector<char> buf(256 * 1024);
+                size_t total(0);
+                while(*is)
+                {
+                    is->read(buf.data(), buf.size());
+                    total += is->gcount();
+                }
+                CATCH_REQUIRE(!is->bad());
+                return total;
+            };
+
+        // warm up the page cache
+        //
+        read_entry();
+
+        double const plain_ms(duration_ms([&]()
+            {
+                CATCH_REQUIRE(read_entry() == size);
+            }));
+        zf.setVerifyCrc(true);
+        double const verify_ms(duration_ms([&]()
+            {
+                CATCH_REQUIRE(read_entry() == size);
+            }));
+
+        double const mib(static_cast<double>(size) / (1024.0 * 1024.0));
+        std::cout << "Inflate " << mib << " MiB: "
+                  << mib * 1000.0 / plain_ms << " MiB/s, with CRC verification "
+                  << mib * 1000.0 / verify_ms << " MiB/s ("
+                  << (verify_ms - plain_ms) * 100.0 / plain_ms << "% overhead)" << std::endl;
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("benchmark_read_entry", "[benchmark][.]")
+{
+    CATCH_START_SECTION("read small entries with a stream or with readEntry()")
+    {
+        std::string const top_dir(SNAP_CATCH2_NAMESPACE::g_tmp_dir() + "/benchmark-read-entry");
+        zipios_test::auto_unlink_t auto_unlink(top_dir, true);
+        CATCH_REQUIRE(system(("mkdir -p " + top_dir + "/test_dir").c_str()) == 0);
+        zipios_test::safe_chdir cwd(top_dir);
+
+        // 1,000 JSON like files of 1 KiB to 64 KiB
+        //
+        size_t const count(1000);
+        size_t total(0);
+        for(size_t i(0); i < count; ++i)
+        {
+            std::ofstream out("test_dir/file" + std::to_string(i) + ".json", std::ios::out | std::ios::binary);
+            size_t const size(1024 + rand() % (63 * 1024));
+            std::string data("[");
+            while(data.length() < size)
+            {
+                data += "{\"id\":" + std::to_string(rand()) + ",\"name\":\"item\"},";
+            }
+            data.back() = ']';
+            out << data;
+            total += data.length();
+        }
+        {
+            zipios::DirectoryCollection dc("test_dir");
+            dc.setMethod(0, zipios::StorageMethod::DEFLATED, zipios::StorageMethod::DEFLATED);
+            std::ofstream out("test.zip", std::ios::out | std::ios::binary | std::ios::trunc);
+            zipios::ZipFile::saveCollectionToArchive(out, dc);
+        }
+
+        zipios::ZipFile zf("test.zip", 0, 0, zipios::ZipFile::AccessMode::MEMORY_MAP, zipios::ZipFile::VerificationMode::NONE);
+        std::vector<std::string> names;
+        for(auto const & entry : zf)
+        {
+            if(!entry->isDirectory())
+            {
+                names.push_back(entry->getName());
+            }
+        }
+
+        size_t stream_total(0);
+        double const stream_ms(duration_ms([&]()
+            {
+                for(auto const & name : names)
+                {
+                    zipios::ZipFile::stream_pointer_t is(zf.getInputStream(name));
+                    std::string const data((std::istreambuf_iterator<char>(*is)), std::istreambuf_iterator<char>());
+                    stream_total += data.length();
+                }
+            }));
+
+        size_t read_entry_total(0);
+        double const read_entry_ms(duration_ms([&]()
+            {
+                for(auto const & name : names)
+                {
+                    read_entry_total += zf.readEntry(name).size();
+                }
+            }));
+
+        CATCH_REQUIRE(stream_total == total);
+        CATCH_REQUIRE(read_entry_total == total);
+
+        std::cout << count << " entries (" << total << " bytes): stream "
+                  << stream_ms << "ms, readEntry() "
+                  << read_entry_ms << "ms ("
+                  << stream_ms / read_entry_ms << "x)" << std::endl;
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("benchmark_seek", "[benchmark][.]")
+{
+    CATCH_START_SECTION("seek in a large DEFLATED entry with and without checkpoints")
+    {
+        std::string const top_dir(SNAP_CATCH2_NAMESPACE::g_tmp_dir() + "/benchmark-seek");
+        zipios_test::auto_unlink_t auto_unlink(top_dir, true);
+        CATCH_REQUIRE(system(("mkdir -p " + top_dir + "/test_dir").c_str()) == 0);
+        zipios_test::safe_chdir cwd(top_dir);
+
+        std::string expected;
+        while(expected.length() < 64 * 1024 * 1024)
+        {
+            expected += "line " + std::to_string(expected.length()) + " of the seek benchmark data\n";
+        }
+        {
+            std::ofstream out("test_dir/large.log", std::ios::out | std::ios::binary);
+            out << expected;
+        }
+        {
+            zipios::DirectoryCollection dc("test_dir");
+            dc.setMethod(0, zipios::StorageMethod::DEFLATED, zipios::StorageMethod::DEFLATED);
+            std::ofstream out("test.zip", std::ios::out | std::ios::binary | std::ios::trunc);
+            zipios::ZipFile::saveCollectionToArchive(out, dc);
+        }
+
+        // read 4 KiB at 100 random positions
+        //
+        std::vector<std::streamoff> positions;
+        for(int i(0); i < 100; ++i)
+        {
+            positions.push_back(rand() % (expected.length() - 4096));
+        }
+        zipios::ZipFile zf("test.zip", 0, 0, zipios::ZipFile::AccessMode::MEMORY_MAP);
+        auto range_scan = [&zf, &positions, &expected]()
+            {
+                zipios::ZipFile::stream_pointer_t is(zf.getInputStream("test_dir/large.log"));
+                char buf[4096];
+                for(auto const pos : positions)
+                {
+                    is->seekg(pos);
+                    is->read(buf, sizeof(buf));
+                    CATCH_REQUIRE(std::string(buf, sizeof(buf)) == expected.substr(pos, sizeof(buf)));
+                }
+            };
+
+        double const plain_ms(duration_ms(range_scan));
+
+        // the first scan builds the index, the following ones use it
+        //
+        zf.setCheckpointInterval(1024 * 1024);
+        double const build_ms(duration_ms(range_scan));
+        double const indexed_ms(duration_ms(range_scan));
+
+        std::cout << positions.size() << " seeks in a "
+                  << expected.length() / (1024 * 1024) << " MiB entry: without index "
+                  << plain_ms << "ms, building the index "
+                  << build_ms << "ms, with index "
+                  << indexed_ms << "ms ("
+                  << plain_ms / indexed_ms << "x)" << std::endl;
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("benchmark_small_streams", "[benchmark][.]")
+{
+    CATCH_START_SECTION("open many streams on small STORED and DEFLATED entries")
+    {
+        std::string const top_dir(SNAP_CATCH2_NAMESPACE::g_tmp_dir() + "/benchmark-small-streams");
+        zipios_test::auto_unlink_t auto_unlink(top_dir, true);
+        CATCH_REQUIRE(system(("mkdir -p " + top_dir + "/test_dir").c_str()) == 0);
+        zipios_test::safe_chdir cwd(top_dir);
+
+        // 1,000 files of 100 to 4,000 bytes, files under 1,000 bytes
+        // get STORED
+        //
+        size_t const count(1000);
+        size_t total(0);
+        for(size_t i(0); i < count; ++i)
+        {
+            std::ofstream out("test_dir/file" + std::to_string(i) + ".txt", std::ios::out | std::ios::binary);
+            size_t const size(100 + rand() % 3900);
+            std::string data;
+            while(data.length() < size)
+            {
+                data += "value " + std::to_string(rand()) + "\n";
+            }
+            out << data;
+            total += data.length();
+        }
+        {
+            zipios::DirectoryCollection dc("test_dir");
+            dc.setMethod(1000, zipios::StorageMethod::STORED, zipios::StorageMethod::DEFLATED);
+            std::ofstream out("test.zip", std::ios::out | std::ios::binary | std::ios::trunc);
+            zipios::ZipFile::saveCollectionToArchive(out, dc);
+        }
+
+        zipios::ZipFile zf("test.zip", 0, 0, zipios::ZipFile::AccessMode::MEMORY_MAP, zipios::ZipFile::VerificationMode::NONE);
+        std::vector<std::string> names;
+        for(auto const & entry : zf)
+        {
+            if(!entry->isDirectory())
+            {
+                names.push_back(entry->getName());
+            }
+        }
+
+        int const repeat(20);
+        size_t stream_total(0);
+        double const stream_ms(duration_ms([&]()
+            {
+                for(int r(0); r < repeat; ++r)
+                {
+                    for(auto const & name : names)
+                    {
+                        zipios::ZipFile::stream_pointer_t is(zf.getInputStream(name));
+                        char buf[4096];
+                        is->read(buf, sizeof(buf));
+                        stream_total += is->gcount();
+                    }
+                }
+            }));
+
+        CATCH_REQUIRE(stream_total == total * repeat);
+
+        std::cout << count * repeat << " streams on small entries: "
+                  << stream_ms << "ms ("
+                  << stream_ms * 1000.0 / (count * repeat) << "us per stream)" << std::endl;
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("benchmark_entry_cache", "[benchmark][.]")
+{
+    CATCH_START_SECTION("read hot DEFLATED entries with and without the cache")
+    {
+        std::string const top_dir(SNAP_CATCH2_NAMESPACE::g_tmp_dir() + "/benchmark-entry-cache");
+        zipios_test::auto_unlink_t auto_unlink(top_dir, true);
+        CATCH_REQUIRE(system(("mkdir -p " + top_dir + "/test_dir").c_str()) == 0);
+        zipios_test::safe_chdir cwd(top_dir);
+
+        // 50 configuration like files of 4 KiB to 64 KiB
+        //
+        size_t const count(50);
+        size_t total(0);
+        for(size_t i(0); i < count; ++i)
+        {
+            std::ofstream out("test_dir/config" + std::to_string(i) + ".ini", std::ios::out | std::ios::binary);
+            size_t const size(4096 + rand() % (60 * 1024));
+            std::string data;
+            while(data.length() < size)
+            {
+                data += "option_" + std::to_string(rand() % 1000) + "=" + std::to_string(rand()) + "\n";
+            }
+            out << data;
+            total += data.length();
+        }
+        {
+            zipios::DirectoryCollection dc("test_dir");
+            dc.setMethod(0, zipios::StorageMethod::DEFLATED, zipios::StorageMethod::DEFLATED);
+            std::ofstream out("test.zip", std::ios::out | std::ios::binary | std::ios::trunc);
+            zipios::ZipFile::saveCollectionToArchive(out, dc);
+        }
+
+        zipios::ZipFile zf("test.zip", 0, 0, zipios::ZipFile::AccessMode::MEMORY_MAP, zipios::ZipFile::VerificationMode::NONE);
+        std::vector<std::string> names;
+        for(auto const & entry : zf)
+        {
+            if(!entry->isDirectory())
+            {
+                names.push_back(entry->getName());
+            }
+        }
+
+        int const repeat(100);
+        auto read_all = [&zf, &names, repeat]()
+            {
+                size_t read_total(0);
+                for(int r(0); r < repeat; ++r)
+                {
+                    for(auto const & name : names)
+                    {
+                        zipios::ZipFile::stream_pointer_t is(zf.getInputStream(name));
+                        std::vector<char> buffer(64 * 1024);
+                        is->read(buffer.data(), buffer.size());
+                        read_total += is->gcount();
+                    }
+                }
+                return read_total;
+            };
+
+        size_t uncached_total(0);
+        double const uncached_ms(duration_ms([&]()
+            {
+                uncached_total = read_all();
+            }));
+
+        zf.setCacheBudget(total);
+        size_t cached_total(0);
+        double const cached_ms(duration_ms([&]()
+            {
+                cached_total = read_all();
+            }));
+
+        CATCH_REQUIRE(uncached_total == total * repeat);
+        CATCH_REQUIRE(cached_total == total * repeat);
+
+        zipios::ZipFile::cache_statistics_t const statistics(zf.getCacheStatistics());
+        std::cout << count * repeat << " reads of " << count << " hot entries: without cache "
+                  << uncached_ms << "ms, with cache "
+                  << cached_ms << "ms ("
+                  << uncached_ms / cached_ms << "x, "
+                  << statistics.m_hits << " hits, "
+                  << statistics.m_misses << " misses)" << std::endl;
+    }
+    CATCH_END_SECTION()
+}
+
+
+
+
+CATCH_TEST_CASE("benchmark_io_policy", "[benchmark][.]")
+{
+    CATCH_START_SECTION("scan an archive with each I/O policy")
+    {
+        std::string const top_dir(SNAP_CATCH2_NAMESPACE::g_tmp_dir() + "/benchmark-io-policy");
+        zipios_test::auto_unlink_t auto_unlink(top_dir, true);
+        CATCH_REQUIRE(system(("mkdir -p " + top_dir + "/test_dir").c_str()) == 0);
+        zipios_test::safe_chdir cwd(top_dir);
+
+        // 256 STORED files of 1 MiB
+        //
+        size_t const count(256);
+        for(size_t i(0); i < count; ++i)
+        {
+            std::ofstream out("test_dir/file" + std::to_string(i) + ".bin", std::ios::out | std::ios::binary);
+            std::string data(1024 * 1024, '\0');
+            for(auto & c : data)
+            {
+                c = static_cast<char>(rand());
+            }
+            out << data;
+        }
+        {
+            zipios::DirectoryCollection dc("test_dir");
+            dc.setMethod(0, zipios::StorageMethod::STORED, zipios::StorageMethod::STORED);
+            std::ofstream out("test.zip", std::ios::out | std::ios::binary | std::ios::trunc);
+            zipios::ZipFile::saveCollectionToArchive(out, dc);
+        }
+
+        struct policy_t
+        {
+            char const *                    m_name;
+            zipios::ZipFile::AccessMode     m_access_mode;
+            zipios::ZipFile::io_policy_t    m_policy;
+        };
+        std::vector<policy_t> policies;
+        for(auto const access_mode : { zipios::ZipFile::AccessMode::STREAM, zipios::ZipFile::AccessMode::MEMORY_MAP })
+        {
+            zipios::ZipFile::io_policy_t policy;
+            policies.push_back({ "default", access_mode, policy });
+            policy.m_access_pattern = zipios::ZipFile::AccessPattern::SEQUENTIAL;
+            policy.m_readahead_entries = 8;
+            policies.push_back({ "sequential + readahead", access_mode, policy });
+            policy.m_drop_after_read = true;
+            policies.push_back({ "sequential + readahead + drop", access_mode, policy });
+            if(access_mode == zipios::ZipFile::AccessMode::STREAM)
+            {
+                policy = zipios::ZipFile::io_policy_t();
+                policy.m_direct_io = true;
+                policies.push_back({ "direct", access_mode, policy });
+            }
+        }
+
+        for(auto const & p : policies)
+        {
+            // start with a cold cache
+            //
+            {
+                zipios::SharedFile file("test.zip");
+                file.advise(0, file.size(), zipios::IOAdvice::DONTNEED);
+            }
+
+            size_t total(0);
+            bool direct_io(false);
+            double const ms(duration_ms([&]()
+                {
+                    zipios::ZipFile zf("test.zip", 0, 0, p.m_access_mode, zipios::ZipFile::VerificationMode::NONE);
+                    zf.setIOPolicy(p.m_policy);
+                    direct_io = zf.getIOPolicy().m_direct_io;
+                    std::vector<char> buffer(1024 * 1024);
+                    for(auto const & entry : zf)
+                    {
+                        if(!entry->isDirectory())
+                        {
+                            total += zf.readEntry(entry->getName(), buffer.data(), buffer.size());
+                        }
+                    }
+                }));
+            CATCH_REQUIRE(total == count * 1024 * 1024);
+
+            std::cout << (p.m_access_mode == zipios::ZipFile::AccessMode::STREAM ? "stream" : "mmap")
+                      << ", " << p.m_name
+                      << (p.m_policy.m_direct_io && !direct_io ? " (not supported)" : "")
+                      << ": " << ms << "ms, "
+                      << resident_bytes("test.zip") / (1024 * 1024) << " MiB left in the page cache" << std::endl;
+        }
+    }
+    CATCH_END_SECTION()
+}
+
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
@@ -28,11 +28,14 @@
 
 #include <zipios/collectioncollection.hpp>
 #include <zipios/directorycollection.hpp>
+#include <zipios/zipfile.hpp>
 #include <zipios/zipiosexceptions.hpp>
 
+#include <algorithm>
 #include <fstream>
 
 #include <string.h>
+#include <unistd.h>
 
 
 
@@ -922,6 +925,169 @@ CATCH_SCENARIO("CollectionCollection with various tests", "[DirectoryCollection]
 }
 
 
+CATCH_TEST_CASE("CollectionCollection overlay of archives", "[CollectionCollection][FileCollection]")
+{
+    std::string const top_dir(SNAP_CATCH2_NAMESPACE::g_tmp_dir() + "/overlay");
+    zipios_test::auto_unlink_t auto_unlink(top_dir, true);
+    CATCH_REQUIRE(system(("mkdir -p " + top_dir + "/base/data/sub " + top_dir + "/patch/data").c_str()) == 0);
+    zipios_test::safe_chdir cwd(top_dir);
+
+    // the patch shadows "data/shared.txt" and adds "data/patch.txt"
+    //
+    char const * const base_files[] =
+    {
+        "base/data/shared.txt",
+        "base/data/base.txt",
+        "base/data/sub/deep.txt",
+    };
+    for(auto const & n : base_files)
+    {
+        std::ofstream file(n, std::ios::out | std::ios::binary);
+        file << "base " << n << "\n";
+    }
+    char const * const patch_files[] =
+    {
+        "patch/data/shared.txt",
+        "patch/data/patch.txt",
+    };
+    for(auto const & n : patch_files)
+    {
+        std::ofstream file(n, std::ios::out | std::ios::binary);
+        file << "patch " << n << "\n";
+    }
+
+    for(auto const & name : { "base", "patch" })
+    {
+        zipios_test::safe_chdir sub(name);
+        zipios::DirectoryCollection dc("data");
+        std::ofstream out("../" + std::string(name) + ".zip", std::ios::out | std::ios::binary | std::ios::trunc);
+        zipios::ZipFile::saveCollectionToArchive(out, dc);
+    }
+
+    auto read_all = [](zipios::FileCollection::stream_pointer_t is)
+        {
+            CATCH_REQUIRE(is != nullptr);
+            return std::string((std::istreambuf_iterator<char>(*is)), std::istreambuf_iterator<char>());
+        };
+
+    zipios::CollectionCollection cc;
+    CATCH_REQUIRE(cc.addCollection(zipios::ZipFile("patch.zip")));
+    CATCH_REQUIRE(cc.addCollection(zipios::ZipFile("base.zip")));
+
+    CATCH_START_SECTION("the first collection wins")
+    {
+        CATCH_REQUIRE(read_all(cc.getInputStream("data/shared.txt")) == "patch patch/data/shared.txt\n");
+        CATCH_REQUIRE(read_all(cc.getInputStream("data/patch.txt")) == "patch patch/data/patch.txt\n");
+        CATCH_REQUIRE(read_all(cc.getInputStream("data/base.txt")) == "base base/data/base.txt\n");
+        CATCH_REQUIRE(read_all(cc.getInputStream("data/sub/deep.txt")) == "base base/data/sub/deep.txt\n");
+        CATCH_REQUIRE(cc.getInputStream("data/missing.txt") == nullptr);
+
+        zipios::FileEntry::pointer_t entry(cc.getEntry("data/shared.txt"));
+        CATCH_REQUIRE(entry != nullptr);
+        CATCH_REQUIRE(entry->getSize() == strlen("patch patch/data/shared.txt\n"));
+        CATCH_REQUIRE(cc.findEntry(std::string_view("data/base.txt")) == cc.getEntry("data/base.txt"));
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("basename matches open the resolved entry")
+    {
+        CATCH_REQUIRE(read_all(cc.getInputStream("shared.txt", zipios::FileCollection::MatchPath::IGNORE)) == "patch patch/data/shared.txt\n");
+        CATCH_REQUIRE(read_all(cc.getInputStream("deep.txt", zipios::FileCollection::MatchPath::IGNORE)) == "base base/data/sub/deep.txt\n");
+        CATCH_REQUIRE(cc.getInputStream("deep.txt") == nullptr);
+        CATCH_REQUIRE(cc.getEntry("base.txt", zipios::FileCollection::MatchPath::IGNORE)->getName() == "data/base.txt");
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("nested and copied collections keep the same overlay")
+    {
+        zipios::CollectionCollection outer;
+        CATCH_REQUIRE(outer.addCollection(cc));
+        CATCH_REQUIRE(outer.addCollection(zipios::ZipFile("base.zip")));
+        CATCH_REQUIRE(read_all(outer.getInputStream("data/shared.txt")) == "patch patch/data/shared.txt\n");
+        CATCH_REQUIRE(read_all(outer.getInputStream("deep.txt", zipios::FileCollection::MatchPath::IGNORE)) == "base base/data/sub/deep.txt\n");
+
+        zipios::CollectionCollection copy(outer);
+        CATCH_REQUIRE(read_all(copy.getInputStream("data/patch.txt")) == "patch patch/data/patch.txt\n");
+
+        zipios::CollectionCollection assigned;
+        assigned = copy;
+        CATCH_REQUIRE(read_all(assigned.getInputStream("data/shared.txt")) == "patch patch/data/shared.txt\n");
+
+        outer.close();
+        CATCH_REQUIRE_THROWS_AS(outer.getInputStream("data/shared.txt"), zipios::InvalidStateException);
+        CATCH_REQUIRE(read_all(copy.getInputStream("data/shared.txt")) == "patch patch/data/shared.txt\n");
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("the index gets built on the first lookup")
+    {
+        zipios::CollectionCollection lazy;
+        CATCH_REQUIRE(lazy.addCollection(zipios::DirectoryCollection("base")));
+
+        // the directory is not read by addCollection()
+        //
+        {
+            std::ofstream file("base/data/late.txt", std::ios::out | std::ios::binary);
+            file << "late\n";
+        }
+        CATCH_REQUIRE(read_all(lazy.getInputStream("base/data/late.txt")) == "late\n");
+
+        // the index is a snapshot of the entries found on that lookup
+        //
+        {
+            std::ofstream file("base/data/later.txt", std::ios::out | std::ios::binary);
+            file << "later\n";
+        }
+        CATCH_REQUIRE(lazy.getEntry("base/data/later.txt") == nullptr);
+
+        // adding a collection rebuilds the index
+        //
+        CATCH_REQUIRE(lazy.addCollection(zipios::ZipFile("patch.zip")));
+        CATCH_REQUIRE(read_all(lazy.getInputStream("data/patch.txt")) == "patch patch/data/patch.txt\n");
+        CATCH_REQUIRE(read_all(lazy.getInputStream("late.txt", zipios::FileCollection::MatchPath::IGNORE)) == "late\n");
+        CATCH_REQUIRE(lazy.size() == 7 + 3);
+
+        unlink("base/data/late.txt");
+        unlink("base/data/later.txt");
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("walk the entries without a copy")
+    {
+        zipios::FileEntry::vector_t const v(cc.entries());
+        CATCH_REQUIRE(v.size() == cc.size());
+        CATCH_REQUIRE(static_cast<size_t>(std::distance(cc.begin(), cc.end())) == v.size());
+        CATCH_REQUIRE(std::equal(cc.begin(), cc.end(), v.begin()));
+
+        // the patch entries come first, shadowed entries included
+        //
+        zipios::ZipFile patch("patch.zip");
+        CATCH_REQUIRE(std::equal(patch.begin(), patch.end(), cc.begin()
+                    , [](zipios::FileEntry::pointer_t a, zipios::FileEntry::pointer_t b)
+                        {
+                            return a->isEqual(*b);
+                        }));
+
+        // a DirectoryCollection loads its entries on the first walk
+        //
+        zipios_test::safe_chdir sub("base");
+        zipios::DirectoryCollection dc("data");
+        size_t count(0);
+        for(auto const & entry : dc)
+        {
+            CATCH_REQUIRE(entry->getName().substr(0, 4) == "data");
+            ++count;
+        }
+        CATCH_REQUIRE(count == 5);
+        CATCH_REQUIRE(dc.size() == 5);
+
+        cc.close();
+        CATCH_REQUIRE_THROWS_AS(cc.begin(), zipios::InvalidStateException);
+    }
+    CATCH_END_SECTION()
+}
+
+
 // Local Variables:
 // mode: cpp
 // indent-tabs-mode: nil
@@ -0,0 +1,484 @@
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (c) 2015-2022  Made to Order Software Corp.  All Rights Reserved
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ *
+ * Zipios unit tests for the compression engine selection.
+ */
+
+#include "catch_main.hpp"
+
+#include <zipios/compressionengine.hpp>
+#include <zipios/directorycollection.hpp>
+#include <zipios/zipfile.hpp>
+#include <zipios/zipiosexceptions.hpp>
+
+#include <src/compressionbackend.hpp>
+#include <src/deflateoutputstreambuf.hpp>
+#include <src/zipcentraldirectoryentry.hpp>
+#include <src/zipoutputstream.hpp>
+#include <src/zipoutputstreambuf.hpp>
+
+#include <fstream>
+#include <map>
+#include <sstream>
+
+
+namespace
+{
+
+
+zipios::CompressionEngine const g_engines[] =
+{
+    zipios::CompressionEngine::ZLIB,
+};
+
+
+/** \brief Restore the default engine on exit.
+ *
+ * The compression engine is a global setting, make sure that a test
+ * failing does not leave another engine in place for the other tests.
+ */
+class engine_restore_t
+{
+public:
+    engine_restore_t()
+        : m_engine(zipios::getCompressionEngine())
+    {
+    }
+
+    ~engine_restore_t()
+    {
+        zipios::setCompressionEngine(m_engine);
+    }
+
+private:
+    zipios::CompressionEngine   m_engine;
+};
+
+
+} // no name namespace
+
+
+CATCH_TEST_CASE("Compression engine selection", "[compression]")
+{
+    CATCH_START_SECTION("zlib is always available and is the default")
+    {
+        CATCH_REQUIRE(zipios::isCompressionEngineAvailable(zipios::CompressionEngine::ZLIB));
+        CATCH_REQUIRE(zipios::isCompressionEngineAvailable(zipios::getCompressionEngine()));
+        CATCH_REQUIRE(zipios::getCompressionEngine() == zipios::CompressionEngine::ZLIB);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("engine names")
+    {
+        CATCH_REQUIRE(std::string(zipios::getCompressionEngineName(zipios::CompressionEngine::ZLIB)) == "zlib");
+        CATCH_REQUIRE(std::string(zipios::getCompressionEngineName(static_cast<zipios::CompressionEngine>(100))) == "unknown");
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("unavailable engines cannot be selected")
+    {
+        engine_restore_t restore;
+        for(auto const engine : g_engines)
+        {
+            if(zipios::isCompressionEngineAvailable(engine))
+            {
+                zipios::setCompressionEngine(engine);
+                CATCH_REQUIRE(zipios::getCompressionEngine() == engine);
+            }
+            else
+            {
+                zipios::CompressionEngine const current(zipios::getCompressionEngine());
+                CATCH_REQUIRE_THROWS_AS(zipios::setCompressionEngine(engine), zipios::InvalidException);
+                CATCH_REQUIRE(zipios::getCompressionEngine() == current);
+            }
+        }
+
+        zipios::CompressionEngine const current(zipios::getCompressionEngine());
+        CATCH_REQUIRE_FALSE(zipios::isCompressionEngineAvailable(static_cast<zipios::CompressionEngine>(100)));
+        CATCH_REQUIRE_THROWS_AS(zipios::setCompressionEngine(static_cast<zipios::CompressionEngine>(100)), zipios::InvalidException);
+        CATCH_REQUIRE(zipios::getCompressionEngine() == current);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("inflate a buffer")
+    {
+        std::vector<char> data(100 * 1024);
+        for(auto & c : data)
+        {
+            c = static_cast<char>(rand() % 10 + '0');
+        }
+
+        for(auto const engine : g_engines)
+        {
+            if(!zipios::isCompressionEngineAvailable(engine))
+            {
+                continue;
+            }
+
+            zipios::DeflateBackend::pointer_t deflate(zipios::DeflateBackend::create(6, engine));
+            std::vector<char> compressed(data.size() * 2);
+            deflate->setInput(data.data(), data.size());
+            size_t compressed_size(compressed.size());
+            CATCH_REQUIRE(deflate->deflate(compressed.data(), compressed_size, true) == zipios::DeflateBackend::status_t::STREAM_END);
+            CATCH_REQUIRE(compressed_size < data.size());
+
+            // decompress with each engine
+            //
+            for(auto const other : g_engines)
+            {
+                if(!zipios::isCompressionEngineAvailable(other))
+                {
+                    continue;
+                }
+
+                std::vector<char> output(data.size());
+                CATCH_REQUIRE(zipios::inflateBuffer(compressed.data(), compressed_size, output.data(), output.size(), other));
+                CATCH_REQUIRE(output == data);
+
+                // wrong output size and invalid data fail
+                //
+                CATCH_REQUIRE_FALSE(zipios::inflateBuffer(compressed.data(), compressed_size, output.data(), output.size() - 1, other));
+                std::vector<char> garbage(compressed.begin(), compressed.begin() + compressed_size);
+                garbage[0] = static_cast<char>(0xFF);
+                CATCH_REQUIRE_FALSE(zipios::inflateBuffer(garbage.data(), garbage.size(), output.data(), output.size(), other));
+
+                // streaming in small blocks
+                //
+                zipios::InflateBackend::pointer_t inflate(zipios::InflateBackend::create(other));
+                inflate->reset();
+                std::vector<char> streamed;
+                size_t in_pos(0);
+                zipios::InflateBackend::status_t status(zipios::InflateBackend::status_t::OK);
+                while(status == zipios::InflateBackend::status_t::OK)
+                {
+                    if(inflate->getAvailableInput() == 0 && in_pos < compressed_size)
+                    {
+                        size_t const in_size(std::min(static_cast<size_t>(1000), compressed_size - in_pos));
+                        inflate->setInput(compressed.data() + in_pos, in_size);
+                        in_pos += in_size;
+                    }
+                    char buffer[777];
+                    size_t size(sizeof(buffer));
+                    status = inflate->inflate(buffer, size, in_pos == compressed_size
+                                    ? zipios::InflateBackend::flush_t::FINISH
+                                    : zipios::InflateBackend::flush_t::NO_FLUSH);
+                    streamed.insert(streamed.end(), buffer, buffer + size);
+
+                    // with FINISH, a full output buffer is a BUFFER_ERROR
+                    //
+                    if(status == zipios::InflateBackend::status_t::BUFFER_ERROR
+                    && size == sizeof(buffer))
+                    {
+                        status = zipios::InflateBackend::status_t::OK;
+                    }
+                }
+                CATCH_REQUIRE(status == zipios::InflateBackend::status_t::STREAM_END);
+                CATCH_REQUIRE(streamed == data);
+            }
+        }
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("Compression engines read and write archives", "[compression][ZipFile]")
+{
+    std::string const top_dir(SNAP_CATCH2_NAMESPACE::g_tmp_dir() + "/compression-engine");
+    zipios_test::auto_unlink_t auto_unlink(top_dir, true);
+    CATCH_REQUIRE(system(("mkdir -p " + top_dir + "/test_dir").c_str()) == 0);
+    zipios_test::safe_chdir cwd(top_dir);
+
+    std::map<std::string, std::string> contents;
+    for(int i(1); i <= 5; ++i)
+    {
+        std::string const name("test_dir/file" + std::to_string(i) + ".txt");
+        std::string data;
+        size_t const size(rand() % (200 * 1024) + 3000);
+        for(size_t pos(0); pos < size; ++pos)
+        {
+            data += static_cast<char>(rand() % 26 + 'a');
+        }
+        std::ofstream out(name, std::ios::out | std::ios::binary);
+        out << data;
+        contents[name] = data;
+    }
+
+    engine_restore_t restore;
+    for(auto const engine : g_engines)
+    {
+        if(!zipios::isCompressionEngineAvailable(engine))
+        {
+            continue;
+        }
+        zipios::setCompressionEngine(engine);
+
+        {
+            zipios::DirectoryCollection dc("test_dir");
+            dc.setMethod(2000, zipios::StorageMethod::STORED, zipios::StorageMethod::DEFLATED);
+            std::ofstream out("test.zip", std::ios::out | std::ios::binary | std::ios::trunc);
+            zipios::ZipFile::saveCollectionToArchive(out, dc);
+        }
+
+        // read back with every engine
+        //
+        for(auto const other : g_engines)
+        {
+            if(!zipios::isCompressionEngineAvailable(other))
+            {
+                continue;
+            }
+            zipios::setCompressionEngine(other);
+
+            zipios::ZipFile zf("test.zip");
+            zf.setVerifyCrc(true);
+            zf.setCheckpointInterval(16 * 1024);
+            for(auto const & c : contents)
+            {
+                zipios::FileEntry::pointer_t entry(zf.getEntry(c.first));
+                CATCH_REQUIRE(entry != nullptr);
+                CATCH_REQUIRE(entry->getMethod() == zipios::StorageMethod::DEFLATED);
+
+                std::vector<char> const data(zf.readEntry(c.first));
+                CATCH_REQUIRE(std::string(data.begin(), data.end()) == c.second);
+
+                zipios::FileCollection::stream_pointer_t is(zf.getInputStream(c.first));
+                CATCH_REQUIRE(is != nullptr);
+                std::string const streamed((std::istreambuf_iterator<char>(*is)), std::istreambuf_iterator<char>());
+                CATCH_REQUIRE(streamed == c.second);
+
+                // seek backward
+                //
+                is->clear();
+                std::streamoff const position(c.second.length() / 3);
+                is->seekg(position, std::ios::beg);
+                char buf[100];
+                is->read(buf, sizeof(buf));
+                CATCH_REQUIRE(is->gcount() == static_cast<std::streamsize>(sizeof(buf)));
+                CATCH_REQUIRE(std::string(buf, sizeof(buf)) == c.second.substr(position, sizeof(buf)));
+            }
+        }
+        zipios::setCompressionEngine(engine);
+    }
+}
+
+
+CATCH_TEST_CASE("Large entries compressed by several threads", "[compression][ZipFile][thread]")
+{
+    std::string const top_dir(SNAP_CATCH2_NAMESPACE::g_tmp_dir() + "/block-deflate");
+    zipios_test::auto_unlink_t auto_unlink(top_dir, true);
+    CATCH_REQUIRE(system(("mkdir -p " + top_dir + "/test_dir").c_str()) == 0);
+    zipios_test::safe_chdir cwd(top_dir);
+
+    // the sizes around 128 KiB hit the limits of the blocks
+    //
+    std::vector<std::string> const words{ "alpha", "beta", "gamma", "delta", "epsilon", "zeta", "eta", "theta" };
+    std::map<std::string, std::string> contents;
+    size_t const sizes[] = { 0, 100, 128 * 1024, 128 * 1024 + 1, 2 * 1024 * 1024 + static_cast<size_t>(rand() % (1024 * 1024)) };
+    for(size_t const size : sizes)
+    {
+        std::string const name("test_dir/file" + std::to_string(size) + ".txt");
+        std::string data;
+        while(data.length() < size)
+        {
+            data += words[rand() % words.size()] + ' ' + std::to_string(rand() % 100) + '\n';
+        }
+        data.resize(size);
+        std::ofstream out(name, std::ios::out | std::ios::binary);
+        out << data;
+        contents[name] = data;
+    }
+
+    auto save = [&contents](size_t thread_count)
+        {
+            std::ostringstream out;
+            {
+                zipios::ZipOutputStream os(out);
+                os.setThreadCount(thread_count);
+                for(auto const & c : contents)
+                {
+                    zipios::FileEntry::pointer_t entry(std::make_shared<zipios::DirectoryEntry>(zipios::FilePath(c.first)));
+                    entry->setMethod(zipios::StorageMethod::DEFLATED);
+                    entry->setLevel(zipios::FileEntry::COMPRESSION_LEVEL_DEFAULT);
+                    os.putNextEntry(entry);
+                    os << c.second;
+                }
+                os.close();
+            }
+            return out.str();
+        };
+
+    engine_restore_t restore;
+    for(auto const engine : g_engines)
+    {
+        if(!zipios::isCompressionEngineAvailable(engine))
+        {
+            continue;
+        }
+        zipios::setCompressionEngine(engine);
+
+        std::string const serial(save(1));
+        std::string const parallel(save(4));
+
+        // the blocks do not depend on the number of threads
+        //
+        CATCH_REQUIRE(save(2) == parallel);
+        CATCH_REQUIRE(save(8) == parallel);
+
+        // each block loses a few bytes only thanks to its dictionary
+        //
+        CATCH_REQUIRE(parallel.length() < serial.length() + serial.length() / 50);
+
+        {
+            std::ofstream out("test.zip", std::ios::out | std::ios::binary | std::ios::trunc);
+            out << parallel;
+        }
+        zipios::ZipFile zf("test.zip");
+        zf.setVerifyCrc(true);
+        for(auto const & c : contents)
+        {
+            zipios::FileEntry::pointer_t entry(zf.getEntry(c.first));
+            CATCH_REQUIRE(entry != nullptr);
+            CATCH_REQUIRE(entry->getMethod() == zipios::StorageMethod::DEFLATED);
+            CATCH_REQUIRE(entry->getSize() == c.second.length());
+
+            std::vector<char> const data(zf.readEntry(c.first));
+            CATCH_REQUIRE(std::string(data.begin(), data.end()) == c.second);
+
+            zipios::FileCollection::stream_pointer_t is(zf.getInputStream(c.first));
+            CATCH_REQUIRE(is != nullptr);
+            std::string const streamed((std::istreambuf_iterator<char>(*is)), std::istreambuf_iterator<char>());
+            CATCH_REQUIRE(streamed == c.second);
+        }
+
+        // entries which fit in one block are compressed as usual
+        //
+        {
+            std::ofstream out("serial.zip", std::ios::out | std::ios::binary | std::ios::trunc);
+            out << serial;
+        }
+        zipios::ZipFile serial_zf("serial.zip");
+        for(auto const & c : contents)
+        {
+            if(c.second.length() < 128 * 1024)
+            {
+                CATCH_REQUIRE(serial_zf.getEntry(c.first)->getCompressedSize() == zf.getEntry(c.first)->getCompressedSize());
+            }
+        }
+    }
+}
+
+
+CATCH_TEST_CASE("Errors while compressing a large entry", "[compression][thread]")
+{
+    // an output which refuses all the data
+    //
+    class failing_streambuf_t
+        : public std::streambuf
+    {
+    protected:
+        virtual int_type overflow(int_type) override
+        {
+            return traits_type::eof();
+        }
+
+        virtual std::streamsize xsputn(char const *, std::streamsize) override
+        {
+            return 0;
+        }
+    };
+
+    // a ZipOutputStreambuf which can pretend it was sent a lot of data
+    //
+    class large_entry_streambuf_t
+        : public zipios::ZipOutputStreambuf
+    {
+    public:
+        large_entry_streambuf_t(std::streambuf * outbuf)
+            : ZipOutputStreambuf(outbuf)
+        {
+        }
+
+        void skip(size_t size)
+        {
+            m_overflown_bytes += size;
+        }
+    };
+
+    std::string data;
+    while(data.length() < 1024 * 1024)
+    {
+        data += std::to_string(rand()) + '\n';
+    }
+
+    CATCH_START_SECTION("a failed write still closes the stream")
+    {
+        failing_streambuf_t failing;
+        zipios::DeflateOutputStreambuf buf(&failing);
+        buf.setThreadCount(2);
+        CATCH_REQUIRE(buf.init(zipios::FileEntry::COMPRESSION_LEVEL_DEFAULT));
+        CATCH_REQUIRE_THROWS_AS([&]()
+            {
+                buf.sputn(data.data(), data.length());
+                buf.closeStream();
+            }(), zipios::IOException);
+
+        // the first closeStream() may report the error again, after
+        // that the stream is closed and the destructor has nothing to do
+        //
+        try
+        {
+            buf.closeStream();
+        }
+        catch(zipios::IOException const &)
+        {
+        }
+        CATCH_REQUIRE_NOTHROW(buf.closeStream());
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("an entry cannot reach 4 GiB")
+    {
+        for(auto const method : { zipios::StorageMethod::STORED, zipios::StorageMethod::DEFLATED })
+        {
+            std::stringbuf out;
+            large_entry_streambuf_t buf(&out);
+            zipios::FileEntry::pointer_t entry(std::make_shared<zipios::ZipCentralDirectoryEntry>());
+            entry->setMethod(method);
+            entry->setUnixTime(time(nullptr));
+            buf.putNextEntry(entry);
+
+            buf.skip(0xFFFFFFFFUL - data.length() / 2);
+            CATCH_REQUIRE_THROWS_AS(buf.sputn(data.data(), data.length()), zipios::IOException);
+        }
+    }
+    CATCH_END_SECTION()
+}
+
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
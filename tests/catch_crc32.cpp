@@ -0,0 +1,170 @@
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2000-2007  Thomas Sondergaard
+  Copyright (c) 2015-2022  Made to Order Software Corp.  All Rights Reserved
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ *
+ * Zipios unit tests for the CRC-32 functions.
+ */
+
+#include "catch_main.hpp"
+
+#include <src/crc32.hpp>
+#include <zipios/zipiosexceptions.hpp>
+
+#include <fstream>
+
+#include <zlib.h>
+
+
+namespace
+{
+
+
+std::vector<unsigned char> random_buffer(size_t size)
+{
+    std::vector<unsigned char> buffer(size);
+    for(auto & c : buffer)
+    {
+        c = static_cast<unsigned char>(rand());
+    }
+    return buffer;
+}
+
+
+uint32_t zlib_crc32(unsigned char const * buffer, size_t size)
+{
+    return crc32(crc32(0L, Z_NULL, 0), buffer, size);
+}
+
+
+} // no name namespace
+
+
+CATCH_TEST_CASE("CRC-32 of buffers", "[crc32]")
+{
+    CATCH_START_SECTION("empty buffer")
+    {
+        CATCH_REQUIRE(zipios::crc32Update(0, nullptr, 0) == 0);
+        CATCH_REQUIRE(zipios::crc32Update(0x12345678, nullptr, 0) == 0x12345678);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("well known value")
+    {
+        char const * check("123456789");
+        CATCH_REQUIRE(zipios::crc32Update(0, check, 9) == 0xCBF43926);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("all sizes and alignments match zlib")
+    {
+        std::vector<unsigned char> const buffer(random_buffer(1024 + 16));
+        for(size_t offset(0); offset < 16; ++offset)
+        {
+            for(size_t size(0); size <= 1024; ++size)
+            {
+                CATCH_REQUIRE(zipios::crc32Update(0, buffer.data() + offset, size) == zlib_crc32(buffer.data() + offset, size));
+            }
+        }
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("incremental updates match one update")
+    {
+        std::vector<unsigned char> const buffer(random_buffer(100 * 1024 + rand() % 1024));
+        uint32_t const expected(zlib_crc32(buffer.data(), buffer.size()));
+
+        uint32_t crc(0);
+        size_t pos(0);
+        while(pos < buffer.size())
+        {
+            size_t const size(std::min(static_cast<size_t>(rand() % 300), buffer.size() - pos));
+            crc = zipios::crc32Update(crc, buffer.data() + pos, size);
+            pos += size;
+        }
+        CATCH_REQUIRE(crc == expected);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("engine name")
+    {
+        std::string const engine(zipios::crc32Engine());
+        CATCH_REQUIRE((engine == "pclmul" || engine == "slice-by-16"));
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("CRC-32 computed by several threads", "[crc32][thread]")
+{
+    std::vector<unsigned char> const buffer(random_buffer(19 * 1024 * 1024 + rand() % 1024));
+    uint32_t const expected(zlib_crc32(buffer.data(), buffer.size()));
+
+    CATCH_START_SECTION("buffer")
+    {
+        for(size_t thread_count(1); thread_count <= 5; ++thread_count)
+        {
+            CATCH_REQUIRE(zipios::crc32Parallel(buffer.data(), buffer.size(), thread_count) == expected);
+        }
+        CATCH_REQUIRE(zipios::crc32Parallel(buffer.data(), buffer.size()) == expected);
+        CATCH_REQUIRE(zipios::crc32Parallel(buffer.data(), 0, 4) == 0);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("file")
+    {
+        zipios_test::safe_chdir cwd(SNAP_CATCH2_NAMESPACE::g_tmp_dir());
+        zipios_test::auto_unlink_t auto_unlink("crc32.bin", true);
+        {
+            std::ofstream out("crc32.bin", std::ios::out | std::ios::binary);
+            out.write(reinterpret_cast<char const *>(buffer.data()), buffer.size());
+        }
+        for(size_t thread_count(0); thread_count <= 5; ++thread_count)
+        {
+            CATCH_REQUIRE(zipios::crc32File("crc32.bin", thread_count) == expected);
+        }
+        CATCH_REQUIRE(zipios::crc32File("crc32.bin") == expected);
+
+        {
+            std::ofstream out("crc32.bin", std::ios::out | std::ios::binary | std::ios::trunc);
+        }
+        CATCH_REQUIRE(zipios::crc32File("crc32.bin") == 0);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("missing file")
+    {
+        zipios_test::safe_chdir cwd(SNAP_CATCH2_NAMESPACE::g_tmp_dir());
+        CATCH_REQUIRE_THROWS_AS(zipios::crc32File("this-file-does-not-exist.bin"), zipios::IOException);
+    }
+    CATCH_END_SECTION()
+}
+
+
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
@@ -27,13 +27,23 @@
 #include "catch_main.hpp"
 
 #include <zipios/zipfile.hpp>
+#include <zipios/collectioncollection.hpp>
 #include <zipios/directorycollection.hpp>
 #include <zipios/zipiosexceptions.hpp>
 #include <zipios/dosdatetime.hpp>
 
+#include <src/inflatepool.hpp>
+#include <src/sharedfile.hpp>
+#include <src/zipinputstream.hpp>
+
 #include <algorithm>
+#include <atomic>
 #include <fstream>
+#include <map>
+#include <thread>
 
+#include <dirent.h>
+#include <sys/stat.h>
 #include <unistd.h>
 #include <string.h>
 #include <zlib.h>
@@ -1450,7 +1460,7 @@ CATCH_TEST_CASE("Valid and Invalid ZipFile Archives", "[ZipFile][FileCollection]
     }
     CATCH_END_SECTION()
 
-    CATCH_START_SECTION("create files with a trailing data descriptor")
+    CATCH_START_SECTION("create files with a missing trailing data descriptor")
     {
         for(int i(0); i < 10; ++i)
         {
@@ -1465,7 +1475,7 @@ CATCH_TEST_CASE("Valid and Invalid ZipFile Archives", "[ZipFile][FileCollection]
                 end_of_central_directory_t eocd;
 
                 // use a valid compression method
-                lh.m_flags |= 1 << 3;  // <-- testing that trailing data is not supported!
+                lh.m_flags |= 1 << 3;  // <-- the trailing data descriptor is missing
                 lh.m_compression_method = static_cast<uint16_t>(g_supported_storage_methods[rand() % (sizeof(g_supported_storage_methods) / sizeof(g_supported_storage_methods[0]))]);
                 lh.m_filename = "invalid";
                 lh.write(os);
@@ -1484,7 +1494,10 @@ CATCH_TEST_CASE("Valid and Invalid ZipFile Archives", "[ZipFile][FileCollection]
             }
 
             zipios::ZipFile zf("file.zip");
-            CATCH_REQUIRE_THROWS_AS(zf.getInputStream("invalid"), zipios::FileCollectionException);
+            zipios::ZipFile::stream_pointer_t is(zf.getInputStream("invalid"));
+            char c;
+            CATCH_REQUIRE_FALSE(is->get(c));
+            CATCH_REQUIRE(is->bad());
         }
     }
     CATCH_END_SECTION()
@@ -1742,14 +1755,112 @@ CATCH_TEST_CASE("saveCollectionToArchive_with_DirectoryCollection", "[ZipFile][D
 }
 
 
+CATCH_TEST_CASE("saveCollectionToArchive with several threads", "[ZipFile][DirectoryCollection][thread]")
+{
+    std::string const top_dir(SNAP_CATCH2_NAMESPACE::g_tmp_dir() + "/save-collection-threads");
+    zipios_test::auto_unlink_t auto_unlink(top_dir, true);
+    CATCH_REQUIRE(system(("mkdir -p " + top_dir + "/test_dir/sub/deeper " + top_dir + "/test_dir/empty").c_str()) == 0);
+    zipios_test::safe_chdir cwd(top_dir);
+
+    // small and large files, text and binary; the large binary files
+    // do not compress so their data goes to temporary files
+    //
+    std::map<std::string, std::string> expected;
+    for(int i(1); i <= 40; ++i)
+    {
+        std::string name("test_dir/");
+        switch(i % 3)
+        {
+        case 1:
+            name += "sub/";
+            break;
+
+        case 2:
+            name += "sub/deeper/";
+            break;
+
+        }
+        name += "file" + std::to_string(i) + (i % 2 == 0 ? ".txt" : ".bin");
+        std::string content;
+        if(i % 13 == 0)
+        {
+            size_t const size(1024 * 1024 + rand() % (1024 * 1024));
+            for(size_t pos(0); pos < size; ++pos)
+            {
+                content += static_cast<char>(rand());
+            }
+        }
+        else if(i % 7 != 0)
+        {
+            size_t const size(rand() % (200 * 1024));
+            while(content.length() < size)
+            {
+                content += "line " + std::to_string(rand() % 1000) + "\n";
+            }
+        }
+        std::ofstream file(name, std::ios::out | std::ios::binary);
+        file << content;
+        expected[name] = content;
+    }
+
+    auto save = [](size_t thread_count)
+        {
+            zipios::DirectoryCollection dc("test_dir");
+            dc.setMethod(1024 * 10, zipios::StorageMethod::STORED, zipios::StorageMethod::DEFLATED);
+            dc.setLevel(1024 * 100, zipios::FileEntry::COMPRESSION_LEVEL_SMALLEST, zipios::FileEntry::COMPRESSION_LEVEL_FASTEST);
+            std::ostringstream out;
+            zipios::ZipFile::saveCollectionToArchive(out, dc, "archive comment", thread_count);
+            CATCH_REQUIRE(out);
+            return out.str();
+        };
+
+    CATCH_START_SECTION("the archive is the same whatever the number of threads")
+    {
+        std::string const serial(save(1));
+        for(size_t const thread_count : { 2, 8, 0 })
+        {
+            std::string const parallel(save(thread_count));
+            CATCH_REQUIRE(parallel.length() == serial.length());
+            CATCH_REQUIRE(parallel == serial);
+        }
+
+        {
+            std::ofstream out("test.zip", std::ios::out | std::ios::binary | std::ios::trunc);
+            out << serial;
+        }
+        zipios::ZipFile zf("test.zip");
+        zf.setVerifyCrc(true);
+        for(auto const & e : expected)
+        {
+            std::vector<char> const data(zf.readEntry(e.first));
+            CATCH_REQUIRE(std::string(data.begin(), data.end()) == e.second);
+        }
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("an invalid entry fails the save and stops the threads")
+    {
+        zipios::DirectoryCollection dc("test_dir");
+        zipios::FileEntry::pointer_t entry(dc.getEntry("test_dir/sub/file19.bin"));
+        CATCH_REQUIRE(entry != nullptr);
+        zipios::FileEntry::buffer_t buffer(65 * 1024, 0x55);
+        entry->setExtra(buffer);
+
+        std::ostringstream out;
+        CATCH_REQUIRE_THROWS_AS(zipios::ZipFile::saveCollectionToArchive(out, dc, std::string(), 4), zipios::InvalidStateException);
+        CATCH_REQUIRE_FALSE(out);
+    }
+    CATCH_END_SECTION()
+}
+
+
 CATCH_TEST_CASE("test_memory_input_stream", "[ZipFile][MemoryStream]")
 {
     std::string const top_dir(SNAP_CATCH2_NAMESPACE::g_tmp_dir() + "/memory-test");
+    zipios_test::auto_unlink_t auto_unlink(top_dir, true);
     CATCH_REQUIRE(system(("mkdir -p " + top_dir).c_str()) == 0);
     zipios_test::safe_chdir cwd(top_dir);
 
-    zipios_test::auto_unlink_t auto_unlink(top_dir, true);
-
     std::stringstream ss;
     ss << "content of the file\n";
     CATCH_REQUIRE(ss.tellp() == 20);
@@ -1842,6 +1953,1909 @@ CATCH_TEST_CASE("test_memory_input_stream", "[ZipFile][MemoryStream]")
 }
 
 
+CATCH_TEST_CASE("ZipFile with a memory mapped archive", "[ZipFile][FileCollection]")
+{
+    CATCH_START_SECTION("memory mapping an inexistant file fails")
+    {
+        CATCH_REQUIRE_THROWS_AS([&](){
+                        zipios::ZipFile zf(
+                                  "this/file/does/not/exists/so/the/constructor/throws"
+                                , 0
+                                , 0
+                                , zipios::ZipFile::AccessMode::MEMORY_MAP);
+                    }(), zipios::IOException);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("memory mapped entries match streamed entries")
+    {
+        std::string const top_dir(SNAP_CATCH2_NAMESPACE::g_tmp_dir() + "/memory-map");
+        zipios_test::auto_unlink_t auto_unlink(top_dir, true);
+        CATCH_REQUIRE(system(("mkdir -p " + top_dir + "/test_dir/sub").c_str()) == 0);
+        zipios_test::safe_chdir cwd(top_dir);
+
+        for(int i(1); i <= 5; ++i)
+        {
+            std::ofstream file_bin(
+                      (i % 2 == 0 ? "test_dir/sub/file" : "test_dir/file") + std::to_string(i) + ".bin"
+                    , std::ios::out | std::ios::binary);
+            size_t const size(rand() % (64 * 1024));
+            for(size_t pos(0); pos < size; ++pos)
+            {
+                // use a small set of bytes so the data compresses
+                //
+                file_bin << static_cast<char>(rand() % 7 + 'a');
+            }
+        }
+
+        {
+            zipios::DirectoryCollection dc("test_dir");
+            dc.setMethod(1024 * 16, zipios::StorageMethod::STORED, zipios::StorageMethod::DEFLATED);
+            std::ofstream out("test.zip", std::ios::out | std::ios::binary | std::ios::trunc);
+            zipios::ZipFile::saveCollectionToArchive(out, dc);
+        }
+
+        zipios::ZipFile streamed("test.zip");
+        zipios::ZipFile::pointer_t mapped(std::make_shared<zipios::ZipFile>(
+                                              "test.zip"
+                                            , 0
+                                            , 0
+                                            , zipios::ZipFile::AccessMode::MEMORY_MAP));
+
+        CATCH_REQUIRE(mapped->isValid());
+        CATCH_REQUIRE(mapped->size() == streamed.size());
+        CATCH_REQUIRE(mapped->getName() == "test.zip");
+        CATCH_REQUIRE_FALSE(mapped->getInputStream("inexistant"));
+
+        std::vector<std::pair<zipios::FileCollection::stream_pointer_t, std::string>> streams;
+        zipios::FileEntry::vector_t v(streamed.entries());
+        for(auto const & entry : v)
+        {
+            zipios::FileEntry::pointer_t mapped_entry(mapped->getEntry(entry->getName()));
+            CATCH_REQUIRE(mapped_entry != nullptr);
+            CATCH_REQUIRE(mapped_entry->isEqual(*entry));
+            if(entry->isDirectory())
+            {
+                continue;
+            }
+
+            zipios::FileCollection::stream_pointer_t is(streamed.getInputStream(entry->getName()));
+            zipios::FileCollection::stream_pointer_t ms(mapped->getInputStream(entry->getName()));
+            CATCH_REQUIRE(is != nullptr);
+            CATCH_REQUIRE(ms != nullptr);
+
+            std::string const expected((std::istreambuf_iterator<char>(*is)), std::istreambuf_iterator<char>());
+            std::string const result((std::istreambuf_iterator<char>(*ms)), std::istreambuf_iterator<char>());
+            CATCH_REQUIRE(expected.length() == entry->getSize());
+            CATCH_REQUIRE(result == expected);
+
+            streams.push_back(std::make_pair(mapped->getInputStream(entry->getName()), expected));
+        }
+
+        // the streams keep the mapping alive after the ZipFile is gone
+        //
+        mapped.reset();
+        for(auto const & ms : streams)
+        {
+            std::string const result((std::istreambuf_iterator<char>(*ms.first)), std::istreambuf_iterator<char>());
+            CATCH_REQUIRE(result == ms.second);
+        }
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("ZipFile local header verification modes", "[ZipFile][FileCollection]")
+{
+    std::string const top_dir(SNAP_CATCH2_NAMESPACE::g_tmp_dir() + "/verification");
+    zipios_test::auto_unlink_t auto_unlink(top_dir, true);
+    CATCH_REQUIRE(system(("mkdir -p " + top_dir + "/test_dir").c_str()) == 0);
+    zipios_test::safe_chdir cwd(top_dir);
+
+    for(int i(1); i <= 3; ++i)
+    {
+        std::ofstream file_txt("test_dir/file" + std::to_string(i) + ".txt", std::ios::out | std::ios::binary);
+        file_txt << "content of file #" << i << "\n";
+    }
+
+    {
+        zipios::DirectoryCollection dc("test_dir");
+        std::ofstream out("test.zip", std::ios::out | std::ios::binary | std::ios::trunc);
+        zipios::ZipFile::saveCollectionToArchive(out, dc);
+    }
+
+    // break the filename of the local header of "file2.txt"
+    //
+    std::string broken_name;
+    {
+        zipios::ZipFile zf("test.zip");
+        zipios::FileEntry::vector_t v(zf.entries());
+        for(auto const & entry : v)
+        {
+            if(entry->getFileName() == "file2.txt")
+            {
+                broken_name = entry->getName();
+                std::fstream zip("test.zip", std::ios::in | std::ios::out | std::ios::binary);
+                std::streamoff const pos(static_cast<std::streamoff>(entry->getEntryOffset()) + 30 + static_cast<std::streamoff>(broken_name.length()) - 5);
+                zip.seekp(pos);
+                zip.put('X');
+            }
+        }
+    }
+    CATCH_REQUIRE_FALSE(broken_name.empty());
+
+    CATCH_START_SECTION("full verification fails on open")
+    {
+        CATCH_REQUIRE_THROWS_AS(zipios::ZipFile("test.zip"), zipios::FileCollectionException);
+        CATCH_REQUIRE_THROWS_AS(zipios::ZipFile(
+                                          "test.zip"
+                                        , 0
+                                        , 0
+                                        , zipios::ZipFile::AccessMode::MEMORY_MAP
+                                        , zipios::ZipFile::VerificationMode::FULL)
+                              , zipios::FileCollectionException);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("sampled verification fails on open with few entries")
+    {
+        CATCH_REQUIRE_THROWS_AS(zipios::ZipFile(
+                                          "test.zip"
+                                        , 0
+                                        , 0
+                                        , zipios::ZipFile::AccessMode::STREAM
+                                        , zipios::ZipFile::VerificationMode::SAMPLED)
+                              , zipios::FileCollectionException);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("lazy verification fails on first access")
+    {
+        for(auto access_mode : { zipios::ZipFile::AccessMode::STREAM, zipios::ZipFile::AccessMode::MEMORY_MAP })
+        {
+            zipios::ZipFile zf("test.zip", 0, 0, access_mode, zipios::ZipFile::VerificationMode::LAZY);
+            CATCH_REQUIRE(zf.isValid());
+            CATCH_REQUIRE(zf.size() == 4); // 3 files + "test_dir"
+
+            zipios::FileCollection::stream_pointer_t is(zf.getInputStream("file1.txt", zipios::FileCollection::MatchPath::IGNORE));
+            CATCH_REQUIRE(is != nullptr);
+            std::string const content((std::istreambuf_iterator<char>(*is)), std::istreambuf_iterator<char>());
+            CATCH_REQUIRE(content == "content of file #1\n");
+
+            CATCH_REQUIRE_THROWS_AS(zf.getInputStream(broken_name), zipios::FileCollectionException);
+        }
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("no verification")
+    {
+        zipios::ZipFile zf("test.zip", 0, 0, zipios::ZipFile::AccessMode::STREAM, zipios::ZipFile::VerificationMode::NONE);
+        CATCH_REQUIRE(zf.isValid());
+        CATCH_REQUIRE(zf.size() == 4); // 3 files + "test_dir"
+
+        zipios::FileCollection::stream_pointer_t is(zf.getInputStream(broken_name));
+        CATCH_REQUIRE(is != nullptr);
+        std::string const content((std::istreambuf_iterator<char>(*is)), std::istreambuf_iterator<char>());
+        CATCH_REQUIRE(content == "content of file #2\n");
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("ZipFile entry streams share the archive file", "[ZipFile][FileCollection]")
+{
+    std::string const top_dir(SNAP_CATCH2_NAMESPACE::g_tmp_dir() + "/shared-file");
+    zipios_test::auto_unlink_t auto_unlink(top_dir, true);
+    CATCH_REQUIRE(system(("mkdir -p " + top_dir + "/test_dir").c_str()) == 0);
+    zipios_test::safe_chdir cwd(top_dir);
+
+    for(int i(1); i <= 8; ++i)
+    {
+        std::ofstream file_bin("test_dir/file" + std::to_string(i) + ".bin", std::ios::out | std::ios::binary);
+        size_t const size(rand() % (40 * 1024) + 1);
+        for(size_t pos(0); pos < size; ++pos)
+        {
+            file_bin << static_cast<char>(rand() % (i * 30) + ' ');
+        }
+    }
+
+    {
+        zipios::DirectoryCollection dc("test_dir");
+        dc.setMethod(1024 * 20, zipios::StorageMethod::STORED, zipios::StorageMethod::DEFLATED);
+        std::ofstream out("test.zip", std::ios::out | std::ios::binary | std::ios::trunc);
+        zipios::ZipFile::saveCollectionToArchive(out, dc);
+    }
+
+    zipios::ZipFile zf("test.zip");
+
+    CATCH_START_SECTION("interleaved reads do not disturb each other")
+    {
+        std::vector<zipios::FileCollection::stream_pointer_t> streams;
+        std::vector<std::string> expected;
+        std::vector<std::string> result;
+        for(auto const & entry : zf)
+        {
+            if(entry->isDirectory())
+            {
+                continue;
+            }
+            std::ifstream in(entry->getName(), std::ios::in | std::ios::binary);
+            expected.push_back(std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>()));
+            streams.push_back(zf.getInputStream(entry->getName()));
+            CATCH_REQUIRE(streams.back() != nullptr);
+            result.push_back(std::string());
+        }
+        CATCH_REQUIRE(streams.size() == 8);
+
+#ifdef __linux__
+        // the entry streams did not open more file descriptors
+        //
+        auto count_fds = []()
+            {
+                size_t count(0);
+                DIR * d(opendir("/proc/self/fd"));
+                while(readdir(d) != nullptr)
+                {
+                    ++count;
+                }
+                closedir(d);
+                return count;
+            };
+        size_t const fds(count_fds());
+        streams.push_back(zf.getInputStream("test_dir/file1.bin"));
+        CATCH_REQUIRE(count_fds() == fds);
+        streams.pop_back();
+#endif
+
+        bool done(false);
+        while(!done)
+        {
+            done = true;
+            for(size_t idx(0); idx < streams.size(); ++idx)
+            {
+                char buf[333];
+                streams[idx]->read(buf, sizeof(buf));
+                if(streams[idx]->gcount() > 0)
+                {
+                    result[idx].append(buf, streams[idx]->gcount());
+                    done = false;
+                }
+            }
+        }
+        for(size_t idx(0); idx < streams.size(); ++idx)
+        {
+            CATCH_REQUIRE(result[idx] == expected[idx]);
+        }
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("the streams keep the file open after close()")
+    {
+        zipios::FileCollection::stream_pointer_t is(zf.getInputStream("test_dir/file3.bin"));
+        CATCH_REQUIRE(is != nullptr);
+        zf.close();
+
+        std::ifstream in("test_dir/file3.bin", std::ios::in | std::ios::binary);
+        std::string const expected((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        std::string const result((std::istreambuf_iterator<char>(*is)), std::istreambuf_iterator<char>());
+        CATCH_REQUIRE(result == expected);
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("Concurrent readers of one collection", "[ZipFile][FileCollection][thread]")
+{
+    std::string const top_dir(SNAP_CATCH2_NAMESPACE::g_tmp_dir() + "/concurrent-readers");
+    zipios_test::auto_unlink_t auto_unlink(top_dir, true);
+    CATCH_REQUIRE(system(("mkdir -p " + top_dir + "/test_dir/sub").c_str()) == 0);
+    zipios_test::safe_chdir cwd(top_dir);
+
+    std::map<std::string, std::string> expected;
+    for(int i(1); i <= 40; ++i)
+    {
+        std::string const name((i % 3 == 0 ? "test_dir/sub/file" : "test_dir/file") + std::to_string(i) + ".txt");
+        std::string content;
+        size_t const size(rand() % (8 * 1024));
+        for(size_t pos(0); pos < size; ++pos)
+        {
+            content += static_cast<char>(rand() % 26 + 'a');
+        }
+        std::ofstream file(name, std::ios::out | std::ios::binary);
+        file << content;
+        expected[name] = content;
+    }
+
+    {
+        zipios::DirectoryCollection dc("test_dir");
+        dc.setMethod(1024 * 4, zipios::StorageMethod::STORED, zipios::StorageMethod::DEFLATED);
+        std::ofstream out("test.zip", std::ios::out | std::ios::binary | std::ios::trunc);
+        zipios::ZipFile::saveCollectionToArchive(out, dc);
+    }
+
+    // each thread searches and reads all the files in a different order
+    // and counts the errors (the CATCH macros are not thread safe)
+    //
+    auto stress = [&expected](zipios::FileCollection & collection)
+        {
+            std::vector<std::string> names;
+            for(auto const & e : expected)
+            {
+                names.push_back(e.first);
+            }
+
+            size_t const thread_count(32);
+            std::atomic<size_t> errors(0);
+            std::vector<std::thread> threads;
+            for(size_t t(0); t < thread_count; ++t)
+            {
+                threads.emplace_back([&collection, &expected, &errors, names, t]() mutable
+                    {
+                        std::rotate(names.begin(), names.begin() + t % names.size(), names.end());
+                        for(int repeat(0); repeat < 5; ++repeat)
+                        {
+                            for(auto const & name : names)
+                            {
+                                zipios::FileEntry::pointer_t entry(collection.getEntry(name));
+                                if(entry == nullptr
+                                || entry->getSize() != expected.at(name).length())
+                                {
+                                    ++errors;
+                                    continue;
+                                }
+                                std::string const filename(name.substr(name.rfind('/') + 1));
+                                if(collection.findEntry(filename, zipios::FileCollection::MatchPath::IGNORE) != entry)
+                                {
+                                    ++errors;
+                                }
+                                zipios::FileCollection::stream_pointer_t is(collection.getInputStream(name));
+                                if(is == nullptr)
+                                {
+                                    ++errors;
+                                    continue;
+                                }
+                                std::string const content((std::istreambuf_iterator<char>(*is)), std::istreambuf_iterator<char>());
+                                if(content != expected.at(name))
+                                {
+                                    ++errors;
+                                }
+                            }
+                        }
+                    });
+            }
+            for(auto & th : threads)
+            {
+                th.join();
+            }
+            return errors.load();
+        };
+
+    CATCH_START_SECTION("streamed ZipFile")
+    {
+        zipios::ZipFile zf("test.zip");
+        CATCH_REQUIRE(stress(zf) == 0);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("memory mapped ZipFile")
+    {
+        zipios::ZipFile zf("test.zip", 0, 0, zipios::ZipFile::AccessMode::MEMORY_MAP, zipios::ZipFile::VerificationMode::LAZY);
+        CATCH_REQUIRE(stress(zf) == 0);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("DirectoryCollection loaded by the first readers")
+    {
+        zipios::DirectoryCollection dc("test_dir");
+        CATCH_REQUIRE(stress(dc) == 0);
+        CATCH_REQUIRE(dc.size() == expected.size() + 2);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("CollectionCollection")
+    {
+        zipios::CollectionCollection cc;
+        cc.addCollection(zipios::ZipFile("test.zip"));
+        cc.addCollection(zipios::DirectoryCollection("test_dir"));
+        CATCH_REQUIRE(stress(cc) == 0);
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("Extract a collection to disk", "[ZipFile][FileCollection][thread]")
+{
+    std::string const top_dir(SNAP_CATCH2_NAMESPACE::g_tmp_dir() + "/extract");
+    zipios_test::auto_unlink_t auto_unlink(top_dir, true);
+    CATCH_REQUIRE(system(("mkdir -p " + top_dir + "/test_dir/sub/deeper " + top_dir + "/test_dir/empty").c_str()) == 0);
+    zipios_test::safe_chdir cwd(top_dir);
+
+    std::map<std::string, std::string> expected;
+    for(int i(1); i <= 30; ++i)
+    {
+        std::string name("test_dir/");
+        switch(i % 3)
+        {
+        case 1:
+            name += "sub/";
+            break;
+
+        case 2:
+            name += "sub/deeper/";
+            break;
+
+        }
+        name += "file" + std::to_string(i) + (i % 2 == 0 ? ".txt" : ".bin");
+        std::string content;
+        size_t const size(i == 7 ? 0 : rand() % (100 * 1024));
+        for(size_t pos(0); pos < size; ++pos)
+        {
+            content += static_cast<char>(rand() % 16 + 'A');
+        }
+        std::ofstream file(name, std::ios::out | std::ios::binary);
+        file << content;
+        expected[name] = content;
+    }
+
+    {
+        zipios::DirectoryCollection dc("test_dir");
+        dc.setMethod(1024 * 10, zipios::StorageMethod::STORED, zipios::StorageMethod::DEFLATED);
+        std::ofstream out("test.zip", std::ios::out | std::ios::binary | std::ios::trunc);
+        zipios::ZipFile::saveCollectionToArchive(out, dc);
+    }
+
+    auto read_file = [](std::string const & filename)
+        {
+            std::ifstream in(filename, std::ios::in | std::ios::binary);
+            return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        };
+
+    CATCH_START_SECTION("extract all the entries with several threads")
+    {
+        zipios::ZipFile zf("test.zip");
+        zipios::FileCollection::extract_errors_t const errors(zf.extractAll("out", 4));
+        CATCH_REQUIRE(errors.empty());
+
+        for(auto const & e : expected)
+        {
+            std::string const filename("out/" + e.first);
+            CATCH_REQUIRE(read_file(filename) == e.second);
+
+            struct stat st;
+            CATCH_REQUIRE(stat(filename.c_str(), &st) == 0);
+            CATCH_REQUIRE(st.st_mtime == zf.getEntry(e.first)->getUnixTime());
+        }
+
+        struct stat st;
+        CATCH_REQUIRE(stat("out/test_dir/empty", &st) == 0);
+        CATCH_REQUIRE(S_ISDIR(st.st_mode));
+        CATCH_REQUIRE(st.st_mtime == zf.getEntry("test_dir/empty")->getUnixTime());
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("extract a selection of the entries")
+    {
+        zipios::ZipFile zf("test.zip");
+        zipios::FileCollection::extract_errors_t const errors(zf.extract(
+                  "selection"
+                , [](zipios::FileEntry const & entry)
+                    {
+                        std::string const name(entry.getName());
+                        return name.length() > 4 && name.substr(name.length() - 4) == ".txt";
+                    }));
+        CATCH_REQUIRE(errors.empty());
+
+        for(auto const & e : expected)
+        {
+            std::string const filename("selection/" + e.first);
+            if(e.first.substr(e.first.length() - 4) == ".txt")
+            {
+                CATCH_REQUIRE(read_file(filename) == e.second);
+            }
+            else
+            {
+                CATCH_REQUIRE(access(filename.c_str(), F_OK) != 0);
+            }
+        }
+        CATCH_REQUIRE(access("selection/test_dir/empty", F_OK) != 0);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("entries outside of the destination are rejected")
+    {
+        CATCH_REQUIRE(system("mkdir -p sub_dir") == 0);
+        zipios_test::safe_chdir sub("sub_dir");
+
+        // all the names of this collection start with "../"
+        //
+        zipios::DirectoryCollection dc("../test_dir/sub/deeper");
+        zipios::FileCollection::extract_errors_t const errors(dc.extractAll("out", 2));
+        CATCH_REQUIRE(errors.size() == dc.size());
+        for(auto const & entry : dc)
+        {
+            CATCH_REQUIRE(errors.find(entry->getName()) != errors.end());
+        }
+        CATCH_REQUIRE(access("out/test_dir", F_OK) != 0);
+        CATCH_REQUIRE(access("../test_dir/sub/deeper/file2.txt", F_OK) == 0);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("files which cannot be written are reported")
+    {
+        // a file named "out" prevents the creation of the directories
+        //
+        {
+            std::ofstream blocker("blocked", std::ios::out | std::ios::binary);
+        }
+        zipios::ZipFile zf("test.zip");
+        zipios::FileCollection::extract_errors_t const errors(zf.extractAll("blocked", 3));
+        CATCH_REQUIRE(errors.size() == zf.size());
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("ZipFile name index", "[ZipFile][FileCollection]")
+{
+    std::string const top_dir(SNAP_CATCH2_NAMESPACE::g_tmp_dir() + "/name-index");
+    zipios_test::auto_unlink_t auto_unlink(top_dir, true);
+    CATCH_REQUIRE(system(("mkdir -p " + top_dir + "/test_dir/a/b " + top_dir + "/test_dir/c").c_str()) == 0);
+    zipios_test::safe_chdir cwd(top_dir);
+
+    // the same basename appears in several directories
+    //
+    char const * const names[] =
+    {
+        "test_dir/same.txt",
+        "test_dir/a/same.txt",
+        "test_dir/a/b/same.txt",
+        "test_dir/c/same.txt",
+        "test_dir/c/other.txt",
+    };
+    for(auto const & n : names)
+    {
+        std::ofstream file(n, std::ios::out | std::ios::binary);
+        file << "content of " << n << "\n";
+    }
+
+    {
+        zipios::DirectoryCollection dc("test_dir");
+        std::ofstream out("test.zip", std::ios::out | std::ios::binary | std::ios::trunc);
+        zipios::ZipFile::saveCollectionToArchive(out, dc);
+    }
+
+    zipios::ZipFile zf("test.zip");
+    zipios::FileEntry::vector_t const v(zf.entries());
+
+    CATCH_START_SECTION("full path lookups find each entry")
+    {
+        for(auto const & entry : v)
+        {
+            CATCH_REQUIRE(zf.getEntry(entry->getName()) == entry);
+            CATCH_REQUIRE(zf.findEntry(entry->getName()) == entry);
+        }
+        CATCH_REQUIRE(zf.getEntry("same.txt") == nullptr);
+        CATCH_REQUIRE(zf.getEntry("a/same") == nullptr);
+        CATCH_REQUIRE(zf.findEntry("") == nullptr);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("basename lookups return the first matching entry")
+    {
+        for(auto const & entry : v)
+        {
+            std::string const filename(entry->getFileName());
+            zipios::FileEntry::pointer_t first;
+            for(auto const & e : v)
+            {
+                if(e->getFileName() == filename)
+                {
+                    first = e;
+                    break;
+                }
+            }
+            CATCH_REQUIRE(first != nullptr);
+            CATCH_REQUIRE(zf.getEntry(filename, zipios::FileCollection::MatchPath::IGNORE) == first);
+        }
+        CATCH_REQUIRE(zf.getEntry("missing.txt", zipios::FileCollection::MatchPath::IGNORE) == nullptr);
+        CATCH_REQUIRE(zf.getEntry("c/other.txt", zipios::FileCollection::MatchPath::IGNORE) == nullptr);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("string view lookups from a larger buffer")
+    {
+        std::string const buffer("GET /test_dir/a/b/same.txt HTTP/1.1");
+        std::string_view const name(std::string_view(buffer).substr(5, 21));
+        CATCH_REQUIRE(name == "test_dir/a/b/same.txt");
+
+        zipios::FileEntry::pointer_t entry(zf.findEntry(name));
+        CATCH_REQUIRE(entry != nullptr);
+        CATCH_REQUIRE(entry->getName() == "test_dir/a/b/same.txt");
+
+        entry = zf.findEntry(name.substr(13), zipios::FileCollection::MatchPath::IGNORE);
+        CATCH_REQUIRE(entry != nullptr);
+        CATCH_REQUIRE(entry->getFileName() == "same.txt");
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("the index of a copy is independent")
+    {
+        zipios::FileCollection::pointer_t copy(zf.clone());
+        zf.close();
+        zipios::FileEntry::pointer_t entry(copy->findEntry("test_dir/c/other.txt"));
+        CATCH_REQUIRE(entry != nullptr);
+        CATCH_REQUIRE(entry->getName() == "test_dir/c/other.txt");
+        CATCH_REQUIRE_THROWS_AS(zf.findEntry("test_dir/c/other.txt"), zipios::InvalidStateException);
+    }
+    CATCH_END_SECTION()
+}
+
+
+
+CATCH_TEST_CASE("Inflate input is bounded to the compressed size", "[ZipFile][FileCollection]")
+{
+    std::string const top_dir(SNAP_CATCH2_NAMESPACE::g_tmp_dir() + "/bounded-inflate");
+    zipios_test::auto_unlink_t auto_unlink(top_dir, true);
+    CATCH_REQUIRE(system(("mkdir -p " + top_dir + "/test_dir").c_str()) == 0);
+    zipios_test::safe_chdir cwd(top_dir);
+
+    std::string expected;
+    {
+        std::ofstream file_text("test_dir/file.txt", std::ios::out | std::ios::binary);
+        size_t const size(rand() % (100 * 1024) + 1);
+        for(size_t pos(0); pos < size; ++pos)
+        {
+            expected += static_cast<char>(rand() % 26 + 'a');
+        }
+        file_text << expected;
+    }
+
+    std::stringstream archive;
+    {
+        zipios::DirectoryCollection dc("test_dir/file.txt");
+        dc.setMethod(0, zipios::StorageMethod::DEFLATED, zipios::StorageMethod::DEFLATED);
+        zipios::ZipFile::saveCollectionToArchive(archive, dc);
+    }
+    std::string const data(archive.str());
+
+    // local header: 30 bytes, filename, extra field and compressed data
+    //
+    auto read16 = [&data](size_t pos)
+        {
+            return static_cast<size_t>(static_cast<unsigned char>(data[pos]))
+                 | (static_cast<size_t>(static_cast<unsigned char>(data[pos + 1])) << 8);
+        };
+    auto read32 = [&read16](size_t pos)
+        {
+            return read16(pos) | (read16(pos + 2) << 16);
+        };
+    CATCH_REQUIRE(read16(8) == static_cast<size_t>(zipios::StorageMethod::DEFLATED));
+    size_t const end_of_data(30 + read16(26) + read16(28) + read32(18));
+
+    CATCH_START_SECTION("inflate does not read past the compressed data")
+    {
+        std::istringstream is(data);
+        zipios::ZipInputStream zis(is);
+        std::string const result((std::istreambuf_iterator<char>(zis)), std::istreambuf_iterator<char>());
+        CATCH_REQUIRE(result == expected);
+        CATCH_REQUIRE(static_cast<size_t>(is.tellg()) == end_of_data);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("inflate does not need a byte after the compressed data")
+    {
+        std::istringstream is(data.substr(0, end_of_data));
+        zipios::ZipInputStream zis(is);
+        std::string const result((std::istreambuf_iterator<char>(zis)), std::istreambuf_iterator<char>());
+        CATCH_REQUIRE(result == expected);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("truncated compressed data is an error")
+    {
+        std::istringstream is(data.substr(0, end_of_data - 1));
+        zipios::ZipInputStream zis(is);
+        std::string result;
+        CATCH_REQUIRE_THROWS_AS(result.assign(std::istreambuf_iterator<char>(zis), std::istreambuf_iterator<char>()), zipios::IOException);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("an empty entry has no compressed data at all")
+    {
+        {
+            std::ofstream empty("empty.txt", std::ios::out | std::ios::binary);
+        }
+        std::stringstream empty_archive;
+        {
+            zipios::DirectoryCollection dc("empty.txt");
+            dc.setMethod(0, zipios::StorageMethod::DEFLATED, zipios::StorageMethod::DEFLATED);
+            zipios::ZipFile::saveCollectionToArchive(empty_archive, dc);
+        }
+        std::string const empty_data(empty_archive.str());
+        CATCH_REQUIRE(static_cast<unsigned char>(empty_data[8]) == static_cast<unsigned char>(zipios::StorageMethod::DEFLATED));
+        CATCH_REQUIRE(empty_data.substr(18, 4) == std::string(4, '\0'));
+
+        std::istringstream is(empty_data);
+        zipios::ZipInputStream zis(is);
+        std::string const result((std::istreambuf_iterator<char>(zis)), std::istreambuf_iterator<char>());
+        CATCH_REQUIRE(result.empty());
+        CATCH_REQUIRE_FALSE(zis.bad());
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("ZipFile CRC verification while reading", "[ZipFile][FileCollection]")
+{
+    std::string const top_dir(SNAP_CATCH2_NAMESPACE::g_tmp_dir() + "/verify-crc");
+    zipios_test::auto_unlink_t auto_unlink(top_dir, true);
+    CATCH_REQUIRE(system(("mkdir -p " + top_dir + "/test_dir").c_str()) == 0);
+    zipios_test::safe_chdir cwd(top_dir);
+
+    // file1 is STORED and file2 is DEFLATED
+    //
+    for(int i(1); i <= 2; ++i)
+    {
+        std::ofstream file_text("test_dir/file" + std::to_string(i) + ".txt", std::ios::out | std::ios::binary);
+        size_t const size(i == 1 ? 10000 : 50000 + rand() % 1000);
+        for(size_t pos(0); pos < size; ++pos)
+        {
+            file_text << static_cast<char>(rand() % 26 + 'a');
+        }
+    }
+    {
+        zipios::DirectoryCollection dc("test_dir");
+        dc.setMethod(20000, zipios::StorageMethod::STORED, zipios::StorageMethod::DEFLATED);
+        std::ofstream out("test.zip", std::ios::out | std::ios::binary | std::ios::trunc);
+        zipios::ZipFile::saveCollectionToArchive(out, dc);
+    }
+
+    // read the entry and return true if the stream reached EOF cleanly
+    //
+    auto read_entry = [](zipios::ZipFile & zf, std::string const & name)
+        {
+            zipios::ZipFile::stream_pointer_t is(zf.getInputStream(name));
+            CATCH_REQUIRE(is != nullptr);
+            char buf[1024];
+            while(is->read(buf, sizeof(buf)))
+            {
+            }
+            return is->eof() && !is->bad();
+        };
+
+    // overwrite one byte of the archive
+    //
+    auto patch = [](zipios::offset_t pos, char c)
+        {
+            std::fstream f("test.zip", std::ios::in | std::ios::out | std::ios::binary);
+            f.seekp(pos);
+            f.put(c);
+        };
+
+    zipios::offset_t stored_offset(0);
+    zipios::offset_t deflated_offset(0);
+    {
+        zipios::ZipFile zf("test.zip");
+        CATCH_REQUIRE_FALSE(zf.getVerifyCrc());
+        zf.setVerifyCrc(true);
+        CATCH_REQUIRE(zf.getVerifyCrc());
+
+        zipios::FileEntry::pointer_t stored(zf.getEntry("test_dir/file1.txt"));
+        CATCH_REQUIRE(stored->getMethod() == zipios::StorageMethod::STORED);
+        stored_offset = stored->getEntryOffset();
+        zipios::FileEntry::pointer_t deflated(zf.getEntry("test_dir/file2.txt"));
+        CATCH_REQUIRE(deflated->getMethod() == zipios::StorageMethod::DEFLATED);
+        deflated_offset = deflated->getEntryOffset();
+
+        CATCH_START_SECTION("valid entries pass the verification")
+        {
+            CATCH_REQUIRE(read_entry(zf, "test_dir/file1.txt"));
+            CATCH_REQUIRE(read_entry(zf, "test_dir/file2.txt"));
+        }
+        CATCH_END_SECTION()
+    }
+
+    CATCH_START_SECTION("corrupted STORED data fails the stream")
+    {
+        // the header is less than 100 bytes and the data is 10,000 bytes
+        //
+        patch(stored_offset + 200, '#');
+
+        zipios::ZipFile zf("test.zip");
+        CATCH_REQUIRE(read_entry(zf, "test_dir/file1.txt"));
+        zf.setVerifyCrc(true);
+        CATCH_REQUIRE_FALSE(read_entry(zf, "test_dir/file1.txt"));
+        CATCH_REQUIRE(read_entry(zf, "test_dir/file2.txt"));
+
+        zipios::ZipFile::stream_pointer_t is(zf.getInputStream("test_dir/file1.txt"));
+        is->exceptions(std::ios::badbit);
+        char buf[1024];
+        CATCH_REQUIRE_THROWS_AS([&]()
+            {
+                while(is->read(buf, sizeof(buf)))
+                {
+                }
+            }(), zipios::IOException);
+
+        // skipping the corrupted byte postpones the verification
+        //
+        is = zf.getInputStream("test_dir/file1.txt");
+        is->seekg(1000);
+        while(is->read(buf, sizeof(buf)))
+        {
+        }
+        CATCH_REQUIRE(is->eof());
+        CATCH_REQUIRE_FALSE(is->bad());
+
+        // reading the skipped data and reaching the end again verifies it
+        //
+        is->clear();
+        is->seekg(0);
+        while(is->read(buf, sizeof(buf)))
+        {
+        }
+        CATCH_REQUIRE(is->bad());
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("wrong CRC of a DEFLATED entry fails the stream")
+    {
+        // the local header CRC is at offset 14, skip the Central
+        // Directory comparison so only the data verification catches it
+        //
+        patch(deflated_offset + 14, '\xFF');
+        patch(deflated_offset + 15, '\xFF');
+
+        zipios::ZipFile zf("test.zip", 0, 0, zipios::ZipFile::AccessMode::STREAM, zipios::ZipFile::VerificationMode::NONE);
+        CATCH_REQUIRE(read_entry(zf, "test_dir/file2.txt"));
+        zf.setVerifyCrc(true);
+        CATCH_REQUIRE_FALSE(read_entry(zf, "test_dir/file2.txt"));
+        CATCH_REQUIRE(read_entry(zf, "test_dir/file1.txt"));
+
+        // the data skipped by a seek is not verified until it gets read
+        //
+        zipios::ZipFile::stream_pointer_t is(zf.getInputStream("test_dir/file2.txt"));
+        char buf[1024];
+        is->seekg(30000);
+        while(is->read(buf, sizeof(buf)))
+        {
+        }
+        CATCH_REQUIRE(is->eof());
+        CATCH_REQUIRE_FALSE(is->bad());
+
+        // reading the skipped data and reaching the end again verifies it
+        //
+        is->clear();
+        is->seekg(0);
+        while(is->read(buf, sizeof(buf)))
+        {
+        }
+        CATCH_REQUIRE(is->bad());
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("ZipFile views of STORED entries", "[ZipFile][FileCollection]")
+{
+    std::string const top_dir(SNAP_CATCH2_NAMESPACE::g_tmp_dir() + "/entry-view");
+    zipios_test::auto_unlink_t auto_unlink(top_dir, true);
+    CATCH_REQUIRE(system(("mkdir -p " + top_dir + "/test_dir/sub").c_str()) == 0);
+    zipios_test::safe_chdir cwd(top_dir);
+
+    // small.bin is STORED, large.bin is DEFLATED
+    //
+    std::map<std::string, std::string> contents;
+    for(auto const & name : { "test_dir/small.bin", "test_dir/large.bin", "test_dir/empty.bin" })
+    {
+        std::string data;
+        size_t const size(std::string(name) == "test_dir/small.bin"
+                            ? 10000 + rand() % 1000
+                            : std::string(name) == "test_dir/large.bin" ? 30000 : 0);
+        for(size_t pos(0); pos < size; ++pos)
+        {
+            data += static_cast<char>(rand());
+        }
+        std::ofstream out(name, std::ios::out | std::ios::binary);
+        out << data;
+        contents[name] = data;
+    }
+    {
+        zipios::DirectoryCollection dc("test_dir");
+        dc.setMethod(20000, zipios::StorageMethod::STORED, zipios::StorageMethod::DEFLATED);
+        std::ofstream out("test.zip", std::ios::out | std::ios::binary | std::ios::trunc);
+        zipios::ZipFile::saveCollectionToArchive(out, dc);
+    }
+
+    for(auto const access_mode : { zipios::ZipFile::AccessMode::STREAM, zipios::ZipFile::AccessMode::MEMORY_MAP })
+    {
+        for(auto const verification_mode : { zipios::ZipFile::VerificationMode::LAZY, zipios::ZipFile::VerificationMode::FULL })
+        {
+            zipios::ZipFile::entry_view_t view;
+            {
+                zipios::ZipFile zf("test.zip", 0, 0, access_mode, verification_mode);
+                zf.setVerifyCrc(true);
+
+                view = zf.getEntryView("test_dir/small.bin");
+                CATCH_REQUIRE(view.m_data != nullptr);
+                CATCH_REQUIRE(view.m_size == contents["test_dir/small.bin"].length());
+
+                zipios::ZipFile::entry_view_t const ignore_path(zf.getEntryView("small.bin", zipios::FileCollection::MatchPath::IGNORE));
+                CATCH_REQUIRE(ignore_path.m_size == view.m_size);
+                CATCH_REQUIRE(memcmp(ignore_path.m_data.get(), view.m_data.get(), view.m_size) == 0);
+
+                zipios::ZipFile::entry_view_t const empty(zf.getEntryView("test_dir/empty.bin"));
+                CATCH_REQUIRE(empty.m_data != nullptr);
+                CATCH_REQUIRE(empty.m_size == 0);
+
+                // compressed entries, directories and missing entries
+                // cannot be viewed
+                //
+                CATCH_REQUIRE(zf.getEntryView("test_dir/large.bin").m_data == nullptr);
+                CATCH_REQUIRE(zf.getEntryView("test_dir/sub").m_data == nullptr);
+                CATCH_REQUIRE(zf.getEntryView("test_dir/missing.bin").m_data == nullptr);
+            }
+
+            // the view remains valid after the ZipFile is gone
+            //
+            CATCH_REQUIRE(std::string(view.m_data.get(), view.m_size) == contents["test_dir/small.bin"]);
+        }
+    }
+}
+
+
+CATCH_TEST_CASE("ZipFile read whole entries in buffers", "[ZipFile][FileCollection]")
+{
+    std::string const top_dir(SNAP_CATCH2_NAMESPACE::g_tmp_dir() + "/read-entry");
+    zipios_test::auto_unlink_t auto_unlink(top_dir, true);
+    CATCH_REQUIRE(system(("mkdir -p " + top_dir + "/test_dir/sub").c_str()) == 0);
+    zipios_test::safe_chdir cwd(top_dir);
+
+    // files over 2,000 bytes get compressed
+    //
+    std::map<std::string, std::string> contents;
+    for(int i(1); i <= 10; ++i)
+    {
+        std::string const name("test_dir/file" + std::to_string(i) + ".txt");
+        std::string data;
+        size_t const size(i == 1 ? 0 : (i == 2 ? 1000 : rand() % (64 * 1024)));
+        for(size_t pos(0); pos < size; ++pos)
+        {
+            data += static_cast<char>(rand() % 26 + 'a');
+        }
+        std::ofstream out(name, std::ios::out | std::ios::binary);
+        out << data;
+        contents[name] = data;
+    }
+    {
+        zipios::DirectoryCollection dc("test_dir");
+        dc.setMethod(2000, zipios::StorageMethod::STORED, zipios::StorageMethod::DEFLATED);
+
+        // an empty DEFLATED entry has no compressed data at all
+        //
+        dc.getEntry("test_dir/file1.txt")->setMethod(zipios::StorageMethod::DEFLATED);
+
+        std::ofstream out("test.zip", std::ios::out | std::ios::binary | std::ios::trunc);
+        zipios::ZipFile::saveCollectionToArchive(out, dc);
+    }
+
+    for(auto const access_mode : { zipios::ZipFile::AccessMode::STREAM, zipios::ZipFile::AccessMode::MEMORY_MAP })
+    {
+        for(auto const verification_mode : { zipios::ZipFile::VerificationMode::NONE, zipios::ZipFile::VerificationMode::LAZY })
+        {
+            zipios::ZipFile zf("test.zip", 0, 0, access_mode, verification_mode);
+            zf.setVerifyCrc(true);
+            CATCH_REQUIRE(zf.getEntry("test_dir/file1.txt")->getMethod() == zipios::StorageMethod::DEFLATED);
+
+            for(auto const & c : contents)
+            {
+                std::vector<char> const data(zf.readEntry(c.first));
+                CATCH_REQUIRE(std::string(data.begin(), data.end()) == c.second);
+
+                zipios::FileCollection::stream_pointer_t is(zf.getInputStream(c.first));
+                CATCH_REQUIRE(is != nullptr);
+                std::string const streamed((std::istreambuf_iterator<char>(*is)), std::istreambuf_iterator<char>());
+                CATCH_REQUIRE(streamed == c.second);
+
+                std::vector<char> buffer(c.second.length() + 10);
+                CATCH_REQUIRE(zf.readEntry(c.first, buffer.data(), buffer.size()) == c.second.length());
+                CATCH_REQUIRE(std::string(buffer.data(), c.second.length()) == c.second);
+
+                if(!c.second.empty())
+                {
+                    CATCH_REQUIRE_THROWS_AS(zf.readEntry(c.first, buffer.data(), c.second.length() - 1), zipios::InvalidException);
+                }
+            }
+
+            CATCH_REQUIRE(zf.readEntry("file2.txt", zipios::FileCollection::MatchPath::IGNORE).size() == contents["test_dir/file2.txt"].length());
+            CATCH_REQUIRE_THROWS_AS(zf.readEntry("test_dir/missing.txt"), zipios::InvalidException);
+            CATCH_REQUIRE_THROWS_AS(zf.readEntry("test_dir/sub"), zipios::InvalidException);
+        }
+    }
+
+    CATCH_START_SECTION("corrupted data")
+    {
+        zipios::offset_t offset(0);
+        std::string name;
+        {
+            zipios::ZipFile zf("test.zip");
+            for(auto const & entry : zf)
+            {
+                if(entry->getMethod() == zipios::StorageMethod::STORED
+                && entry->getSize() > 200)
+                {
+                    offset = entry->getEntryOffset();
+                    name = entry->getName();
+                    break;
+                }
+            }
+        }
+        {
+            std::fstream f("test.zip", std::ios::in | std::ios::out | std::ios::binary);
+            f.seekp(offset + 150);
+            f.put('#');
+        }
+
+        zipios::ZipFile zf("test.zip");
+        CATCH_REQUIRE(zf.readEntry(name).size() == contents[name].length());
+        zf.setVerifyCrc(true);
+        CATCH_REQUIRE_THROWS_AS(zf.readEntry(name), zipios::IOException);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("STORED entry larger than its data")
+    {
+        // make the size of a STORED entry in the Central Directory larger
+        // than its compressed size so it would go past the end of the file
+        //
+        std::string archive;
+        {
+            std::ifstream in("test.zip", std::ios::in | std::ios::binary);
+            archive.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        }
+        auto read16 = [&archive](size_t pos)
+            {
+                return static_cast<size_t>(static_cast<unsigned char>(archive[pos]))
+                     | (static_cast<size_t>(static_cast<unsigned char>(archive[pos + 1])) << 8);
+            };
+        std::string name;
+        for(size_t pos(archive.find("PK\x01\x02")); pos != std::string::npos; pos = archive.find("PK\x01\x02", pos + 4))
+        {
+            name = archive.substr(pos + 46, read16(pos + 28));
+            if(read16(pos + 10) == static_cast<size_t>(zipios::StorageMethod::STORED)
+            && contents.find(name) != contents.end()
+            && !contents[name].empty())
+            {
+                archive[pos + 26] = 0x10;   // size += 1 MiB
+                break;
+            }
+            name.clear();
+        }
+        CATCH_REQUIRE_FALSE(name.empty());
+        {
+            std::ofstream out("test.zip", std::ios::out | std::ios::binary | std::ios::trunc);
+            out << archive;
+        }
+
+        for(auto const access_mode : { zipios::ZipFile::AccessMode::STREAM, zipios::ZipFile::AccessMode::MEMORY_MAP })
+        {
+            zipios::ZipFile zf("test.zip", 0, 0, access_mode, zipios::ZipFile::VerificationMode::NONE);
+            CATCH_REQUIRE(zf.getEntry(name)->getSize() > contents[name].length() + 1024 * 1024 - 1);
+            CATCH_REQUIRE_THROWS_AS(zf.readEntry(name), zipios::FileCollectionException);
+        }
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("ZipFile bulk reads of entries", "[ZipFile][FileCollection]")
+{
+    std::string const top_dir(SNAP_CATCH2_NAMESPACE::g_tmp_dir() + "/bulk-read");
+    zipios_test::auto_unlink_t auto_unlink(top_dir, true);
+    CATCH_REQUIRE(system(("mkdir -p " + top_dir + "/test_dir").c_str()) == 0);
+    zipios_test::safe_chdir cwd(top_dir);
+
+    // stored.bin is STORED, deflated.txt is DEFLATED
+    //
+    std::map<std::string, std::string> contents;
+    for(auto const & name : { "test_dir/stored.bin", "test_dir/deflated.txt" })
+    {
+        bool const stored(std::string(name) == "test_dir/stored.bin");
+        std::string data;
+        size_t const size(200 * 1024 + rand() % 1024);
+        for(size_t pos(0); pos < size; ++pos)
+        {
+            data += static_cast<char>(stored ? rand() : rand() % 26 + 'a');
+        }
+        std::ofstream out(name, std::ios::out | std::ios::binary);
+        out << data;
+        contents[name] = data;
+    }
+    {
+        zipios::DirectoryCollection dc("test_dir");
+        dc.setMethod(0, zipios::StorageMethod::DEFLATED, zipios::StorageMethod::DEFLATED);
+        dc.getEntry("test_dir/stored.bin")->setMethod(zipios::StorageMethod::STORED);
+        std::ofstream out("test.zip", std::ios::out | std::ios::binary | std::ios::trunc);
+        zipios::ZipFile::saveCollectionToArchive(out, dc);
+    }
+
+    for(auto const access_mode : { zipios::ZipFile::AccessMode::STREAM, zipios::ZipFile::AccessMode::MEMORY_MAP })
+    {
+        for(bool const verify_crc : { false, true })
+        {
+            zipios::ZipFile zf("test.zip", 0, 0, access_mode);
+            zf.setVerifyCrc(verify_crc);
+            CATCH_REQUIRE(zf.getEntry("test_dir/stored.bin")->getMethod() == zipios::StorageMethod::STORED);
+            CATCH_REQUIRE(zf.getEntry("test_dir/deflated.txt")->getMethod() == zipios::StorageMethod::DEFLATED);
+
+            for(auto const & c : contents)
+            {
+                // mix small reads, which go through the stream buffer,
+                // and large reads, which go directly to our buffer
+                //
+                zipios::ZipFile::stream_pointer_t is(zf.getInputStream(c.first));
+                std::string result;
+                std::vector<char> buf(64 * 1024);
+                for(int i(0); ; ++i)
+                {
+                    size_t const size(i % 3 == 0 ? rand() % 100 + 1 : (i % 3 == 1 ? 20000 + rand() % 40000 : buf.size()));
+                    is->read(buf.data(), size);
+                    result.append(buf.data(), is->gcount());
+                    if(!*is)
+                    {
+                        break;
+                    }
+                }
+                CATCH_REQUIRE(is->eof());
+                CATCH_REQUIRE_FALSE(is->bad());
+                CATCH_REQUIRE(result == c.second);
+            }
+        }
+    }
+}
+
+
+CATCH_TEST_CASE("ZipFile seek in entries", "[ZipFile][FileCollection]")
+{
+    std::string const top_dir(SNAP_CATCH2_NAMESPACE::g_tmp_dir() + "/seek-entries");
+    zipios_test::auto_unlink_t auto_unlink(top_dir, true);
+    CATCH_REQUIRE(system(("mkdir -p " + top_dir + "/test_dir").c_str()) == 0);
+    zipios_test::safe_chdir cwd(top_dir);
+
+    // stored.bin is STORED, deflated.txt is DEFLATED and large enough
+    // to span many deflate blocks
+    //
+    std::map<std::string, std::string> contents;
+    for(auto const & name : { "test_dir/stored.bin", "test_dir/deflated.txt" })
+    {
+        bool const stored(std::string(name) == "test_dir/stored.bin");
+        std::string data;
+        size_t const size((stored ? 200 : 1024) * 1024 + rand() % 1024);
+        while(data.length() < size)
+        {
+            data += stored
+                        ? std::string(1, static_cast<char>(rand()))
+                        : "word" + std::to_string(rand() % 5000) + (rand() % 10 == 0 ? "\n" : " ");
+        }
+        std::ofstream out(name, std::ios::out | std::ios::binary);
+        out << data;
+        contents[name] = data;
+    }
+    {
+        zipios::DirectoryCollection dc("test_dir");
+        dc.setMethod(0, zipios::StorageMethod::DEFLATED, zipios::StorageMethod::DEFLATED);
+        dc.getEntry("test_dir/stored.bin")->setMethod(zipios::StorageMethod::STORED);
+        std::ofstream out("test.zip", std::ios::out | std::ios::binary | std::ios::trunc);
+        zipios::ZipFile::saveCollectionToArchive(out, dc);
+    }
+
+    CATCH_START_SECTION("seek with and without a checkpoint index")
+    {
+        for(auto const access_mode : { zipios::ZipFile::AccessMode::STREAM, zipios::ZipFile::AccessMode::MEMORY_MAP })
+        {
+            for(size_t const interval : { 0, 64 * 1024 })
+            {
+                zipios::ZipFile zf("test.zip", 0, 0, access_mode);
+                zf.setVerifyCrc(true);
+                CATCH_REQUIRE(zf.getCheckpointInterval() == 0);
+                zf.setCheckpointInterval(interval);
+                CATCH_REQUIRE(zf.getCheckpointInterval() == interval);
+                CATCH_REQUIRE(zf.getEntry("test_dir/deflated.txt")->getMethod() == zipios::StorageMethod::DEFLATED);
+
+                for(auto const & c : contents)
+                {
+                    std::streamoff const size(c.second.length());
+                    zipios::ZipFile::stream_pointer_t is(zf.getInputStream(c.first));
+                    CATCH_REQUIRE(is->tellg() == 0);
+
+                    std::vector<char> buf(20000);
+                    for(int i(0); i < 50; ++i)
+                    {
+                        std::streamoff pos(rand() % (size + 1));
+                        switch(i % 3)
+                        {
+                        case 0:
+                            is->seekg(pos);
+                            break;
+
+                        case 1:
+                            is->seekg(pos - size, std::ios::end);
+                            break;
+
+                        default:
+                            is->seekg(pos - is->tellg(), std::ios::cur);
+                            break;
+
+                        }
+                        CATCH_REQUIRE(*is);
+                        CATCH_REQUIRE(is->tellg() == pos);
+
+                        size_t const length(i % 2 == 0 ? rand() % 100 + 1 : buf.size());
+                        is->read(buf.data(), length);
+                        size_t const expected(std::min(length, static_cast<size_t>(size - pos)));
+                        CATCH_REQUIRE(static_cast<size_t>(is->gcount()) == expected);
+                        CATCH_REQUIRE(std::string(buf.data(), expected) == c.second.substr(pos, expected));
+                        if(expected < length)
+                        {
+                            CATCH_REQUIRE(is->eof());
+                            is->clear();
+                        }
+                        else
+                        {
+                            CATCH_REQUIRE(is->tellg() == pos + static_cast<std::streamoff>(expected));
+                        }
+                    }
+
+                    // positions outside of the entry are refused
+                    //
+                    is->seekg(size + 1);
+                    CATCH_REQUIRE(is->fail());
+                    is->clear();
+                    is->seekg(-1, std::ios::beg);
+                    CATCH_REQUIRE(is->fail());
+                    is->clear();
+
+                    // reading all the data from the start verifies the
+                    // CRC32 even though the stream was seeked before
+                    //
+                    is->seekg(0);
+                    std::string const data((std::istreambuf_iterator<char>(*is)), std::istreambuf_iterator<char>());
+                    CATCH_REQUIRE_FALSE(is->bad());
+                    CATCH_REQUIRE(data == c.second);
+                }
+            }
+        }
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("the checkpoint index is built while reading")
+    {
+        zipios::ZipFile zf("test.zip");
+        zipios::FileEntry::pointer_t entry(zf.getEntry("test_dir/deflated.txt"));
+        std::string const & expected(contents["test_dir/deflated.txt"]);
+
+        zipios::InflateIndex::pointer_t index(std::make_shared<zipios::InflateIndex>(100 * 1024));
+        CATCH_REQUIRE(index->getInterval() == 100 * 1024);
+        CATCH_REQUIRE(index->size() == 0);
+        CATCH_REQUIRE(index->findCheckpoint(500 * 1024) == nullptr);
+        {
+            zipios::ZipInputStream zis("test.zip", entry->getEntryOffset(), nullptr, false, index);
+            std::string const data((std::istreambuf_iterator<char>(zis)), std::istreambuf_iterator<char>());
+            CATCH_REQUIRE(data == expected);
+        }
+
+        // at most one checkpoint every 100 KiB, at block boundaries
+        //
+        size_t const count(index->size());
+        CATCH_REQUIRE(count >= 2);
+        CATCH_REQUIRE(count <= expected.length() / (100 * 1024));
+        zipios::InflateIndex::checkpoint_t::pointer_t checkpoint(index->findCheckpoint(500 * 1024));
+        CATCH_REQUIRE(checkpoint != nullptr);
+        CATCH_REQUIRE(checkpoint->m_out <= 500 * 1024);
+        CATCH_REQUIRE(checkpoint->m_out >= 100 * 1024);
+        CATCH_REQUIRE(checkpoint->m_in < checkpoint->m_out);
+        CATCH_REQUIRE(checkpoint->m_bits < 8);
+        CATCH_REQUIRE(checkpoint->m_window.size() == 32768);
+        CATCH_REQUIRE(std::string(reinterpret_cast<char const *>(checkpoint->m_window.data()), checkpoint->m_window.size())
+                            == expected.substr(checkpoint->m_out - 32768, 32768));
+
+        // a second stream reuses the index and does not add checkpoints
+        //
+        {
+            zipios::ZipInputStream zis("test.zip", entry->getEntryOffset(), nullptr, false, index);
+            for(std::streamoff pos : { 900 * 1024, 300 * 1024, 700 * 1024, 10 })
+            {
+                zis.seekg(pos);
+                char buf[64];
+                zis.read(buf, sizeof(buf));
+                CATCH_REQUIRE(zis);
+                CATCH_REQUIRE(std::string(buf, sizeof(buf)) == expected.substr(pos, sizeof(buf)));
+            }
+            std::string const data((std::istreambuf_iterator<char>(zis)), std::istreambuf_iterator<char>());
+            CATCH_REQUIRE(data == expected.substr(10 + 64));
+        }
+        CATCH_REQUIRE(index->size() == count);
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("ZipFile streams recycle inflate backends", "[ZipFile][FileCollection]")
+{
+    std::string const top_dir(SNAP_CATCH2_NAMESPACE::g_tmp_dir() + "/inflate-pool");
+    zipios_test::auto_unlink_t auto_unlink(top_dir, true);
+    CATCH_REQUIRE(system(("mkdir -p " + top_dir + "/test_dir").c_str()) == 0);
+    zipios_test::safe_chdir cwd(top_dir);
+
+    // files over 2,000 bytes get compressed
+    //
+    std::map<std::string, std::string> stored;
+    std::map<std::string, std::string> deflated;
+    for(int i(1); i <= 40; ++i)
+    {
+        std::string const name("test_dir/file" + std::to_string(i) + ".txt");
+        std::string data;
+        size_t const size((i & 1) != 0 ? rand() % 1500 + 1 : rand() % (64 * 1024) + 3000);
+        for(size_t pos(0); pos < size; ++pos)
+        {
+            data += static_cast<char>(rand() % 26 + 'a');
+        }
+        std::ofstream out(name, std::ios::out | std::ios::binary);
+        out << data;
+        ((i & 1) != 0 ? stored : deflated)[name] = data;
+    }
+    {
+        zipios::DirectoryCollection dc("test_dir");
+        dc.setMethod(2000, zipios::StorageMethod::STORED, zipios::StorageMethod::DEFLATED);
+        std::ofstream out("test.zip", std::ios::out | std::ios::binary | std::ios::trunc);
+        zipios::ZipFile::saveCollectionToArchive(out, dc);
+    }
+
+    // no CATCH_REQUIRE() here, this lambda is also used by threads
+    //
+    auto read_entry = [](zipios::ZipFile & zf, std::string const & name)
+        {
+            zipios::FileCollection::stream_pointer_t is(zf.getInputStream(name));
+            if(is == nullptr)
+            {
+                return std::string();
+            }
+            return std::string((std::istreambuf_iterator<char>(*is)), std::istreambuf_iterator<char>());
+        };
+
+    for(auto const access_mode : { zipios::ZipFile::AccessMode::STREAM, zipios::ZipFile::AccessMode::MEMORY_MAP })
+    {
+        zipios::ZipFile zf("test.zip", 0, 0, access_mode);
+        zf.setVerifyCrc(true);
+
+        CATCH_START_SECTION("STORED entries do not use an inflate backend")
+        {
+            size_t const count(zipios::getInflateBackendCount());
+            for(auto const & c : stored)
+            {
+                CATCH_REQUIRE(zf.getEntry(c.first)->getMethod() == zipios::StorageMethod::STORED);
+                CATCH_REQUIRE(read_entry(zf, c.first) == c.second);
+            }
+            CATCH_REQUIRE(zipios::getInflateBackendCount() == count);
+        }
+        CATCH_END_SECTION()
+
+        CATCH_START_SECTION("DEFLATED entries read one after the other share one backend")
+        {
+            CATCH_REQUIRE(read_entry(zf, deflated.begin()->first) == deflated.begin()->second);
+            size_t const count(zipios::getInflateBackendCount());
+            for(auto const & c : deflated)
+            {
+                CATCH_REQUIRE(zf.getEntry(c.first)->getMethod() == zipios::StorageMethod::DEFLATED);
+                CATCH_REQUIRE(read_entry(zf, c.first) == c.second);
+            }
+            CATCH_REQUIRE(zipios::getInflateBackendCount() == count);
+        }
+        CATCH_END_SECTION()
+
+        CATCH_START_SECTION("streams opened at the same time each get their own backend")
+        {
+            for(int repeat(0); repeat < 2; ++repeat)
+            {
+                size_t const count(zipios::getInflateBackendCount());
+                std::vector<zipios::FileCollection::stream_pointer_t> streams;
+                for(auto const & c : deflated)
+                {
+                    streams.push_back(zf.getInputStream(c.first));
+                    if(streams.size() == 3)
+                    {
+                        break;
+                    }
+                }
+
+                // interleave the reads
+                //
+                std::vector<std::string> data(streams.size());
+                bool more(true);
+                while(more)
+                {
+                    more = false;
+                    for(size_t idx(0); idx < streams.size(); ++idx)
+                    {
+                        char buf[1000];
+                        streams[idx]->read(buf, sizeof(buf));
+                        data[idx] += std::string(buf, streams[idx]->gcount());
+                        more = more || *streams[idx];
+                    }
+                }
+                size_t idx(0);
+                for(auto const & c : deflated)
+                {
+                    if(idx == streams.size())
+                    {
+                        break;
+                    }
+                    CATCH_REQUIRE(data[idx] == c.second);
+                    ++idx;
+                }
+
+                // the second time around, the backends come from the pool
+                //
+                if(repeat == 1)
+                {
+                    CATCH_REQUIRE(zipios::getInflateBackendCount() == count);
+                }
+            }
+        }
+        CATCH_END_SECTION()
+
+        CATCH_START_SECTION("each thread has its own pool")
+        {
+            std::atomic<int> errors(0);
+            std::vector<std::thread> threads;
+            for(int t(0); t < 4; ++t)
+            {
+                threads.emplace_back([&zf, &deflated, &stored, &errors, &read_entry]()
+                    {
+                        for(int repeat(0); repeat < 3; ++repeat)
+                        {
+                            for(auto const & c : deflated)
+                            {
+                                if(read_entry(zf, c.first) != c.second)
+                                {
+                                    ++errors;
+                                }
+                            }
+                            for(auto const & c : stored)
+                            {
+                                if(read_entry(zf, c.first) != c.second)
+                                {
+                                    ++errors;
+                                }
+                            }
+                        }
+                    });
+            }
+            for(auto & t : threads)
+            {
+                t.join();
+            }
+            CATCH_REQUIRE(errors == 0);
+        }
+        CATCH_END_SECTION()
+    }
+}
+
+
+CATCH_TEST_CASE("ZipFile cache of entries", "[ZipFile][FileCollection]")
+{
+    std::string const top_dir(SNAP_CATCH2_NAMESPACE::g_tmp_dir() + "/entry-cache");
+    zipios_test::auto_unlink_t auto_unlink(top_dir, true);
+    CATCH_REQUIRE(system(("mkdir -p " + top_dir + "/test_dir").c_str()) == 0);
+    zipios_test::safe_chdir cwd(top_dir);
+
+    // 8 DEFLATED files of 10,000 bytes, one STORED file and one large file
+    //
+    std::map<std::string, std::string> contents;
+    auto add_file = [&contents](std::string const & name, size_t size)
+        {
+            std::string data;
+            while(data.length() < size)
+            {
+                data += "line " + std::to_string(rand()) + "\n";
+            }
+            data.resize(size);
+            std::ofstream out("test_dir/" + name, std::ios::out | std::ios::binary);
+            out << data;
+            contents["test_dir/" + name] = data;
+        };
+    for(int i(0); i < 8; ++i)
+    {
+        add_file("file" + std::to_string(i) + ".txt", 10000);
+    }
+    add_file("small.txt", 500);
+    add_file("large.txt", 100000);
+    {
+        zipios::DirectoryCollection dc("test_dir");
+        dc.setMethod(1000, zipios::StorageMethod::STORED, zipios::StorageMethod::DEFLATED);
+        std::ofstream out("test.zip", std::ios::out | std::ios::binary | std::ios::trunc);
+        zipios::ZipFile::saveCollectionToArchive(out, dc);
+    }
+
+    auto read_stream = [](zipios::ZipFile & zf, std::string const & name)
+        {
+            zipios::FileCollection::stream_pointer_t is(zf.getInputStream(name));
+            if(is == nullptr)
+            {
+                return std::string();
+            }
+            return std::string((std::istreambuf_iterator<char>(*is)), std::istreambuf_iterator<char>());
+        };
+
+    for(auto const access_mode : { zipios::ZipFile::AccessMode::STREAM, zipios::ZipFile::AccessMode::MEMORY_MAP })
+    {
+        CATCH_START_SECTION("no cache by default")
+        {
+            zipios::ZipFile zf("test.zip", 0, 0, access_mode);
+            CATCH_REQUIRE(zf.getCacheBudget() == 0);
+            CATCH_REQUIRE(read_stream(zf, "test_dir/file0.txt") == contents["test_dir/file0.txt"]);
+            zipios::ZipFile::cache_statistics_t const statistics(zf.getCacheStatistics());
+            CATCH_REQUIRE(statistics.m_hits == 0);
+            CATCH_REQUIRE(statistics.m_misses == 0);
+            CATCH_REQUIRE(statistics.m_budget == 0);
+            CATCH_REQUIRE(zf.getEntryView("test_dir/file0.txt").m_data == nullptr);
+        }
+        CATCH_END_SECTION()
+
+        CATCH_START_SECTION("hits, misses and LRU evictions")
+        {
+            zipios::ZipFile zf("test.zip", 0, 0, access_mode);
+            zf.setVerifyCrc(true);
+            zf.setCacheBudget(35000);
+            CATCH_REQUIRE(zf.getCacheBudget() == 35000);
+
+            // first read is a miss, the following reads are hits
+            //
+            CATCH_REQUIRE(read_stream(zf, "test_dir/file0.txt") == contents["test_dir/file0.txt"]);
+            CATCH_REQUIRE(read_stream(zf, "test_dir/file0.txt") == contents["test_dir/file0.txt"]);
+            std::vector<char> const data(zf.readEntry("test_dir/file0.txt"));
+            CATCH_REQUIRE(std::string(data.begin(), data.end()) == contents["test_dir/file0.txt"]);
+            char buffer[10000];
+            CATCH_REQUIRE(zf.readEntry("test_dir/file0.txt", buffer, sizeof(buffer)) == sizeof(buffer));
+            CATCH_REQUIRE(std::string(buffer, sizeof(buffer)) == contents["test_dir/file0.txt"]);
+            zipios::ZipFile::entry_view_t const view(zf.getEntryView("test_dir/file0.txt"));
+            CATCH_REQUIRE(view.m_data != nullptr);
+            CATCH_REQUIRE(std::string(view.m_data.get(), view.m_size) == contents["test_dir/file0.txt"]);
+
+            zipios::ZipFile::cache_statistics_t statistics(zf.getCacheStatistics());
+            CATCH_REQUIRE(statistics.m_misses == 1);
+            CATCH_REQUIRE(statistics.m_hits == 4);
+            CATCH_REQUIRE(statistics.m_evictions == 0);
+            CATCH_REQUIRE(statistics.m_entries == 1);
+            CATCH_REQUIRE(statistics.m_size == 10000);
+            CATCH_REQUIRE(statistics.m_budget == 35000);
+
+            // cached streams can seek
+            //
+            {
+                zipios::FileCollection::stream_pointer_t is(zf.getInputStream("test_dir/file0.txt"));
+                is->seekg(5000);
+                CATCH_REQUIRE(is->tellg() == 5000);
+                char buf[100];
+                is->read(buf, sizeof(buf));
+                CATCH_REQUIRE(std::string(buf, sizeof(buf)) == contents["test_dir/file0.txt"].substr(5000, sizeof(buf)));
+                is->seekg(-10, std::ios::end);
+                std::string const tail((std::istreambuf_iterator<char>(*is)), std::istreambuf_iterator<char>());
+                CATCH_REQUIRE(tail == contents["test_dir/file0.txt"].substr(10000 - 10));
+            }
+
+            // fill the cache: file0, file1, file2 fit, file3 evicts file0
+            //
+            CATCH_REQUIRE(read_stream(zf, "test_dir/file1.txt") == contents["test_dir/file1.txt"]);
+            CATCH_REQUIRE(read_stream(zf, "test_dir/file2.txt") == contents["test_dir/file2.txt"]);
+            CATCH_REQUIRE(read_stream(zf, "test_dir/file3.txt") == contents["test_dir/file3.txt"]);
+            statistics = zf.getCacheStatistics();
+            CATCH_REQUIRE(statistics.m_misses == 4);
+            CATCH_REQUIRE(statistics.m_evictions == 1);
+            CATCH_REQUIRE(statistics.m_entries == 3);
+            CATCH_REQUIRE(statistics.m_size == 30000);
+
+            // the view of an evicted entry remains valid
+            //
+            CATCH_REQUIRE(std::string(view.m_data.get(), view.m_size) == contents["test_dir/file0.txt"]);
+
+            // file1 becomes the most recently used, file4 evicts file2
+            //
+            CATCH_REQUIRE(read_stream(zf, "test_dir/file1.txt") == contents["test_dir/file1.txt"]);
+            CATCH_REQUIRE(read_stream(zf, "test_dir/file4.txt") == contents["test_dir/file4.txt"]);
+            statistics = zf.getCacheStatistics();
+            CATCH_REQUIRE(statistics.m_hits == 6);
+            CATCH_REQUIRE(statistics.m_misses == 5);
+            CATCH_REQUIRE(statistics.m_evictions == 2);
+            CATCH_REQUIRE(read_stream(zf, "test_dir/file1.txt") == contents["test_dir/file1.txt"]);
+            CATCH_REQUIRE(zf.getCacheStatistics().m_hits == 7);
+            CATCH_REQUIRE(read_stream(zf, "test_dir/file2.txt") == contents["test_dir/file2.txt"]);
+            CATCH_REQUIRE(zf.getCacheStatistics().m_misses == 6);
+
+            // entries larger than the budget are not cached
+            //
+            CATCH_REQUIRE(read_stream(zf, "test_dir/large.txt") == contents["test_dir/large.txt"]);
+            CATCH_REQUIRE(zf.readEntry("test_dir/large.txt").size() == 100000);
+            CATCH_REQUIRE(zf.getEntryView("test_dir/large.txt").m_data == nullptr);
+            statistics = zf.getCacheStatistics();
+            CATCH_REQUIRE(statistics.m_misses == 6);
+            CATCH_REQUIRE(statistics.m_hits == 7);
+
+            // STORED entries are cached only when the archive is not mapped
+            //
+            CATCH_REQUIRE(read_stream(zf, "test_dir/small.txt") == contents["test_dir/small.txt"]);
+            CATCH_REQUIRE(read_stream(zf, "test_dir/small.txt") == contents["test_dir/small.txt"]);
+            statistics = zf.getCacheStatistics();
+            if(access_mode == zipios::ZipFile::AccessMode::MEMORY_MAP)
+            {
+                CATCH_REQUIRE(statistics.m_misses == 6);
+                CATCH_REQUIRE(statistics.m_hits == 7);
+            }
+            else
+            {
+                CATCH_REQUIRE(statistics.m_misses == 7);
+                CATCH_REQUIRE(statistics.m_hits == 8);
+            }
+
+            // a smaller budget evicts entries immediately
+            //
+            zf.setCacheBudget(15000);
+            statistics = zf.getCacheStatistics();
+            CATCH_REQUIRE(statistics.m_size <= 15000);
+            CATCH_REQUIRE(statistics.m_budget == 15000);
+
+            // a clone shares the cache
+            //
+            zipios::FileCollection::pointer_t clone(zf.clone());
+            zipios::ZipFile * clone_zf(dynamic_cast<zipios::ZipFile *>(clone.get()));
+            CATCH_REQUIRE(clone_zf != nullptr);
+            CATCH_REQUIRE(clone_zf->getCacheBudget() == 15000);
+            CATCH_REQUIRE(read_stream(*clone_zf, "test_dir/file5.txt") == contents["test_dir/file5.txt"]);
+            size_t const hits(zf.getCacheStatistics().m_hits);
+            CATCH_REQUIRE(read_stream(zf, "test_dir/file5.txt") == contents["test_dir/file5.txt"]);
+            CATCH_REQUIRE(zf.getCacheStatistics().m_hits == hits + 1);
+
+            // clearing keeps the counters
+            //
+            zf.clearCache();
+            statistics = zf.getCacheStatistics();
+            CATCH_REQUIRE(statistics.m_entries == 0);
+            CATCH_REQUIRE(statistics.m_size == 0);
+            CATCH_REQUIRE(statistics.m_hits == hits + 1);
+
+            // a budget of 0 turns the cache off
+            //
+            zf.setCacheBudget(0);
+            CATCH_REQUIRE(zf.getCacheBudget() == 0);
+            size_t const misses(zf.getCacheStatistics().m_misses);
+            CATCH_REQUIRE(read_stream(zf, "test_dir/file6.txt") == contents["test_dir/file6.txt"]);
+            CATCH_REQUIRE(zf.getCacheStatistics().m_misses == misses);
+            CATCH_REQUIRE(zf.getCacheStatistics().m_entries == 0);
+
+            zf.close();
+            CATCH_REQUIRE(zf.getCacheStatistics().m_budget == 0);
+        }
+        CATCH_END_SECTION()
+
+        CATCH_START_SECTION("concurrent access")
+        {
+            zipios::ZipFile zf("test.zip", 0, 0, access_mode);
+            zf.setCacheBudget(45000);
+
+            std::vector<std::string> names;
+            for(int i(0); i < 8; ++i)
+            {
+                names.push_back("test_dir/file" + std::to_string(i) + ".txt");
+            }
+
+            size_t const thread_count(8);
+            size_t const reads(200);
+            std::atomic<size_t> errors(0);
+            std::vector<std::thread> threads;
+            for(size_t t(0); t < thread_count; ++t)
+            {
+                threads.emplace_back([&zf, &contents, &names, &errors, &read_stream, t]()
+                    {
+                        for(size_t r(0); r < reads; ++r)
+                        {
+                            std::string const & name(names[(t * 7 + r * r) % names.size()]);
+                            std::string const data((r & 1) == 0
+                                    ? read_stream(zf, name)
+                                    : [&zf, &name]()
+                                        {
+                                            std::vector<char> const v(zf.readEntry(name));
+                                            return std::string(v.begin(), v.end());
+                                        }());
+                            if(data != contents.at(name))
+                            {
+                                ++errors;
+                            }
+                        }
+                    });
+            }
+            for(auto & t : threads)
+            {
+                t.join();
+            }
+            CATCH_REQUIRE(errors == 0);
+
+            zipios::ZipFile::cache_statistics_t const statistics(zf.getCacheStatistics());
+            CATCH_REQUIRE(statistics.m_hits + statistics.m_misses == thread_count * reads);
+            CATCH_REQUIRE(statistics.m_size <= 45000);
+            CATCH_REQUIRE(statistics.m_entries <= 4);
+        }
+        CATCH_END_SECTION()
+    }
+}
+
+
+CATCH_TEST_CASE("ZipFile I/O policies", "[ZipFile][FileCollection]")
+{
+    std::string const top_dir(SNAP_CATCH2_NAMESPACE::g_tmp_dir() + "/io-policy");
+    zipios_test::auto_unlink_t auto_unlink(top_dir, true);
+    CATCH_REQUIRE(system(("mkdir -p " + top_dir + "/test_dir").c_str()) == 0);
+    zipios_test::safe_chdir cwd(top_dir);
+
+    // files of various sizes so entries start at unaligned positions
+    //
+    std::map<std::string, std::string> contents;
+    for(int i(0); i < 12; ++i)
+    {
+        std::string const name("test_dir/file" + std::to_string(i) + ".txt");
+        size_t const size(rand() % (i * 20000 + 100) + 10);
+        std::string data;
+        while(data.length() < size)
+        {
+            data += "line " + std::to_string(rand()) + "\n";
+        }
+        data.resize(size);
+        std::ofstream out(name, std::ios::out | std::ios::binary);
+        out << data;
+        contents[name] = data;
+    }
+    {
+        zipios::DirectoryCollection dc("test_dir");
+        dc.setMethod(5000, zipios::StorageMethod::STORED, zipios::StorageMethod::DEFLATED);
+        std::ofstream out("test.zip", std::ios::out | std::ios::binary | std::ios::trunc);
+        zipios::ZipFile::saveCollectionToArchive(out, dc);
+    }
+
+    CATCH_START_SECTION("direct reads return the same data as normal reads")
+    {
+        zipios::SharedFile buffered("test.zip");
+        zipios::SharedFile direct("test.zip");
+        CATCH_REQUIRE_FALSE(direct.getDirectIO());
+        if(direct.setDirectIO(true))
+        {
+            CATCH_REQUIRE(direct.getDirectIO());
+            std::vector<char> const all([&buffered]()
+                {
+                    std::vector<char> data(buffered.size());
+                    CATCH_REQUIRE(buffered.read(data.data(), data.size(), 0) == data.size());
+                    return data;
+                }());
+            for(int i(0); i < 200; ++i)
+            {
+                zipios::offset_t const pos(rand() % (buffered.size() + 10));
+                size_t const size(rand() % (i < 10 ? 3 * 1024 * 1024 : 20000));
+                std::vector<char> expected(size);
+                std::vector<char> data(size);
+                size_t const expected_size(buffered.read(expected.data(), size, pos));
+                CATCH_REQUIRE(direct.read(data.data(), size, pos) == expected_size);
+                CATCH_REQUIRE(memcmp(data.data(), expected.data(), expected_size) == 0);
+                if(expected_size > 0)
+                {
+                    CATCH_REQUIRE(memcmp(data.data(), all.data() + pos, expected_size) == 0);
+                }
+            }
+        }
+        CATCH_REQUIRE_FALSE(direct.setDirectIO(false));
+        CATCH_REQUIRE_FALSE(direct.getDirectIO());
+    }
+    CATCH_END_SECTION()
+
+    zipios::ZipFile::io_policy_t const default_policy;
+    CATCH_REQUIRE(default_policy.m_access_pattern == zipios::ZipFile::AccessPattern::NORMAL);
+    CATCH_REQUIRE(default_policy.m_readahead_entries == 0);
+    CATCH_REQUIRE_FALSE(default_policy.m_drop_after_read);
+    CATCH_REQUIRE_FALSE(default_policy.m_direct_io);
+
+    for(auto const access_mode : { zipios::ZipFile::AccessMode::STREAM, zipios::ZipFile::AccessMode::MEMORY_MAP })
+    {
+        CATCH_START_SECTION("all the policies return the same data")
+        {
+            for(auto const pattern : { zipios::ZipFile::AccessPattern::NORMAL, zipios::ZipFile::AccessPattern::SEQUENTIAL, zipios::ZipFile::AccessPattern::RANDOM })
+            {
+                for(int flags(0); flags < 8; ++flags)
+                {
+                    zipios::ZipFile zf("test.zip", 0, 0, access_mode);
+                    zf.setVerifyCrc(true);
+
+                    zipios::ZipFile::io_policy_t const initial(zf.getIOPolicy());
+                    CATCH_REQUIRE(initial.m_access_pattern == zipios::ZipFile::AccessPattern::NORMAL);
+                    CATCH_REQUIRE(initial.m_readahead_entries == 0);
+                    CATCH_REQUIRE_FALSE(initial.m_drop_after_read);
+                    CATCH_REQUIRE_FALSE(initial.m_direct_io);
+
+                    zipios::ZipFile::io_policy_t policy;
+                    policy.m_access_pattern = pattern;
+                    policy.m_readahead_entries = (flags & 1) != 0 ? 3 : 0;
+                    policy.m_drop_after_read = (flags & 2) != 0;
+                    policy.m_direct_io = (flags & 4) != 0;
+                    zf.setIOPolicy(policy);
+
+                    zipios::ZipFile::io_policy_t const current(zf.getIOPolicy());
+                    CATCH_REQUIRE(current.m_access_pattern == pattern);
+                    CATCH_REQUIRE(current.m_readahead_entries == policy.m_readahead_entries);
+                    CATCH_REQUIRE(current.m_drop_after_read == policy.m_drop_after_read);
+                    if(access_mode == zipios::ZipFile::AccessMode::MEMORY_MAP
+                    || !policy.m_direct_io)
+                    {
+                        CATCH_REQUIRE_FALSE(current.m_direct_io);
+                    }
+
+                    for(auto const & c : contents)
+                    {
+                        std::vector<char> const data(zf.readEntry(c.first));
+                        CATCH_REQUIRE(std::string(data.begin(), data.end()) == c.second);
+
+                        zipios::FileCollection::stream_pointer_t is(zf.getInputStream(c.first));
+                        CATCH_REQUIRE(is != nullptr);
+                        std::string const streamed((std::istreambuf_iterator<char>(*is)), std::istreambuf_iterator<char>());
+                        CATCH_REQUIRE(streamed == c.second);
+
+                        // seek back within the entry
+                        //
+                        is->clear();
+                        std::streamoff const position(c.second.length() / 2);
+                        is->seekg(position, std::ios::beg);
+                        std::string const tail((std::istreambuf_iterator<char>(*is)), std::istreambuf_iterator<char>());
+                        CATCH_REQUIRE(tail == c.second.substr(position));
+
+                        zipios::ZipFile::entry_view_t const view(zf.getEntryView(c.first));
+                        if(view.m_data != nullptr)
+                        {
+                            CATCH_REQUIRE(std::string(view.m_data.get(), view.m_size) == c.second);
+                        }
+                    }
+
+                    // the clones get the policy
+                    //
+                    zipios::FileCollection::pointer_t clone(zf.clone());
+                    zipios::ZipFile * zf_clone(dynamic_cast<zipios::ZipFile *>(clone.get()));
+                    CATCH_REQUIRE(zf_clone != nullptr);
+                    CATCH_REQUIRE(zf_clone->getIOPolicy().m_readahead_entries == policy.m_readahead_entries);
+                    CATCH_REQUIRE(zf_clone->getIOPolicy().m_drop_after_read == policy.m_drop_after_read);
+                    std::vector<char> const last(zf_clone->readEntry("test_dir/file11.txt"));
+                    CATCH_REQUIRE(std::string(last.begin(), last.end()) == contents["test_dir/file11.txt"]);
+                }
+            }
+        }
+        CATCH_END_SECTION()
+
+        CATCH_START_SECTION("the cached entries are dropped once read")
+        {
+            zipios::ZipFile zf("test.zip", 0, 0, access_mode);
+            zipios::ZipFile::io_policy_t policy;
+            policy.m_readahead_entries = 100;
+            policy.m_drop_after_read = true;
+            zf.setIOPolicy(policy);
+            zf.setCacheBudget(1024 * 1024);
+            for(int repeat(0); repeat < 2; ++repeat)
+            {
+                for(auto const & c : contents)
+                {
+                    zipios::FileCollection::stream_pointer_t is(zf.getInputStream(c.first));
+                    CATCH_REQUIRE(is != nullptr);
+                    std::string const streamed((std::istreambuf_iterator<char>(*is)), std::istreambuf_iterator<char>());
+                    CATCH_REQUIRE(streamed == c.second);
+                }
+            }
+        }
+        CATCH_END_SECTION()
+    }
+}
+
 
 // Local Variables:
 // mode: cpp
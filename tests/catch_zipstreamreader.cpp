@@ -0,0 +1,717 @@
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (c) 2015-2022  Made to Order Software Corp.  All Rights Reserved
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ *
+ * Zipios unit tests for the forward-only ZipStreamReader.
+ */
+
+#include "catch_main.hpp"
+
+#include <src/ziplocalentry.hpp>
+#include <zipios/directorycollection.hpp>
+#include <zipios/zipfile.hpp>
+#include <zipios/zipiosexceptions.hpp>
+#include <zipios/zipstreamreader.hpp>
+
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+#include <zlib.h>
+
+
+namespace
+{
+
+
+/** \brief A stream buffer behaving like a pipe.
+ *
+ * The data is returned in small blocks of random sizes and the buffer
+ * cannot be repositioned. Any attempt to seek gets counted.
+ */
+class pipe_streambuf
+    : public std::streambuf
+{
+public:
+    pipe_streambuf(std::string const & data)
+        : m_data(data)
+    {
+    }
+
+    size_t seek_count() const
+    {
+        return m_seek_count;
+    }
+
+protected:
+    virtual int_type underflow() override
+    {
+        if(m_position >= m_data.length())
+        {
+            return traits_type::eof();
+        }
+        size_t const size(std::min(static_cast<size_t>(rand() % 3000 + 1), m_data.length() - m_position));
+        memcpy(m_buffer, m_data.data() + m_position, size);
+        m_position += size;
+        setg(m_buffer, m_buffer, m_buffer + size);
+        return traits_type::to_int_type(*gptr());
+    }
+
+    virtual pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override
+    {
+        static_cast<void>(off);
+        static_cast<void>(dir);
+        static_cast<void>(which);
+        ++m_seek_count;
+        return pos_type(off_type(-1));
+    }
+
+    virtual pos_type seekpos(pos_type pos, std::ios_base::openmode which) override
+    {
+        static_cast<void>(pos);
+        static_cast<void>(which);
+        ++m_seek_count;
+        return pos_type(off_type(-1));
+    }
+
+private:
+    std::string         m_data = std::string();
+    size_t              m_position = 0;
+    size_t              m_seek_count = 0;
+    char                m_buffer[3000] = {};
+};
+
+
+std::string read_file(std::string const & filename)
+{
+    std::ifstream in(filename, std::ios::in | std::ios::binary);
+    return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+}
+
+
+struct descriptor_entry_t
+{
+    std::string         m_name = std::string();
+    std::string         m_data = std::string();
+    bool                m_deflated = true;
+    bool                m_signature = true;     // the data descriptor starts with PK 7 8
+};
+
+
+void write16(std::string & out, uint32_t value)
+{
+    out += static_cast<char>(value);
+    out += static_cast<char>(value >> 8);
+}
+
+
+void write32(std::string & out, uint32_t value)
+{
+    write16(out, value);
+    write16(out, value >> 16);
+}
+
+
+/** \brief Create an archive as written by a streaming Zip writer.
+ *
+ * All the entries have bit 3 of their general purpose flags set. The
+ * local headers of the DEFLATED entries have their CRC32 and sizes set
+ * to zero. The local headers of the STORED entries include their sizes
+ * since otherwise a reader cannot find the end of their data. In both
+ * cases a data descriptor follows the data.
+ *
+ * \param[in] entries  The entries to save in the archive.
+ * \param[in] corrupt  The name of an entry which gets a data descriptor
+ *                     with a wrong uncompressed size.
+ *
+ * \return The archive.
+ */
+std::string data_descriptor_archive(std::vector<descriptor_entry_t> const & entries, std::string const & corrupt = std::string())
+{
+    uint32_t const dos_time(0x54210000);        // 2022/01/01 00:00:00
+
+    std::string archive;
+    std::string central_directory;
+    for(auto const & e : entries)
+    {
+        std::string compressed;
+        if(e.m_deflated)
+        {
+            z_stream zs = {};
+            CATCH_REQUIRE(deflateInit2(&zs, rand() % 9 + 1, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) == Z_OK);
+            compressed.resize(deflateBound(&zs, e.m_data.length()));
+            zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(e.m_data.data()));
+            zs.avail_in = static_cast<uInt>(e.m_data.length());
+            zs.next_out = reinterpret_cast<Bytef *>(&compressed[0]);
+            zs.avail_out = static_cast<uInt>(compressed.length());
+            CATCH_REQUIRE(deflate(&zs, Z_FINISH) == Z_STREAM_END);
+            compressed.resize(zs.total_out);
+            deflateEnd(&zs);
+        }
+        else
+        {
+            compressed = e.m_data;
+        }
+        uint32_t const crc(crc32(0, reinterpret_cast<Bytef const *>(e.m_data.data()), static_cast<uInt>(e.m_data.length())));
+        uint32_t const method(e.m_deflated ? 8 : 0);
+        uint32_t const offset(static_cast<uint32_t>(archive.length()));
+
+        write32(archive, 0x04034b50);
+        write16(archive, 20);                   // version needed to extract
+        write16(archive, 1 << 3);               // trailing data descriptor
+        write16(archive, method);
+        write32(archive, dos_time);
+        write32(archive, 0);                    // CRC32
+        write32(archive, e.m_deflated ? 0 : static_cast<uint32_t>(compressed.length()));
+        write32(archive, e.m_deflated ? 0 : static_cast<uint32_t>(e.m_data.length()));
+        write16(archive, static_cast<uint32_t>(e.m_name.length()));
+        write16(archive, 0);                    // extra field length
+        archive += e.m_name;
+        archive += compressed;
+        if(e.m_signature)
+        {
+            write32(archive, 0x08074b50);
+        }
+        write32(archive, crc);
+        write32(archive, static_cast<uint32_t>(compressed.length()));
+        write32(archive, static_cast<uint32_t>(e.m_data.length()) + (e.m_name == corrupt ? 1 : 0));
+
+        write32(central_directory, 0x02014b50);
+        write16(central_directory, 20);         // version made by
+        write16(central_directory, 20);         // version needed to extract
+        write16(central_directory, 1 << 3);
+        write16(central_directory, method);
+        write32(central_directory, dos_time);
+        write32(central_directory, crc);
+        write32(central_directory, static_cast<uint32_t>(compressed.length()));
+        write32(central_directory, static_cast<uint32_t>(e.m_data.length()));
+        write16(central_directory, static_cast<uint32_t>(e.m_name.length()));
+        write16(central_directory, 0);          // extra field length
+        write16(central_directory, 0);          // comment length
+        write16(central_directory, 0);          // disk number start
+        write16(central_directory, 0);          // internal attributes
+        write32(central_directory, 0);          // external attributes
+        write32(central_directory, offset);
+        central_directory += e.m_name;
+    }
+
+    uint32_t const central_directory_offset(static_cast<uint32_t>(archive.length()));
+    archive += central_directory;
+    write32(archive, 0x06054b50);
+    write16(archive, 0);                        // disk number
+    write16(archive, 0);                        // disk with the Central Directory
+    write16(archive, static_cast<uint32_t>(entries.size()));
+    write16(archive, static_cast<uint32_t>(entries.size()));
+    write32(archive, static_cast<uint32_t>(central_directory.length()));
+    write32(archive, central_directory_offset);
+    write16(archive, 0);                        // comment length
+
+    return archive;
+}
+
+
+} // no name namespace
+
+
+CATCH_TEST_CASE("ZipStreamReader reads archives without seeking", "[ZipStreamReader]")
+{
+    std::string const top_dir(SNAP_CATCH2_NAMESPACE::g_tmp_dir() + "/zip-stream-reader");
+    zipios_test::auto_unlink_t auto_unlink(top_dir, true);
+    CATCH_REQUIRE(system(("mkdir -p " + top_dir + "/test_dir/sub").c_str()) == 0);
+    zipios_test::safe_chdir cwd(top_dir);
+
+    std::map<std::string, std::string> contents;
+    for(int i(0); i < 10; ++i)
+    {
+        std::string const name((i % 3 == 0 ? "test_dir/sub/file" : "test_dir/file") + std::to_string(i) + ".txt");
+        size_t const size(i == 0 ? 0 : rand() % (i * 30000) + 1);
+        std::string data;
+        while(data.length() < size)
+        {
+            data += "line " + std::to_string(rand()) + "\n";
+        }
+        data.resize(size);
+        std::ofstream out(name, std::ios::out | std::ios::binary);
+        out << data;
+        contents[name] = data;
+    }
+    {
+        zipios::DirectoryCollection dc("test_dir");
+        dc.setMethod(10000, zipios::StorageMethod::STORED, zipios::StorageMethod::DEFLATED);
+        std::ofstream out("test.zip", std::ios::out | std::ios::binary | std::ios::trunc);
+        zipios::ZipFile::saveCollectionToArchive(out, dc);
+    }
+    std::string const archive(read_file("test.zip"));
+
+    // the entries in the order of the archive
+    //
+    std::vector<zipios::FileEntry::pointer_t> expected_entries;
+    {
+        zipios::ZipFile zf("test.zip");
+        for(auto const & entry : zf)
+        {
+            expected_entries.push_back(entry);
+        }
+    }
+
+    CATCH_START_SECTION("read all the entries in full")
+    {
+        pipe_streambuf buf(archive);
+        std::istream is(&buf);
+        zipios::ZipStreamReader reader(is);
+        CATCH_REQUIRE_FALSE(reader.getVerifyCrc());
+        reader.setVerifyCrc(true);
+        CATCH_REQUIRE(reader.getVerifyCrc());
+        CATCH_REQUIRE(reader.getEntry() == nullptr);
+        CATCH_REQUIRE(reader.getInputStream() == nullptr);
+
+        size_t count(0);
+        for(;;)
+        {
+            zipios::FileEntry::pointer_t entry(reader.nextEntry());
+            if(entry == nullptr)
+            {
+                break;
+            }
+            CATCH_REQUIRE(count < expected_entries.size());
+            zipios::FileEntry::pointer_t const expected(expected_entries[count]);
+            ++count;
+
+            CATCH_REQUIRE(reader.getEntry() == entry);
+            CATCH_REQUIRE(entry->getName() == expected->getName());
+            CATCH_REQUIRE(entry->isDirectory() == expected->isDirectory());
+            CATCH_REQUIRE(entry->getMethod() == expected->getMethod());
+            CATCH_REQUIRE(entry->getSize() == expected->getSize());
+            CATCH_REQUIRE(entry->getCrc() == expected->getCrc());
+
+            zipios::ZipStreamReader::stream_pointer_t data_stream(reader.getInputStream());
+            CATCH_REQUIRE(data_stream != nullptr);
+            CATCH_REQUIRE(reader.getInputStream() == data_stream);
+            std::string const data((std::istreambuf_iterator<char>(*data_stream)), std::istreambuf_iterator<char>());
+            CATCH_REQUIRE_FALSE(data_stream->bad());
+            if(entry->isDirectory())
+            {
+                CATCH_REQUIRE(data.empty());
+            }
+            else
+            {
+                CATCH_REQUIRE(data == contents[entry->getName()]);
+            }
+        }
+        CATCH_REQUIRE(count == expected_entries.size());
+        CATCH_REQUIRE(buf.seek_count() == 0);
+
+        // once at the end, the reader stays there
+        //
+        CATCH_REQUIRE(reader.nextEntry() == nullptr);
+        CATCH_REQUIRE(reader.nextEntry() == nullptr);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("partially read and skipped entries")
+    {
+        pipe_streambuf buf(archive);
+        std::istream is(&buf);
+        zipios::ZipStreamReader reader(is);
+
+        size_t count(0);
+        for(zipios::FileEntry::pointer_t entry(reader.nextEntry()); entry != nullptr; entry = reader.nextEntry())
+        {
+            ++count;
+            if(entry->isDirectory())
+            {
+                continue;
+            }
+            std::string const & expected(contents[entry->getName()]);
+            switch(count % 3)
+            {
+            case 0:
+                // skip the entry entirely
+                break;
+
+            case 1:
+            {
+                // read the start only
+                zipios::ZipStreamReader::stream_pointer_t data_stream(reader.getInputStream());
+                char start[100];
+                data_stream->read(start, sizeof(start));
+                size_t const size(data_stream->gcount());
+                CATCH_REQUIRE(size == std::min(sizeof(start), expected.length()));
+                CATCH_REQUIRE(std::string(start, size) == expected.substr(0, size));
+            }
+                break;
+
+            case 2:
+            {
+                // skip forward then read the rest
+                zipios::ZipStreamReader::stream_pointer_t data_stream(reader.getInputStream());
+                std::streamoff const position(expected.length() / 2);
+                data_stream->seekg(position, std::ios::beg);
+                CATCH_REQUIRE(data_stream->good());
+                std::string const tail((std::istreambuf_iterator<char>(*data_stream)), std::istreambuf_iterator<char>());
+                CATCH_REQUIRE(tail == expected.substr(position));
+            }
+                break;
+
+            }
+        }
+        CATCH_REQUIRE(count == expected_entries.size());
+        CATCH_REQUIRE(buf.seek_count() == 0);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("read from a file stream")
+    {
+        std::ifstream in("test.zip", std::ios::in | std::ios::binary);
+        zipios::ZipStreamReader reader(in);
+        size_t count(0);
+        while(reader.nextEntry() != nullptr)
+        {
+            ++count;
+        }
+        CATCH_REQUIRE(count == expected_entries.size());
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("the archive may start after other data")
+    {
+        std::istringstream in("some header before the archive" + archive);
+        in.seekg(30);
+        zipios::ZipStreamReader reader(in);
+        zipios::FileEntry::pointer_t entry(reader.nextEntry());
+        CATCH_REQUIRE(entry != nullptr);
+        CATCH_REQUIRE(entry->getName() == expected_entries[0]->getName());
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("empty archive")
+    {
+        std::string const empty("PK\x05\x06" + std::string(18, '\0'));
+        std::istringstream in(empty);
+        zipios::ZipStreamReader reader(in);
+        CATCH_REQUIRE(reader.nextEntry() == nullptr);
+        CATCH_REQUIRE(reader.getEntry() == nullptr);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("truncated archives")
+    {
+        // truncated in the middle of the data of the largest entry
+        //
+        zipios::FileEntry::pointer_t largest(expected_entries[0]);
+        for(auto const & entry : expected_entries)
+        {
+            if(entry->getCompressedSize() > largest->getCompressedSize())
+            {
+                largest = entry;
+            }
+        }
+        size_t const cut(static_cast<size_t>(largest->getEntryOffset()) + largest->getHeaderSize() + largest->getCompressedSize() / 2);
+        {
+            pipe_streambuf buf(archive.substr(0, cut));
+            std::istream is(&buf);
+            zipios::ZipStreamReader reader(is);
+            CATCH_REQUIRE_THROWS_AS([&reader]()
+                {
+                    while(reader.nextEntry() != nullptr)
+                    {
+                    }
+                }(), zipios::FileCollectionException);
+        }
+
+        // truncated before the Central Directory
+        //
+        {
+            size_t const central_directory(archive.find("PK\x01\x02"));
+            CATCH_REQUIRE(central_directory != std::string::npos);
+            pipe_streambuf buf(archive.substr(0, central_directory));
+            std::istream is(&buf);
+            zipios::ZipStreamReader reader(is);
+            CATCH_REQUIRE_THROWS_AS([&reader]()
+                {
+                    while(reader.nextEntry() != nullptr)
+                    {
+                    }
+                }(), zipios::FileCollectionException);
+        }
+
+        // truncated in a local header
+        //
+        {
+            pipe_streambuf buf(archive.substr(0, 20));
+            std::istream is(&buf);
+            zipios::ZipStreamReader reader(is);
+            CATCH_REQUIRE_THROWS_AS(reader.nextEntry(), zipios::FileCollectionException);
+        }
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("not an archive")
+    {
+        for(auto const & garbage : { std::string("this is not a zip archive"), std::string("PK\x09\x09 unknown record") })
+        {
+            std::istringstream in(garbage);
+            zipios::ZipStreamReader reader(in);
+            CATCH_REQUIRE_THROWS_AS(reader.nextEntry(), zipios::FileCollectionException);
+        }
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("a CRC error fails the stream")
+    {
+        // find the data of a DEFLATED entry and change its CRC
+        //
+        zipios::FileEntry::pointer_t deflated;
+        for(auto const & entry : expected_entries)
+        {
+            if(entry->getMethod() == zipios::StorageMethod::DEFLATED)
+            {
+                deflated = entry;
+                break;
+            }
+        }
+        CATCH_REQUIRE(deflated != nullptr);
+        std::string corrupted(archive);
+        corrupted[static_cast<size_t>(deflated->getEntryOffset()) + 14] ^= 0x55;   // CRC32 in the local header
+
+        pipe_streambuf buf(corrupted);
+        std::istream is(&buf);
+        zipios::ZipStreamReader reader(is);
+        reader.setVerifyCrc(true);
+        for(zipios::FileEntry::pointer_t entry(reader.nextEntry()); entry != nullptr; entry = reader.nextEntry())
+        {
+            zipios::ZipStreamReader::stream_pointer_t data_stream(reader.getInputStream());
+            char data[1024];
+            while(data_stream->read(data, sizeof(data)))
+            {
+            }
+            CATCH_REQUIRE(data_stream->bad() == (entry->getName() == deflated->getName()));
+        }
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("Entries with a trailing data descriptor", "[ZipStreamReader][ZipFile]")
+{
+    std::string const top_dir(SNAP_CATCH2_NAMESPACE::g_tmp_dir() + "/data-descriptor");
+    zipios_test::auto_unlink_t auto_unlink(top_dir, true);
+    CATCH_REQUIRE(system(("mkdir -p " + top_dir).c_str()) == 0);
+    zipios_test::safe_chdir cwd(top_dir);
+
+    // a mix of small and large entries so the data descriptors end up
+    // anywhere in the chunks read by the inflate stream
+    //
+    std::vector<descriptor_entry_t> entries;
+    for(int i(0); i < 12; ++i)
+    {
+        descriptor_entry_t e;
+        e.m_name = "file" + std::to_string(i) + ".txt";
+        size_t const size(i == 0 ? 0 : (i % 4 == 0 ? rand() % (300 * 1024) : rand() % 20000));
+        while(e.m_data.length() < size)
+        {
+            e.m_data += "line " + std::to_string(rand() % 1000) + " of " + e.m_name + "\n";
+        }
+        e.m_data.resize(size);
+        e.m_deflated = i % 3 != 2;
+        e.m_signature = (rand() & 1) != 0;
+        entries.push_back(e);
+    }
+    std::string const archive(data_descriptor_archive(entries));
+
+    CATCH_START_SECTION("stream the entries in full")
+    {
+        pipe_streambuf buf(archive);
+        std::istream is(&buf);
+        zipios::ZipStreamReader reader(is);
+        reader.setVerifyCrc(true);
+
+        for(auto const & e : entries)
+        {
+            zipios::FileEntry::pointer_t entry(reader.nextEntry());
+            CATCH_REQUIRE(entry != nullptr);
+            CATCH_REQUIRE(entry->getName() == e.m_name);
+
+            zipios::ZipStreamReader::stream_pointer_t data_stream(reader.getInputStream());
+            std::string const data((std::istreambuf_iterator<char>(*data_stream)), std::istreambuf_iterator<char>());
+            CATCH_REQUIRE_FALSE(data_stream->bad());
+            CATCH_REQUIRE(data == e.m_data);
+
+            // the data descriptor was read
+            //
+            zipios::FileEntry::pointer_t const complete(reader.getEntry());
+            CATCH_REQUIRE(complete->getSize() == e.m_data.length());
+            CATCH_REQUIRE(complete->getCrc() == crc32(0, reinterpret_cast<Bytef const *>(e.m_data.data()), static_cast<uInt>(e.m_data.length())));
+        }
+        CATCH_REQUIRE(reader.nextEntry() == nullptr);
+        CATCH_REQUIRE(buf.seek_count() == 0);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("skip some or all of the data")
+    {
+        pipe_streambuf buf(archive);
+        std::istream is(&buf);
+        zipios::ZipStreamReader reader(is);
+
+        for(auto const & e : entries)
+        {
+            zipios::FileEntry::pointer_t entry(reader.nextEntry());
+            CATCH_REQUIRE(entry != nullptr);
+            CATCH_REQUIRE(entry->getName() == e.m_name);
+            if((rand() & 1) != 0)
+            {
+                // read the start only
+                //
+                std::string data(std::min(static_cast<size_t>(rand() % 5000), e.m_data.length()), '\0');
+                zipios::ZipStreamReader::stream_pointer_t data_stream(reader.getInputStream());
+                data_stream->read(&data[0], data.length());
+                CATCH_REQUIRE(data == e.m_data.substr(0, data.length()));
+            }
+        }
+        CATCH_REQUIRE(reader.nextEntry() == nullptr);
+        CATCH_REQUIRE(buf.seek_count() == 0);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("read the entries with a ZipFile")
+    {
+        {
+            std::ofstream out("descriptor.zip", std::ios::out | std::ios::binary | std::ios::trunc);
+            out << archive;
+        }
+
+        for(auto const access_mode : { zipios::ZipFile::AccessMode::STREAM, zipios::ZipFile::AccessMode::MEMORY_MAP })
+        {
+            for(auto const verification_mode : { zipios::ZipFile::VerificationMode::FULL, zipios::ZipFile::VerificationMode::LAZY })
+            {
+                zipios::ZipFile zf("descriptor.zip", 0, 0, access_mode, verification_mode);
+                zf.setVerifyCrc(true);
+                CATCH_REQUIRE(zf.size() == entries.size());
+                for(auto const & e : entries)
+                {
+                    zipios::FileEntry::pointer_t entry(zf.getEntry(e.m_name));
+                    CATCH_REQUIRE(entry != nullptr);
+                    CATCH_REQUIRE(entry->getSize() == e.m_data.length());
+
+                    zipios::ZipFile::stream_pointer_t data_stream(zf.getInputStream(e.m_name));
+                    std::string const data((std::istreambuf_iterator<char>(*data_stream)), std::istreambuf_iterator<char>());
+                    CATCH_REQUIRE_FALSE(data_stream->bad());
+                    CATCH_REQUIRE(data == e.m_data);
+
+                    std::vector<char> const buffer(zf.readEntry(e.m_name));
+                    CATCH_REQUIRE(std::string(buffer.begin(), buffer.end()) == e.m_data);
+                }
+            }
+        }
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("a data descriptor which does not match the data fails the stream")
+    {
+        std::string const corrupt(entries[4].m_name);
+        std::string const corrupted(data_descriptor_archive(entries, corrupt));
+
+        pipe_streambuf buf(corrupted);
+        std::istream is(&buf);
+        zipios::ZipStreamReader reader(is);
+        for(zipios::FileEntry::pointer_t entry(reader.nextEntry()); entry != nullptr; entry = reader.nextEntry())
+        {
+            zipios::ZipStreamReader::stream_pointer_t data_stream(reader.getInputStream());
+            char data[1024];
+            while(data_stream->read(data, sizeof(data)))
+            {
+            }
+            CATCH_REQUIRE(data_stream->bad() == (entry->getName() == corrupt));
+        }
+
+        {
+            std::ofstream out("corrupted.zip", std::ios::out | std::ios::binary | std::ios::trunc);
+            out << corrupted;
+        }
+        zipios::ZipFile zf("corrupted.zip");
+        zipios::ZipFile::stream_pointer_t data_stream(zf.getInputStream(corrupt));
+        char data[1024];
+        while(data_stream->read(data, sizeof(data)))
+        {
+        }
+        CATCH_REQUIRE(data_stream->bad());
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("the data descriptor only relaxes the CRC32 and sizes")
+    {
+        // the archive starts with the local header of an entry with a
+        // data descriptor, its CRC32 and sizes are all zero
+        //
+        std::istringstream in(archive);
+        zipios::ZipLocalEntry header;
+        header.read(in);
+        CATCH_REQUIRE(header.hasTrailingDataDescriptor());
+        CATCH_REQUIRE(header.getCrc() == 0);
+        CATCH_REQUIRE_FALSE(header.hasCrc());
+
+        zipios::FileEntry::pointer_t same(header.clone());
+        CATCH_REQUIRE(header.isEqual(*same));
+        same->setSize(1234);
+        CATCH_REQUIRE(header.isEqual(*same));
+        CATCH_REQUIRE(same->isEqual(header));
+
+        // same CRC32 value but one side says it has no CRC32
+        //
+        zipios::FileEntry::pointer_t crc(header.clone());
+        crc->setCrc(0);
+        CATCH_REQUIRE(crc->hasCrc());
+        CATCH_REQUIRE_FALSE(header.isEqual(*crc));
+        CATCH_REQUIRE_FALSE(crc->isEqual(header));
+
+        zipios::FileEntry::pointer_t time(header.clone());
+        time->setUnixTime(header.getUnixTime() + 3600);
+        CATCH_REQUIRE_FALSE(header.isEqual(*time));
+
+        zipios::FileEntry::pointer_t comment(header.clone());
+        comment->setComment("different");
+        CATCH_REQUIRE_FALSE(header.isEqual(*comment));
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("a STORED entry of unknown size cannot be streamed")
+    {
+        std::string stored(data_descriptor_archive({ descriptor_entry_t{ "stored.txt", "some data", false, true } }));
+        stored[18] = stored[19] = stored[20] = stored[21] = '\0';      // compressed size in the local header
+
+        std::istringstream in(stored);
+        zipios::ZipStreamReader reader(in);
+        CATCH_REQUIRE_THROWS_AS(reader.nextEntry(), zipios::FileCollectionException);
+    }
+    CATCH_END_SECTION()
+}
+
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
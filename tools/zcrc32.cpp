@@ -1,11 +1,11 @@
 
 
-#include    <fstream>
+#include    "zipios/crc32.hpp"
+#include    "zipios/zipiosexceptions.hpp"
+
 #include    <iomanip>
 #include    <iostream>
 
-#include    <zlib.h>
-
 
 int main(int argc, char *argv[])
 {
@@ -15,23 +15,17 @@ int main(int argc, char *argv[])
         return 1;
     }
 
-    std::ifstream in(argv[1]);
-    if(!in)
+    uint32_t result(0);
+    try
     {
-        std::cerr << "error: could not access file \"" << argv[1] << "\".\n";
-        return 1;
+        // use all the CPUs, this tool does nothing else
+        //
+        result = zipios::crc32File(argv[1], 0);
     }
-
-    int result(crc32(0, nullptr, 0));
-    for(;;)
+    catch(zipios::IOException const &)
     {
-        char buf[64 * 1024];
-        in.read(buf, sizeof(buf));
-        if(in.gcount() == 0)
-        {
-            break;
-        }
-        result = crc32(result, reinterpret_cast<Bytef const *>(buf), in.gcount());
+        std::cerr << "error: could not access file \"" << argv[1] << "\".\n";
+        return 1;
     }
 
     std::cout << std::hex << std::setw(8) << std::setfill('0') << result << "\n";
@@ -186,7 +186,7 @@ int main(int argc, char *argv[])
                     std::cout << *it << ": ";
                 }
                 zipios::ZipFile zf(*it);
-                std::cout << zf.entries().size() << std::endl;
+                std::cout << zf.size() << std::endl;
             }
             break;
 
@@ -200,10 +200,9 @@ int main(int argc, char *argv[])
                 }
                 zipios::ZipFile zf(*it);
                 int count(0);
-                zipios::FileEntry::vector_t entries(zf.entries());
-                for(auto entry(entries.begin()); entry != entries.end(); ++entry)
+                for(auto const & entry : zf)
                 {
-                    if((*entry)->isDirectory())
+                    if(entry->isDirectory())
                     {
                         ++count;
                     }
@@ -222,10 +221,9 @@ int main(int argc, char *argv[])
                 }
                 zipios::ZipFile zf(*it);
                 int count(0);
-                zipios::FileEntry::vector_t entries(zf.entries());
-                for(auto entry(entries.begin()); entry != entries.end(); ++entry)
+                for(auto const & entry : zf)
                 {
-                    if(!(*entry)->isDirectory())
+                    if(!entry->isDirectory())
                     {
                         ++count;
                     }
@@ -32,6 +32,8 @@
 
 #include "zipios/filecollection.hpp"
 
+#include <deque>
+
 
 namespace zipios
 {
@@ -50,14 +52,35 @@ public:
     bool                            addCollection(FileCollection const & collection);
     bool                            addCollection(FileCollection::pointer_t collection);
     virtual void                    close() override;
-    virtual FileEntry::vector_t     entries() const override;
     virtual FileEntry::pointer_t    getEntry(std::string const & name, MatchPath matchpath = MatchPath::MATCH) const override;
+    virtual FileEntry::pointer_t    findEntry(std::string_view name, MatchPath matchpath = MatchPath::MATCH) const override;
     virtual stream_pointer_t        getInputStream(std::string const & entry_name, MatchPath matchpath = MatchPath::MATCH) override;
-    virtual size_t                  size() const override;
     virtual void                    mustBeValid() const;
 
 protected:
+    virtual stream_pointer_t        getEntryInputStream(FileEntry::pointer_t entry) override;
+    virtual void                    loadEntries() const override;
+
     vector_t                        m_collections;
+
+private:
+    struct overlay_entry_t
+    {
+        FileCollection::pointer_t   m_collection = FileCollection::pointer_t();
+        FileEntry::pointer_t        m_entry = FileEntry::pointer_t();
+    };
+    typedef std::unordered_map<std::string_view, overlay_entry_t> overlay_t;
+
+    void                            buildOverlay() const;
+    void                            addToOverlay(FileCollection::pointer_t collection) const;
+    void                            invalidateOverlay();
+    overlay_entry_t                 resolve(std::string_view name, MatchPath matchpath) const;
+
+    mutable std::deque<std::string> m_overlay_names = std::deque<std::string>();
+    mutable overlay_t               m_overlay = overlay_t();
+    mutable overlay_t               m_filename_overlay = overlay_t();
+    mutable std::shared_mutex       m_overlay_mutex = std::shared_mutex();
+    mutable std::atomic<bool>       m_overlay_valid = false;
 };
 
 
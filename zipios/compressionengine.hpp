@@ -0,0 +1,64 @@
+#pragma once
+#ifndef ZIPIOS_COMPRESSIONENGINE_HPP
+#define ZIPIOS_COMPRESSIONENGINE_HPP
+
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (c) 2015-2022  Made to Order Software Corp.  All Rights Reserved
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Select the library used to compress and decompress data.
+ *
+ * Zipios compresses and decompresses data through backends so the
+ * library doing the work can be selected at runtime with the functions
+ * declared here. At this time zlib is the only engine.
+ */
+
+#include "zipios/zipios-config.hpp"
+
+#include <cstdint>
+
+
+namespace zipios
+{
+
+
+enum class CompressionEngine : uint32_t
+{
+    ZLIB
+};
+
+
+bool                    isCompressionEngineAvailable(CompressionEngine engine);
+void                    setCompressionEngine(CompressionEngine engine);
+CompressionEngine       getCompressionEngine();
+char const *            getCompressionEngineName(CompressionEngine engine);
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
+#endif
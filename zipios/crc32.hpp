@@ -0,0 +1,58 @@
+#pragma once
+#ifndef ZIPIOS_CRC32_HPP
+#define ZIPIOS_CRC32_HPP
+
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (c) 2015-2022  Made to Order Software Corp.  All Rights Reserved
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc.,  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Compute the CRC-32 of buffers and files.
+ *
+ * This file declares the functions used to compute the same CRC-32
+ * checksum as the one saved in zip archives. The implementation
+ * selects the fastest kernel available on the running CPU.
+ */
+
+#include "zipios/zipios-config.hpp"
+
+#include <cstdint>
+#include <string>
+
+
+namespace zipios
+{
+
+
+uint32_t            crc32Parallel(void const * buffer, size_t size, size_t thread_count = 0);
+uint32_t            crc32File(std::string const & filename, size_t thread_count = 1);
+char const *        crc32Engine();
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
+#endif
@@ -45,19 +45,24 @@ public:
                                     DirectoryCollection(
                                               std::string const & path
                                             , bool recursive = true);
+                                    DirectoryCollection(DirectoryCollection const & rhs);
     virtual pointer_t               clone() const override;
     virtual                         ~DirectoryCollection() override;
 
+    DirectoryCollection &           operator = (DirectoryCollection const & rhs);
+
     virtual void                    close() override;
     virtual FileEntry::vector_t     entries() const override;
     virtual FileEntry::pointer_t    getEntry(std::string const & name, MatchPath matchpath = MatchPath::MATCH) const override;
     virtual stream_pointer_t        getInputStream(std::string const & entry_name, MatchPath matchpath = MatchPath::MATCH) override;
 
 protected:
-    void                            loadEntries() const;
+    virtual stream_pointer_t        getEntryInputStream(FileEntry::pointer_t entry) override;
+    virtual void                    loadEntries() const override;
     void                            load(FilePath const & subdir);
 
-    mutable bool                    m_entries_loaded = false;
+    mutable std::mutex              m_load_mutex = std::mutex();
+    mutable std::atomic<bool>       m_entries_loaded = false;
     bool                            m_recursive = true;
     FilePath                        m_filepath;
 };
@@ -32,17 +32,34 @@
 
 #include "zipios/fileentry.hpp"
 
+#include <atomic>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <string_view>
+#include <unordered_map>
+
 
 namespace zipios
 {
 
 
+class CollectionCollection;
+
+
 class FileCollection
 {
 public:
     typedef std::shared_ptr<FileCollection> pointer_t;
     typedef std::vector<pointer_t>          vector_t;
     typedef std::shared_ptr<std::istream>   stream_pointer_t;
+    typedef FileEntry::vector_t::const_iterator
+                                            const_iterator;
+    typedef std::function<bool(FileEntry const & entry)>
+                                            filter_t;
+    typedef std::map<std::string, std::string>
+                                            extract_errors_t;
 
     enum class MatchPath : uint32_t
     {
@@ -60,7 +77,12 @@ public:
     virtual void                    addEntry(FileEntry const & entry);
     virtual void                    close();
     virtual FileEntry::vector_t     entries() const;
+    extract_errors_t                extractAll(std::string const & directory, size_t thread_count = 0);
+    extract_errors_t                extract(std::string const & directory, filter_t const & filter, size_t thread_count = 0);
+    const_iterator                  begin() const;
+    const_iterator                  end() const;
     virtual FileEntry::pointer_t    getEntry(std::string const & name, MatchPath matchpath = MatchPath::MATCH) const;
+    virtual FileEntry::pointer_t    findEntry(std::string_view name, MatchPath matchpath = MatchPath::MATCH) const;
     virtual stream_pointer_t        getInputStream(std::string const & entry_name, MatchPath matchpath = MatchPath::MATCH) = 0;
     virtual std::string             getName() const;
     virtual size_t                  size() const;
@@ -70,9 +92,26 @@ public:
     void                            setLevel(size_t limit, FileEntry::CompressionLevel small_compression_level, FileEntry::CompressionLevel large_compression_level);
 
 protected:
+    friend class CollectionCollection;
+
+    virtual stream_pointer_t        getEntryInputStream(FileEntry::pointer_t entry);
+    virtual void                    loadEntries() const;
+    void                            invalidateIndex();
+
     std::string                     m_filename = std::string();
     FileEntry::vector_t             m_entries = FileEntry::vector_t();
     bool                            m_valid = true;
+
+private:
+    typedef std::unordered_map<std::string_view, FileEntry::pointer_t> name_index_t;
+
+    void                            buildIndex() const;
+
+    mutable std::vector<std::string> m_index_names = std::vector<std::string>();
+    mutable name_index_t            m_name_index = name_index_t();
+    mutable name_index_t            m_filename_index = name_index_t();
+    mutable std::shared_mutex       m_index_mutex = std::shared_mutex();
+    mutable std::atomic<bool>       m_index_valid = false;
 };
 
 
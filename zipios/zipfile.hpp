@@ -44,29 +44,131 @@ namespace zipios
 {
 
 
+class EntryCache;
+class InflateIndexCache;
+class MemoryMappedFile;
+class SharedFile;
+
+
 class ZipFile : public FileCollection
 {
 public:
-    static pointer_t            openEmbeddedZipFile(std::string const & filename);
-
-                                ZipFile();
-                                ZipFile(std::string const & filename, offset_t s_off = 0, offset_t e_off = 0);
-                                ZipFile(std::istream & is, offset_t s_off = 0, offset_t e_off = 0);
-    virtual pointer_t           clone() const override;
-    virtual                     ~ZipFile() override;
-
-    virtual stream_pointer_t    getInputStream(
-                                          std::string const & entry_name
-                                        , MatchPath matchpath = MatchPath::MATCH) override;
-    static void                 saveCollectionToArchive(
-                                          std::ostream & os
-                                        , FileCollection & collection
-                                        , std::string const & zip_comment = std::string());
+    enum class AccessMode : uint32_t
+    {
+        STREAM,
+        MEMORY_MAP
+    };
+
+    enum class VerificationMode : uint32_t
+    {
+        NONE,
+        LAZY,
+        SAMPLED,
+        FULL
+    };
+
+    enum class AccessPattern : uint32_t
+    {
+        NORMAL,
+        SEQUENTIAL,
+        RANDOM
+    };
+
+    struct io_policy_t
+    {
+        AccessPattern                   m_access_pattern = AccessPattern::NORMAL;
+        size_t                          m_readahead_entries = 0;
+        bool                            m_drop_after_read = false;
+        bool                            m_direct_io = false;
+    };
+
+    struct entry_view_t
+    {
+        std::shared_ptr<char const>     m_data = std::shared_ptr<char const>();
+        size_t                          m_size = 0;
+    };
+
+    struct cache_statistics_t
+    {
+        size_t                          m_hits = 0;
+        size_t                          m_misses = 0;
+        size_t                          m_evictions = 0;
+        size_t                          m_entries = 0;
+        size_t                          m_size = 0;
+        size_t                          m_budget = 0;
+    };
+
+    static pointer_t                    openEmbeddedZipFile(std::string const & filename);
+
+                                        ZipFile();
+                                        ZipFile(
+                                                  std::string const & filename
+                                                , offset_t s_off = 0
+                                                , offset_t e_off = 0
+                                                , AccessMode access_mode = AccessMode::STREAM
+                                                , VerificationMode verification_mode = VerificationMode::FULL);
+                                        ZipFile(
+                                                  std::istream & is
+                                                , offset_t s_off = 0
+                                                , offset_t e_off = 0
+                                                , VerificationMode verification_mode = VerificationMode::FULL);
+    virtual pointer_t                   clone() const override;
+    virtual                             ~ZipFile() override;
+
+    virtual void                        close() override;
+    void                                setVerifyCrc(bool verify_crc);
+    bool                                getVerifyCrc() const;
+    void                                setCheckpointInterval(size_t interval);
+    size_t                              getCheckpointInterval() const;
+    void                                setCacheBudget(size_t budget);
+    size_t                              getCacheBudget() const;
+    cache_statistics_t                  getCacheStatistics() const;
+    void                                clearCache();
+    void                                setIOPolicy(io_policy_t const & policy);
+    io_policy_t                         getIOPolicy() const;
+    virtual stream_pointer_t            getInputStream(
+                                                  std::string const & entry_name
+                                                , MatchPath matchpath = MatchPath::MATCH) override;
+    entry_view_t                        getEntryView(
+                                                  std::string const & entry_name
+                                                , MatchPath matchpath = MatchPath::MATCH);
+    size_t                              readEntry(
+                                                  std::string const & entry_name
+                                                , char * buffer
+                                                , size_t size
+                                                , MatchPath matchpath = MatchPath::MATCH);
+    std::vector<char>                   readEntry(
+                                                  std::string const & entry_name
+                                                , MatchPath matchpath = MatchPath::MATCH);
+    static void                         saveCollectionToArchive(
+                                                  std::ostream & os
+                                                , FileCollection & collection
+                                                , std::string const & zip_comment = std::string()
+                                                , size_t thread_count = 1);
+
+protected:
+    virtual stream_pointer_t            getEntryInputStream(FileEntry::pointer_t entry) override;
 
 private:
-    void                        init(std::istream & is);
-
-    VirtualSeeker               m_vs = VirtualSeeker();
+    void                                init(std::istream & is);
+    void                                verifyLocalHeader(std::istream & is, FileEntry const & entry);
+    offset_t                            findEntryData(FileEntry const & entry) const;
+    void                                readEntryData(FileEntry const & entry, char * buffer);
+    std::shared_ptr<std::vector<char> const>
+                                        getCachedData(FileEntry::pointer_t entry);
+    void                                readAhead(FileEntry const & entry) const;
+    void                                dropEntryData(FileEntry const & entry, offset_t end) const;
+
+    VirtualSeeker                       m_vs = VirtualSeeker();
+    VerificationMode                    m_verification_mode = VerificationMode::FULL;
+    bool                                m_verify_crc = false;
+    size_t                              m_checkpoint_interval = 0;
+    std::shared_ptr<InflateIndexCache>  m_index_cache = std::shared_ptr<InflateIndexCache>();
+    std::shared_ptr<EntryCache>         m_entry_cache = std::shared_ptr<EntryCache>();
+    io_policy_t                         m_io_policy = io_policy_t();
+    std::vector<offset_t>               m_entry_offsets = std::vector<offset_t>();
+    std::shared_ptr<MemoryMappedFile>   m_mapped_file = std::shared_ptr<MemoryMappedFile>();
+    std::shared_ptr<SharedFile>         m_shared_file = std::shared_ptr<SharedFile>();
 };
 
 
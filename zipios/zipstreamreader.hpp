@@ -0,0 +1,85 @@
+#pragma once
+#ifndef ZIPIOS_ZIPSTREAMREADER_HPP
+#define ZIPIOS_ZIPSTREAMREADER_HPP
+
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (c) 2015-2022  Made to Order Software Corp.  All Rights Reserved
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Define the zipios::ZipStreamReader class.
+ *
+ * The zipios::ZipStreamReader class reads a Zip archive from a stream
+ * which cannot be repositioned, such as a pipe, one entry at a time.
+ */
+
+#include "zipios/fileentry.hpp"
+
+#include <iostream>
+#include <memory>
+
+
+namespace zipios
+{
+
+
+class ForwardInputStreambuf;
+class ZipInputStream;
+
+
+class ZipStreamReader
+{
+public:
+    typedef std::shared_ptr<std::istream>   stream_pointer_t;
+
+                                        ZipStreamReader(std::istream & is);
+                                        ZipStreamReader(ZipStreamReader const & rhs) = delete;
+                                        ~ZipStreamReader();
+
+    ZipStreamReader &                   operator = (ZipStreamReader const & rhs) = delete;
+
+    void                                setVerifyCrc(bool verify_crc);
+    bool                                getVerifyCrc() const;
+    FileEntry::pointer_t                nextEntry();
+    FileEntry::pointer_t                getEntry() const;
+    stream_pointer_t                    getInputStream() const;
+
+private:
+    std::shared_ptr<ForwardInputStreambuf>
+                                        m_buffer = std::shared_ptr<ForwardInputStreambuf>();
+    std::unique_ptr<std::istream>       m_input = std::unique_ptr<std::istream>();
+    std::shared_ptr<ZipInputStream>     m_stream = std::shared_ptr<ZipInputStream>();
+    FileEntry::pointer_t                m_entry = FileEntry::pointer_t();
+    offset_t                            m_data_end = 0;
+    bool                                m_verify_crc = false;
+    bool                                m_end = false;
+};
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
+#endif